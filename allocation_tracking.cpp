@@ -0,0 +1,236 @@
+#include "allocation_tracking.h"
+
+#include "context.h"
+
+#include <array>
+#include <cstdlib>
+#include <format>
+#include <new>
+
+thread_local AllocationPhase current_allocation_phase = AllocationPhase::other;
+
+static std::atomic<bool> is_tracking_enabled{};
+static std::array<AllocationCounters, num_allocation_phases> phase_counters{};
+
+void *operator new(size_t size)
+{
+    if (is_tracking_enabled.load(std::memory_order_relaxed))
+    {
+        auto &counters = phase_counters[static_cast<size_t>(current_allocation_phase)];
+        counters.num_allocations.fetch_add(1, std::memory_order_relaxed);
+        counters.num_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    auto result = malloc(size == 0 ? 1 : size);
+    if (result == nullptr)
+    {
+        throw std::bad_alloc{};
+    }
+
+    return result;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    free(pointer);
+}
+
+void enable_allocation_tracking()
+{
+    is_tracking_enabled.store(true, std::memory_order_relaxed);
+}
+
+const AllocationCounters &allocation_counters(AllocationPhase phase)
+{
+    return phase_counters[static_cast<size_t>(phase)];
+}
+
+std::string_view to_string(AllocationPhase phase)
+{
+    switch (phase)
+    {
+        case AllocationPhase::other:            return "other";
+        case AllocationPhase::parse:            return "parse";
+        case AllocationPhase::desugar:          return "desugar";
+        case AllocationPhase::convert:          return "convert";
+        case AllocationPhase::typecheck:        return "typecheck";
+        case AllocationPhase::compile_ir:       return "compile_ir";
+        case AllocationPhase::optimize:         return "optimize";
+        case AllocationPhase::codegen:          return "codegen";
+        case AllocationPhase::compile_bytecode: return "compile_bytecode";
+        case AllocationPhase::run:              return "run";
+    }
+
+    UNREACHED;
+}
+
+// The heap memory that the nodes of a tree own through their members
+struct OwnedMemory
+{
+    uint64_t child_lists{};
+    uint64_t scopes{};
+    uint64_t strings{};
+};
+
+static bool is_on_heap(const std::string &string)
+{
+    auto object = reinterpret_cast<const char *>(&string);
+    return string.data() < object || string.data() >= object + sizeof(string);
+}
+
+static uint64_t string_bytes(const std::string &string)
+{
+    return is_on_heap(string) ? string.capacity() + 1 : 0;
+}
+
+struct OwnedMemoryCounter : NodeVisitorBase
+{
+    std::array<OwnedMemory, num_node_kinds> owned_memory{};
+
+    OwnedMemory &of(NodeKind kind) { return this->owned_memory[static_cast<size_t>(kind)]; }
+
+    void visit(BlockNode *block) override
+    {
+        auto &owned = this->of(NodeKind::block);
+        owned.child_lists += block->statements.capacity() * sizeof(Node *);
+
+        // NOTE: This is an estimate because the layout of the hash table nodes is up to the standard library
+        using Entry = std::pair<const std::string, DeclarationNode *>;
+        owned.scopes += block->declarations.bucket_count() * sizeof(void *);
+        owned.scopes += block->declarations.size() * (sizeof(Entry) + 2 * sizeof(void *));
+        for (const auto &[name, declaration] : block->declarations)
+        {
+            owned.scopes += string_bytes(name);
+        }
+    }
+
+    void visit(GenericNode *generic) override
+    {
+        auto &owned = this->of(NodeKind::generic);
+        owned.child_lists += generic->type_parameters.capacity() * sizeof(std::string_view);
+        for (const auto &instance : generic->instances)
+        {
+            owned.child_lists += instance.type_arguments.capacity() * sizeof(Node *);
+            owned.strings += string_bytes(instance.identifier);
+        }
+    }
+
+    void visit(LiteralNode *literal) override
+    {
+        if (auto string = std::get_if<std::string>(&literal->value))
+        {
+            this->of(NodeKind::literal).strings += string_bytes(*string);
+        }
+    }
+
+    void visit(ProcedureCallNode *procedure_call) override
+    {
+        this->of(NodeKind::procedure_call).child_lists += procedure_call->arguments.capacity() * sizeof(Node *);
+    }
+
+    void visit(ProcedureSignatureNode *procedure_signature) override
+    {
+        this->of(NodeKind::procedure_signature).child_lists +=
+            procedure_signature->arguments.capacity() * sizeof(DeclarationNode *);
+    }
+};
+
+void print_allocation_statistics(std::ostream &out, const Context &ctx, ModuleNode *module_node)
+{
+    out << "Heap allocations by phase:" << std::endl;
+    out << std::format("    {:<20} {:>14} {:>14}", "phase", "allocations", "bytes") << std::endl;
+
+    uint64_t total_allocations{};
+    uint64_t total_bytes{};
+    for (size_t i = 0; i < num_allocation_phases; ++i)
+    {
+        const auto &counters = phase_counters[i];
+        auto num_allocations = counters.num_allocations.load(std::memory_order_relaxed);
+        auto num_bytes       = counters.num_bytes.load(std::memory_order_relaxed);
+
+        total_allocations += num_allocations;
+        total_bytes += num_bytes;
+
+        out << std::format(
+                   "    {:<20} {:>14} {:>14}",
+                   to_string(static_cast<AllocationPhase>(i)),
+                   num_allocations,
+                   num_bytes)
+            << std::endl;
+    }
+
+    out << std::format("    {:<20} {:>14} {:>14}", "total", total_allocations, total_bytes) << std::endl;
+
+    OwnedMemoryCounter counter{};
+    visit(module_node, counter);
+
+    out << std::format(
+               "Context pool: {} of {} bytes used (peak {}) in {} allocations",
+               ctx.pool.used_bytes(),
+               ctx.pool.capacity(),
+               ctx.pool.peak_bytes,
+               ctx.pool.num_allocations)
+        << std::endl;
+    out << std::format("    {:<20} {:>14}", "phase", "bytes") << std::endl;
+    for (size_t i = 0; i < num_allocation_phases; ++i)
+    {
+        if (ctx.pool.bytes_by_phase[i] != 0)
+        {
+            auto phase = to_string(static_cast<AllocationPhase>(i));
+            out << std::format("    {:<20} {:>14}", phase, ctx.pool.bytes_by_phase[i]) << std::endl;
+        }
+    }
+
+    out << std::format(
+               "    {:<20} {:>10} {:>12} {:>12} {:>12} {:>12}",
+               "node kind",
+               "nodes",
+               "pool bytes",
+               "child lists",
+               "scopes",
+               "strings")
+        << std::endl;
+
+    uint64_t node_bytes{};
+    OwnedMemory total_owned{};
+    for (size_t i = 0; i < num_node_kinds; ++i)
+    {
+        const auto &statistics = ctx.node_statistics[i];
+        const auto &owned      = counter.owned_memory[i];
+        if (statistics.num_nodes == 0)
+        {
+            continue;
+        }
+
+        node_bytes += statistics.num_bytes;
+        total_owned.child_lists += owned.child_lists;
+        total_owned.scopes += owned.scopes;
+        total_owned.strings += owned.strings;
+
+        out << std::format(
+                   "    {:<20} {:>10} {:>12} {:>12} {:>12} {:>12}",
+                   to_string(static_cast<NodeKind>(i)),
+                   statistics.num_nodes,
+                   statistics.num_bytes,
+                   owned.child_lists,
+                   owned.scopes,
+                   owned.strings)
+            << std::endl;
+    }
+
+    // The rest of the pool is the syntax tree of parse and desugar, see the pool bytes of those phases above
+    out << std::format(
+               "    {:<20} {:>10} {:>12} {:>12} {:>12} {:>12}",
+               "total",
+               "",
+               node_bytes,
+               total_owned.child_lists,
+               total_owned.scopes,
+               total_owned.strings)
+        << std::endl;
+}
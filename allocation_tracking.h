@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Attributes the memory that the compiler allocates to the phase of the pipeline that allocated it.
+//
+// The global operator new counts every allocation in the phase that is current on the allocating thread, once
+// tracking is enabled. Code that calls malloc directly is not counted, which includes some of LLVM's containers
+// (SmallVector, DenseMap), and neither is the pool of a Context, which counts its bytes per phase itself
+// (see MemoryPool::bytes_by_phase). The syntax tree of parse and desugar and the nodes live in that pool, the nodes are
+// also counted per node kind by the Context (see Context::node_statistics). The heap memory owned by nodes (child
+// lists, scopes, string literals) is measured by walking the tree.
+
+enum class AllocationPhase
+{
+    other,
+    parse,
+    desugar,
+    convert,  // Syntax tree to nodes
+    typecheck,
+    compile_ir,
+    optimize,
+    codegen,
+    compile_bytecode,
+    run,
+};
+
+constexpr size_t num_allocation_phases = static_cast<size_t>(AllocationPhase::run) + 1;
+
+// Set with SET_TEMPORARILY around the work of a phase
+extern thread_local AllocationPhase current_allocation_phase;
+
+struct AllocationCounters
+{
+    std::atomic<uint64_t> num_allocations{};
+    std::atomic<uint64_t> num_bytes{};
+};
+
+void enable_allocation_tracking();
+const AllocationCounters &allocation_counters(AllocationPhase phase);
+
+std::string_view to_string(AllocationPhase phase);
+
+// Prints the heap allocations per phase and the pool and heap memory of the nodes of the context
+void print_allocation_statistics(std::ostream &out, const struct Context &ctx, struct ModuleNode *module_node);
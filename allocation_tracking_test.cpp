@@ -0,0 +1,83 @@
+#include "allocation_tracking.h"
+#include "context.h"
+#include "frontend.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+static const auto source = R"(
+printf := proc(format: *i8, ...) i32 external
+
+main := proc() void
+{
+    a := 1
+    if a < 2 printf("%d\n", a + 3)
+}
+)"sv;
+
+TEST_CASE("Nodes are counted per kind", "[allocation_tracking]")
+{
+    Context ctx{};
+    auto module_node = analyze_source(ctx, source);
+    REQUIRE(module_node != nullptr);
+
+    auto statistics = [&](NodeKind kind) { return ctx.node_statistics[static_cast<size_t>(kind)]; };
+
+    CHECK(statistics(NodeKind::module).num_nodes == 1);
+    CHECK(statistics(NodeKind::module).num_bytes == sizeof(ModuleNode));
+    CHECK(statistics(NodeKind::if_statement).num_nodes == 1);
+    CHECK(statistics(NodeKind::procedure_call).num_nodes == 1);
+    CHECK(statistics(NodeKind::block).num_nodes >= 3);
+
+    uint64_t num_bytes{};
+    for (const auto &kind_statistics : ctx.node_statistics)
+    {
+        num_bytes += kind_statistics.num_bytes;
+    }
+
+    CHECK(num_bytes <= ctx.pool.used_bytes());
+    CHECK(ctx.pool.used_bytes() <= ctx.pool.peak_bytes);
+
+    // The syntax tree is in the pool too
+    auto pool_bytes = [&](AllocationPhase phase) { return ctx.pool.bytes_by_phase[static_cast<size_t>(phase)]; };
+    CHECK(pool_bytes(AllocationPhase::parse) > 0);
+    CHECK(pool_bytes(AllocationPhase::convert) > 0);
+
+    size_t phase_bytes{};
+    for (auto bytes : ctx.pool.bytes_by_phase)
+    {
+        phase_bytes += bytes;
+    }
+
+    CHECK(phase_bytes == ctx.pool.used_bytes());
+}
+
+TEST_CASE("Heap allocations are counted in the current phase", "[allocation_tracking]")
+{
+    enable_allocation_tracking();
+
+    auto num_allocations = [](AllocationPhase phase)
+    { return allocation_counters(phase).num_allocations.load(std::memory_order_relaxed); };
+
+    auto num_parse_allocations     = num_allocations(AllocationPhase::parse);
+    auto num_typecheck_allocations = num_allocations(AllocationPhase::typecheck);
+
+    Context ctx{};
+    REQUIRE(analyze_source(ctx, source) != nullptr);
+
+    CHECK(num_allocations(AllocationPhase::parse) > num_parse_allocations);
+    CHECK(num_allocations(AllocationPhase::typecheck) > num_typecheck_allocations);
+
+    auto num_run_allocations = num_allocations(AllocationPhase::run);
+    auto num_run_bytes       = allocation_counters(AllocationPhase::run).num_bytes.load(std::memory_order_relaxed);
+
+    {
+        SET_TEMPORARILY(current_allocation_phase, AllocationPhase::run);
+
+        // NOTE: Not a new-expression, those may be optimized away
+        auto memory = ::operator new(100);
+        ::operator delete(memory);
+    }
+
+    CHECK(num_allocations(AllocationPhase::run) == num_run_allocations + 1);
+    CHECK(allocation_counters(AllocationPhase::run).num_bytes.load(std::memory_order_relaxed) == num_run_bytes + 100);
+}
@@ -0,0 +1,37 @@
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct
+{
+    int64_t x, y, z;
+    int64_t vx, vy, vz;
+    int64_t mass, charge;
+} Particle;
+
+int main(void)
+{
+    static Particle particles[65536];
+    for (int64_t i = 0; i < 65536; ++i)
+    {
+        particles[i].x    = i;
+        particles[i].vx   = i % 7 - 3;
+        particles[i].mass = i % 5 + 1;
+    }
+
+    for (int64_t step = 0; step < 100; ++step)
+    {
+        for (int64_t i = 0; i < 65536; ++i)
+        {
+            particles[i].x = particles[i].x + particles[i].vx;
+        }
+    }
+
+    int64_t checksum = 0;
+    for (int64_t i = 0; i < 65536; ++i)
+    {
+        checksum = checksum + particles[i].x * particles[i].mass;
+    }
+
+    printf("%lld\n", (long long)checksum);
+    return 0;
+}
@@ -0,0 +1,19 @@
+#include <stdint.h>
+#include <stdio.h>
+
+int main(void)
+{
+    int64_t sum = 0;
+    for (int64_t i = 0; i < 10000000; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            continue;
+        }
+
+        sum = sum + i * 2;
+    }
+
+    printf("%lld\n", (long long)sum);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include <stdint.h>
+#include <stdio.h>
+
+static int64_t a(int64_t i, int64_t k)
+{
+    return (i * 3 + k * 7) % 11 - 5;
+}
+
+static int64_t b(int64_t k, int64_t j)
+{
+    return (k * 5 + j * 2) % 13 - 6;
+}
+
+int main(void)
+{
+    int64_t n        = 200;
+    int64_t checksum = 0;
+    for (int64_t i = 0; i < n; ++i)
+    {
+        for (int64_t j = 0; j < n; ++j)
+        {
+            int64_t c = 0;
+            for (int64_t k = 0; k < n; ++k)
+            {
+                c = c + a(i, k) * b(k, j);
+            }
+
+            checksum = checksum + c * (i + j + 1);
+        }
+    }
+
+    printf("%lld\n", (long long)checksum);
+    return 0;
+}
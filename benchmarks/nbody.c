@@ -0,0 +1,43 @@
+#include <math.h>
+#include <stdio.h>
+
+int main(void)
+{
+    double x0 = 0.0, y0 = 0.0, vx0 = 0.0, vy0 = 0.0;
+    double x1 = 1.0, y1 = 0.0, vx1 = 0.0, vy1 = 1.0;
+    double x2 = 0.0, y2 = 2.0, vx2 = 0.5, vy2 = 0.0;
+
+    double dt        = 0.001;
+    double softening = 0.01;
+
+    for (long step = 0; step < 1000000; ++step)
+    {
+        double dx = x1 - x0;
+        double dy = y1 - y0;
+        double d2 = dx * dx + dy * dy + softening;
+        double f  = dt / (d2 * sqrt(d2));
+        vx0 = vx0 + dx * f, vy0 = vy0 + dy * f;
+        vx1 = vx1 - dx * f, vy1 = vy1 - dy * f;
+
+        dx = x2 - x0;
+        dy = y2 - y0;
+        d2 = dx * dx + dy * dy + softening;
+        f  = dt / (d2 * sqrt(d2));
+        vx0 = vx0 + dx * f, vy0 = vy0 + dy * f;
+        vx2 = vx2 - dx * f, vy2 = vy2 - dy * f;
+
+        dx = x2 - x1;
+        dy = y2 - y1;
+        d2 = dx * dx + dy * dy + softening;
+        f  = dt / (d2 * sqrt(d2));
+        vx1 = vx1 + dx * f, vy1 = vy1 + dy * f;
+        vx2 = vx2 - dx * f, vy2 = vy2 - dy * f;
+
+        x0 = x0 + vx0 * dt, y0 = y0 + vy0 * dt;
+        x1 = x1 + vx1 * dt, y1 = y1 + vy1 * dt;
+        x2 = x2 + vx2 * dt, y2 = y2 + vy2 * dt;
+    }
+
+    printf("%.6f %.6f\n", x0, y0);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include <stdint.h>
+#include <stdio.h>
+
+int main(void)
+{
+    int64_t sum = 0;
+    for (int64_t i = 0; i < 1000; ++i)
+    {
+        for (int64_t j = 0; j < 1000; ++j)
+        {
+            for (int64_t k = 0; k < 20; ++k)
+            {
+                sum = sum + (i * j + k) % 7;
+            }
+        }
+    }
+
+    printf("%lld\n", (long long)sum);
+    return 0;
+}
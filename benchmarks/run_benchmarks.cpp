@@ -0,0 +1,366 @@
+// Runs the compute kernels in the benchmarks directory with every execution mode of the compiler (the JIT at every
+// optimization level, the interpreter and mixed mode) and compares them against the equivalent C programs next to
+// them, compiled with clang -O2 ($CC overrides the compiler). Every kernel prints its result, the outputs of all modes
+// must match the output of the C program.
+//
+// Usage: run-benchmarks [--repetitions n] [benchmarks directory]
+// The reported times are the best of the repetitions. Compile times include code generation, optimization and
+// machine code generation, but not parsing and type checking. Run times only include main, the C programs measure
+// their main themselves (see timing_main.c).
+
+#include "basics.h"
+#include "compile_ir.h"
+#include "compile_vm.h"
+#include "frontend.h"
+#include "jit.h"
+#include "mixed_program.h"
+#include "string_util.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <llvm/IR/Module.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Measurement
+{
+    double compile_ms{};
+    double run_ms{};
+    std::string output{};
+};
+
+// Everything the program prints (also from JIT compiled code calling printf) goes to a temporary file while it runs
+static std::string capture_stdout(const std::function<void()> &run)
+{
+    fflush(stdout);
+
+    auto file  = tmpfile();
+    auto saved = dup(STDOUT_FILENO);
+    dup2(fileno(file), STDOUT_FILENO);
+
+    run();
+
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    std::string output{};
+    rewind(file);
+    for (int c; (c = fgetc(file)) != EOF;)
+    {
+        output.push_back(static_cast<char>(c));
+    }
+
+    fclose(file);
+
+    return output;
+}
+
+// optimization_level 0 runs the unoptimized code
+static Measurement run_with_jit(ModuleNode *module_node, int optimization_level)
+{
+    Measurement result{};
+
+    auto start              = Clock::now();
+    auto compilation_result = compile_to_ir(module_node, IrCompilationOptions{.internalize = true});
+    if (optimization_level != 0)
+    {
+        optimize_module(*compilation_result.module, optimization_level);
+    }
+
+    Jit jit{};
+    jit.add_module(std::move(compilation_result.context), std::move(compilation_result.module));
+    auto main = reinterpret_cast<void (*)()>(jit.get_symbol_address("main"));
+    result.compile_ms = milliseconds_since(start);
+
+    result.output = capture_stdout(
+        [&]
+        {
+            start = Clock::now();
+            main();
+            result.run_ms = milliseconds_since(start);
+        });
+
+    return result;
+}
+
+static Measurement run_with_interpreter(ModuleNode *module_node)
+{
+    Measurement result{};
+
+    auto start   = Clock::now();
+    auto program = compile_to_bytecode(module_node);
+    result.compile_ms = milliseconds_since(start);
+
+    Vm vm{};
+    result.output = capture_stdout(
+        [&]
+        {
+            start = Clock::now();
+            run_main(&vm, &program);
+            result.run_ms = milliseconds_since(start);
+        });
+
+    return result;
+}
+
+// The hot procedures are compiled while the program runs, so all of the time is run time
+static Measurement run_mixed(ModuleNode *module_node)
+{
+    Measurement result{};
+
+    Jit jit{};
+    result.output = capture_stdout(
+        [&]
+        {
+            auto start = Clock::now();
+            MixedProgram program{jit, module_node};
+            program.run_main();
+            result.run_ms = milliseconds_since(start);
+        });
+
+    return result;
+}
+
+static std::optional<Measurement> run_c(const fs::path &source_path)
+{
+    Measurement result{};
+
+    auto compiler        = getenv("CC") != nullptr ? getenv("CC") : "clang";
+    auto executable_path = fs::temp_directory_path() / std::format("fasel-benchmark-{}", source_path.stem().string());
+    auto object_path     = fs::path{executable_path}.replace_extension(".o");
+    auto timing_path     = source_path.parent_path() / "timing_main.c";
+
+    defer
+    {
+        fs::remove(object_path);
+        fs::remove(executable_path);
+    };
+
+    // The main of the benchmark becomes benchmark_main, which the main of timing_main.c measures
+    auto start   = Clock::now();
+    auto command = std::format(
+        "{0} -O2 -Dmain=benchmark_main -c -o {1} {2} && {0} -O2 -o {3} {4} {1} -lm",
+        compiler,
+        object_path.string(),
+        source_path.string(),
+        executable_path.string(),
+        timing_path.string());
+    if (std::system(command.c_str()) != 0)
+    {
+        std::cerr << "Failed to compile " << source_path << std::endl;
+        return std::nullopt;
+    }
+
+    result.compile_ms = milliseconds_since(start);
+
+    auto stream = popen(executable_path.c_str(), "r");
+    if (stream == nullptr)
+    {
+        std::cerr << "Failed to run " << executable_path << std::endl;
+        return std::nullopt;
+    }
+
+    for (int c; (c = fgetc(stream)) != EOF;)
+    {
+        result.output.push_back(static_cast<char>(c));
+    }
+
+    auto status = pclose(stream);
+    if (status != 0)
+    {
+        std::cerr << std::format("{} exited with status {}", executable_path.string(), status) << std::endl;
+        return std::nullopt;
+    }
+
+    // The last line is the time of benchmark_main
+    constexpr auto marker = "benchmark_main ms "sv;
+    auto time_line        = result.output.rfind(marker);
+    if (time_line == std::string::npos)
+    {
+        std::cerr << std::format("{} did not print the time of its main", executable_path.string()) << std::endl;
+        return std::nullopt;
+    }
+
+    result.run_ms = atof(result.output.c_str() + time_line + marker.size());
+    result.output.resize(time_line);
+
+    return result;
+}
+
+static std::string_view first_line(std::string_view output)
+{
+    return output.substr(0, output.find('\n'));
+}
+
+int main(int argc, char **argv)
+{
+    auto repetitions = 1;
+    fs::path directory{"../benchmarks"};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+        {
+            repetitions = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            directory = argv[i];
+        }
+    }
+
+    std::vector<fs::path> paths{};
+    for (const auto &entry : fs::directory_iterator{directory})
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".fsl")
+        {
+            paths.push_back(entry.path());
+        }
+    }
+
+    std::ranges::sort(paths);
+
+    if (paths.empty())
+    {
+        std::cerr << "No benchmarks in " << directory << std::endl;
+        return 1;
+    }
+
+    auto num_mismatches = 0;
+
+    std::cout << std::format(
+                     "{:<20} {:<12} {:>12} {:>12} {:>8}  {}",
+                     "benchmark",
+                     "mode",
+                     "compile ms",
+                     "run ms",
+                     "vs. C",
+                     "output")
+              << std::endl;
+
+    for (const auto &path : paths)
+    {
+        auto source = read_file_as_string(path.string());
+        if (source.has_value() == false)
+        {
+            std::cerr << "Failed to read " << path << std::endl;
+            return 1;
+        }
+
+        auto modes = std::vector<std::pair<std::string, std::function<Measurement(ModuleNode *)>>>{
+            {"JIT",         [](ModuleNode *node) { return run_with_jit(node, 0); }},
+            {"JIT -O1",     [](ModuleNode *node) { return run_with_jit(node, 1); }},
+            {"JIT -O2",     [](ModuleNode *node) { return run_with_jit(node, 2); }},
+            {"JIT -O3",     [](ModuleNode *node) { return run_with_jit(node, 3); }},
+            {"interpreter", run_with_interpreter},
+            {"mixed",       run_mixed},
+        };
+
+        auto best = [&](const std::function<std::optional<Measurement>()> &measure)
+        {
+            std::optional<Measurement> result{};
+            for (auto i = 0; i < repetitions; ++i)
+            {
+                auto measurement = measure();
+                if (measurement.has_value() == false)
+                {
+                    return measurement;
+                }
+
+                if (result.has_value() == false)
+                {
+                    result = std::move(measurement);
+                    continue;
+                }
+
+                result->compile_ms = std::min(result->compile_ms, measurement->compile_ms);
+                result->run_ms     = std::min(result->run_ms, measurement->run_ms);
+            }
+
+            return result;
+        };
+
+        auto c_path = fs::path{path}.replace_extension(".c");
+        std::optional<Measurement> c{};
+        if (fs::exists(c_path))
+        {
+            c = best([&] { return run_c(c_path); });
+        }
+
+        auto print = [&](std::string_view mode, const Measurement &measurement)
+        {
+            auto ratio = c.has_value() ? std::format("{:.2f}x", measurement.run_ms / c->run_ms) : std::string{"-"};
+            std::cout << std::format(
+                             "{:<20} {:<12} {:>12.1f} {:>12.1f} {:>8}  {}",
+                             path.filename().string(),
+                             mode,
+                             measurement.compile_ms,
+                             measurement.run_ms,
+                             ratio,
+                             first_line(measurement.output))
+                      << std::endl;
+        };
+
+        if (c.has_value())
+        {
+            print("C", c.value());
+        }
+
+        for (const auto &[mode, run] : modes)
+        {
+            auto measurement = best(
+                [&]() -> std::optional<Measurement>
+                {
+                    // Every run gets a fresh AST because the backends annotate the nodes while compiling them
+                    Context ctx{};
+                    auto module_node = analyze_source(ctx, source.value());
+                    if (module_node == nullptr)
+                    {
+                        return std::nullopt;
+                    }
+
+                    // Every mode runs main, looking it up aborts if it does not exist
+                    if (module_node->block->declarations.contains("main") == false)
+                    {
+                        std::cerr << path.string() << " has no main procedure" << std::endl;
+                        return std::nullopt;
+                    }
+
+                    return run(module_node);
+                });
+
+            if (measurement.has_value() == false)
+            {
+                std::cerr << "Failed to compile " << path << std::endl;
+                return 1;
+            }
+
+            print(mode, measurement.value());
+
+            if (c.has_value() && measurement->output != c->output)
+            {
+                std::cerr << std::format("Output of {} ({}) does not match the C program", path.string(), mode)
+                          << std::endl;
+                ++num_mismatches;
+            }
+        }
+    }
+
+    return num_mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+// Feeds many programs through the service mode of the compiler (fasel --serve) and checks that its memory stays flat:
+// a long-running service must free everything that it allocated for a program once the program finished.
+// The programs are the ones in the serve directory next to this file, served round-robin.
+//
+// Usage: serve-memory [--programs n] <fasel> [programs directory]
+// Prints the latencies and the resident set size after every tenth of the programs, and fails if the resident set
+// size at the end exceeds the one after the first tenth (the warm-up, where caches and pools fill up) by more than
+// the tolerance.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Allowed growth of the resident set size after the warm-up, the larger of the two
+constexpr int64_t tolerance_percent = 5;
+constexpr int64_t tolerance_kib     = 8 * 1024;
+
+struct Report
+{
+    int64_t program{};
+    double compile_ms{};
+    double run_ms{};
+    int64_t rss_kib{};
+    int64_t max_rss_kib{};
+};
+
+// Parses the line that fasel --serve prints for every program:
+// [<program>] <path>: compile <ms> ms, run <ms> ms, rss <KiB> KiB, max rss <KiB> KiB
+// The programs print to the same stream, so other lines are not reports.
+static std::optional<Report> parse_report(const std::string &line)
+{
+    auto separator = line.rfind(": compile ");
+    if (line.starts_with("[") == false || separator == std::string::npos)
+    {
+        return std::nullopt;
+    }
+
+    Report report{};
+
+    long long program     = 0;
+    long long rss_kib     = 0;
+    long long max_rss_kib = 0;
+    if (sscanf(line.c_str(), "[%lld]", &program) != 1 ||
+        sscanf(line.c_str() + separator,
+               ": compile %lf ms, run %lf ms, rss %lld KiB, max rss %lld KiB",
+               &report.compile_ms,
+               &report.run_ms,
+               &rss_kib,
+               &max_rss_kib) != 4)
+    {
+        return std::nullopt;
+    }
+
+    report.program     = program;
+    report.rss_kib     = rss_kib;
+    report.max_rss_kib = max_rss_kib;
+
+    return report;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    auto index = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+    std::ranges::nth_element(values, values.begin() + static_cast<ptrdiff_t>(index));
+    return values[index];
+}
+
+static double mean(std::span<const double> values)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+
+    auto sum = 0.0;
+    for (auto value : values)
+    {
+        sum += value;
+    }
+
+    return sum / static_cast<double>(values.size());
+}
+
+static void print_latencies(const char *label, std::span<const double> compile_ms, std::span<const double> run_ms)
+{
+    std::vector<double> compile{compile_ms.begin(), compile_ms.end()};
+    std::vector<double> run{run_ms.begin(), run_ms.end()};
+
+    std::cout << std::format(
+                     "{:<12} compile mean {:7.3f} p50 {:7.3f} p99 {:7.3f} ms, "
+                     "run mean {:7.3f} p50 {:7.3f} p99 {:7.3f} ms",
+                     label,
+                     mean(compile),
+                     percentile(compile, 0.5),
+                     percentile(compile, 0.99),
+                     mean(run),
+                     percentile(run, 0.5),
+                     percentile(run, 0.99))
+              << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int64_t num_programs = 100000;
+    const char *fasel    = nullptr;
+    fs::path directory{"../benchmarks/serve"};
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--programs") == 0 && i + 1 < argc)
+        {
+            num_programs = std::max(10LL, atoll(argv[++i]));
+        }
+        else if (fasel == nullptr)
+        {
+            fasel = argv[i];
+        }
+        else
+        {
+            directory = argv[i];
+        }
+    }
+
+    if (fasel == nullptr)
+    {
+        std::cerr << "Usage: serve-memory [--programs n] <fasel> [programs directory]" << std::endl;
+        return 1;
+    }
+
+    std::vector<fs::path> paths{};
+    for (const auto &entry : fs::directory_iterator{directory})
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".fsl")
+        {
+            paths.push_back(fs::absolute(entry.path()));
+        }
+    }
+
+    std::ranges::sort(paths);
+
+    if (paths.empty())
+    {
+        std::cerr << "No programs in " << directory << std::endl;
+        return 1;
+    }
+
+    // The paths go through a file rather than a pipe, popen only gives us one end
+    auto input_path = fs::temp_directory_path() / std::format("serve-memory-{}.txt", getpid());
+    {
+        std::ofstream input{input_path};
+        for (int64_t i = 0; i < num_programs; ++i)
+        {
+            input << paths[static_cast<size_t>(i) % paths.size()].string() << '\n';
+        }
+    }
+
+    auto command = std::format("\"{}\" --serve < \"{}\"", fasel, input_path.string());
+    auto output  = popen(command.c_str(), "r");
+    if (output == nullptr)
+    {
+        std::cerr << "Could not run " << command << std::endl;
+        fs::remove(input_path);
+        return 1;
+    }
+
+    std::cout << std::format("Serving {} programs ({} different ones) with {}", num_programs, paths.size(), fasel)
+              << std::endl;
+
+    auto tenth = num_programs / 10;
+
+    std::vector<double> compile_ms{};
+    std::vector<double> run_ms{};
+    std::vector<int64_t> rss_kib_at_tenth{};
+    int64_t max_rss_kib = 0;
+    std::string summary{};
+
+    char *line_buffer       = nullptr;
+    size_t line_buffer_size = 0;
+    while (getline(&line_buffer, &line_buffer_size, output) != -1)
+    {
+        std::string line{line_buffer};
+        if (line.ends_with('\n'))
+        {
+            line.pop_back();
+        }
+
+        if (line.starts_with("Served "))
+        {
+            summary = line;
+            continue;
+        }
+
+        auto report = parse_report(line);
+        if (report.has_value() == false)
+        {
+            continue;
+        }
+
+        compile_ms.push_back(report->compile_ms);
+        run_ms.push_back(report->run_ms);
+        max_rss_kib = report->max_rss_kib;
+
+        if (report->program % tenth == 0)
+        {
+            rss_kib_at_tenth.push_back(report->rss_kib);
+
+            auto from  = compile_ms.size() - static_cast<size_t>(tenth);
+            auto label = std::format("{:>8}", report->program);
+            print_latencies(label.c_str(), std::span{compile_ms}.subspan(from), std::span{run_ms}.subspan(from));
+            std::cout << std::format("{:<12} rss {} KiB", "", report->rss_kib) << std::endl;
+        }
+    }
+
+    free(line_buffer);
+    auto status = pclose(output);
+    fs::remove(input_path);
+
+    std::cout << std::endl;
+
+    if (summary.empty() == false)
+    {
+        std::cout << summary << std::endl;
+    }
+
+    if (status != 0 || static_cast<int64_t>(compile_ms.size()) != num_programs || rss_kib_at_tenth.empty())
+    {
+        std::cerr << std::format("fasel --serve served {} of {} programs (exit status {})",
+                                 compile_ms.size(),
+                                 num_programs,
+                                 status)
+                  << std::endl;
+        return 1;
+    }
+
+    print_latencies("all", compile_ms, run_ms);
+
+    auto warm_rss_kib  = rss_kib_at_tenth.front();
+    auto final_rss_kib = rss_kib_at_tenth.back();
+    auto growth_kib    = final_rss_kib - warm_rss_kib;
+    auto allowed_kib   = std::max(warm_rss_kib * tolerance_percent / 100, tolerance_kib);
+
+    std::cout << std::format("rss after warm-up {} KiB, at the end {} KiB (max rss {} KiB): grew by {} KiB ({:.1f} "
+                             "bytes per program after the warm-up), {} KiB allowed",
+                             warm_rss_kib,
+                             final_rss_kib,
+                             max_rss_kib,
+                             growth_kib,
+                             static_cast<double>(growth_kib) * 1024.0 / static_cast<double>(num_programs - tenth),
+                             allowed_kib)
+              << std::endl;
+
+    if (growth_kib > allowed_kib)
+    {
+        std::cout << "FAILED: the memory of fasel --serve grows with the number of programs" << std::endl;
+        return 1;
+    }
+
+    std::cout << "OK: the memory of fasel --serve stays flat" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct
+{
+    int64_t x[65536], y[65536], z[65536];
+    int64_t vx[65536], vy[65536], vz[65536];
+    int64_t mass[65536], charge[65536];
+} Particles;
+
+int main(void)
+{
+    static Particles particles;
+    for (int64_t i = 0; i < 65536; ++i)
+    {
+        particles.x[i]    = i;
+        particles.vx[i]   = i % 7 - 3;
+        particles.mass[i] = i % 5 + 1;
+    }
+
+    for (int64_t step = 0; step < 100; ++step)
+    {
+        for (int64_t i = 0; i < 65536; ++i)
+        {
+            particles.x[i] = particles.x[i] + particles.vx[i];
+        }
+    }
+
+    int64_t checksum = 0;
+    for (int64_t i = 0; i < 65536; ++i)
+    {
+        checksum = checksum + particles.x[i] * particles.mass[i];
+    }
+
+    printf("%lld\n", (long long)checksum);
+    return 0;
+}
@@ -0,0 +1,31 @@
+#include <stdint.h>
+#include <stdio.h>
+
+static uint64_t count_matching_bytes(uint64_t word, uint64_t pattern)
+{
+    uint64_t low_bits  = 0x7f7f7f7f7f7f7f7full;
+    uint64_t high_bits = 0x8080808080808080ull;
+    uint64_t ones      = 0x0101010101010101ull;
+
+    uint64_t x        = word ^ pattern;
+    uint64_t non_zero = (((x & low_bits) + low_bits) | x) & high_bits;
+
+    return 8 - ((non_zero >> 7) * ones >> 56);
+}
+
+int main(void)
+{
+    uint64_t pattern = 0x6161616161616161ull;
+    uint64_t state   = 12345;
+    uint64_t count   = 0;
+
+    for (int64_t i = 0; i < 20000000; ++i)
+    {
+        state         = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t word = (state & 0x0303030303030303ull) | 0x6060606060606060ull;
+        count         = count + count_matching_bytes(word, pattern);
+    }
+
+    printf("%llu\n", (unsigned long long)count);
+    return 0;
+}
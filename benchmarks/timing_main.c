@@ -0,0 +1,23 @@
+// The main function of the C versions of the benchmarks, whose own main is renamed to benchmark_main (see run_c in
+// run_benchmarks.cpp). It prints the time that benchmark_main took as the last line of the output, so starting and
+// ending the process is not measured, just like only main() is measured for Fasel.
+
+#include <stdio.h>
+#include <time.h>
+
+int benchmark_main(void);
+
+int main(void)
+{
+    struct timespec start;
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = benchmark_main();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double milliseconds = (double)(end.tv_sec - start.tv_sec) * 1e3 + (double)(end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("benchmark_main ms %f\n", milliseconds);
+
+    return status;
+}
@@ -0,0 +1,93 @@
+#include "context.h"
+#include "frontend.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+static const auto source = R"(
+sum := proc(values: []i64) i64
+{
+    result := 0
+    for i 0:<values.length {
+        result = result + values[i]
+    }
+
+    return result
+}
+
+get := proc(values: []i64, index: i64) i64
+{
+    return values[index]
+}
+
+shrink := proc(values: []i64) i64
+{
+    result := 0
+    for i 0:<values.length {
+        values = values[1:]
+        result = result + values[i]
+    }
+
+    return result
+}
+
+fixed := proc() void
+{
+    elements: [8]i64
+    for i 0:<8 {
+        elements[i] = i
+    }
+
+    for i 0:<=8 {
+        elements[i] = i
+    }
+
+    elements[7] = 0
+}
+)"sv;
+
+struct IndexCollector : NodeVisitorBase
+{
+    std::vector<IndexNode *> indices{};
+
+    void visit(IndexNode *index) override { this->indices.push_back(index); }
+};
+
+static std::vector<bool> needs_bounds_checks(ModuleNode *module_node, std::string_view procedure_name)
+{
+    auto declaration = module_node->block->find_declaration(procedure_name);
+    auto procedure   = node_cast<ProcedureNode, true>(declaration->init_expression);
+
+    IndexCollector collector{};
+    visit(procedure->body, collector);
+
+    std::vector<bool> result{};
+    for (auto index : collector.indices)
+    {
+        result.push_back(index->needs_bounds_check);
+    }
+
+    return result;
+}
+
+TEST_CASE("Indices that are known to be in bounds are not checked", "[bounds_check]")
+{
+    Context ctx{};
+    auto module_node = analyze_source(ctx, source);
+    REQUIRE(module_node != nullptr);
+
+    CHECK(needs_bounds_checks(module_node, "sum") == std::vector<bool>{false});
+    CHECK(needs_bounds_checks(module_node, "get") == std::vector<bool>{true});
+    CHECK(needs_bounds_checks(module_node, "shrink") == std::vector<bool>{true});
+    CHECK(needs_bounds_checks(module_node, "fixed") == std::vector<bool>{false, true, false});
+}
+
+TEST_CASE("Bounds checks can be disabled", "[bounds_check]")
+{
+    Context ctx{};
+    ctx.bounds_checks = false;
+    auto module_node  = analyze_source(ctx, source);
+    REQUIRE(module_node != nullptr);
+
+    CHECK(needs_bounds_checks(module_node, "get") == std::vector<bool>{false});
+    CHECK(needs_bounds_checks(module_node, "fixed") == std::vector<bool>{false, false, false});
+}
@@ -0,0 +1,314 @@
+#include "bytecode_image.h"
+
+#include "runtime.h"
+
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+static uint64_t align_up(uint64_t value)
+{
+    return (value + bytecode_image_alignment - 1) / bytecode_image_alignment * bytecode_image_alignment;
+}
+
+BytecodeImage::~BytecodeImage()
+{
+    if (this->data != nullptr)
+    {
+        munmap(const_cast<uint8_t *>(this->data), this->size);
+    }
+}
+
+bool write_bytecode_image(const VmProgram &program, std::string_view path)
+{
+    auto strings = std::string{program.string_table()};
+
+    auto add_string = [&](std::string_view string)
+    {
+        auto offset = static_cast<uint64_t>(strings.size());
+        strings += string;
+        strings.push_back('\0');
+
+        return offset;
+    };
+
+    std::vector<BytecodeImageProcedure> procedures{};
+    for (const auto &procedure : program.procedures)
+    {
+        procedures.push_back(BytecodeImageProcedure{
+            .name            = add_string(procedure.name),
+            .address         = procedure.address,
+            .num_arguments   = static_cast<uint32_t>(procedure.num_arguments),
+            .num_registers   = static_cast<uint32_t>(procedure.num_registers),
+            .num_results     = static_cast<uint32_t>(procedure.num_results),
+            .frame_alignment = static_cast<uint32_t>(procedure.frame_alignment),
+            .frame_size      = static_cast<uint64_t>(procedure.frame_size),
+        });
+    }
+
+    std::vector<BytecodeImageExternalCall> external_calls{};
+    std::vector<VmValueKind> constant_pool{};
+    for (const auto &call : program.external_calls)
+    {
+        external_calls.push_back(BytecodeImageExternalCall{
+            .name           = add_string(call.name),
+            .argument_kinds = static_cast<uint64_t>(constant_pool.size()),
+            .num_arguments  = static_cast<uint32_t>(call.argument_kinds.size()),
+            .return_kind    = call.return_kind,
+        });
+        constant_pool.insert(constant_pool.end(), call.argument_kinds.begin(), call.argument_kinds.end());
+    }
+
+    auto code = program.code();
+
+    BytecodeImageHeader header{
+        .version        = bytecode_image_version,
+        .header_size    = sizeof(BytecodeImageHeader),
+        .main_procedure = program.main_procedure,
+    };
+    memcpy(header.magic, bytecode_image_magic, sizeof(header.magic));
+
+    auto end     = align_up(sizeof(header));
+    auto section = [&](uint64_t size)
+    {
+        auto result = BytecodeImageSection{.offset = end, .size = size};
+        end         = align_up(end + size);
+
+        return result;
+    };
+
+    header.code           = section(code.size());
+    header.strings        = section(strings.size());
+    header.procedures     = section(procedures.size() * sizeof(BytecodeImageProcedure));
+    header.external_calls = section(external_calls.size() * sizeof(BytecodeImageExternalCall));
+    header.constant_pool  = section(constant_pool.size());
+
+    std::vector<uint8_t> image(end);
+    memcpy(image.data(), &header, sizeof(header));
+    memcpy(image.data() + header.code.offset, code.data(), header.code.size);
+    memcpy(image.data() + header.strings.offset, strings.data(), header.strings.size);
+    memcpy(image.data() + header.procedures.offset, procedures.data(), header.procedures.size);
+    memcpy(image.data() + header.external_calls.offset, external_calls.data(), header.external_calls.size);
+    memcpy(image.data() + header.constant_pool.offset, constant_pool.data(), header.constant_pool.size);
+
+    std::ofstream file{std::string{path}, std::ios::binary};
+    if (file.is_open() == false)
+    {
+        std::cerr << "Could not open bytecode image " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+
+    return file.good();
+}
+
+bool is_bytecode_image(std::string_view path)
+{
+    std::ifstream file{std::string{path}, std::ios::binary};
+
+    char magic[sizeof(bytecode_image_magic)]{};
+    file.read(magic, sizeof(magic));
+
+    return file.good() && memcmp(magic, bytecode_image_magic, sizeof(magic)) == 0;
+}
+
+std::optional<VmProgram> map_bytecode_image(std::string_view path)
+{
+    auto fd = open(std::string{path}.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        std::cerr << "Could not open bytecode image " << path << std::endl;
+        return std::nullopt;
+    }
+
+    defer
+    {
+        close(fd);
+    };
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size < static_cast<off_t>(sizeof(BytecodeImageHeader)))
+    {
+        std::cerr << "Not a bytecode image: " << path << std::endl;
+        return std::nullopt;
+    }
+
+    auto size = static_cast<size_t>(file_stat.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "Could not map bytecode image " << path << std::endl;
+        return std::nullopt;
+    }
+
+    auto image  = std::make_shared<BytecodeImage>();
+    image->data = static_cast<const uint8_t *>(data);
+    image->size = size;
+
+    auto malformed = [&](std::string_view reason)
+    {
+        std::cerr << std::format("Malformed bytecode image {}: {}", path, reason) << std::endl;
+        return std::nullopt;
+    };
+
+    BytecodeImageHeader header{};
+    memcpy(&header, image->data, sizeof(header));
+
+    if (memcmp(header.magic, bytecode_image_magic, sizeof(header.magic)) != 0)
+    {
+        std::cerr << "Not a bytecode image: " << path << std::endl;
+        return std::nullopt;
+    }
+
+    if (header.version != bytecode_image_version || header.header_size != sizeof(header))
+    {
+        std::cerr << std::format(
+                         "Bytecode image {} has version {}, expected version {}",
+                         path,
+                         header.version,
+                         bytecode_image_version)
+                  << std::endl;
+        return std::nullopt;
+    }
+
+    for (auto section : {header.code, header.strings, header.procedures, header.external_calls, header.constant_pool})
+    {
+        if (section.offset % bytecode_image_alignment != 0 || section.offset > size ||
+            section.size > size - section.offset)
+        {
+            return malformed("section out of range");
+        }
+    }
+
+    if (header.procedures.size % sizeof(BytecodeImageProcedure) != 0 ||
+        header.external_calls.size % sizeof(BytecodeImageExternalCall) != 0)
+    {
+        return malformed("truncated table");
+    }
+
+    image->code    = std::span{image->data + header.code.offset, header.code.size};
+    image->strings = std::string_view{
+        reinterpret_cast<const char *>(image->data) + header.strings.offset,
+        header.strings.size,
+    };
+
+    if (image->strings.empty() == false && image->strings.back() != '\0')
+    {
+        return malformed("unterminated string table");
+    }
+
+    auto string_at = [&](uint64_t offset) -> std::optional<std::string>
+    {
+        if (offset >= image->strings.size())
+        {
+            return std::nullopt;
+        }
+
+        return std::string{image->strings.data() + offset};
+    };
+
+    VmProgram program{};
+    program.main_procedure = header.main_procedure;
+
+    auto num_procedures = header.procedures.size / sizeof(BytecodeImageProcedure);
+    for (size_t i = 0; i < num_procedures; ++i)
+    {
+        BytecodeImageProcedure record{};
+        memcpy(&record, image->data + header.procedures.offset + i * sizeof(record), sizeof(record));
+
+        auto name = string_at(record.name);
+        if (name.has_value() == false)
+        {
+            return malformed("invalid procedure name");
+        }
+
+        // The frame size is checked by verify_program
+        program.procedures.push_back(VmProcedure{
+            .name            = std::move(name.value()),
+            .address         = record.address,
+            .num_arguments   = record.num_arguments,
+            .num_results     = record.num_results,
+            .num_registers   = record.num_registers,
+            .frame_size      = static_cast<int64_t>(record.frame_size),
+            .frame_alignment = record.frame_alignment,
+        });
+    }
+
+    if (program.main_procedure < -1 || program.main_procedure >= static_cast<int64_t>(num_procedures))
+    {
+        return malformed("invalid main procedure");
+    }
+
+    auto is_value_kind = [](VmValueKind kind) { return kind <= VmValueKind::f64; };
+
+    std::unordered_map<std::string, void *> external_addresses{};
+
+    auto num_external_calls = header.external_calls.size / sizeof(BytecodeImageExternalCall);
+    for (size_t i = 0; i < num_external_calls; ++i)
+    {
+        BytecodeImageExternalCall record{};
+        memcpy(&record, image->data + header.external_calls.offset + i * sizeof(record), sizeof(record));
+
+        auto name = string_at(record.name);
+        if (name.has_value() == false)
+        {
+            return malformed("invalid external procedure name");
+        }
+
+        if (record.argument_kinds > header.constant_pool.size ||
+            record.num_arguments > header.constant_pool.size - record.argument_kinds ||
+            is_value_kind(record.return_kind) == false)
+        {
+            return malformed(std::format("invalid signature of the external procedure {}", name.value()));
+        }
+
+        VmExternalCall call{
+            .name        = std::move(name.value()),
+            .return_kind = record.return_kind,
+        };
+
+        auto argument_kinds = image->data + header.constant_pool.offset + record.argument_kinds;
+        for (uint32_t j = 0; j < record.num_arguments; ++j)
+        {
+            auto kind = static_cast<VmValueKind>(argument_kinds[j]);
+            if (kind == VmValueKind::none || is_value_kind(kind) == false)
+            {
+                return malformed(std::format("invalid signature of the external procedure {}", call.name));
+            }
+
+            call.argument_kinds.push_back(kind);
+        }
+
+        auto &address = external_addresses[call.name];
+        if (address == nullptr)
+        {
+            address = find_runtime_symbol(call.name);
+        }
+
+        if (address == nullptr)
+        {
+            address = dlsym(RTLD_DEFAULT, call.name.c_str());
+            if (address == nullptr)
+            {
+                std::cerr << std::format("Could not resolve the external procedure {}", call.name) << std::endl;
+                return std::nullopt;
+            }
+        }
+
+        call.address = address;
+
+        program.external_calls.push_back(std::move(call));
+    }
+
+    program.image = std::move(image);
+
+    return program;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "compile_vm.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+// A compiled program for the bytecode interpreter, stored in a file that is mapped into memory as a whole.
+// The code and the string table are executed directly from the mapping, so loading an image mostly consists of
+// the page faults for the parts of the program that actually run.
+//
+// Layout (native byte order, every section aligned to bytecode_image_alignment):
+// header:          BytecodeImageHeader
+// code:            the bytecode
+// strings:         the string table - the string literals and the procedure names, each terminated by a zero byte
+// procedures:      BytecodeImageProcedure[]
+// external calls:  BytecodeImageExternalCall[]
+// constant pool:   the argument kinds (VmValueKind, one byte each) of all external calls
+//
+// The addresses of external procedures are not stored, they are resolved by name when the image is mapped.
+
+constexpr char bytecode_image_magic[8]      = {'F', 'A', 'S', 'E', 'L', 'B', 'C', '\0'};
+constexpr uint32_t bytecode_image_version   = 7;
+constexpr uint64_t bytecode_image_alignment = 16;
+
+struct BytecodeImageSection
+{
+    uint64_t offset{};  // From the start of the file
+    uint64_t size{};    // In bytes
+};
+
+struct BytecodeImageHeader
+{
+    char magic[8]{};
+    uint32_t version{};
+    uint32_t header_size{};
+    int64_t main_procedure{};
+    BytecodeImageSection code{};
+    BytecodeImageSection strings{};
+    BytecodeImageSection procedures{};
+    BytecodeImageSection external_calls{};
+    BytecodeImageSection constant_pool{};
+};
+
+struct BytecodeImageProcedure
+{
+    uint64_t name{};  // Offset in the string table
+    int64_t address{};
+    uint32_t num_arguments{};
+    uint32_t num_registers{};
+    uint32_t num_results{};
+    uint32_t frame_alignment{};
+    uint64_t frame_size{};
+};
+
+struct BytecodeImageExternalCall
+{
+    uint64_t name{};            // Offset in the string table
+    uint64_t argument_kinds{};  // Offset in the constant pool
+    uint32_t num_arguments{};
+    VmValueKind return_kind{};
+    uint8_t padding[3]{};
+};
+
+// A mapped image file, unmapped when the last program that uses it is gone
+struct BytecodeImage
+{
+    const uint8_t *data{};
+    size_t size{};
+    std::span<const uint8_t> code{};
+    std::string_view strings{};
+
+    BytecodeImage() = default;
+    BytecodeImage(const BytecodeImage &) = delete;
+    BytecodeImage &operator=(const BytecodeImage &) = delete;
+    ~BytecodeImage();
+};
+
+bool write_bytecode_image(const VmProgram &program, std::string_view path);
+
+// Maps the image and checks its structure - the code itself is checked by load_program (see verify_program)
+std::optional<VmProgram> map_bytecode_image(std::string_view path);
+
+// Whether the file starts with the magic of a bytecode image
+bool is_bytecode_image(std::string_view path);
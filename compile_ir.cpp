@@ -1,10 +1,15 @@
 #include "compile_ir.h"
 
+#include "allocation_tracking.h"
 #include "node.h"
+#include "profile.h"
+#include "runtime.h"
 
 #include <llvm/ADT/StringRef.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/ProfileSummary.h>
 #include <llvm/IR/NoFolder.h>
 #include <llvm/IR/Value.h>
 
@@ -16,22 +21,451 @@
 
 using namespace llvm;
 
+// A struct result is returned by copying it to the address that is passed as the first argument (see convert_type)
+static unsigned first_argument_index(const ProcedureSignatureNode *signature)
+{
+    return is_aggregate(signature->return_type) ? 1 : 0;
+}
+
+// The procedures without inlining annotations whose bodies have at most this many nodes are inlined into their callers
+// if they neither loop nor call other procedures (like accessors), the others of up to inline_hint_size nodes are
+// hinted to be inlined
+constexpr int64_t always_inline_size = 12;
+constexpr int64_t inline_hint_size   = 40;
+
+// Measures the body of a procedure for the automatic inlining of small procedures
+struct ProcedureSize : NodeVisitorBase
+{
+    int64_t num_nodes{};
+    bool has_loops{};  // Loops or labels, which might be jumped to backwards
+    bool has_calls{};
+
+    void visit(BinaryOperatorNode *binary_operator) override { ++this->num_nodes; }
+    void visit(DeclarationNode *declaration) override { ++this->num_nodes; }
+    void visit(IdentifierNode *identifier) override { ++this->num_nodes; }
+    void visit(IfStatementNode *if_statement) override { ++this->num_nodes; }
+    void visit(IndexNode *index) override { ++this->num_nodes; }
+    void visit(LiteralNode *literal) override { ++this->num_nodes; }
+    void visit(MemberAccessNode *member_access) override { ++this->num_nodes; }
+    void visit(ReturnStatementNode *return_statement) override { ++this->num_nodes; }
+    void visit(SliceNode *slice) override { ++this->num_nodes; }
+    void visit(TypeCastNode *type_cast) override { ++this->num_nodes; }
+
+    void visit(LabelNode *label) override
+    {
+        ++this->num_nodes;
+        this->has_loops = true;
+    }
+
+    void visit(ProcedureCallNode *procedure_call) override
+    {
+        ++this->num_nodes;
+        this->has_calls = true;
+    }
+
+    void visit(WhileLoopNode *while_loop) override
+    {
+        ++this->num_nodes;
+        this->has_loops = true;
+    }
+};
+
 struct IrCompiler
 {
-    explicit IrCompiler(LLVMContext &llvm_context, Module &module)
+    explicit IrCompiler(LLVMContext &llvm_context, Module &module, const IrCompilationOptions &options)
         : llvm_context{llvm_context}
         , module{module}
+        , options{options}
         , ir{llvm_context}
     {
     }
 
     LLVMContext &llvm_context;
     Module &module;
+    const IrCompilationOptions &options;
     IRBuilder<llvm::NoFolder> ir;
     // IRBuilder<> ir;
-    std::vector<Node *> current_prologue{};
+    Node *current_prologue{};  // Runs before the next iteration of the innermost loop
     BasicBlock *current_break_target{};
     BasicBlock *current_continue_target{};
+    Profile::ProcedureCounters *current_counters{};
+    std::vector<BranchInst *> current_branches{};
+    Value *current_result{};  // The address that a struct result is copied to
+    BasicBlock *current_trap{};  // Aborts the program when a bounds check of the procedure fails
+
+    // The coroutine of the async procedure that is being compiled (see generate_coroutine_prologue)
+    struct Coroutine
+    {
+        Value *handle{};  // The frame of the coroutine, which is the task, nullptr if the procedure is not async
+        Value *promise{};
+        StructType *promise_type{};
+        BasicBlock *final{};    // Stores nothing, the return statements store the result before they branch to it
+        BasicBlock *cleanup{};  // The frames are freed with the arena of the executor (see fasel_executor_begin)
+        BasicBlock *suspend{};  // Returns the frame to the caller when the coroutine suspends
+    };
+
+    Coroutine current_coroutine{};
+
+    // The address of a value in memory and the alignment that is known for it
+    struct Address
+    {
+        Value *pointer{};
+        Align alignment{};
+    };
+
+    // Adds amount to the counter with the given index of the procedure that is being compiled
+    void increment_counter(size_t index, Value *amount)
+    {
+        auto &counters = this->current_counters->counters;
+        while (counters.size() <= index)
+        {
+            counters.push_back(0);
+        }
+
+        auto address = ConstantExpr::getIntToPtr(
+            this->ir.getInt64(reinterpret_cast<uint64_t>(&counters[index])),
+            this->ir.getPtrTy());
+
+        // Atomic, because the threads of parallel for loops and spawn run the same code, but without ordering
+        this->ir.CreateAtomicRMW(AtomicRMWInst::Add, address, amount, Align{8}, AtomicOrdering::Monotonic);
+    }
+
+    BranchInst *create_conditional_branch(Value *condition, BasicBlock *true_block, BasicBlock *false_block)
+    {
+        if (this->current_counters != nullptr)
+        {
+            auto index = 1 + 2 * this->current_branches.size();
+            auto taken = this->ir.CreateZExt(condition, this->ir.getInt64Ty(), "branch_taken");
+            this->increment_counter(index, taken);
+            this->increment_counter(index + 1, this->ir.CreateSub(this->ir.getInt64(1), taken, "branch_not_taken"));
+        }
+
+        auto branch = this->ir.CreateCondBr(condition, true_block, false_block);
+        this->current_branches.push_back(branch);
+
+        return branch;
+    }
+
+    // Maps the inlining annotations of the procedure to function attributes, procedures without annotations that are
+    // small enough are inlined automatically (see ProcedureSize)
+    void add_inlining_attributes(Function *function, DeclarationNode *decl)
+    {
+        auto procedure = node_cast<ProcedureNode, true>(decl->init_expression);
+
+        if (procedure->is_hot)
+        {
+            function->addFnAttr(Attribute::Hot);
+        }
+
+        // Like the cold attribute of C compilers
+        if (procedure->is_cold)
+        {
+            function->addFnAttr(Attribute::Cold);
+            function->addFnAttr(Attribute::OptimizeForSize);
+        }
+
+        if (procedure->is_inline)
+        {
+            function->addFnAttr(Attribute::AlwaysInline);
+            return;
+        }
+
+        if (procedure->is_noinline)
+        {
+            function->addFnAttr(Attribute::NoInline);
+            return;
+        }
+
+        // Coroutines are only inlined once they have been split (see lower_coroutines)
+        if (procedure->is_external || procedure->is_async || procedure->is_cold || decl->identifier == "main")
+        {
+            return;
+        }
+
+        ProcedureSize size{};
+        visit(procedure->body, size);
+
+        if (size.num_nodes <= always_inline_size && size.has_loops == false && size.has_calls == false)
+        {
+            function->addFnAttr(Attribute::AlwaysInline);
+        }
+        else if (size.num_nodes <= inline_hint_size)
+        {
+            function->addFnAttr(Attribute::InlineHint);
+        }
+    }
+
+    // Marks the calls of the function to the other compiled procedures to be inlined (@flatten). Only the calls in
+    // the body itself are inlined, not the calls in the bodies that are inlined into it.
+    void flatten_calls(Function *function)
+    {
+        for (auto &block : *function)
+        {
+            for (auto &instruction : block)
+            {
+                auto call   = dyn_cast<CallBase>(&instruction);
+                auto callee = call != nullptr ? call->getCalledFunction() : nullptr;
+                if (callee == nullptr || callee == function || callee->isDeclaration() ||
+                    callee->hasFnAttribute(Attribute::NoInline))
+                {
+                    continue;
+                }
+
+                call->addFnAttr(Attribute::AlwaysInline);
+            }
+        }
+    }
+
+    void attach_profile(Function *function, std::string_view procedure_name)
+    {
+        auto counters = this->options.optimization_profile->find(procedure_name);
+        if (counters == nullptr || counters->num_branches() != this->current_branches.size())
+        {
+            // The procedure is not in the profile or the profile is stale
+            return;
+        }
+
+        function->setEntryCount(counters->entry_count());
+
+        MDBuilder md_builder{this->llvm_context};
+        for (size_t i = 0; i < this->current_branches.size(); ++i)
+        {
+            auto true_count  = counters->count(1 + 2 * i);
+            auto false_count = counters->count(2 + 2 * i);
+            if (true_count == 0 && false_count == 0)
+            {
+                continue;
+            }
+
+            // Branch weights are 32 bit
+            auto scale = std::max(true_count, false_count) / std::numeric_limits<uint32_t>::max() + 1;
+            this->current_branches[i]->setMetadata(
+                LLVMContext::MD_prof,
+                md_builder.createBranchWeights(
+                    static_cast<uint32_t>(true_count / scale),
+                    static_cast<uint32_t>(false_count / scale)));
+        }
+    }
+
+    // Converts a value to the representation of the interpreter's registers: integers are extended to 64 bits
+    // according to their signedness, booleans are 0 or 1 and floating point values are doubles
+    Value *to_register_value(Value *value, const Node *type)
+    {
+        // Structs and arrays are passed by address
+        if (type->kind == NodeKind::pointer_type || is_aggregate(type))
+        {
+            return this->ir.CreatePtrToInt(value, this->ir.getInt64Ty());
+        }
+
+        auto basic = node_cast<BasicTypeNode, true>(type);
+        switch (basic->type_kind)
+        {
+            case BasicTypeNode::Kind::boolean:        return this->ir.CreateZExt(value, this->ir.getInt64Ty());
+            case BasicTypeNode::Kind::signed_integer: return this->ir.CreateSExtOrBitCast(value, this->ir.getInt64Ty());
+            case BasicTypeNode::Kind::unsigned_integer:
+                return this->ir.CreateZExtOrBitCast(value, this->ir.getInt64Ty());
+
+            case BasicTypeNode::Kind::floatingpoint:
+            {
+                auto dbl = this->ir.CreateFPExt(value, this->ir.getDoubleTy());
+                return this->ir.CreateBitCast(dbl, this->ir.getInt64Ty());
+            }
+
+            default: TODO;
+        }
+    }
+
+    // The inverse of to_register_value
+    Value *from_register_value(Value *value, const Node *type)
+    {
+        if (type->kind == NodeKind::pointer_type || is_aggregate(type))
+        {
+            return this->ir.CreateIntToPtr(value, this->ir.getPtrTy());
+        }
+
+        auto basic = node_cast<BasicTypeNode, true>(type);
+        switch (basic->type_kind)
+        {
+            case BasicTypeNode::Kind::boolean:
+            case BasicTypeNode::Kind::signed_integer:
+            case BasicTypeNode::Kind::unsigned_integer:
+                return this->ir.CreateTruncOrBitCast(value, this->convert_type(type));
+
+            case BasicTypeNode::Kind::floatingpoint:
+            {
+                auto dbl = this->ir.CreateBitCast(value, this->ir.getDoubleTy());
+                return this->ir.CreateFPTrunc(dbl, this->convert_type(type));
+            }
+
+            default: TODO;
+        }
+    }
+
+    // Stores a value to consecutive 64 bit slots in the representation of the interpreter's registers, vectors take
+    // one slot per lane
+    void store_register_values(Value *value, const Node *type, Value *slots, size_t first_slot)
+    {
+        auto vector_type = node_cast<VectorTypeNode>(type);
+        if (vector_type == nullptr)
+        {
+            auto address = this->ir.CreateConstGEP1_64(this->ir.getInt64Ty(), slots, first_slot);
+            this->ir.CreateStore(this->to_register_value(value, type), address);
+            return;
+        }
+
+        for (auto lane = 0; lane < vector_type->length; ++lane)
+        {
+            auto element = this->ir.CreateExtractElement(value, lane);
+            this->store_register_values(element, vector_type->element_type, slots, first_slot + lane);
+        }
+    }
+
+    // The inverse of store_register_values
+    Value *load_register_values(const Node *type, Value *slots, size_t first_slot)
+    {
+        auto vector_type = node_cast<VectorTypeNode>(type);
+        if (vector_type == nullptr)
+        {
+            auto address = this->ir.CreateConstGEP1_64(this->ir.getInt64Ty(), slots, first_slot);
+            auto value   = this->ir.CreateLoad(this->ir.getInt64Ty(), address);
+            return this->from_register_value(value, type);
+        }
+
+        Value *vector = PoisonValue::get(this->convert_type(vector_type));
+        for (auto lane = 0; lane < vector_type->length; ++lane)
+        {
+            auto element = this->load_register_values(vector_type->element_type, slots, first_slot + lane);
+            vector       = this->ir.CreateInsertElement(vector, element, lane);
+        }
+
+        return vector;
+    }
+
+    // A vector result is returned in the slots in front of the arguments, the address that a struct result is copied to
+    // is passed there (see VmProcedure::num_results)
+    static size_t num_result_slots(const ProcedureSignatureNode *signature)
+    {
+        auto type = signature->return_type;
+        switch (type->kind)
+        {
+            case NodeKind::vector_type: return static_cast<size_t>(num_lanes(type));
+            case NodeKind::struct_type:
+            case NodeKind::slice_type:  return 1;
+            default:                    return 0;
+        }
+    }
+
+    // int64_t <procedure>.from_interpreter(int64_t *arguments) { return <procedure>(arguments...); }
+    void generate_interpreter_entry(DeclarationNode *decl, Function *function)
+    {
+        IRBuilderBase::InsertPointGuard guard{this->ir};
+
+        auto signature = node_cast<ProcedureNode, true>(decl->init_expression)->signature;
+
+        auto entry = Function::Create(
+            FunctionType::get(this->ir.getInt64Ty(), {this->ir.getPtrTy()}, false),
+            GlobalValue::LinkageTypes::ExternalLinkage,
+            std::format("{}.from_interpreter", decl->identifier),
+            this->module);
+        entry->addFnAttr(Attribute::NoUnwind);
+
+        this->ir.SetInsertPoint(BasicBlock::Create(this->llvm_context, "entry", entry));
+
+        std::vector<Value *> arguments{};
+        if (is_aggregate(signature->return_type))
+        {
+            arguments.push_back(this->load_register_values(signature->return_type, entry->getArg(0), 0));
+        }
+
+        auto slot = num_result_slots(signature);
+        for (auto argument : signature->arguments)
+        {
+            auto type = argument->init_expression->inferred_type();
+            arguments.push_back(this->load_register_values(type, entry->getArg(0), slot));
+            slot += num_lanes(type);
+        }
+
+        auto result = this->ir.CreateCall(function, arguments);
+        if (function->getReturnType()->isVoidTy())
+        {
+            this->ir.CreateRet(this->ir.getInt64(0));
+        }
+        else if (signature->return_type->kind == NodeKind::vector_type)
+        {
+            this->store_register_values(result, signature->return_type, entry->getArg(0), 0);
+            this->ir.CreateRet(this->ir.getInt64(0));
+        }
+        else
+        {
+            this->ir.CreateRet(this->to_register_value(result, signature->return_type));
+        }
+    }
+
+    // The body of a procedure that is not compiled: passes the arguments to the interpreter, which runs the procedure
+    void generate_interpreter_call(DeclarationNode *decl, Function *function)
+    {
+        IRBuilderBase::InsertPointGuard guard{this->ir};
+
+        auto bridge    = this->options.interpreter_bridge;
+        auto signature = node_cast<ProcedureNode, true>(decl->init_expression)->signature;
+
+        this->ir.SetInsertPoint(BasicBlock::Create(this->llvm_context, "entry", function));
+
+        auto num_slots = num_result_slots(signature);
+        for (auto argument : signature->arguments)
+        {
+            num_slots += num_lanes(argument->init_expression->inferred_type());
+        }
+
+        auto arguments = this->ir.CreateAlloca(
+            ArrayType::get(this->ir.getInt64Ty(), std::max<size_t>(num_slots, 1)),
+            nullptr,
+            "arguments");
+
+        auto first_argument = first_argument_index(signature);
+        if (first_argument != 0)
+        {
+            this->store_register_values(function->getArg(0), signature->return_type, arguments, 0);
+        }
+
+        auto slot = num_result_slots(signature);
+        for (size_t i = 0; i < signature->arguments.size(); ++i)
+        {
+            auto type = signature->arguments[i]->init_expression->inferred_type();
+            this->store_register_values(function->getArg(first_argument + i), type, arguments, slot);
+            slot += num_lanes(type);
+        }
+
+        auto enter_type = FunctionType::get(
+            this->ir.getInt64Ty(),
+            {this->ir.getPtrTy(), this->ir.getInt64Ty(), this->ir.getPtrTy()},
+            false);
+        auto enter = ConstantExpr::getIntToPtr(
+            this->ir.getInt64(reinterpret_cast<uint64_t>(bridge->enter)),
+            this->ir.getPtrTy());
+        auto context = ConstantExpr::getIntToPtr(
+            this->ir.getInt64(reinterpret_cast<uint64_t>(bridge->context)),
+            this->ir.getPtrTy());
+
+        auto result = this->ir.CreateCall(
+            enter_type,
+            enter,
+            {context, this->ir.getInt64(bridge->procedure_index(decl)), arguments},
+            "result");
+
+        if (function->getReturnType()->isVoidTy())
+        {
+            this->ir.CreateRetVoid();
+        }
+        else if (signature->return_type->kind == NodeKind::vector_type)
+        {
+            this->ir.CreateRet(this->load_register_values(signature->return_type, arguments, 0));
+        }
+        else
+        {
+            this->ir.CreateRet(this->from_register_value(result, signature->return_type));
+        }
+    }
 
     void allocate_locals(BlockNode *block)
     {
@@ -44,8 +478,14 @@ struct IrCompiler
         {
             if (auto decl = node_cast<DeclarationNode>(statement))
             {
-                auto type         = this->convert_type(decl->init_expression->inferred_type());
-                decl->named_value = this->ir.CreateAlloca(type, nullptr, decl->identifier);
+                auto type   = decl->init_expression->inferred_type();
+                auto alloca = this->ir.CreateAlloca(this->convert_type(type), nullptr, decl->identifier);
+                if (is_aggregate(type))
+                {
+                    alloca->setAlignment(Align{static_cast<uint64_t>(align_of(type))});
+                }
+
+                decl->named_value = alloca;
                 continue;
             }
 
@@ -82,6 +522,60 @@ struct IrCompiler
         }
     }
 
+    // Allocas in the entry block are allocated once per call instead of each time that they are reached
+    AllocaInst *create_entry_alloca(Type *type, Align alignment, std::string_view name)
+    {
+        auto &entry_block = this->ir.GetInsertBlock()->getParent()->getEntryBlock();
+
+        IRBuilder<> entry_ir{&entry_block, entry_block.begin()};
+        auto alloca = entry_ir.CreateAlloca(type, nullptr, name);
+        alloca->setAlignment(alignment);
+
+        return alloca;
+    }
+
+    AllocaInst *create_entry_alloca(const Node *type, std::string_view name)
+    {
+        return this->create_entry_alloca(
+            this->convert_type(type),
+            Align{static_cast<uint64_t>(align_of(type))},
+            name);
+    }
+
+    struct Member
+    {
+        int64_t offset{};
+        Type *type{};
+        int64_t size{};
+    };
+
+    // A packed struct with the members at their offsets and explicit padding in between, so LLVM uses exactly the
+    // layout that the typechecker computed
+    StructType *make_packed_struct(const std::vector<Member> &members, int64_t size)
+    {
+        std::vector<Type *> elements{};
+        int64_t end{};
+
+        auto pad_to = [&](int64_t offset)
+        {
+            if (offset > end)
+            {
+                elements.push_back(ArrayType::get(this->ir.getInt8Ty(), offset - end));
+            }
+        };
+
+        for (const auto &member : members)
+        {
+            pad_to(member.offset);
+            elements.push_back(member.type);
+            end = member.offset + member.size;
+        }
+
+        pad_to(size);
+
+        return StructType::get(this->llvm_context, elements, true);
+    }
+
     Type *convert_type(const Node *node)
     {
         assert(node != nullptr);
@@ -122,6 +616,26 @@ struct IrCompiler
             {
                 auto array = static_cast<const ArrayTypeNode *>(node);
 
+                // One array per field
+                if (array->is_soa)
+                {
+                    auto struct_type = node_cast<StructTypeNode, true>(array->element_type);
+                    auto length      = array_length(array);
+
+                    std::vector<Member> members{};
+                    for (size_t i = 0; i < struct_type->fields.size(); ++i)
+                    {
+                        auto field_type = struct_type->fields[i].type;
+                        members.push_back(Member{
+                            .offset = soa_field_offset(array, static_cast<int64_t>(i)),
+                            .type   = ArrayType::get(this->convert_type(field_type), length),
+                            .size   = length * size_of(field_type),
+                        });
+                    }
+
+                    return this->make_packed_struct(members, size_of(array));
+                }
+
                 auto element_type = this->convert_type(array->element_type);
 
                 auto length_literal = node_cast<LiteralNode>(array->length);
@@ -140,11 +654,32 @@ struct IrCompiler
                 return ArrayType::get(element_type, length);
             }
 
+            case NodeKind::vector_type:
+            {
+                auto vector = static_cast<const VectorTypeNode *>(node);
+                return FixedVectorType::get(this->convert_type(vector->element_type), vector->length);
+            }
+
             case NodeKind::struct_type:
             {
-                auto strukt = static_cast<const StructTypeNode *>(node);
+                auto struct_type = static_cast<const StructTypeNode *>(node);
+
+                std::vector<Member> members{};
+                for (const auto &field : struct_type->fields)
+                {
+                    members.push_back(Member{
+                        .offset = field.offset,
+                        .type   = this->convert_type(field.type),
+                        .size   = size_of(field.type),
+                    });
+                }
+
+                return this->make_packed_struct(members, struct_type->size);
+            }
 
-                TODO;
+            case NodeKind::slice_type:
+            {
+                return this->convert_type(static_cast<const SliceTypeNode *>(node)->layout);
             }
 
             case NodeKind::procedure_signature:
@@ -154,9 +689,18 @@ struct IrCompiler
                 auto return_type = this->convert_type(signature->return_type);
                 std::vector<Type *> argument_types;
 
+                // Structs are passed as the address of a copy, a struct result is copied to the address that is
+                // passed as the first argument
+                if (is_aggregate(signature->return_type))
+                {
+                    return_type = this->ir.getVoidTy();
+                    argument_types.push_back(this->ir.getPtrTy());
+                }
+
                 for (auto argument : signature->arguments)
                 {
-                    auto argument_type = this->convert_type(argument->init_expression->inferred_type());
+                    auto type          = argument->init_expression->inferred_type();
+                    auto argument_type = is_aggregate(type) ? this->ir.getPtrTy() : this->convert_type(type);
                     argument_types.push_back(argument_type);
                 }
 
@@ -169,9 +713,33 @@ struct IrCompiler
         }
     }
 
+    // The function of an async procedure creates the task and returns the frame of its coroutine, which is the handle
+    // of the task (see generate_coroutine_prologue)
+    FunctionType *function_type(const ProcedureNode *procedure)
+    {
+        auto type = cast<FunctionType>(this->convert_type(procedure->signature));
+        if (procedure->is_async == false)
+        {
+            return type;
+        }
+
+        return FunctionType::get(this->ir.getPtrTy(), type->params(), false);
+    }
+
+    // The promise of the coroutine of an async procedure: the task that awaits it, whether it is done and its result
+    StructType *promise_type(const Node *result_type)
+    {
+        std::vector<Type *> elements{this->ir.getPtrTy(), this->ir.getInt1Ty()};
+        if (Node::types_equal(result_type, &BuiltinTypes::voyd) == false)
+        {
+            elements.push_back(this->convert_type(result_type));
+        }
+
+        return StructType::get(this->llvm_context, elements);
+    }
+
     Value *generate_code(BinaryOperatorNode *bin_op)
     {
-        assert(bin_op->inferred_type()->kind == NodeKind::basic_type);
         assert(Node::types_equal(bin_op->lhs->inferred_type(), bin_op->rhs->inferred_type()));
 
         switch (bin_op->operator_kind)
@@ -202,14 +770,14 @@ struct IrCompiler
                 assert(lhs != nullptr && lhs->getType()->isIntegerTy(1));
 
                 auto lhs_true = this->ir.CreateICmpEQ(lhs, this->ir.getTrue(), "and_lhs_eq_true");
-                this->ir.CreateCondBr(lhs_true, lhs_true_block, end_block);
+                this->create_conditional_branch(lhs_true, lhs_true_block, end_block);
 
                 this->ir.SetInsertPoint(lhs_true_block);
                 auto rhs = this->generate_code(bin_op->rhs);
                 assert(rhs != nullptr && rhs->getType()->isIntegerTy(1));
 
                 auto rhs_true = this->ir.CreateICmpEQ(rhs, this->ir.getTrue(), "and_rhs_eq_true");
-                this->ir.CreateCondBr(rhs_true, rhs_true_block, end_block);
+                this->create_conditional_branch(rhs_true, rhs_true_block, end_block);
 
                 this->ir.SetInsertPoint(rhs_true_block);
                 this->ir.CreateStore(this->ir.getTrue(), result_alloc);
@@ -248,14 +816,14 @@ struct IrCompiler
                 assert(lhs != nullptr && lhs->getType()->isIntegerTy(1));
 
                 auto lhs_true = this->ir.CreateICmpEQ(lhs, this->ir.getFalse(), "or_lhs_eq_true");
-                this->ir.CreateCondBr(lhs_true, lhs_true_block, end_block);
+                this->create_conditional_branch(lhs_true, lhs_true_block, end_block);
 
                 this->ir.SetInsertPoint(lhs_true_block);
                 auto rhs = this->generate_code(bin_op->rhs);
                 assert(rhs != nullptr && rhs->getType()->isIntegerTy(1));
 
                 auto rhs_true = this->ir.CreateICmpEQ(rhs, this->ir.getFalse(), "or_rhs_eq_true");
-                this->ir.CreateCondBr(rhs_true, rhs_true_block, end_block);
+                this->create_conditional_branch(rhs_true, rhs_true_block, end_block);
 
                 this->ir.SetInsertPoint(rhs_true_block);
                 this->ir.CreateStore(this->ir.getFalse(), result_alloc);
@@ -271,7 +839,19 @@ struct IrCompiler
             default: break;
         }
 
+        // Fields and array elements are stored to their addresses, structs and arrays are copied
         auto is_store = bin_op->operator_kind == Tt::assign;
+        if (is_store && (bin_op->lhs->kind != NodeKind::identifier || is_aggregate(bin_op->lhs->inferred_type())))
+        {
+            auto address = this->generate_address(bin_op->lhs);
+            if (is_aggregate(bin_op->lhs->inferred_type()))
+            {
+                this->generate_copy(address, bin_op->rhs);
+                return nullptr;
+            }
+
+            return this->ir.CreateAlignedStore(this->generate_code(bin_op->rhs), address.pointer, address.alignment);
+        }
 
         auto lhs = this->generate_code(bin_op->lhs, is_store);
         ENSURE(lhs != nullptr);
@@ -284,7 +864,8 @@ struct IrCompiler
             return this->ir.CreateStore(rhs, lhs);
         }
 
-        auto lhs_simple = node_cast<BasicTypeNode, true>(bin_op->lhs->inferred_type());
+        // The instructions apply to each lane of vectors
+        auto lhs_simple = lane_type(bin_op->lhs->inferred_type());
 
         switch (lhs_simple->type_kind)
         {
@@ -388,25 +969,11 @@ struct IrCompiler
             auto is_terminator = statement->kind == NodeKind::break_statement ||
                                  statement->kind == NodeKind::continue_statement ||
                                  statement->kind == NodeKind::return_statement;
-            if (is_terminator)
-            {
-                for (auto prologue_statement : this->current_prologue)
-                {
-                    this->generate_code(prologue_statement);
-                }
-
-                this->generate_code(statement);
-                break;
-            }
-
             this->generate_code(statement);
 
-            if (i + 1 == block->statements.size())
+            if (is_terminator)
             {
-                for (auto prologue_statement : this->current_prologue)
-                {
-                    this->generate_code(prologue_statement);
-                }
+                break;
             }
         }
 
@@ -421,16 +988,21 @@ struct IrCompiler
             return nullptr;
         }
 
-        if (decl->init_expression->kind == NodeKind::procedure)
+        // Types and generics have no code, the instances of generics are declarations of their own
+        if (decl->init_expression->kind == NodeKind::struct_type || decl->init_expression->kind == NodeKind::generic)
         {
-            // TODO: Transform local procedure declarations to global ones
-            assert(decl->is_global());
+            return nullptr;
+        }
+
+        if (decl->init_expression->kind == NodeKind::procedure)
+        {
+            // TODO: Transform local procedure declarations to global ones
+            assert(decl->is_global());
             // assert(this->ir.GetInsertBlock() == nullptr);
 
             auto procedure = node_cast<ProcedureNode, true>(decl->init_expression);
 
-            auto type          = this->convert_type(decl->init_expression->inferred_type());
-            auto function_type = cast<FunctionType>(type);
+            auto function_type = this->function_type(procedure);
             auto function      = Function::Create(
                 function_type,
                 GlobalValue::LinkageTypes::ExternalLinkage,
@@ -439,18 +1011,96 @@ struct IrCompiler
             decl->named_value =
                 function;  // NOTE: Must set the named_value before compiling the body to allow recursion
 
-            auto i = 0;
-            for (auto &arg : function->args())
+            auto first_argument = first_argument_index(procedure->signature);
+            if (first_argument != 0)
+            {
+                function->getArg(0)->setName("result");
+            }
+
+            for (size_t i = 0; i < procedure->signature->arguments.size(); ++i)
             {
-                arg.setName(procedure->signature->arguments[i]->identifier);
-                ++i;
+                function->getArg(first_argument + i)->setName(procedure->signature->arguments[i]->identifier);
             }
 
+            auto has_body = procedure->is_external == false && (this->options.should_compile_procedure == nullptr ||
+                                                                 this->options.should_compile_procedure(decl));
+
             if (procedure->is_external == false)
+            {
+                // There are no exceptions in Fasel and all values are initialized (declarations without an
+                // initialization expression are zero-initialized)
+                function->addFnAttr(Attribute::NoUnwind);
+                for (auto &arg : function->args())
+                {
+                    arg.addAttr(Attribute::NoUndef);
+                }
+
+                // The addresses of struct arguments and results point to copies that only the callee accesses
+                if (first_argument != 0)
+                {
+                    function->getArg(0)->addAttr(Attribute::NoAlias);
+                }
+
+                for (size_t i = 0; i < procedure->signature->arguments.size(); ++i)
+                {
+                    if (is_aggregate(procedure->signature->arguments[i]->init_expression->inferred_type()))
+                    {
+                        function->getArg(first_argument + i)->addAttr(Attribute::NoAlias);
+                    }
+                }
+
+                if (function_type->getReturnType()->isVoidTy() == false)
+                {
+                    function->addRetAttr(Attribute::NoUndef);
+                }
+            }
+
+            this->add_inlining_attributes(function, decl);
+
+            // The interpreter runs the tasks that it creates itself (see MixedProgram)
+            auto is_bridged = procedure->is_external == false && procedure->is_async == false;
+            if (is_bridged && this->options.interpreter_bridge != nullptr)
+            {
+                if (has_body)
+                {
+                    this->generate_interpreter_entry(decl, function);
+                }
+                else
+                {
+                    this->generate_interpreter_call(decl, function);
+                }
+            }
+
+            if (has_body && this->options.internalize && decl->identifier != "main")
+            {
+                function->setLinkage(GlobalValue::LinkageTypes::InternalLinkage);
+            }
+
+            if (has_body)
             {
                 auto block = BasicBlock::Create(this->llvm_context, "entry", function);
                 this->ir.SetInsertPoint(block);  // TODO: Restore insert point when done?
+
+                this->current_branches.clear();
+                this->current_counters = nullptr;
+                if (this->options.instrumentation_profile != nullptr)
+                {
+                    this->current_counters =
+                        &this->options.instrumentation_profile->procedures[std::string{decl->identifier}];
+                    this->increment_counter(0, this->ir.getInt64(1));
+                }
+
                 this->generate_code(decl->init_expression);
+
+                if (procedure->is_flatten)
+                {
+                    this->flatten_calls(function);
+                }
+
+                if (this->options.optimization_profile != nullptr)
+                {
+                    this->attach_profile(function, decl->identifier);
+                }
             }
 
             return nullptr;
@@ -459,8 +1109,25 @@ struct IrCompiler
         // TODO: There are no global variables yet and they are not on the roadmap
         ENSURE(decl->is_global() == false);
 
+        if (auto type = decl->init_expression->inferred_type(); is_aggregate(type))
+        {
+            auto address = Address{decl->named_value, Align{static_cast<uint64_t>(align_of(type))}};
+            if (decl->init_expression->kind == NodeKind::nop)
+            {
+                this->ir.CreateMemSet(address.pointer, this->ir.getInt8(0), size_of(type), address.alignment);
+            }
+            else
+            {
+                this->generate_copy(address, decl->init_expression);
+            }
+
+            return nullptr;
+        }
+
         // Declaration assignment to init expresion
-        auto value = this->generate_code(decl->init_expression);
+        auto value = decl->init_expression->kind == NodeKind::nop
+                         ? Constant::getNullValue(this->convert_type(decl->init_expression->inferred_type()))
+                         : this->generate_code(decl->init_expression);
         this->ir.CreateStore(value, decl->named_value);
 
         return nullptr;
@@ -477,7 +1144,8 @@ struct IrCompiler
             return ident->declaration->named_value;
         }
 
-        if (isa<Argument>(ident->declaration->named_value))
+        // Structs and arrays are held by address
+        if (isa<Argument>(ident->declaration->named_value) || is_aggregate(ident->inferred_type()))
         {
             return ident->declaration->named_value;
         }
@@ -497,7 +1165,7 @@ struct IrCompiler
         auto else_block = BasicBlock::Create(this->llvm_context, "if_else");
         auto done_block = BasicBlock::Create(this->llvm_context, "if_end");
 
-        this->ir.CreateCondBr(if_cond, then_block, else_block);
+        this->create_conditional_branch(if_cond, then_block, else_block);
 
         this->ir.SetInsertPoint(then_block);
         this->generate_code(yf->then_block);
@@ -529,15 +1197,9 @@ struct IrCompiler
 
     Value *generate_code(WhileLoopNode *whyle)
     {
-        auto old_prologue_size = this->current_prologue.size();
-        defer
-        {
-            this->current_prologue.resize(old_prologue_size);
-        };
-
-        if (whyle->prologue != nullptr)
+        if (whyle->is_parallel)
         {
-            this->current_prologue.push_back(whyle->prologue);
+            return this->generate_parallel_loop(whyle);
         }
 
         auto function = this->ir.GetInsertBlock()->getParent();
@@ -548,6 +1210,7 @@ struct IrCompiler
 
         SET_TEMPORARILY(this->current_break_target, done_block);
         SET_TEMPORARILY(this->current_continue_target, head_block);
+        SET_TEMPORARILY(this->current_prologue, whyle->prologue);
 
         assert(this->ir.GetInsertBlock()->getTerminator() == nullptr);
         this->ir.CreateBr(head_block);
@@ -556,13 +1219,14 @@ struct IrCompiler
 
         auto condition  = this->generate_code(whyle->condition);
         auto while_cond = this->ir.CreateICmpNE(condition, this->ir.getFalse(), "while_cond");
-        this->ir.CreateCondBr(while_cond, body_block, done_block);
+        this->create_conditional_branch(while_cond, body_block, done_block);
 
         this->ir.SetInsertPoint(body_block);
         this->generate_code(whyle->body);
 
         if (this->ir.GetInsertBlock()->getTerminator() == nullptr)
         {
+            this->generate_code(whyle->prologue);
             this->ir.CreateBr(head_block);
         }
 
@@ -572,6 +1236,270 @@ struct IrCompiler
         return nullptr;
     }
 
+    // The value that the copies of a reduction variable start out with
+    Constant *reduction_identity(Reduction::Kind kind, const BasicTypeNode *type)
+    {
+        auto llvm_type = this->convert_type(type);
+        auto num_bits  = static_cast<unsigned>(type->size * 8);
+        auto is_float  = type->type_kind == BasicTypeNode::Kind::floatingpoint;
+        auto is_signed = type->type_kind == BasicTypeNode::Kind::signed_integer;
+
+        switch (kind)
+        {
+            case Reduction::Kind::sum: return Constant::getNullValue(llvm_type);
+
+            case Reduction::Kind::min:
+            {
+                if (is_float)
+                {
+                    return ConstantFP::getInfinity(llvm_type, false);
+                }
+
+                auto max = is_signed ? APInt::getSignedMaxValue(num_bits) : APInt::getMaxValue(num_bits);
+                return ConstantInt::get(llvm_type, max);
+            }
+
+            case Reduction::Kind::max:
+            {
+                if (is_float)
+                {
+                    return ConstantFP::getInfinity(llvm_type, true);
+                }
+
+                auto min = is_signed ? APInt::getSignedMinValue(num_bits) : APInt::getMinValue(num_bits);
+                return ConstantInt::get(llvm_type, min);
+            }
+        }
+
+        UNREACHED;
+    }
+
+    Value *generate_reduction(Reduction::Kind kind, const BasicTypeNode *type, Value *lhs, Value *rhs)
+    {
+        auto is_float  = type->type_kind == BasicTypeNode::Kind::floatingpoint;
+        auto is_signed = type->type_kind == BasicTypeNode::Kind::signed_integer;
+
+        switch (kind)
+        {
+            case Reduction::Kind::sum:
+            {
+                return is_float ? this->ir.CreateFAdd(lhs, rhs, "reduced") : this->ir.CreateAdd(lhs, rhs, "reduced");
+            }
+
+            case Reduction::Kind::min:
+            {
+                if (is_float)
+                {
+                    return this->ir.CreateMinNum(lhs, rhs);
+                }
+
+                auto intrinsic = is_signed ? llvm::Intrinsic::smin : llvm::Intrinsic::umin;
+                return this->ir.CreateBinaryIntrinsic(intrinsic, lhs, rhs);
+            }
+
+            case Reduction::Kind::max:
+            {
+                if (is_float)
+                {
+                    return this->ir.CreateMaxNum(lhs, rhs);
+                }
+
+                auto intrinsic = is_signed ? llvm::Intrinsic::smax : llvm::Intrinsic::umax;
+                return this->ir.CreateBinaryIntrinsic(intrinsic, lhs, rhs);
+            }
+        }
+
+        UNREACHED;
+    }
+
+    // A parallel for loop passes its body, outlined into a function of its own, to the runtime library (see runtime.h):
+    //
+    // void <procedure>.parallel_for(ptr environment, i64 begin, i64 end)
+    // {
+    //     <counter> := begin
+    //     <reduction variables...> := <identity of the operator>
+    //     while <counter> < end { <body> <counter> = <counter> + 1 }
+    //
+    //     fasel_reduction_lock()
+    //     <*environment[i]> = <*environment[i]> <operator> <reduction variable>...
+    //     fasel_reduction_unlock()
+    // }
+    //
+    // The environment holds the addresses of the variables of the procedure that the body reads (see
+    // WhileLoopNode::captures), followed by the addresses of the reduction variables.
+    Value *generate_parallel_loop(WhileLoopNode *whyle)
+    {
+        auto condition = node_cast<BinaryOperatorNode, true>(whyle->condition);
+        auto counter   = node_cast<IdentifierNode, true>(condition->lhs)->declaration;
+
+        // The range and the grain size are evaluated once, before the iterations run
+        auto begin = this->ir.CreateLoad(this->ir.getInt64Ty(), counter->named_value, "begin");
+        auto end   = this->generate_code(condition->rhs);
+        if (condition->operator_kind == Tt::less_than_or_equal)
+        {
+            end = this->ir.CreateAdd(end, this->ir.getInt64(1), "end");
+        }
+
+        auto grain_size = whyle->grain_size != nullptr ? this->generate_code(whyle->grain_size) : this->ir.getInt64(0);
+
+        std::vector<DeclarationNode *> shared{whyle->captures};
+        for (const auto &reduction : whyle->reductions)
+        {
+            shared.push_back(reduction.variable->declaration);
+        }
+
+        auto environment_type = ArrayType::get(this->ir.getPtrTy(), std::max<size_t>(shared.size(), 1));
+        auto environment      = this->create_entry_alloca(environment_type, Align{8}, "environment");
+        for (size_t i = 0; i < shared.size(); ++i)
+        {
+            auto address = shared[i]->named_value;
+
+            // Arguments are held in registers unless they are aggregates
+            auto type = shared[i]->init_expression->inferred_type();
+            if (isa<Argument>(address) && is_aggregate(type) == false)
+            {
+                auto copy = this->create_entry_alloca(type, shared[i]->identifier);
+                this->ir.CreateStore(address, copy);
+                address = copy;
+            }
+
+            this->ir.CreateStore(address, this->ir.CreateConstGEP2_64(environment_type, environment, 0, i));
+        }
+
+        auto function_type = FunctionType::get(
+            this->ir.getVoidTy(),
+            {this->ir.getPtrTy(), this->ir.getInt64Ty(), this->ir.getInt64Ty()},
+            false);
+        auto function = Function::Create(
+            function_type,
+            GlobalValue::LinkageTypes::InternalLinkage,
+            std::format("{}.parallel_for", this->ir.GetInsertBlock()->getParent()->getName().str()),
+            this->module);
+        function->addFnAttr(Attribute::NoUnwind);
+        function->getArg(0)->setName("environment");
+        function->getArg(1)->setName("begin");
+        function->getArg(2)->setName("end");
+
+        {
+            IRBuilderBase::InsertPointGuard guard{this->ir};
+            this->generate_parallel_body(whyle, function, shared, environment_type);
+        }
+
+        auto parallel_for = this->module.getOrInsertFunction(
+            "fasel_parallel_for",
+            FunctionType::get(
+                this->ir.getVoidTy(),
+                {this->ir.getPtrTy(), this->ir.getPtrTy(), this->ir.getInt64Ty(), this->ir.getInt64Ty(),
+                 this->ir.getInt64Ty()},
+                false));
+        this->ir.CreateCall(parallel_for, {function, environment, begin, end, grain_size});
+
+        return nullptr;
+    }
+
+    // Compiles the outlined body of a parallel for loop (see generate_parallel_loop). While it is compiled, the
+    // variables that the body uses refer to their addresses in the environment, to the copies of the reduction
+    // variables and to a counter of its own.
+    void generate_parallel_body(
+        WhileLoopNode *whyle,
+        Function *function,
+        const std::vector<DeclarationNode *> &shared,
+        ArrayType *environment_type)
+    {
+        auto condition = node_cast<BinaryOperatorNode, true>(whyle->condition);
+        auto counter   = node_cast<IdentifierNode, true>(condition->lhs)->declaration;
+
+        std::vector<std::pair<DeclarationNode *, Value *>> saved_values{{counter, counter->named_value}};
+        for (auto decl : shared)
+        {
+            saved_values.emplace_back(decl, decl->named_value);
+        }
+
+        defer
+        {
+            for (auto [decl, value] : saved_values)
+            {
+                decl->named_value = value;
+            }
+        };
+
+        SET_TEMPORARILY(this->current_result, nullptr);
+        SET_TEMPORARILY(this->current_trap, nullptr);
+        SET_TEMPORARILY(this->current_break_target, nullptr);
+
+        this->ir.SetInsertPoint(BasicBlock::Create(this->llvm_context, "entry", function));
+
+        std::vector<Value *> shared_addresses{};
+        for (size_t i = 0; i < shared.size(); ++i)
+        {
+            auto slot = this->ir.CreateConstGEP2_64(environment_type, function->getArg(0), 0, i);
+            shared_addresses.push_back(this->ir.CreateLoad(this->ir.getPtrTy(), slot, shared[i]->identifier));
+            shared[i]->named_value = shared_addresses.back();
+        }
+
+        auto first_reduction = whyle->captures.size();
+        for (size_t i = 0; i < whyle->reductions.size(); ++i)
+        {
+            auto &reduction = whyle->reductions[i];
+            auto type       = node_cast<BasicTypeNode, true>(reduction.variable->inferred_type());
+            auto copy       = this->ir.CreateAlloca(this->convert_type(type), nullptr, reduction.variable->identifier);
+            this->ir.CreateStore(this->reduction_identity(reduction.kind, type), copy);
+            shared[first_reduction + i]->named_value = copy;
+        }
+
+        counter->named_value = this->ir.CreateAlloca(this->ir.getInt64Ty(), nullptr, counter->identifier);
+        this->ir.CreateStore(function->getArg(1), counter->named_value);
+
+        // Every task has its own variables
+        this->allocate_locals(whyle->body);
+
+        auto head_block = BasicBlock::Create(this->llvm_context, "parallel_for_head", function);
+        auto body_block = BasicBlock::Create(this->llvm_context, "parallel_for_body", function);
+        auto done_block = BasicBlock::Create(this->llvm_context, "parallel_for_done", function);
+
+        SET_TEMPORARILY(this->current_continue_target, head_block);
+        SET_TEMPORARILY(this->current_prologue, whyle->prologue);
+
+        this->ir.CreateBr(head_block);
+
+        this->ir.SetInsertPoint(head_block);
+        auto value    = this->ir.CreateLoad(this->ir.getInt64Ty(), counter->named_value, "counter");
+        auto in_range = this->ir.CreateICmpSLT(value, function->getArg(2), "parallel_for_cond");
+        this->create_conditional_branch(in_range, body_block, done_block);
+
+        this->ir.SetInsertPoint(body_block);
+        this->generate_code(whyle->body);
+
+        if (this->ir.GetInsertBlock()->getTerminator() == nullptr)
+        {
+            this->generate_code(whyle->prologue);
+            this->ir.CreateBr(head_block);
+        }
+
+        this->ir.SetInsertPoint(done_block);
+
+        if (whyle->reductions.empty() == false)
+        {
+            auto lock_type = FunctionType::get(this->ir.getVoidTy(), false);
+            this->ir.CreateCall(this->module.getOrInsertFunction("fasel_reduction_lock", lock_type));
+
+            for (size_t i = 0; i < whyle->reductions.size(); ++i)
+            {
+                auto &reduction = whyle->reductions[i];
+                auto type       = node_cast<BasicTypeNode, true>(reduction.variable->inferred_type());
+                auto address    = shared_addresses[first_reduction + i];
+
+                auto result = this->ir.CreateLoad(this->convert_type(type), address, "result");
+                auto copy   = this->ir.CreateLoad(this->convert_type(type), shared[first_reduction + i]->named_value);
+                this->ir.CreateStore(this->generate_reduction(reduction.kind, type, result, copy), address);
+            }
+
+            this->ir.CreateCall(this->module.getOrInsertFunction("fasel_reduction_unlock", lock_type));
+        }
+
+        this->ir.CreateRetVoid();
+    }
+
     Value *generate_code(BreakStatementNode *node)
     {
         assert(this->current_break_target != nullptr);
@@ -585,6 +1513,7 @@ struct IrCompiler
     {
         assert(this->current_continue_target != nullptr);
 
+        this->generate_code(this->current_prologue);
         this->ir.CreateBr(this->current_continue_target);
 
         return nullptr;
@@ -632,117 +1561,849 @@ struct IrCompiler
     {
         assert(proc->is_external == false);
 
-        for (auto arg : proc->signature->arguments)
-        {
-            for (auto &the_arg : this->ir.GetInsertBlock()->getParent()->args())
-            {
-                if (StringRef{arg->identifier} == the_arg.getName())
-                {
-                    arg->named_value = &the_arg;
-                }
-            }
+        auto function       = this->ir.GetInsertBlock()->getParent();
+        auto first_argument = first_argument_index(proc->signature);
 
-            assert(arg->named_value != nullptr);
+        this->current_result    = first_argument != 0 ? function->getArg(0) : nullptr;
+        this->current_trap      = nullptr;
+        this->current_coroutine = {};
+        for (size_t i = 0; i < proc->signature->arguments.size(); ++i)
+        {
+            proc->signature->arguments[i]->named_value = function->getArg(first_argument + i);
         }
 
         this->allocate_locals(proc->body);
+        if (proc->is_async)
+        {
+            this->generate_coroutine_prologue(proc, function);
+        }
+
         this->generate_code(proc->body);
 
         return nullptr;
     }
 
-    Value *generate_code(ProcedureCallNode *call)
+    // An async procedure is compiled to a switched-resume coroutine of LLVM (https://llvm.org/docs/Coroutines.html).
+    // Its function allocates the frame from the arena of the executor, schedules the task and suspends, so it returns
+    // the frame right away. The executor resumes the task later, which runs until it awaits a task that is not done,
+    // yields or returns. The tasks that await it read the promise (see generate_await):
+    //
+    // final:
+    //     promise.done = true
+    //     if promise.waiter != null fasel_task_schedule(fasel.resume, promise.waiter)
+    //     <final suspension>
+    void generate_coroutine_prologue(ProcedureNode *proc, Function *function)
     {
-        assert(call->procedure->kind == NodeKind::identifier);  // TODO: Function pointer calling
-        auto ident = static_cast<IdentifierNode *>(call->procedure);
-
-        if (ident->declaration->named_value == nullptr)
+        auto &coroutine        = this->current_coroutine;
+        coroutine.promise_type = this->promise_type(proc->signature->return_type);
+        coroutine.promise      = this->create_entry_alloca(coroutine.promise_type, Align{8}, "promise");
+        function->setPresplitCoroutine();
+
+        auto null = ConstantPointerNull::get(this->ir.getPtrTy());
+        auto id   = this->ir.CreateIntrinsic(
+            llvm::Intrinsic::coro_id,
+            {},
+            {this->ir.getInt32(8), coroutine.promise, null, null});
+
+        auto task_allocate = this->module.getOrInsertFunction(
+            "fasel_task_allocate",
+            FunctionType::get(this->ir.getPtrTy(), {this->ir.getInt64Ty(), this->ir.getInt64Ty()}, false));
+        auto size      = this->ir.CreateIntrinsic(llvm::Intrinsic::coro_size, {this->ir.getInt64Ty()}, {});
+        auto alignment = this->ir.CreateIntrinsic(llvm::Intrinsic::coro_align, {this->ir.getInt64Ty()}, {});
+        auto memory    = this->ir.CreateCall(task_allocate, {size, alignment}, "memory");
+        coroutine.handle = this->ir.CreateIntrinsic(llvm::Intrinsic::coro_begin, {}, {id, memory});
+
+        this->ir.CreateStore(null, this->ir.CreateStructGEP(coroutine.promise_type, coroutine.promise, 0, "waiter"));
+        this->ir.CreateStore(
+            this->ir.getFalse(),
+            this->ir.CreateStructGEP(coroutine.promise_type, coroutine.promise, 1, "done"));
+
+        // The caller may reuse the copies of struct arguments as soon as the task suspends
+        auto first_argument = first_argument_index(proc->signature);
+        for (size_t i = 0; i < proc->signature->arguments.size(); ++i)
         {
-            // Compile on demand for out of order declarations
-            IrCompiler ir_compiler{this->llvm_context, this->module};
-            ir_compiler.generate_code(ident->declaration);
-            assert(ident->declaration->named_value != nullptr);
+            auto argument = proc->signature->arguments[i];
+            if (auto type = argument->init_expression->inferred_type(); is_aggregate(type))
+            {
+                auto copy      = this->create_entry_alloca(type, argument->identifier);
+                auto alignment = copy->getAlign();
+                this->ir.CreateMemCpy(copy, alignment, function->getArg(first_argument + i), alignment, size_of(type));
+                argument->named_value = copy;
+            }
         }
 
-        assert(ident->declaration->init_expression->kind == NodeKind::procedure);
-        auto proc = static_cast<ProcedureNode *>(ident->declaration->init_expression);
-
-        auto type = cast<FunctionType>(this->convert_type(proc->signature));
-
-        std::vector<Value *> arguments{};
-        for (auto argument : call->arguments)
-        {
-            auto argument_value = this->generate_code(argument);
-            arguments.push_back(argument_value);
-        }
+        coroutine.final   = BasicBlock::Create(this->llvm_context, "final", function);
+        coroutine.cleanup = BasicBlock::Create(this->llvm_context, "cleanup", function);
+        coroutine.suspend = BasicBlock::Create(this->llvm_context, "suspend", function);
 
-        if (proc->signature->return_type->kind == NodeKind::basic_type)
         {
-            auto return_basic = node_cast<BasicTypeNode>(proc->signature->return_type);
-            if (return_basic->type_kind == BasicTypeNode::Kind::voyd)
-            {
-                this->ir.CreateCall(type, ident->declaration->named_value, arguments);
-                return nullptr;
-            }
+            IRBuilderBase::InsertPointGuard guard{this->ir};
+
+            this->ir.SetInsertPoint(coroutine.suspend);
+            this->ir.CreateIntrinsic(
+                llvm::Intrinsic::coro_end,
+                {},
+                {coroutine.handle, this->ir.getFalse(), ConstantTokenNone::get(this->llvm_context)});
+            this->ir.CreateRet(coroutine.handle);
+
+            this->ir.SetInsertPoint(coroutine.cleanup);
+            this->ir.CreateBr(coroutine.suspend);
+
+            auto resume_waiter = BasicBlock::Create(this->llvm_context, "resume_waiter", function);
+            auto final_suspend = BasicBlock::Create(this->llvm_context, "final_suspend", function);
+
+            this->ir.SetInsertPoint(coroutine.final);
+            this->ir.CreateStore(
+                this->ir.getTrue(),
+                this->ir.CreateStructGEP(coroutine.promise_type, coroutine.promise, 1, "done"));
+            auto waiter = this->ir.CreateLoad(
+                this->ir.getPtrTy(),
+                this->ir.CreateStructGEP(coroutine.promise_type, coroutine.promise, 0, "waiter"),
+                "waiter");
+            this->ir.CreateCondBr(this->ir.CreateIsNotNull(waiter), resume_waiter, final_suspend);
+
+            this->ir.SetInsertPoint(resume_waiter);
+            this->generate_schedule(waiter);
+            this->ir.CreateBr(final_suspend);
+
+            this->ir.SetInsertPoint(final_suspend);
+            this->generate_suspend(nullptr, true);
         }
 
-        return this->ir
-            .CreateCall(type, ident->declaration->named_value, arguments, std::format("call_{}", ident->identifier));
+        auto body = BasicBlock::Create(this->llvm_context, "body", function);
+        this->generate_schedule(coroutine.handle);
+        this->generate_suspend(body);
+        this->ir.SetInsertPoint(body);
     }
 
-    Value *generate_code(ReturnStatementNode *retyrn)
+    // Suspends the task of the procedure, it continues with the block when the executor resumes it. The final
+    // suspension is never resumed.
+    void generate_suspend(BasicBlock *resume, bool is_final = false)
     {
-        if (retyrn->expression->kind == NodeKind::nop)
+        auto state = this->ir.CreateIntrinsic(
+            llvm::Intrinsic::coro_suspend,
+            {},
+            {ConstantTokenNone::get(this->llvm_context), this->ir.getInt1(is_final)});
+
+        auto zwitch = this->ir.CreateSwitch(state, this->current_coroutine.suspend, 2);
+        if (resume != nullptr)
         {
-            return this->ir.CreateRet(nullptr);
+            zwitch->addCase(this->ir.getInt8(0), resume);
         }
 
-        auto value = this->generate_code(retyrn->expression);
-        this->ir.CreateRet(value);
+        zwitch->addCase(this->ir.getInt8(1), this->current_coroutine.cleanup);
+    }
 
-        return nullptr;
+    // Queues the task for being resumed by the executor
+    void generate_schedule(Value *task)
+    {
+        auto schedule = this->module.getOrInsertFunction(
+            "fasel_task_schedule",
+            FunctionType::get(this->ir.getVoidTy(), {this->ir.getPtrTy(), this->ir.getPtrTy()}, false));
+        this->ir.CreateCall(schedule, {this->task_resume_function(), task});
     }
 
-    Value *generate_code(LabelNode *label)
+    // void fasel.resume(ptr task) { llvm.coro.resume(task) }, the executor resumes tasks through it (see TaskResume)
+    Function *task_resume_function()
     {
-        TODO;
+        if (auto function = this->module.getFunction("fasel.resume"))
+        {
+            return function;
+        }
 
-        // this->current_function->insert(this->current_function->end(), label->block);
-        // this->current_function->insert(this->current_function->end(), label->after);
+        auto function = Function::Create(
+            FunctionType::get(this->ir.getVoidTy(), {this->ir.getPtrTy()}, false),
+            GlobalValue::LinkageTypes::InternalLinkage,
+            "fasel.resume",
+            this->module);
+        function->addFnAttr(Attribute::NoUnwind);
+        function->getArg(0)->setName("task");
 
-        // this->ir.SetInsertPoint(label->block);
-        // this->ir.CreateBr(label->after);
-        // this->ir.SetInsertPoint(label->block->begin());
+        IRBuilderBase::InsertPointGuard guard{this->ir};
+        this->ir.SetInsertPoint(BasicBlock::Create(this->llvm_context, "entry", function));
+        this->ir.CreateIntrinsic(llvm::Intrinsic::coro_resume, {}, {function->getArg(0)});
+        this->ir.CreateRetVoid();
 
-        // return nullptr;
+        return function;
     }
 
-    Value *generate_code(GotoStatementNode *gotoo)
+    // Waits until the task is done and returns its result. The task of the procedure stores itself as the waiter of
+    // the task and suspends if it is not done, the task schedules its waiter when it is done. There is only one
+    // waiter, so awaiting a task that another task awaits fails:
+    //
+    // while promise.done == false {
+    //     if promise.waiter != null && promise.waiter != <the task of the procedure> fasel_task_fail(awaited_twice)
+    //     promise.waiter = <the task of the procedure>
+    //     <suspension>
+    // }
+    Value *generate_await(Value *task, const Node *result_type)
     {
-        TODO;
+        auto function     = this->ir.GetInsertBlock()->getParent();
+        auto promise_type = this->promise_type(result_type);
+        auto promise      = this->ir.CreateIntrinsic(
+            llvm::Intrinsic::coro_promise,
+            {},
+            {task, this->ir.getInt32(8), this->ir.getFalse()});
+
+        auto check = BasicBlock::Create(this->llvm_context, "await_check", function);
+        auto wait  = BasicBlock::Create(this->llvm_context, "await_wait", function);
+        auto ready = BasicBlock::Create(this->llvm_context, "await_ready", function);
+        this->ir.CreateBr(check);
+
+        this->ir.SetInsertPoint(check);
+        auto done = this->ir.CreateLoad(
+            this->ir.getInt1Ty(),
+            this->ir.CreateStructGEP(promise_type, promise, 1, "done"),
+            "done");
+        this->ir.CreateCondBr(done, ready, wait);
+
+        this->ir.SetInsertPoint(wait);
+        auto waiter          = this->ir.CreateStructGEP(promise_type, promise, 0, "waiter");
+        auto previous_waiter = this->ir.CreateLoad(this->ir.getPtrTy(), waiter, "previous_waiter");
+        auto is_awaited      = this->ir.CreateAnd(
+            this->ir.CreateIsNotNull(previous_waiter),
+            this->ir.CreateICmpNE(previous_waiter, this->current_coroutine.handle));
+        this->generate_task_check(this->ir.CreateNot(is_awaited), TaskError::awaited_twice);
+        this->ir.CreateStore(this->current_coroutine.handle, waiter);
+        this->generate_suspend(check);
+
+        this->ir.SetInsertPoint(ready);
+        return this->load_task_result(promise, promise_type, result_type);
+    }
 
-        // auto decl = this->current_procedure->body->find_declaration(gotoo->label_identifier);
-        // assert(decl != nullptr);
+    // Continues only if the condition holds and fails with the error otherwise (see fasel_task_fail)
+    void generate_task_check(Value *condition, TaskError error)
+    {
+        auto function = this->ir.GetInsertBlock()->getParent();
+        auto fail     = BasicBlock::Create(this->llvm_context, "task_fail", function);
+        auto ok       = BasicBlock::Create(this->llvm_context, "task_ok", function);
 
-        // auto label = node_cast<LabelNode, true>(decl->init_expression);
-        // assert(label->block != nullptr);
+        MDBuilder md_builder{this->llvm_context};
+        this->ir.CreateCondBr(condition, ok, fail, md_builder.createBranchWeights(1 << 20, 1));
 
-        // this->ir.CreateBr(label->block);
+        this->ir.SetInsertPoint(fail);
+        auto task_fail = this->module.getOrInsertFunction(
+            "fasel_task_fail",
+            FunctionType::get(this->ir.getVoidTy(), {this->ir.getInt64Ty()}, false));
+        this->ir.CreateCall(task_fail, {this->ir.getInt64(static_cast<int64_t>(error))});
+        this->ir.CreateUnreachable();
 
-        // return nullptr;
+        this->ir.SetInsertPoint(ok);
     }
 
-    Value *generate_code(TypeCastNode *cast)
+    Value *load_task_result(Value *promise, StructType *promise_type, const Node *result_type)
     {
-        auto dest_basic_type = node_cast<BasicTypeNode, true>(cast->inferred_type());
-        auto src_basic_type  = node_cast<BasicTypeNode, true>(cast->expression->inferred_type());
+        if (promise_type->getNumElements() == 2)
+        {
+            return nullptr;
+        }
 
-        // assert(dest_basic_type->type_kind == BasicTypeNode::Kind::floatingpoint);
+        return this->ir.CreateLoad(
+            this->convert_type(result_type),
+            this->ir.CreateStructGEP(promise_type, promise, 2, "result"),
+            "result");
+    }
 
-        auto expression_value = this->generate_code(cast->expression);
-        auto dest_type        = this->convert_type(dest_basic_type);
+    // The arguments of the task intrinsics are the calls of async procedures, which create the tasks
+    Value *generate_task_intrinsic(ProcedureCallNode *call)
+    {
+        switch (call->intrinsic)
+        {
+            // The executor runs until no task is ready, the one of the call must be done by then
+            case ::Intrinsic::run:
+            {
+                auto arena = this->generate_address(call->arguments[0]);
+                auto data  = this->ir.CreateAlignedLoad(this->ir.getPtrTy(), arena.pointer, arena.alignment, "arena");
+                auto size  = this->generate_length(call->arguments[0]->inferred_type(), arena);
+
+                auto executor_begin = this->module.getOrInsertFunction(
+                    "fasel_executor_begin",
+                    FunctionType::get(this->ir.getVoidTy(), {this->ir.getPtrTy(), this->ir.getInt64Ty()}, false));
+                auto executor_run = this->module.getOrInsertFunction(
+                    "fasel_executor_run",
+                    FunctionType::get(this->ir.getVoidTy(), {}, false));
+
+                this->ir.CreateCall(executor_begin, {data, size});
+                auto task = this->generate_code(call->arguments[1]);
+                this->ir.CreateCall(executor_run, {});
+
+                auto result_type  = call->arguments[1]->inferred_type();
+                auto promise_type = this->promise_type(result_type);
+                auto promise      = this->ir.CreateIntrinsic(
+                    llvm::Intrinsic::coro_promise,
+                    {},
+                    {task, this->ir.getInt32(8), this->ir.getFalse()});
+                auto done = this->ir.CreateLoad(
+                    this->ir.getInt1Ty(),
+                    this->ir.CreateStructGEP(promise_type, promise, 1, "done"),
+                    "done");
+                this->generate_task_check(done, TaskError::not_done);
+
+                return this->load_task_result(promise, promise_type, result_type);
+            }
 
-        // assert(dest_type->isFloatingPointTy());
+            case ::Intrinsic::start:
+            {
+                return this->ir.CreatePtrToInt(this->generate_code(call->arguments[0]), this->ir.getInt64Ty(), "task");
+            }
+
+            // Started tasks cannot return a value
+            case ::Intrinsic::await:
+            {
+                auto argument = call->arguments[0];
+                if (async_procedure(argument) != nullptr)
+                {
+                    return this->generate_await(this->generate_code(argument), argument->inferred_type());
+                }
+
+                auto task = this->ir.CreateIntToPtr(this->generate_code(argument), this->ir.getPtrTy(), "task");
+                return this->generate_await(task, &BuiltinTypes::voyd);
+            }
+
+            case ::Intrinsic::yield:
+            {
+                auto function = this->ir.GetInsertBlock()->getParent();
+                auto resume   = BasicBlock::Create(this->llvm_context, "yield_resume", function);
+                this->generate_schedule(this->current_coroutine.handle);
+                this->generate_suspend(resume);
+                this->ir.SetInsertPoint(resume);
+
+                return nullptr;
+            }
+
+            default: UNREACHED;
+        }
+    }
+
+    Value *generate_intrinsic(ProcedureCallNode *call)
+    {
+        // Usually folded by the typechecker, the first argument is a type
+        if (is_layout_query(call->intrinsic))
+        {
+            return this->ir.getInt64(evaluate_layout_query(call));
+        }
+
+        if (is_atomic(call->intrinsic))
+        {
+            return this->generate_atomic(call);
+        }
+
+        // The argument is the call that the new thread makes
+        if (call->intrinsic == ::Intrinsic::spawn)
+        {
+            return this->generate_spawn(call);
+        }
+
+        if (is_task_intrinsic(call->intrinsic))
+        {
+            return this->generate_task_intrinsic(call);
+        }
+
+        std::vector<Value *> arguments{};
+        for (auto argument : call->arguments)
+        {
+            arguments.push_back(this->generate_code(argument));
+        }
+
+        auto element_type = lane_type(call->arguments[0]->inferred_type());
+
+        // NOTE: ::Intrinsic, because llvm::Intrinsic is visible here as well
+        switch (call->intrinsic)
+        {
+            case ::Intrinsic::make_vector:
+            {
+                auto vector_type = node_cast<VectorTypeNode, true>(call->inferred_type());
+                if (arguments.size() == 1)
+                {
+                    return this->ir.CreateVectorSplat(vector_type->length, arguments[0], "splat");
+                }
+
+                Value *vector = PoisonValue::get(this->convert_type(vector_type));
+                for (size_t lane = 0; lane < arguments.size(); ++lane)
+                {
+                    vector = this->ir.CreateInsertElement(vector, arguments[lane], lane, "vector");
+                }
+
+                return vector;
+            }
+
+            case ::Intrinsic::extract:
+            {
+                return this->ir.CreateExtractElement(arguments[0], call->lanes[0], "extract");
+            }
+
+            case ::Intrinsic::insert:
+            {
+                return this->ir.CreateInsertElement(arguments[0], arguments[2], call->lanes[0], "insert");
+            }
+
+            case ::Intrinsic::shuffle:
+            case ::Intrinsic::swizzle:
+            {
+                // The lanes of the second vector follow the lanes of the first one
+                std::vector<int> mask{call->lanes.begin(), call->lanes.end()};
+                if (call->intrinsic == ::Intrinsic::swizzle)
+                {
+                    return this->ir.CreateShuffleVector(arguments[0], mask, "swizzle");
+                }
+
+                return this->ir.CreateShuffleVector(arguments[0], arguments[1], mask, "shuffle");
+            }
+
+            case ::Intrinsic::select:
+            {
+                return this->ir.CreateSelect(arguments[0], arguments[1], arguments[2], "select");
+            }
+
+            // The floating point reductions are ordered, they add or multiply the lanes from the first to the last
+            case ::Intrinsic::reduce_add:
+            {
+                if (element_type->type_kind == BasicTypeNode::Kind::floatingpoint)
+                {
+                    auto zero = ConstantFP::getNegativeZero(this->convert_type(element_type));
+                    return this->ir.CreateFAddReduce(zero, arguments[0]);
+                }
+
+                return this->ir.CreateAddReduce(arguments[0]);
+            }
+
+            case ::Intrinsic::reduce_mul:
+            {
+                if (element_type->type_kind == BasicTypeNode::Kind::floatingpoint)
+                {
+                    auto one = ConstantFP::get(this->convert_type(element_type), 1.0);
+                    return this->ir.CreateFMulReduce(one, arguments[0]);
+                }
+
+                return this->ir.CreateMulReduce(arguments[0]);
+            }
+
+            case ::Intrinsic::reduce_min:
+            case ::Intrinsic::reduce_max:
+            {
+                auto is_min = call->intrinsic == ::Intrinsic::reduce_min;
+                if (element_type->type_kind == BasicTypeNode::Kind::floatingpoint)
+                {
+                    return is_min ? this->ir.CreateFPMinReduce(arguments[0]) : this->ir.CreateFPMaxReduce(arguments[0]);
+                }
+
+                auto is_signed = element_type->type_kind == BasicTypeNode::Kind::signed_integer;
+                return is_min ? this->ir.CreateIntMinReduce(arguments[0], is_signed)
+                              : this->ir.CreateIntMaxReduce(arguments[0], is_signed);
+            }
+
+            case ::Intrinsic::any: return this->ir.CreateOrReduce(arguments[0]);
+            case ::Intrinsic::all: return this->ir.CreateAndReduce(arguments[0]);
+
+            case ::Intrinsic::join:
+            {
+                auto thread_join = this->module.getOrInsertFunction(
+                    "fasel_thread_join",
+                    FunctionType::get(this->ir.getVoidTy(), {this->ir.getInt64Ty()}, false));
+                this->ir.CreateCall(thread_join, {arguments[0]});
+
+                return nullptr;
+            }
+
+            default: UNREACHED;
+        }
+    }
+
+    static AtomicOrdering atomic_ordering(MemoryOrder order)
+    {
+        switch (order)
+        {
+            case MemoryOrder::relaxed: return AtomicOrdering::Monotonic;
+            case MemoryOrder::acquire: return AtomicOrdering::Acquire;
+            case MemoryOrder::release: return AtomicOrdering::Release;
+            case MemoryOrder::acq_rel: return AtomicOrdering::AcquireRelease;
+            case MemoryOrder::seq_cst: return AtomicOrdering::SequentiallyConsistent;
+            default:                   UNREACHED;
+        }
+    }
+
+    // The typechecker made sure that the operand is aligned to its size
+    Value *generate_atomic(ProcedureCallNode *call)
+    {
+        auto ordering = atomic_ordering(call->memory_order);
+        if (call->intrinsic == ::Intrinsic::atomic_fence)
+        {
+            this->ir.CreateFence(ordering);
+            return nullptr;
+        }
+
+        auto type    = call->arguments[0]->inferred_type();
+        auto address = this->generate_address(call->arguments[0]);
+
+        std::vector<Value *> values{};
+        for (size_t i = 1; i < call->arguments.size(); ++i)
+        {
+            values.push_back(this->generate_code(call->arguments[i]));
+        }
+
+        auto basic     = node_cast<BasicTypeNode>(type);
+        auto is_float  = basic != nullptr && basic->type_kind == BasicTypeNode::Kind::floatingpoint;
+        auto is_signed = basic != nullptr && basic->type_kind == BasicTypeNode::Kind::signed_integer;
+
+        AtomicRMWInst::BinOp operation{};
+        switch (call->intrinsic)
+        {
+            case ::Intrinsic::atomic_load:
+            {
+                auto load = this->ir.CreateAlignedLoad(
+                    this->convert_type(type),
+                    address.pointer,
+                    address.alignment,
+                    "atomic_load");
+                load->setAtomic(ordering);
+
+                return load;
+            }
+
+            case ::Intrinsic::atomic_store:
+            {
+                auto store = this->ir.CreateAlignedStore(values[0], address.pointer, address.alignment);
+                store->setAtomic(ordering);
+
+                return nullptr;
+            }
+
+            case ::Intrinsic::atomic_compare_exchange:
+            {
+                auto compare_exchange = this->ir.CreateAtomicCmpXchg(
+                    address.pointer,
+                    values[0],
+                    values[1],
+                    address.alignment,
+                    ordering,
+                    AtomicCmpXchgInst::getStrongestFailureOrdering(ordering));
+
+                return this->ir.CreateExtractValue(compare_exchange, 0, "previous");
+            }
+
+            case ::Intrinsic::atomic_exchange: operation = AtomicRMWInst::Xchg; break;
+            case ::Intrinsic::atomic_add:      operation = is_float ? AtomicRMWInst::FAdd : AtomicRMWInst::Add; break;
+            case ::Intrinsic::atomic_sub:      operation = is_float ? AtomicRMWInst::FSub : AtomicRMWInst::Sub; break;
+            case ::Intrinsic::atomic_and:      operation = AtomicRMWInst::And; break;
+            case ::Intrinsic::atomic_or:       operation = AtomicRMWInst::Or; break;
+            case ::Intrinsic::atomic_xor:      operation = AtomicRMWInst::Xor; break;
+            case ::Intrinsic::atomic_min:      operation = is_signed ? AtomicRMWInst::Min : AtomicRMWInst::UMin; break;
+            case ::Intrinsic::atomic_max:      operation = is_signed ? AtomicRMWInst::Max : AtomicRMWInst::UMax; break;
+            default:                           UNREACHED;
+        }
+
+        return this->ir.CreateAtomicRMW(operation, address.pointer, values[0], address.alignment, ordering);
+    }
+
+    // The function that a call to the procedure calls
+    Value *generate_callee(IdentifierNode *ident)
+    {
+        auto proc = node_cast<ProcedureNode, true>(ident->declaration->init_expression);
+        if (this->options.procedure_slot && proc->is_external == false)
+        {
+            // Call indirectly through the procedure's slot
+            auto slot         = this->options.procedure_slot(ident->declaration);
+            auto slot_address = ConstantExpr::getIntToPtr(
+                this->ir.getInt64(reinterpret_cast<uint64_t>(slot)),
+                this->ir.getPtrTy());
+
+            auto load = this->ir.CreateLoad(this->ir.getPtrTy(), slot_address, std::format("{}_slot", ident->identifier));
+            load->setAtomic(AtomicOrdering::Monotonic);
+            load->setAlignment(Align{alignof(std::atomic<void *>)});
+
+            return load;
+        }
+
+        if (ident->declaration->named_value == nullptr)
+        {
+            // Compile on demand for out of order declarations
+            IrCompiler ir_compiler{this->llvm_context, this->module, this->options};
+            ir_compiler.generate_code(ident->declaration);
+            assert(ident->declaration->named_value != nullptr);
+        }
+
+        return ident->declaration->named_value;
+    }
+
+    // spawn(f(...)) copies the arguments of the call to an environment (see thread_environment) and passes it to the
+    // runtime library (see runtime.h), together with a function that calls the procedure with them:
+    //
+    // void <f>.spawn(ptr environment)
+    // {
+    //     f(<environment[i]>...)  // Struct arguments are passed by their address in the environment
+    // }
+    Value *generate_spawn(ProcedureCallNode *spawn)
+    {
+        auto call   = node_cast<ProcedureCallNode, true>(spawn->arguments[0]);
+        auto ident  = node_cast<IdentifierNode, true>(call->procedure);
+        auto proc   = node_cast<ProcedureNode, true>(ident->declaration->init_expression);
+        auto layout = thread_environment(call);
+
+        auto argument_address = [&](Value *environment, size_t index)
+        {
+            auto pointer = this->ir.CreateConstInBoundsGEP1_64(
+                this->ir.getInt8Ty(),
+                environment,
+                static_cast<uint64_t>(layout.offsets[index]));
+
+            return Address{pointer, Align{static_cast<uint64_t>(align_of(call->arguments[index]->inferred_type()))}};
+        };
+
+        auto environment = this->create_entry_alloca(
+            ArrayType::get(this->ir.getInt8Ty(), std::max<int64_t>(layout.size, 1)),
+            Align{static_cast<uint64_t>(layout.alignment)},
+            "environment");
+        for (size_t i = 0; i < call->arguments.size(); ++i)
+        {
+            auto argument = call->arguments[i];
+            auto address  = argument_address(environment, i);
+            if (is_aggregate(argument->inferred_type()))
+            {
+                this->generate_copy(address, argument);
+                continue;
+            }
+
+            this->ir.CreateAlignedStore(this->generate_code(argument), address.pointer, address.alignment);
+        }
+
+        // The arguments have the types of the parameters, so all spawns of the procedure share the function
+        auto name  = std::format("{}.spawn", ident->identifier);
+        auto entry = this->module.getFunction(name);
+        if (entry == nullptr)
+        {
+            entry = Function::Create(
+                FunctionType::get(this->ir.getVoidTy(), {this->ir.getPtrTy()}, false),
+                GlobalValue::LinkageTypes::InternalLinkage,
+                name,
+                this->module);
+            entry->addFnAttr(Attribute::NoUnwind);
+            entry->getArg(0)->setName("environment");
+
+            IRBuilderBase::InsertPointGuard guard{this->ir};
+            this->ir.SetInsertPoint(BasicBlock::Create(this->llvm_context, "entry", entry));
+
+            std::vector<Value *> arguments{};
+            for (size_t i = 0; i < call->arguments.size(); ++i)
+            {
+                auto type    = call->arguments[i]->inferred_type();
+                auto address = argument_address(entry->getArg(0), i);
+                if (is_aggregate(type))
+                {
+                    arguments.push_back(address.pointer);
+                    continue;
+                }
+
+                auto value = this->ir.CreateAlignedLoad(this->convert_type(type), address.pointer, address.alignment);
+                arguments.push_back(value);
+            }
+
+            auto type = cast<FunctionType>(this->convert_type(proc->signature));
+            this->ir.CreateCall(type, this->generate_callee(ident), arguments);
+            this->ir.CreateRetVoid();
+        }
+
+        auto thread_spawn = this->module.getOrInsertFunction(
+            "fasel_thread_spawn",
+            FunctionType::get(
+                this->ir.getInt64Ty(),
+                {this->ir.getPtrTy(), this->ir.getPtrTy(), this->ir.getInt64Ty(), this->ir.getInt64Ty()},
+                false));
+
+        return this->ir.CreateCall(
+            thread_spawn,
+            {entry, environment, this->ir.getInt64(layout.size), this->ir.getInt64(layout.alignment)},
+            "thread");
+    }
+
+    // A tail call (see ReturnStatementNode) passes on the result address and the struct arguments that the procedure
+    // received itself, it is followed by the return
+    Value *generate_code(ProcedureCallNode *call, bool is_tail_call = false)
+    {
+        if (call->intrinsic != ::Intrinsic::none)
+        {
+            return this->generate_intrinsic(call);
+        }
+
+        assert(call->procedure->kind == NodeKind::identifier);  // TODO: Function pointer calling
+        auto ident = static_cast<IdentifierNode *>(call->procedure);
+
+        assert(ident->declaration->init_expression->kind == NodeKind::procedure);
+        auto proc = static_cast<ProcedureNode *>(ident->declaration->init_expression);
+
+        auto type   = this->function_type(proc);
+        auto callee = this->generate_callee(ident);
+
+        std::vector<Value *> arguments{};
+
+        Value *result{};
+        if (auto return_type = proc->signature->return_type; is_aggregate(return_type))
+        {
+            result = is_tail_call ? this->current_result : this->create_entry_alloca(return_type, "result");
+            arguments.push_back(result);
+        }
+
+        for (auto argument : call->arguments)
+        {
+            // Structs are passed by value, the callee gets the address of a copy
+            if (auto argument_type = argument->inferred_type(); is_aggregate(argument_type))
+            {
+                if (is_tail_call)
+                {
+                    arguments.push_back(node_cast<IdentifierNode, true>(argument)->declaration->named_value);
+                    continue;
+                }
+
+                auto copy = this->create_entry_alloca(argument_type, "argument");
+                this->generate_copy(Address{copy, copy->getAlign()}, argument);
+                arguments.push_back(copy);
+                continue;
+            }
+
+            auto argument_value = this->generate_code(argument);
+            arguments.push_back(argument_value);
+        }
+
+        if (is_tail_call)
+        {
+            auto instruction = this->ir.CreateCall(type, callee, arguments);
+            instruction->setTailCallKind(CallInst::TCK_MustTail);
+            return instruction;
+        }
+
+        if (result != nullptr)
+        {
+            this->ir.CreateCall(type, callee, arguments);
+            return result;
+        }
+
+        if (proc->is_async)
+        {
+            return this->ir.CreateCall(type, callee, arguments, "task");
+        }
+
+        if (proc->signature->return_type->kind == NodeKind::basic_type)
+        {
+            auto return_basic = node_cast<BasicTypeNode>(proc->signature->return_type);
+            if (return_basic->type_kind == BasicTypeNode::Kind::voyd)
+            {
+                this->ir.CreateCall(type, callee, arguments);
+                return nullptr;
+            }
+        }
+
+        return this->ir.CreateCall(type, callee, arguments, std::format("call_{}", ident->identifier));
+    }
+
+    Value *generate_code(ReturnStatementNode *retyrn)
+    {
+        // The result of a task is kept in its promise
+        if (auto &coroutine = this->current_coroutine; coroutine.handle != nullptr)
+        {
+            if (retyrn->expression->kind != NodeKind::nop)
+            {
+                auto value = this->generate_code(retyrn->expression);
+                this->ir.CreateStore(value, this->ir.CreateStructGEP(coroutine.promise_type, coroutine.promise, 2));
+            }
+
+            this->ir.CreateBr(coroutine.final);
+
+            return nullptr;
+        }
+
+        if (retyrn->expression->kind == NodeKind::nop)
+        {
+            return this->ir.CreateRet(nullptr);
+        }
+
+        // musttail guarantees that the call replaces the frame, the return has to follow it immediately
+        if (retyrn->is_tail_call)
+        {
+            auto call = this->generate_code(node_cast<ProcedureCallNode, true>(retyrn->expression), true);
+            if (call->getType()->isVoidTy())
+            {
+                this->ir.CreateRetVoid();
+            }
+            else
+            {
+                this->ir.CreateRet(call);
+            }
+
+            return nullptr;
+        }
+
+        if (auto type = retyrn->expression->inferred_type(); is_aggregate(type))
+        {
+            this->generate_copy(
+                Address{this->current_result, Align{static_cast<uint64_t>(align_of(type))}},
+                retyrn->expression);
+            this->ir.CreateRetVoid();
+
+            return nullptr;
+        }
+
+        auto value = this->generate_code(retyrn->expression);
+
+        // Self-recursive calls whose arguments cannot point into the frame are marked as tail calls, which the code
+        // generator turns into jumps where it can
+        auto call     = dyn_cast_or_null<CallInst>(value);
+        auto function = this->ir.GetInsertBlock()->getParent();
+        if (call != nullptr && call->getCalledFunction() == function &&
+            std::ranges::none_of(call->args(), [](const Use &argument) { return argument->getType()->isPointerTy(); }))
+        {
+            call->setTailCall();
+        }
+
+        this->ir.CreateRet(value);
+
+        return nullptr;
+    }
+
+    Value *generate_code(LabelNode *label)
+    {
+        TODO;
+
+        // this->current_function->insert(this->current_function->end(), label->block);
+        // this->current_function->insert(this->current_function->end(), label->after);
+
+        // this->ir.SetInsertPoint(label->block);
+        // this->ir.CreateBr(label->after);
+        // this->ir.SetInsertPoint(label->block->begin());
+
+        // return nullptr;
+    }
+
+    Value *generate_code(GotoStatementNode *gotoo)
+    {
+        TODO;
+
+        // auto decl = this->current_procedure->body->find_declaration(gotoo->label_identifier);
+        // assert(decl != nullptr);
+
+        // auto label = node_cast<LabelNode, true>(decl->init_expression);
+        // assert(label->block != nullptr);
+
+        // this->ir.CreateBr(label->block);
+
+        // return nullptr;
+    }
+
+    Value *generate_code(TypeCastNode *cast)
+    {
+        // A scalar that is cast to a vector is set in all lanes, it already has the type of the lanes
+        if (auto vector_type = node_cast<VectorTypeNode>(cast->inferred_type()))
+        {
+            return this->ir.CreateVectorSplat(vector_type->length, this->generate_code(cast->expression), "splat");
+        }
+
+        auto dest_basic_type = node_cast<BasicTypeNode, true>(cast->inferred_type());
+        auto src_basic_type  = node_cast<BasicTypeNode, true>(cast->expression->inferred_type());
+
+        // assert(dest_basic_type->type_kind == BasicTypeNode::Kind::floatingpoint);
+
+        auto expression_value = this->generate_code(cast->expression);
+        auto dest_type        = this->convert_type(dest_basic_type);
+
+        // assert(dest_type->isFloatingPointTy());
 
         switch (src_basic_type->type_kind)
         {
@@ -771,6 +2432,12 @@ struct IrCompiler
             {
                 switch (dest_basic_type->type_kind)
                 {
+                    case BasicTypeNode::Kind::unsigned_integer:
+                    {
+                        assert(src_basic_type->size != dest_basic_type->size);
+                        return this->ir.CreateIntCast(expression_value, dest_type, false, "intcast");
+                    }
+
                     case BasicTypeNode::Kind::floatingpoint:
                     {
                         return this->ir.CreateUIToFP(expression_value, dest_type, "utof");
@@ -812,6 +2479,224 @@ struct IrCompiler
         }
     }
 
+    // Returns the address of the variable, the field, the array element or the struct or array (whose value is its
+    // address)
+    Address generate_address(Node *node)
+    {
+        switch (node->kind)
+        {
+            case NodeKind::member_access:
+            {
+                auto member_access = static_cast<MemberAccessNode *>(node);
+                auto struct_type   = struct_layout(member_access->object->inferred_type());
+                const auto &field  = struct_type->fields[member_access->field_index];
+
+                // a[i].x of a @soa array is the element i of the array of the field
+                if (auto index = node_cast<IndexNode>(member_access->object))
+                {
+                    auto array = node_cast<ArrayTypeNode>(index->array->inferred_type());
+                    if (array != nullptr && array->is_soa)
+                    {
+                        auto offset = soa_field_offset(array, member_access->field_index);
+                        return this->generate_element_address(index, offset, field.type);
+                    }
+                }
+
+                auto object  = this->generate_address(member_access->object);
+                auto pointer = this->ir.CreateConstInBoundsGEP1_64(
+                    this->ir.getInt8Ty(),
+                    object.pointer,
+                    field.offset,
+                    member_access->member);
+
+                return Address{pointer, commonAlignment(object.alignment, field.offset)};
+            }
+
+            case NodeKind::index:
+            {
+                auto index = static_cast<IndexNode *>(node);
+                return this->generate_element_address(index, 0, index->inferred_type());
+            }
+
+            default:
+            {
+                auto type = node->inferred_type();
+
+                // The address of a local variable that is not an aggregate is its alloca (see allocate_locals)
+                if (auto ident = node_cast<IdentifierNode>(node); ident != nullptr && is_aggregate(type) == false)
+                {
+                    assert(isa<Argument>(ident->declaration->named_value) == false);
+                    return Address{ident->declaration->named_value, Align{static_cast<uint64_t>(align_of(type))}};
+                }
+
+                assert(is_aggregate(type));
+
+                return Address{this->generate_code(node), Align{static_cast<uint64_t>(align_of(type))}};
+            }
+        }
+    }
+
+    // Returns the address of the element of the array or the slice whose elements start at the offset from the first
+    // element. The index is checked against the number of elements unless it is known to be in bounds.
+    Address generate_element_address(IndexNode *index, int64_t offset, const Node *element_type)
+    {
+        auto array = this->generate_address(index->array);
+        auto value = this->generate_integer(index->index);
+
+        if (index->needs_bounds_check)
+        {
+            auto length = this->generate_length(index->array->inferred_type(), array);
+            this->generate_bounds_check(this->ir.CreateICmpULT(value, length, "in_bounds"));
+        }
+
+        // A slice holds the address of its elements, which are aligned like their type
+        if (index->array->inferred_type()->kind == NodeKind::slice_type)
+        {
+            auto data = this->ir.CreateAlignedLoad(this->ir.getPtrTy(), array.pointer, array.alignment, "data");
+            array     = Address{data, Align{static_cast<uint64_t>(align_of(element_type))}};
+        }
+
+        auto pointer = array.pointer;
+        if (offset != 0)
+        {
+            pointer = this->ir.CreateConstInBoundsGEP1_64(this->ir.getInt8Ty(), pointer, offset);
+        }
+
+        pointer = this->ir.CreateInBoundsGEP(this->convert_type(element_type), pointer, value, "element");
+
+        auto alignment = commonAlignment(commonAlignment(array.alignment, offset), size_of(element_type));
+        return Address{pointer, alignment};
+    }
+
+    // Evaluates an integer expression as an i64
+    Value *generate_integer(Node *node)
+    {
+        auto type      = node_cast<BasicTypeNode, true>(node->inferred_type());
+        auto is_signed = type->type_kind == BasicTypeNode::Kind::signed_integer;
+
+        return this->ir.CreateIntCast(this->generate_code(node), this->ir.getInt64Ty(), is_signed);
+    }
+
+    // The number of elements of the array or the slice at the address as an i64
+    Value *generate_length(const Node *type, Address address)
+    {
+        if (auto array = node_cast<ArrayTypeNode>(type))
+        {
+            return this->ir.getInt64(array_length(array));
+        }
+
+        auto pointer = this->ir.CreateConstInBoundsGEP1_64(
+            this->ir.getInt8Ty(),
+            address.pointer,
+            SliceTypeNode::length_offset,
+            "length");
+
+        return this->ir.CreateAlignedLoad(
+            this->ir.getInt64Ty(),
+            pointer,
+            commonAlignment(address.alignment, SliceTypeNode::length_offset),
+            "length");
+    }
+
+    // Continues only if the condition holds and aborts the program otherwise, the failure is assumed to be unlikely
+    void generate_bounds_check(Value *condition)
+    {
+        auto function = this->ir.GetInsertBlock()->getParent();
+
+        if (this->current_trap == nullptr)
+        {
+            IRBuilderBase::InsertPointGuard guard{this->ir};
+
+            this->current_trap = BasicBlock::Create(this->llvm_context, "out_of_bounds", function);
+            this->ir.SetInsertPoint(this->current_trap);
+            this->ir.CreateCall(
+                this->module.getOrInsertFunction("llvm.trap", FunctionType::get(this->ir.getVoidTy(), false)));
+            this->ir.CreateUnreachable();
+        }
+
+        auto in_bounds = BasicBlock::Create(this->llvm_context, "in_bounds", function);
+
+        MDBuilder md_builder{this->llvm_context};
+        this->ir.CreateCondBr(condition, in_bounds, this->current_trap, md_builder.createBranchWeights(1 << 20, 1));
+        this->ir.SetInsertPoint(in_bounds);
+    }
+
+    // a[b:e], the slice is created in a local of the procedure and its address is the value
+    Value *generate_code(SliceNode *slice)
+    {
+        auto object_type = slice->object->inferred_type();
+        auto object      = this->generate_address(slice->object);
+        auto length      = this->generate_length(object_type, object);
+
+        auto data = object.pointer;
+        if (object_type->kind == NodeKind::slice_type)
+        {
+            data = this->ir.CreateAlignedLoad(this->ir.getPtrTy(), object.pointer, object.alignment, "data");
+        }
+
+        auto begin = slice->begin != nullptr ? this->generate_integer(slice->begin) : this->ir.getInt64(0);
+        auto end   = slice->end != nullptr ? this->generate_integer(slice->end) : length;
+
+        // Unsigned comparisons, so that negative bounds fail as well
+        if (slice->needs_bounds_check)
+        {
+            auto is_ordered = this->ir.CreateICmpULE(begin, end, "is_ordered");
+            auto is_inside  = this->ir.CreateICmpULE(end, length, "is_inside");
+            this->generate_bounds_check(this->ir.CreateAnd(is_ordered, is_inside, "in_bounds"));
+        }
+
+        auto slice_type   = node_cast<SliceTypeNode, true>(slice->inferred_type());
+        auto element_type = this->convert_type(slice_type->element_type);
+        auto elements     = this->ir.CreateInBoundsGEP(element_type, data, begin, "elements");
+        auto result       = this->create_entry_alloca(slice_type, "slice");
+
+        auto length_pointer = this->ir.CreateConstInBoundsGEP1_64(
+            this->ir.getInt8Ty(),
+            result,
+            SliceTypeNode::length_offset,
+            "length");
+        this->ir.CreateAlignedStore(elements, result, Align{8});
+        this->ir.CreateAlignedStore(this->ir.CreateSub(end, begin, "length"), length_pointer, Align{8});
+
+        return result;
+    }
+
+    // Loads the field or the array element - structs and arrays are not loaded, their value is their address
+    Value *generate_load(Node *node)
+    {
+        // The length of an array that has not been folded
+        auto member_access = node_cast<MemberAccessNode>(node);
+        if (auto array = member_access != nullptr ? node_cast<ArrayTypeNode>(member_access->object->inferred_type())
+                                                  : nullptr)
+        {
+            return this->ir.getInt64(array_length(array));
+        }
+
+        auto address = this->generate_address(node);
+        if (is_aggregate(node->inferred_type()))
+        {
+            return address.pointer;
+        }
+
+        return this->ir.CreateAlignedLoad(
+            this->convert_type(node->inferred_type()),
+            address.pointer,
+            address.alignment,
+            "load");
+    }
+
+    // Copies the struct or array that the expression evaluates to
+    void generate_copy(Address destination, Node *expression)
+    {
+        auto source = this->generate_address(expression);
+        this->ir.CreateMemCpy(
+            destination.pointer,
+            destination.alignment,
+            source.pointer,
+            source.alignment,
+            size_of(expression->inferred_type()));
+    }
+
     Value *generate_code(Node *node, bool is_store = false)
     {
         switch (node->kind)
@@ -832,6 +2717,9 @@ struct IrCompiler
             case NodeKind::goto_statement:      return this->generate_code(static_cast<GotoStatementNode *>(node));
             case NodeKind::label:               return this->generate_code(static_cast<LabelNode *>(node));
             case NodeKind::type_cast:           return this->generate_code(static_cast<TypeCastNode *>(node));
+            case NodeKind::member_access:       return this->generate_load(node);
+            case NodeKind::index:               return this->generate_load(node);
+            case NodeKind::slice:               return this->generate_code(static_cast<SliceNode *>(node));
 
             case NodeKind::array_type:          UNREACHED;
             case NodeKind::nop:                 return nullptr;
@@ -839,21 +2727,101 @@ struct IrCompiler
             case NodeKind::procedure_signature: UNREACHED;
             case NodeKind::basic_type:          UNREACHED;
             case NodeKind::struct_type:         UNREACHED;
+            case NodeKind::slice_type:          UNREACHED;
+            case NodeKind::generic:             UNREACHED;
         }
 
         UNREACHED;
     }
 };
 
+// Like llvm::InstrProfSummaryBuilder: for each cutoff (in millionths of the total count), finds the smallest count
+// such that the counts that are at least as large make up that portion of the total count
+static std::unique_ptr<ProfileSummary> make_profile_summary(const Profile &profile)
+{
+    std::vector<uint64_t> counts{};
+    uint64_t max_function_count{};
+    uint64_t max_internal_count{};
+    for (const auto &[name, procedure] : profile.procedures)
+    {
+        max_function_count = std::max(max_function_count, procedure.entry_count());
+        for (size_t i = 0; i < procedure.counters.size(); ++i)
+        {
+            counts.push_back(procedure.count(i));
+            if (i != 0)
+            {
+                max_internal_count = std::max(max_internal_count, procedure.count(i));
+            }
+        }
+    }
+
+    std::sort(counts.begin(), counts.end(), std::greater<>{});
+
+    uint64_t total_count{};
+    for (auto count : counts)
+    {
+        total_count += count;
+    }
+
+    SummaryEntryVector detailed_summary{};
+    size_t num_counts{};
+    uint64_t accumulated_count{};
+    for (auto cutoff : {10000u, 100000u, 200000u, 300000u, 400000u, 500000u, 600000u, 700000u, 800000u, 900000u,
+                        950000u, 990000u, 999000u, 999900u, 999990u, 999999u})
+    {
+        auto desired_count = static_cast<uint64_t>(static_cast<double>(total_count) * cutoff / 1000000);
+        while (num_counts < counts.size() && accumulated_count < desired_count)
+        {
+            accumulated_count += counts[num_counts];
+            ++num_counts;
+        }
+
+        auto min_count = num_counts == 0 ? (counts.empty() ? 0 : counts[0]) : counts[num_counts - 1];
+        detailed_summary.emplace_back(cutoff, min_count, num_counts);
+    }
+
+    return std::make_unique<ProfileSummary>(
+        ProfileSummary::PSK_Instr,
+        detailed_summary,
+        total_count,
+        counts.empty() ? 0 : counts[0],
+        max_internal_count,
+        max_function_count,
+        static_cast<uint32_t>(counts.size()),
+        static_cast<uint32_t>(profile.procedures.size()));
+}
+
 IrCompilationResult::~IrCompilationResult() = default;
 
-IrCompilationResult compile_to_ir(struct Node *node)
+IrCompilationResult compile_to_ir(struct Node *node, const IrCompilationOptions &options)
 {
+    SET_TEMPORARILY(current_allocation_phase, AllocationPhase::compile_ir);
+
     auto llvm_context = std::make_unique<LLVMContext>();
     auto module       = std::make_unique<Module>("inmemory_temp_module", *llvm_context);
 
-    IrCompiler ir_compiler{*llvm_context, *module};
+    // NOTE: The same tree may be compiled more than once, so forget the functions of the previous compilation
+    if (auto module_node = node_cast<ModuleNode>(node))
+    {
+        for (auto statement : module_node->block->statements)
+        {
+            if (auto decl = node_cast<DeclarationNode>(statement))
+            {
+                decl->named_value = nullptr;
+            }
+        }
+    }
+
+    IrCompiler ir_compiler{*llvm_context, *module, options};
     ir_compiler.generate_code(node);
 
+    if (options.optimization_profile != nullptr)
+    {
+        // The summary tells the optimizer which counts are hot and which are cold
+        module->setProfileSummary(
+            make_profile_summary(*options.optimization_profile)->getMD(*llvm_context),
+            ProfileSummary::PSK_Instr);
+    }
+
     return IrCompilationResult{std::move(llvm_context), std::move(module)};
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
 
 namespace llvm
@@ -23,4 +26,43 @@ struct IrCompilationResult
     std::unique_ptr<llvm::Module> module;
 };
 
-IrCompilationResult compile_to_ir(struct Node *node);
+// Mixed mode (see MixedProgram): the bytecode interpreter and the generated code call each other by passing the
+// arguments as an array of 64 bit values in the representation of the interpreter's registers (see op_code.h)
+struct InterpreterBridge
+{
+    // Runs the procedure with the given index on the interpreter and returns its return value
+    int64_t (*enter)(void *context, int64_t procedure_index, int64_t *arguments){};
+    void *context{};
+    std::function<int64_t(struct DeclarationNode *declaration)> procedure_index{};
+};
+
+struct IrCompilationOptions
+{
+    // When set, calls to procedures defined in the module do not call the procedure's function directly,
+    // but load the callee's address from the slot returned by this callback. Slots can be patched at runtime
+    // to redirect all calls to a new version of a procedure.
+    std::function<std::atomic<void *> *(struct DeclarationNode *declaration)> procedure_slot{};
+
+    // When set, only the procedures for which this returns true get a function body
+    std::function<bool(struct DeclarationNode *declaration)> should_compile_procedure{};
+
+    // When set, every procedure that gets a body also gets an entry point for the interpreter named
+    // "<procedure>.from_interpreter" with the signature int64_t(const int64_t *arguments), and every other procedure
+    // that is not external gets a body that runs it on the interpreter instead
+    const InterpreterBridge *interpreter_bridge{};
+
+    // Whole-program mode: all procedures except main() and external ones get internal linkage, which allows LLVM to
+    // inline them freely, drop the ones that are unused and change their calling convention. Only main() can be
+    // looked up in the JIT then.
+    bool internalize{};
+
+    // When set, the generated code counts how often each procedure is entered and how each conditional branch goes
+    // into the counters of this profile. The profile must outlive the generated code.
+    struct Profile *instrumentation_profile{};
+
+    // When set, the entry counts and branch weights recorded in this profile are attached to the IR so that the
+    // optimizer can lay out and inline the code according to how the program actually behaved
+    const struct Profile *optimization_profile{};
+};
+
+IrCompilationResult compile_to_ir(struct Node *node, const IrCompilationOptions &options = {});
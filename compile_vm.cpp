@@ -0,0 +1,2283 @@
+#include "compile_vm.h"
+
+#include "allocation_tracking.h"
+#include "bytecode_image.h"
+#include "evaluate.h"
+#include "node.h"
+#include "runtime.h"
+
+#include <bit>
+#include <cstring>
+#include <dlfcn.h>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+
+std::span<const uint8_t> VmProgram::code() const
+{
+    return this->image != nullptr ? this->image->code : std::span{this->bytecode};
+}
+
+std::string_view VmProgram::string_table() const
+{
+    return this->image != nullptr ? this->image->strings : std::string_view{this->strings};
+}
+
+void BytecodeWriter::write_data(const void *data, size_t length)
+{
+    if (this->pos + length > this->bytecode.size())
+    {
+        this->bytecode.resize(this->pos + length);
+    }
+
+    memcpy(&this->bytecode[this->pos], data, length);
+    this->pos += length;
+}
+
+int64_t BytecodeWriter::write_op(OpCode op)
+{
+    auto addr = this->pos;
+    this->write(op);
+
+    return addr;
+}
+
+int64_t BytecodeWriter::write_a(OpCode op, VmRegister a)
+{
+    assert(op_format(op) == OpFormat::a);
+
+    auto addr = this->write_op(op);
+    this->write(a);
+
+    return addr;
+}
+
+int64_t BytecodeWriter::write_d_a(OpCode op, VmRegister d, VmRegister a)
+{
+    assert(op_format(op) == OpFormat::d_a);
+
+    auto addr = this->write_op(op);
+    this->write(d);
+    this->write(a);
+
+    return addr;
+}
+
+int64_t BytecodeWriter::write_d_imm(OpCode op, VmRegister d, int64_t imm)
+{
+    assert(op_format(op) == OpFormat::d_imm);
+
+    auto addr = this->write_op(op);
+    this->write(d);
+    this->write(imm);
+
+    return addr;
+}
+
+int64_t BytecodeWriter::write_d_a_b(OpCode op, VmRegister d, VmRegister a, VmRegister b)
+{
+    assert(op_format(op) == OpFormat::d_a_b);
+
+    auto addr = this->write_op(op);
+    this->write(d);
+    this->write(a);
+    this->write(b);
+
+    return addr;
+}
+
+int64_t BytecodeWriter::write_d_a_imm(OpCode op, VmRegister d, VmRegister a, int64_t imm)
+{
+    assert(op_format(op) == OpFormat::d_a_imm);
+
+    auto addr = this->write_op(op);
+    this->write(d);
+    this->write(a);
+    this->write(imm);
+
+    return addr;
+}
+
+int64_t BytecodeWriter::write_d_a_bytes(OpCode op, VmRegister d, VmRegister a, uint8_t bytes)
+{
+    assert(op_format(op) == OpFormat::d_a_bytes);
+
+    auto addr = this->write_op(op);
+    this->write(d);
+    this->write(a);
+    this->write(bytes);
+
+    return addr;
+}
+
+int64_t BytecodeWriter::write_target(OpCode op, int32_t target)
+{
+    assert(op_format(op) == OpFormat::target);
+
+    this->write_op(op);
+    auto target_addr = this->pos;
+    this->write(target);
+
+    return target_addr;
+}
+
+int64_t BytecodeWriter::write_a_target(OpCode op, VmRegister a, int32_t target)
+{
+    assert(op_format(op) == OpFormat::a_target);
+
+    this->write_op(op);
+    this->write(a);
+    auto target_addr = this->pos;
+    this->write(target);
+
+    return target_addr;
+}
+
+int64_t BytecodeWriter::write_a_b_target(OpCode op, VmRegister a, VmRegister b, int32_t target)
+{
+    assert(op_format(op) == OpFormat::a_b_target);
+
+    this->write_op(op);
+    this->write(a);
+    this->write(b);
+    auto target_addr = this->pos;
+    this->write(target);
+
+    return target_addr;
+}
+
+int64_t BytecodeWriter::write_a_imm_target(OpCode op, VmRegister a, int64_t imm, int32_t target)
+{
+    assert(op_format(op) == OpFormat::a_imm_target);
+
+    this->write_op(op);
+    this->write(a);
+    this->write(imm);
+    auto target_addr = this->pos;
+    this->write(target);
+
+    return target_addr;
+}
+
+int64_t BytecodeWriter::write_index_a_d(OpCode op, uint32_t index, VmRegister a, VmRegister d)
+{
+    assert(op_format(op) == OpFormat::index_a_d);
+
+    auto addr = this->write_op(op);
+    this->write(index);
+    this->write(a);
+    this->write(d);
+
+    return addr;
+}
+
+void BytecodeWriter::patch_target(int64_t target_position, int32_t target)
+{
+    memcpy(&this->bytecode[target_position], &target, sizeof(target));
+}
+
+static VmValueKind value_kind(const Node *type)
+{
+    auto basic = node_cast<BasicTypeNode>(type);
+    if (basic == nullptr)
+    {
+        return VmValueKind::integer;
+    }
+
+    switch (basic->type_kind)
+    {
+        case BasicTypeNode::Kind::voyd:          return VmValueKind::none;
+        case BasicTypeNode::Kind::floatingpoint: return basic->size == 4 ? VmValueKind::f32 : VmValueKind::f64;
+        default:                                 return VmValueKind::integer;
+    }
+}
+
+// Vectors take one register per lane. A procedure that returns a vector returns it in the registers in front of its
+// arguments, this is the number of them. A struct or a slice is returned by copying it to the address that the caller
+// passes in the register in front of the arguments.
+static int64_t num_result_registers(const ProcedureSignatureNode *signature)
+{
+    auto type = signature->return_type;
+    switch (type->kind)
+    {
+        case NodeKind::vector_type: return num_lanes(type);
+        case NodeKind::struct_type:
+        case NodeKind::slice_type:  return 1;
+        default:                    return 0;
+    }
+}
+
+static bool is_comparison(Tt operator_kind)
+{
+    switch (operator_kind)
+    {
+        case Tt::equal:
+        case Tt::inequal:
+        case Tt::less_than:
+        case Tt::less_than_or_equal:
+        case Tt::greater_than:
+        case Tt::greater_than_or_equal: return true;
+
+        default: return false;
+    }
+}
+
+// The comparison that holds exactly when the given one does not - only valid for integers
+static Tt negate_comparison(Tt operator_kind)
+{
+    switch (operator_kind)
+    {
+        case Tt::equal:                 return Tt::inequal;
+        case Tt::inequal:               return Tt::equal;
+        case Tt::less_than:             return Tt::greater_than_or_equal;
+        case Tt::less_than_or_equal:    return Tt::greater_than;
+        case Tt::greater_than:          return Tt::less_than_or_equal;
+        case Tt::greater_than_or_equal: return Tt::less_than;
+        default:                        UNREACHED;
+    }
+}
+
+// The fused compare and branch instruction that jumps if the comparison holds
+static OpCode compare_and_branch_op(Tt operator_kind, bool is_signed, bool has_immediate)
+{
+    switch (operator_kind)
+    {
+        case Tt::equal:                 return has_immediate ? JEQI : JEQ;
+        case Tt::inequal:               return has_immediate ? JNEI : JNE;
+        case Tt::less_than:             return has_immediate ? (is_signed ? JLTI : JLTUI) : (is_signed ? JLT : JLTU);
+        case Tt::less_than_or_equal:    return has_immediate ? (is_signed ? JLEI : JLEUI) : (is_signed ? JLE : JLEU);
+        case Tt::greater_than:          return has_immediate ? (is_signed ? JGTI : JGTUI) : (is_signed ? JGT : JGTU);
+        case Tt::greater_than_or_equal: return has_immediate ? (is_signed ? JGEI : JGEUI) : (is_signed ? JGE : JGEU);
+        default:                        UNREACHED;
+    }
+}
+
+// Returns the value of an integer or boolean literal in the canonical form of the type
+static std::optional<int64_t> integer_immediate(const Node *node, const BasicTypeNode *type)
+{
+    auto literal = node_cast<LiteralNode>(node);
+    if (literal == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    if (std::holds_alternative<uint64_t>(literal->value))
+    {
+        return normalize_integer(type, std::get<uint64_t>(literal->value));
+    }
+
+    if (std::holds_alternative<bool>(literal->value))
+    {
+        return std::get<bool>(literal->value) ? 1 : 0;
+    }
+
+    return std::nullopt;
+}
+
+struct BytecodeCompiler
+{
+    explicit BytecodeCompiler(VmProgram &program)
+        : program{program}
+    {
+    }
+
+    VmProgram &program;
+    BytecodeWriter w{};
+    std::unordered_map<DeclarationNode *, int64_t> procedure_indices{};
+    std::unordered_map<std::string_view, void *> external_addresses{};
+    std::unordered_map<DeclarationNode *, int64_t> spawn_entry_indices{};  // See generate_spawn
+    std::vector<ProcedureCallNode *> pending_spawn_entries{};
+    std::unordered_map<DeclarationNode *, VmRegister> local_registers{};
+    int64_t next_register{};  // Registers below are occupied by arguments, locals and temporaries in use
+    int64_t num_registers{};
+    int64_t frame_size{};  // The frame memory of the procedure, structs and arrays are never moved to registers
+    int64_t frame_alignment = 1;
+    std::vector<int64_t> *current_break_jumps{};
+    std::vector<int64_t> *current_continue_jumps{};
+
+    int32_t position() const
+    {
+        return static_cast<int32_t>(this->w.pos);
+    }
+
+    void patch_jumps(const std::vector<int64_t> &jumps, int32_t target)
+    {
+        for (auto jump : jumps)
+        {
+            this->w.patch_target(jump, target);
+        }
+    }
+
+    VmRegister allocate_register()
+    {
+        return this->allocate_registers(1);
+    }
+
+    // Allocates consecutive registers and returns the first one
+    VmRegister allocate_registers(int64_t count)
+    {
+        if (this->next_register + count - 1 > std::numeric_limits<VmRegister>::max())
+        {
+            FATAL("Too many registers in procedure");
+        }
+
+        auto reg = static_cast<VmRegister>(this->next_register);
+        this->next_register += count;
+        this->num_registers = std::max(this->num_registers, this->next_register);
+
+        return reg;
+    }
+
+    // Returns the offset of the memory in the frame memory. The memory is not reused, even if the value that it is
+    // allocated for goes out of scope.
+    int64_t allocate_memory(int64_t size, int64_t alignment)
+    {
+        auto offset           = (this->frame_size + alignment - 1) / alignment * alignment;
+        this->frame_size      = offset + size;
+        this->frame_alignment = std::max(this->frame_alignment, alignment);
+
+        return offset;
+    }
+
+    // Returns a register that holds the address of fresh frame memory for a value of the aggregate type
+    VmRegister allocate_aggregate(const Node *type)
+    {
+        auto reg = this->allocate_register();
+        this->w.write_d_imm(ADDR, reg, this->allocate_memory(size_of(type), align_of(type)));
+
+        return reg;
+    }
+
+    // Copies a value that takes the given number of registers
+    void move(VmRegister dst, VmRegister src, int64_t count)
+    {
+        for (auto lane = 0; lane < count; ++lane)
+        {
+            if (dst + lane != src + lane)
+            {
+                this->w.write_d_a(MOV, dst + lane, src + lane);
+            }
+        }
+    }
+
+    // Moves the value to the destination, bringing a 64 bit result into the canonical form of an integer of the type
+    void normalize_into(VmRegister dst, VmRegister src, const Node *type)
+    {
+        auto basic = node_cast<BasicTypeNode>(type);
+        if (basic != nullptr && basic->size < 8)
+        {
+            switch (basic->type_kind)
+            {
+                case BasicTypeNode::Kind::signed_integer:
+                {
+                    this->w.write_d_a_bytes(SEXT, dst, src, basic->size);
+                    return;
+                }
+
+                case BasicTypeNode::Kind::unsigned_integer:
+                {
+                    this->w.write_d_a_bytes(ZEXT, dst, src, basic->size);
+                    return;
+                }
+
+                case BasicTypeNode::Kind::boolean:
+                {
+                    this->w.write_d_a_bytes(ZEXT, dst, src, 1);
+                    return;
+                }
+
+                default: break;
+            }
+        }
+
+        if (dst != src)
+        {
+            this->w.write_d_a(MOV, dst, src);
+        }
+    }
+
+    void normalize(VmRegister reg, const Node *type)
+    {
+        this->normalize_into(reg, reg, type);
+    }
+
+    void generate_module(ModuleNode *module)
+    {
+        // Register all procedures first, so calls to procedures that are declared later can be compiled directly
+        for (auto statement : module->block->statements)
+        {
+            auto decl = node_cast<DeclarationNode>(statement);
+            if (decl == nullptr)
+            {
+                continue;
+            }
+
+            // Types and generics have no code, the instances of generics are declarations of their own
+            auto kind = decl->init_expression->kind;
+            if (kind == NodeKind::struct_type || kind == NodeKind::generic)
+            {
+                continue;
+            }
+
+            auto procedure = node_cast<ProcedureNode>(decl->init_expression);
+            if (procedure == nullptr)
+            {
+                // TODO: There are no global variables yet and they are not on the roadmap
+                TODO;
+            }
+
+            if (procedure->is_external)
+            {
+                continue;
+            }
+
+            this->register_procedure(decl);
+        }
+
+        for (auto statement : module->block->statements)
+        {
+            auto decl = node_cast<DeclarationNode>(statement);
+            if (decl != nullptr && this->procedure_indices.contains(decl))
+            {
+                this->generate_procedure(decl);
+            }
+        }
+
+        this->finish();
+    }
+
+    // The program consists of the procedures that the call reaches and an entry procedure that makes the call
+    void generate_entry(ProcedureCallNode *call)
+    {
+        auto procedures = reachable_procedures(call);
+        for (auto decl : procedures)
+        {
+            this->register_procedure(decl);
+        }
+
+        for (auto decl : procedures)
+        {
+            this->generate_procedure(decl);
+        }
+
+        this->program.main_procedure = static_cast<int64_t>(this->program.procedures.size());
+        this->program.procedures.push_back(VmProcedure{
+            .name    = "#run",
+            .address = static_cast<int64_t>(this->w.pos),
+        });
+
+        this->local_registers.clear();
+        this->next_register   = 0;
+        this->num_registers   = 0;
+        this->frame_size      = 0;
+        this->frame_alignment = 1;
+
+        auto result = this->allocate_register();
+        this->generate_call(call, result);
+
+        if (value_kind(call->inferred_type()) == VmValueKind::none)
+        {
+            this->w.write_op(RETV);
+        }
+        else
+        {
+            this->w.write_a(RET, result);
+        }
+
+        auto &entry           = this->program.procedures[this->program.main_procedure];
+        entry.num_registers   = this->num_registers;
+        entry.frame_size      = this->frame_size;
+        entry.frame_alignment = this->frame_alignment;
+
+        this->finish();
+    }
+
+    void register_procedure(DeclarationNode *decl)
+    {
+        auto procedure = node_cast<ProcedureNode, true>(decl->init_expression);
+
+        this->procedure_indices[decl] = static_cast<int64_t>(this->program.procedures.size());
+        if (decl->identifier == "main")
+        {
+            this->program.main_procedure = static_cast<int64_t>(this->program.procedures.size());
+        }
+
+        auto num_results   = num_result_registers(procedure->signature);
+        auto num_arguments = num_results;
+        for (auto argument : procedure->signature->arguments)
+        {
+            num_arguments += num_lanes(argument->init_expression->inferred_type());
+        }
+
+        this->program.procedures.push_back(VmProcedure{
+            .name          = std::string{decl->identifier},
+            .num_arguments = num_arguments,
+            .num_results   = num_results,
+        });
+    }
+
+    void finish()
+    {
+        this->generate_spawn_entries();
+
+        if (this->w.pos > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+        {
+            FATAL("The bytecode is too large");
+        }
+
+        this->program.bytecode = std::move(this->w.bytecode);
+    }
+
+    void generate_procedure(DeclarationNode *decl)
+    {
+        auto procedure = node_cast<ProcedureNode, true>(decl->init_expression);
+        auto index     = this->procedure_indices.at(decl);
+
+        this->program.procedures[index].address = static_cast<int64_t>(this->w.pos);
+
+        this->local_registers.clear();
+        this->next_register   = 0;
+        this->num_registers   = 0;
+        this->frame_size      = 0;
+        this->frame_alignment = 1;
+
+        // A vector result is returned in the first registers of the frame, in front of the arguments (or the address
+        // of a struct result is passed there)
+        this->allocate_registers(num_result_registers(procedure->signature));
+
+        for (auto argument : procedure->signature->arguments)
+        {
+            auto type                       = argument->init_expression->inferred_type();
+            this->local_registers[argument] = this->allocate_registers(num_lanes(type));
+        }
+
+        // The struct arguments of a task are copies in the frame memory of its creator, which may be gone when the
+        // task continues, so the task copies them to its own frame memory before it suspends for the first time
+        // (see TASK)
+        if (procedure->is_async)
+        {
+            for (auto argument : procedure->signature->arguments)
+            {
+                if (auto type = argument->init_expression->inferred_type(); is_aggregate(type))
+                {
+                    auto copy = this->allocate_register();
+                    this->w.write_d_imm(ADDR, copy, this->allocate_memory(size_of(type), align_of(type)));
+                    this->w.write_d_a_imm(COPY, copy, this->local_registers.at(argument), size_of(type));
+                    this->local_registers[argument] = copy;
+                }
+            }
+
+            this->w.write_op(YIELD);
+        }
+
+        this->generate_statement(procedure->body);
+
+        // Implicit return at the end of the procedure
+        auto return_type = procedure->signature->return_type;
+        if (is_aggregate(return_type))
+        {
+            this->w.write_d_imm(ZERO, 0, size_of(return_type));
+            this->w.write_op(RETV);
+        }
+        else if (auto num_results = num_result_registers(procedure->signature); num_results != 0)
+        {
+            for (auto lane = 0; lane < num_results; ++lane)
+            {
+                this->w.write_d_imm(LOADI, lane, 0);
+            }
+
+            this->w.write_op(RETV);
+        }
+        else if (value_kind(procedure->signature->return_type) == VmValueKind::none)
+        {
+            this->w.write_op(RETV);
+        }
+        else
+        {
+            auto zero = this->allocate_register();
+            this->w.write_d_imm(LOADI, zero, 0);
+            this->w.write_a(RET, zero);
+        }
+
+        // NOTE: Spawns add procedures (see generate_spawn), so references to the procedures do not stay valid
+        auto &vm_procedure           = this->program.procedures[index];
+        vm_procedure.num_registers   = this->num_registers;
+        vm_procedure.frame_size      = this->frame_size;
+        vm_procedure.frame_alignment = this->frame_alignment;
+    }
+
+    void generate_statement(Node *node)
+    {
+        // Free the temporaries and the locals of nested blocks after the statement
+        auto registers_in_use = this->next_register;
+        defer
+        {
+            this->next_register = registers_in_use;
+        };
+
+        switch (node->kind)
+        {
+            case NodeKind::block:
+            {
+                auto block = static_cast<BlockNode *>(node);
+                if (block->expected_compiler_error_kind != BlockNode::CompilerErrorKind::none)
+                {
+                    return;
+                }
+
+                for (auto statement : block->statements)
+                {
+                    this->generate_statement(statement);
+
+                    auto is_terminator = statement->kind == NodeKind::break_statement ||
+                                         statement->kind == NodeKind::continue_statement ||
+                                         statement->kind == NodeKind::return_statement;
+                    if (is_terminator)
+                    {
+                        break;
+                    }
+                }
+
+                return;
+            }
+
+            case NodeKind::declaration:
+            {
+                auto decl = static_cast<DeclarationNode *>(node);
+
+                // TODO: Transform local procedure declarations to global ones
+                assert(decl->init_expression->kind != NodeKind::procedure);
+
+                // The register of a struct or an array holds the address of its value in the frame memory
+                if (auto type = decl->init_expression->inferred_type(); is_aggregate(type))
+                {
+                    auto reg = this->allocate_aggregate(type);
+                    if (decl->init_expression->kind == NodeKind::nop)
+                    {
+                        this->w.write_d_imm(ZERO, reg, size_of(type));
+                    }
+                    else
+                    {
+                        this->w.write_d_a_imm(COPY, reg, this->generate_operand(decl->init_expression), size_of(type));
+                    }
+
+                    this->local_registers[decl] = reg;
+                    registers_in_use            = reg + 1;
+
+                    return;
+                }
+
+                auto count = num_lanes(decl->init_expression->inferred_type());
+                auto reg   = this->allocate_registers(count);
+
+                // Declarations without an initialization expression are zero-initialized
+                if (decl->init_expression->kind == NodeKind::nop)
+                {
+                    for (auto lane = 0; lane < count; ++lane)
+                    {
+                        this->w.write_d_imm(LOADI, reg + lane, 0);
+                    }
+                }
+                else
+                {
+                    this->generate_into(decl->init_expression, reg);
+                }
+
+                this->local_registers[decl] = reg;
+
+                // The local stays alive until the end of the block
+                registers_in_use = reg + count;
+
+                return;
+            }
+
+            case NodeKind::binary_operator:
+            {
+                auto bin_op = static_cast<BinaryOperatorNode *>(node);
+                if (bin_op->operator_kind != Tt::assign)
+                {
+                    break;
+                }
+
+                auto type  = bin_op->lhs->inferred_type();
+                auto ident = node_cast<IdentifierNode>(bin_op->lhs);
+                if (ident != nullptr && is_aggregate(type) == false)
+                {
+                    this->generate_into(bin_op->rhs, this->local_registers.at(ident->declaration));
+                    return;
+                }
+
+                auto address = this->generate_address(bin_op->lhs);
+                auto value   = this->generate_operand(bin_op->rhs);
+                if (is_aggregate(type))
+                {
+                    this->w.write_d_a_imm(COPY, address, value, size_of(type));
+                }
+                else
+                {
+                    this->generate_store(address, value, type);
+                }
+
+                return;
+            }
+
+            case NodeKind::if_statement:
+            {
+                auto yf = static_cast<IfStatementNode *>(node);
+
+                std::vector<int64_t> else_jumps{};
+                this->generate_branch(yf->condition, false, else_jumps);
+
+                this->generate_statement(yf->then_block);
+
+                if (yf->else_block == nullptr)
+                {
+                    this->patch_jumps(else_jumps, this->position());
+                    return;
+                }
+
+                auto jmp_done = this->w.write_target(JMP, -1);
+
+                this->patch_jumps(else_jumps, this->position());
+                this->generate_statement(yf->else_block);
+
+                this->w.patch_target(jmp_done, this->position());
+
+                return;
+            }
+
+            case NodeKind::while_loop:
+            {
+                auto whyle = static_cast<WhileLoopNode *>(node);
+
+                // The condition is at the bottom of the loop, so an iteration only takes a single branch
+                std::vector<int64_t> break_jumps{};
+                std::vector<int64_t> continue_jumps{};
+
+                auto jmp_condition = this->w.write_target(JMP, -1);
+
+                auto body = this->position();
+                {
+                    SET_TEMPORARILY(this->current_break_jumps, &break_jumps);
+                    SET_TEMPORARILY(this->current_continue_jumps, &continue_jumps);
+
+                    this->generate_statement(whyle->body);
+                }
+
+                // 'continue' runs the prologue (the step of a for loop) before the condition
+                this->patch_jumps(continue_jumps, this->position());
+                this->generate_statement(whyle->prologue);
+
+                auto condition = this->position();
+                this->w.patch_target(jmp_condition, condition);
+
+                std::vector<int64_t> body_jumps{};
+                this->generate_branch(whyle->condition, true, body_jumps);
+                this->patch_jumps(body_jumps, body);
+
+                this->patch_jumps(break_jumps, this->position());
+
+                return;
+            }
+
+            case NodeKind::break_statement:
+            {
+                assert(this->current_break_jumps != nullptr);
+                this->current_break_jumps->push_back(this->w.write_target(JMP, -1));
+                return;
+            }
+
+            case NodeKind::continue_statement:
+            {
+                assert(this->current_continue_jumps != nullptr);
+                this->current_continue_jumps->push_back(this->w.write_target(JMP, -1));
+                return;
+            }
+
+            case NodeKind::return_statement:
+            {
+                auto retyrn = static_cast<ReturnStatementNode *>(node);
+                if (retyrn->expression->kind == NodeKind::nop)
+                {
+                    this->w.write_op(RETV);
+                    return;
+                }
+
+                // The return is only reached when TCALL calls native code, a struct result was written through the
+                // result address of the procedure then
+                if (retyrn->is_tail_call)
+                {
+                    auto type   = retyrn->expression->inferred_type();
+                    auto result = type->kind == NodeKind::vector_type ? 0 : this->allocate_registers(num_lanes(type));
+                    this->generate_call(static_cast<ProcedureCallNode *>(retyrn->expression), result, true);
+
+                    if (is_aggregate(type) || type->kind == NodeKind::vector_type ||
+                        Node::types_equal(type, &BuiltinTypes::voyd))
+                    {
+                        this->w.write_op(RETV);
+                    }
+                    else
+                    {
+                        this->w.write_a(RET, result);
+                    }
+
+                    return;
+                }
+
+                if (retyrn->expression->inferred_type()->kind == NodeKind::vector_type)
+                {
+                    this->generate_into(retyrn->expression, 0);
+                    this->w.write_op(RETV);
+                    return;
+                }
+
+                if (auto type = retyrn->expression->inferred_type(); is_aggregate(type))
+                {
+                    this->w.write_d_a_imm(COPY, 0, this->generate_operand(retyrn->expression), size_of(type));
+                    this->w.write_op(RETV);
+                    return;
+                }
+
+                this->w.write_a(RET, this->generate_operand(retyrn->expression));
+
+                return;
+            }
+
+            case NodeKind::procedure_call:
+            {
+                auto result = this->allocate_registers(num_lanes(node->inferred_type()));
+                this->generate_call(static_cast<ProcedureCallNode *>(node), result);
+
+                return;
+            }
+
+            case NodeKind::nop:   return;
+            case NodeKind::label: TODO;
+
+            case NodeKind::goto_statement: TODO;
+
+            default: break;
+        }
+
+        // Expression statement
+        this->generate_operand(node);
+    }
+
+    // A tail call (see ReturnStatementNode) passes on the result address and the struct arguments that the procedure
+    // received itself, it is followed by the return
+    void generate_call(ProcedureCallNode *call, VmRegister dst, bool is_tail_call = false)
+    {
+        if (call->intrinsic != Intrinsic::none)
+        {
+            this->generate_intrinsic(call, dst);
+            return;
+        }
+
+        assert(call->procedure->kind == NodeKind::identifier);  // TODO: Function pointer calling
+        auto ident = static_cast<IdentifierNode *>(call->procedure);
+
+        assert(ident->declaration->init_expression->kind == NodeKind::procedure);
+        auto proc = static_cast<ProcedureNode *>(ident->declaration->init_expression);
+
+        // The arguments go to consecutive registers at the top of the frame, they become the first registers of
+        // the callee's frame. A vector result is returned in the registers in front of them, a struct result is
+        // copied to the memory whose address is passed there.
+        auto num_results    = num_result_registers(proc->signature);
+        auto first_argument = static_cast<VmRegister>(this->next_register);
+        auto num_registers  = num_results;
+        for (auto argument : call->arguments)
+        {
+            num_registers += num_lanes(argument->inferred_type());
+        }
+
+        this->allocate_registers(num_registers);
+
+        if (auto return_type = proc->signature->return_type; is_aggregate(return_type))
+        {
+            if (is_tail_call)
+            {
+                this->w.write_d_a(MOV, first_argument, 0);
+            }
+            else
+            {
+                this->w.write_d_imm(
+                    ADDR,
+                    first_argument,
+                    this->allocate_memory(size_of(return_type), align_of(return_type)));
+            }
+        }
+
+        auto argument_register = first_argument + num_results;
+        for (auto argument : call->arguments)
+        {
+            // Structs are passed by value, the callee gets the address of a copy. A tail call passes on the copy that
+            // the procedure got.
+            auto type = argument->inferred_type();
+            if (is_aggregate(type) && is_tail_call)
+            {
+                this->w.write_d_a(MOV, argument_register, this->generate_operand(argument));
+            }
+            else if (is_aggregate(type))
+            {
+                auto value = this->generate_operand(argument);
+                this->w.write_d_imm(ADDR, argument_register, this->allocate_memory(size_of(type), align_of(type)));
+                this->w.write_d_a_imm(COPY, argument_register, value, size_of(type));
+            }
+            else
+            {
+                this->generate_into(argument, argument_register);
+            }
+
+            argument_register += num_lanes(type);
+            this->next_register = first_argument + num_registers;
+        }
+
+        if (proc->is_async)
+        {
+            auto index = static_cast<uint32_t>(this->procedure_indices.at(ident->declaration));
+            this->w.write_index_a_d(TASK, index, first_argument, dst);
+
+            return;
+        }
+
+        if (proc->is_external == false)
+        {
+            auto index = static_cast<uint32_t>(this->procedure_indices.at(ident->declaration));
+            this->w.write_index_a_d(is_tail_call ? TCALL : CALL, index, first_argument, dst);
+
+            // The return value that CALL writes to dst is meaningless then
+            this->move(dst, first_argument, num_results);
+
+            return;
+        }
+
+        auto &address = this->external_addresses[ident->identifier];
+        if (address == nullptr)
+        {
+            address = find_runtime_symbol(ident->identifier);
+        }
+
+        if (address == nullptr)
+        {
+            address = dlsym(RTLD_DEFAULT, std::string{ident->identifier}.c_str());
+            if (address == nullptr)
+            {
+                FATAL(std::format("Could not resolve the external procedure {}", ident->identifier));
+            }
+        }
+
+        VmExternalCall external_call{
+            .name        = std::string{ident->identifier},
+            .address     = address,
+            .return_kind = value_kind(proc->signature->return_type),
+        };
+
+        for (auto argument : call->arguments)
+        {
+            external_call.argument_kinds.push_back(value_kind(argument->inferred_type()));
+        }
+
+        auto index = static_cast<uint32_t>(this->program.external_calls.size());
+        this->w.write_index_a_d(CALLX, index, first_argument, dst);
+        this->program.external_calls.push_back(std::move(external_call));
+
+        // C code does not care about the upper bits of narrow return values
+        this->normalize(dst, proc->signature->return_type);
+    }
+
+    // Vectors take one register per lane, so the intrinsics operate on the lanes one by one
+    void generate_intrinsic(ProcedureCallNode *call, VmRegister dst)
+    {
+        if (is_atomic(call->intrinsic))
+        {
+            this->generate_atomic(call, dst);
+            return;
+        }
+
+        if (call->intrinsic == Intrinsic::spawn)
+        {
+            this->generate_spawn(call, dst);
+            return;
+        }
+
+        auto &arguments = call->arguments;
+
+        switch (call->intrinsic)
+        {
+            case Intrinsic::make_vector:
+            {
+                std::vector<VmRegister> values{};
+                for (auto argument : arguments)
+                {
+                    values.push_back(this->generate_operand(argument));
+                }
+
+                for (auto lane = 0; lane < num_lanes(call->inferred_type()); ++lane)
+                {
+                    this->w.write_d_a(MOV, dst + lane, values.size() == 1 ? values[0] : values[lane]);
+                }
+
+                return;
+            }
+
+            case Intrinsic::extract:
+            {
+                auto vector = this->generate_operand(arguments[0]);
+                this->w.write_d_a(MOV, dst, vector + call->lanes[0]);
+
+                return;
+            }
+
+            case Intrinsic::insert:
+            {
+                auto vector = this->generate_operand(arguments[0]);
+                auto value  = this->generate_operand(arguments[2]);
+                for (auto lane = 0; lane < num_lanes(call->inferred_type()); ++lane)
+                {
+                    this->move(dst + lane, lane == call->lanes[0] ? value : vector + lane, 1);
+                }
+
+                return;
+            }
+
+            case Intrinsic::shuffle:
+            case Intrinsic::swizzle:
+            {
+                // The lanes of b follow the lanes of a
+                auto input_lanes = num_lanes(arguments[0]->inferred_type());
+                auto a           = this->generate_operand(arguments[0]);
+                auto b           = call->intrinsic == Intrinsic::shuffle ? this->generate_operand(arguments[1]) : a;
+
+                auto num_result_lanes = static_cast<int64_t>(call->lanes.size());
+                auto overlaps         = [&](VmRegister input)
+                { return dst < input + input_lanes && input < dst + num_result_lanes; };
+
+                // The lanes are picked in any order, so they go to temporaries first if the destination is an input
+                auto result = overlaps(a) || overlaps(b) ? this->allocate_registers(num_result_lanes) : dst;
+                for (auto i = 0; i < num_result_lanes; ++i)
+                {
+                    auto lane = call->lanes[i];
+                    this->w.write_d_a(MOV, result + i, lane < input_lanes ? a + lane : b + lane - input_lanes);
+                }
+
+                this->move(dst, result, num_result_lanes);
+
+                return;
+            }
+
+            case Intrinsic::select:
+            {
+                auto mask = this->generate_operand(arguments[0]);
+                auto a    = this->generate_operand(arguments[1]);
+                auto b    = this->generate_operand(arguments[2]);
+                for (auto lane = 0; lane < num_lanes(call->inferred_type()); ++lane)
+                {
+                    auto jmp_else = this->w.write_a_target(JMPZ, mask + lane, -1);
+                    this->move(dst + lane, a + lane, 1);
+                    auto jmp_done = this->w.write_target(JMP, -1);
+
+                    this->w.patch_target(jmp_else, this->position());
+                    this->move(dst + lane, b + lane, 1);
+
+                    this->w.patch_target(jmp_done, this->position());
+                }
+
+                return;
+            }
+
+            case Intrinsic::reduce_add:
+            case Intrinsic::reduce_mul:
+            case Intrinsic::reduce_min:
+            case Intrinsic::reduce_max:
+            {
+                auto type       = node_cast<BasicTypeNode, true>(call->inferred_type());
+                auto vector     = this->generate_operand(arguments[0]);
+                auto takes_lane = this->allocate_register();  // For reduce_min and reduce_max
+
+                this->w.write_d_a(MOV, dst, vector);
+                for (auto lane = 1; lane < num_lanes(arguments[0]->inferred_type()); ++lane)
+                {
+                    switch (call->intrinsic)
+                    {
+                        case Intrinsic::reduce_add:
+                        {
+                            this->generate_operator(Tt::plus, type, dst, dst, vector + lane);
+                            break;
+                        }
+
+                        case Intrinsic::reduce_mul:
+                        {
+                            this->generate_operator(Tt::asterisk, type, dst, dst, vector + lane);
+                            break;
+                        }
+
+                        default:
+                        {
+                            auto is_min = call->intrinsic == Intrinsic::reduce_min;
+                            this->generate_operator(
+                                is_min ? Tt::less_than : Tt::greater_than,
+                                type,
+                                takes_lane,
+                                vector + lane,
+                                dst);
+
+                            auto jmp_skip = this->w.write_a_target(JMPZ, takes_lane, -1);
+                            this->w.write_d_a(MOV, dst, vector + lane);
+                            this->w.patch_target(jmp_skip, this->position());
+
+                            break;
+                        }
+                    }
+                }
+
+                return;
+            }
+
+            // Usually folded by the typechecker
+            case Intrinsic::size_of:
+            case Intrinsic::align_of:
+            case Intrinsic::offset_of:
+            {
+                this->w.write_d_imm(LOADI, dst, evaluate_layout_query(call));
+                return;
+            }
+
+            case Intrinsic::any:
+            case Intrinsic::all:
+            {
+                auto mask = this->generate_operand(arguments[0]);
+
+                this->w.write_d_a(MOV, dst, mask);
+                for (auto lane = 1; lane < num_lanes(arguments[0]->inferred_type()); ++lane)
+                {
+                    this->w.write_d_a_b(call->intrinsic == Intrinsic::any ? BITOR : BITAND, dst, dst, mask + lane);
+                }
+
+                return;
+            }
+
+            case Intrinsic::join:
+            {
+                auto thread = this->generate_operand(arguments[0]);
+                this->generate_runtime_call(
+                    "fasel_thread_join",
+                    {VmValueKind::integer},
+                    VmValueKind::none,
+                    thread,
+                    dst);
+
+                return;
+            }
+
+            // Calls of async procedures create their tasks (see TASK)
+            case Intrinsic::run:
+            {
+                // The address and the length of the arena
+                auto arena  = this->generate_operand(arguments[0]);
+                auto begin  = this->allocate_registers(2);
+                auto length = this->generate_length(arguments[0]->inferred_type(), arena);
+                this->w.write_d_a_bytes(LOAD, begin, arena, 8);
+                this->move(begin + 1, length, 1);
+                this->generate_runtime_call(
+                    "fasel_executor_begin",
+                    {VmValueKind::integer, VmValueKind::integer},
+                    VmValueKind::none,
+                    begin,
+                    dst);
+
+                auto task = this->allocate_register();
+                this->generate_call(node_cast<ProcedureCallNode, true>(arguments[1]), task);
+                this->w.write_d_a(RUN, dst, task);
+
+                return;
+            }
+
+            case Intrinsic::start:
+            {
+                this->generate_call(node_cast<ProcedureCallNode, true>(arguments[0]), dst);
+                return;
+            }
+
+            case Intrinsic::await:
+            {
+                auto task = this->allocate_register();
+                if (auto task_call = node_cast<ProcedureCallNode>(arguments[0]); async_procedure(task_call) != nullptr)
+                {
+                    this->generate_call(task_call, task);
+                }
+                else
+                {
+                    this->generate_into(arguments[0], task);
+                }
+
+                this->w.write_d_a(AWAIT, dst, task);
+
+                return;
+            }
+
+            case Intrinsic::yield:
+            {
+                this->w.write_op(YIELD);
+                return;
+            }
+
+            default: UNREACHED;
+        }
+    }
+
+    // Locals are held in registers that no other thread can access, so the atomic operations on them are plain
+    // moves. Values in memory may be shared with other threads, the runtime library operates on them and makes the
+    // fences (see fasel_atomic).
+    void generate_atomic(ProcedureCallNode *call, VmRegister dst)
+    {
+        auto ident = call->intrinsic != Intrinsic::atomic_fence ? node_cast<IdentifierNode>(call->arguments[0])
+                                                                : nullptr;
+        if (ident == nullptr)
+        {
+            this->generate_shared_atomic(call, dst);
+            return;
+        }
+
+        auto type     = ident->inferred_type();
+        auto basic    = node_cast<BasicTypeNode>(type);
+        auto variable = this->local_registers.at(ident->declaration);
+
+        std::vector<VmRegister> values{};
+        for (size_t i = 1; i < call->arguments.size(); ++i)
+        {
+            values.push_back(this->generate_operand(call->arguments[i]));
+        }
+
+        auto previous = this->allocate_register();
+        this->move(previous, variable, 1);
+
+        auto store = [&](VmRegister value) { this->move(variable, value, 1); };
+
+        auto result = this->allocate_register();
+        switch (call->intrinsic)
+        {
+            case Intrinsic::atomic_load: break;
+
+            case Intrinsic::atomic_store:
+            case Intrinsic::atomic_exchange:
+            {
+                store(values[0]);
+                break;
+            }
+
+            case Intrinsic::atomic_compare_exchange:
+            {
+                this->w.write_d_a_b(CMPEQ, result, previous, values[0]);
+                auto jmp_skip = this->w.write_a_target(JMPZ, result, -1);
+                store(values[1]);
+                this->w.patch_target(jmp_skip, this->position());
+
+                break;
+            }
+
+            case Intrinsic::atomic_min:
+            case Intrinsic::atomic_max:
+            {
+                auto is_min = call->intrinsic == Intrinsic::atomic_min;
+                this->generate_operator(is_min ? Tt::less_than : Tt::greater_than, basic, result, values[0], previous);
+
+                auto jmp_skip = this->w.write_a_target(JMPZ, result, -1);
+                store(values[0]);
+                this->w.patch_target(jmp_skip, this->position());
+
+                break;
+            }
+
+            default:
+            {
+                Tt operator_kind{};
+                switch (call->intrinsic)
+                {
+                    case Intrinsic::atomic_add: operator_kind = Tt::plus; break;
+                    case Intrinsic::atomic_sub: operator_kind = Tt::minus; break;
+                    case Intrinsic::atomic_and: operator_kind = Tt::bit_and; break;
+                    case Intrinsic::atomic_or:  operator_kind = Tt::bit_or; break;
+                    case Intrinsic::atomic_xor: operator_kind = Tt::bit_xor; break;
+                    default:                    UNREACHED;
+                }
+
+                this->generate_operator(operator_kind, basic, result, previous, values[0]);
+                store(result);
+
+                break;
+            }
+        }
+
+        if (call->intrinsic != Intrinsic::atomic_store)
+        {
+            this->move(dst, previous, 1);
+        }
+    }
+
+    // fasel_atomic(operation, type, address, value, desired)
+    void generate_shared_atomic(ProcedureCallNode *call, VmRegister dst)
+    {
+        // The runtime library does not read the arguments that the operation does not have
+        auto first_argument = this->allocate_registers(5);
+        this->w.write_d_imm(LOADI, first_argument, static_cast<int64_t>(atomic_operation(call->intrinsic)));
+        if (call->intrinsic != Intrinsic::atomic_fence)
+        {
+            auto target = call->arguments[0];
+            this->w.write_d_imm(LOADI, first_argument + 1, static_cast<int64_t>(atomic_type(target->inferred_type())));
+            this->move(first_argument + 2, this->generate_address(target), 1);
+
+            for (size_t i = 1; i < call->arguments.size(); ++i)
+            {
+                this->generate_into(call->arguments[i], first_argument + 2 + i);
+            }
+        }
+
+        auto returns_value = call->intrinsic != Intrinsic::atomic_store && call->intrinsic != Intrinsic::atomic_fence;
+        this->generate_runtime_call(
+            "fasel_atomic",
+            std::vector<VmValueKind>(5, VmValueKind::integer),
+            returns_value ? VmValueKind::integer : VmValueKind::none,
+            first_argument,
+            dst);
+    }
+
+    static AtomicOperation atomic_operation(Intrinsic intrinsic)
+    {
+        switch (intrinsic)
+        {
+            case Intrinsic::atomic_load:             return AtomicOperation::load;
+            case Intrinsic::atomic_store:            return AtomicOperation::store;
+            case Intrinsic::atomic_exchange:         return AtomicOperation::exchange;
+            case Intrinsic::atomic_compare_exchange: return AtomicOperation::compare_exchange;
+            case Intrinsic::atomic_add:              return AtomicOperation::add;
+            case Intrinsic::atomic_sub:              return AtomicOperation::sub;
+            case Intrinsic::atomic_and:              return AtomicOperation::bit_and;
+            case Intrinsic::atomic_or:               return AtomicOperation::bit_or;
+            case Intrinsic::atomic_xor:              return AtomicOperation::bit_xor;
+            case Intrinsic::atomic_min:              return AtomicOperation::min;
+            case Intrinsic::atomic_max:              return AtomicOperation::max;
+            case Intrinsic::atomic_fence:            return AtomicOperation::fence;
+            default:                                 UNREACHED;
+        }
+    }
+
+    // Pointers are unsigned integers
+    static AtomicType atomic_type(const Node *type)
+    {
+        auto basic = node_cast<BasicTypeNode>(type);
+        if (basic != nullptr && basic->type_kind == BasicTypeNode::Kind::floatingpoint)
+        {
+            return basic->size == 4 ? AtomicType::f32 : AtomicType::f64;
+        }
+
+        auto is_signed = basic != nullptr && basic->type_kind == BasicTypeNode::Kind::signed_integer;
+        switch (size_of(type))
+        {
+            case 1:  return is_signed ? AtomicType::i8 : AtomicType::u8;
+            case 2:  return is_signed ? AtomicType::i16 : AtomicType::u16;
+            case 4:  return is_signed ? AtomicType::i32 : AtomicType::u32;
+            case 8:  return is_signed ? AtomicType::i64 : AtomicType::u64;
+            default: UNREACHED;
+        }
+    }
+
+    // Calls the function of the runtime library (see runtime.h) with the arguments in the registers starting at
+    // first_argument
+    void generate_runtime_call(
+        std::string_view name,
+        std::vector<VmValueKind> argument_kinds,
+        VmValueKind return_kind,
+        VmRegister first_argument,
+        VmRegister dst)
+    {
+        auto address = find_runtime_symbol(name);
+        assert(address != nullptr);
+
+        auto index = static_cast<uint32_t>(this->program.external_calls.size());
+        this->w.write_index_a_d(CALLX, index, first_argument, dst);
+        this->program.external_calls.push_back(VmExternalCall{
+            .name           = std::string{name},
+            .address        = address,
+            .argument_kinds = std::move(argument_kinds),
+            .return_kind    = return_kind,
+        });
+    }
+
+    // spawn(f(...)) copies the arguments of the call to an environment in the frame memory (see thread_environment).
+    // SPAWN copies it for the new thread and calls a procedure that loads the arguments from the copy and calls the
+    // procedure with them (see generate_spawn_entries).
+    void generate_spawn(ProcedureCallNode *spawn, VmRegister dst)
+    {
+        auto call   = node_cast<ProcedureCallNode, true>(spawn->arguments[0]);
+        auto ident  = node_cast<IdentifierNode, true>(call->procedure);
+        auto layout = thread_environment(call);
+
+        // The address of the environment, its size and its alignment
+        auto environment = this->allocate_registers(3);
+        this->w.write_d_imm(ADDR, environment, this->allocate_memory(layout.size, layout.alignment));
+        this->w.write_d_imm(LOADI, environment + 1, layout.size);
+        this->w.write_d_imm(LOADI, environment + 2, layout.alignment);
+
+        auto registers_in_use = this->next_register;
+        for (size_t i = 0; i < call->arguments.size(); ++i)
+        {
+            auto argument = call->arguments[i];
+            auto type     = argument->inferred_type();
+            auto address  = this->allocate_register();
+            this->w.write_d_a_imm(ADDI, address, environment, layout.offsets[i]);
+
+            auto value = this->generate_operand(argument);
+            if (is_aggregate(type))
+            {
+                this->w.write_d_a_imm(COPY, address, value, size_of(type));
+            }
+            else
+            {
+                this->generate_store(address, value, type);
+            }
+
+            this->next_register = registers_in_use;
+        }
+
+        // The arguments have the types of the parameters, so all spawns of the procedure share the entry
+        auto [it, is_new] = this->spawn_entry_indices.try_emplace(
+            ident->declaration,
+            static_cast<int64_t>(this->program.procedures.size()));
+        if (is_new)
+        {
+            this->program.procedures.push_back(VmProcedure{
+                .name          = std::format("{}.spawn", ident->identifier),
+                .num_arguments = 1,
+            });
+            this->pending_spawn_entries.push_back(call);
+        }
+
+        this->w.write_index_a_d(SPAWN, static_cast<uint32_t>(it->second), environment, dst);
+    }
+
+    // The procedures that spawned threads start with, they follow the other procedures:
+    //
+    // <f>.spawn := proc(environment: u64) void { f(<environment[i]>...) }
+    void generate_spawn_entries()
+    {
+        for (auto call : this->pending_spawn_entries)
+        {
+            auto ident         = node_cast<IdentifierNode, true>(call->procedure);
+            auto layout        = thread_environment(call);
+            auto &vm_procedure = this->program.procedures[this->spawn_entry_indices.at(ident->declaration)];
+
+            vm_procedure.address = static_cast<int64_t>(this->w.pos);
+
+            this->local_registers.clear();
+            this->next_register   = 0;
+            this->num_registers   = 0;
+            this->frame_size      = 0;
+            this->frame_alignment = 1;
+
+            auto environment   = this->allocate_register();
+            auto address       = this->allocate_register();
+            auto num_registers = int64_t{};
+            for (auto argument : call->arguments)
+            {
+                num_registers += num_lanes(argument->inferred_type());
+            }
+
+            // Structs are passed by their address in the environment, which belongs to the thread
+            auto first_argument    = this->allocate_registers(num_registers);
+            auto argument_register = first_argument;
+            for (size_t i = 0; i < call->arguments.size(); ++i)
+            {
+                auto type = call->arguments[i]->inferred_type();
+                if (is_aggregate(type))
+                {
+                    this->w.write_d_a_imm(ADDI, argument_register, environment, layout.offsets[i]);
+                }
+                else
+                {
+                    this->w.write_d_a_imm(ADDI, address, environment, layout.offsets[i]);
+                    this->generate_load(argument_register, address, type);
+                }
+
+                argument_register += num_lanes(type);
+            }
+
+            auto index = static_cast<uint32_t>(this->procedure_indices.at(ident->declaration));
+            this->w.write_index_a_d(CALL, index, first_argument, address);
+            this->w.write_op(RETV);
+
+            vm_procedure.num_registers   = this->num_registers;
+            vm_procedure.frame_size      = this->frame_size;
+            vm_procedure.frame_alignment = this->frame_alignment;
+        }
+
+        this->pending_spawn_entries.clear();
+    }
+
+    // Returns the register that holds the value of the expression - locals are used in place
+    VmRegister generate_operand(Node *node)
+    {
+        if (node->kind == NodeKind::identifier)
+        {
+            auto ident = static_cast<IdentifierNode *>(node);
+            auto it    = this->local_registers.find(ident->declaration);
+            if (it != this->local_registers.end())
+            {
+                return it->second;
+            }
+        }
+
+        auto reg = this->allocate_registers(num_lanes(node->inferred_type()));
+        this->generate_into(node, reg);
+
+        return reg;
+    }
+
+    // Evaluates the expression into the register. The register is only written after all operands were read,
+    // so the destination can be a local that the expression reads.
+    void generate_into(Node *node, VmRegister dst)
+    {
+        auto registers_in_use = this->next_register;
+        defer
+        {
+            this->next_register = registers_in_use;
+        };
+
+        switch (node->kind)
+        {
+            case NodeKind::binary_operator:
+            {
+                this->generate_binary_operator(static_cast<BinaryOperatorNode *>(node), dst);
+                return;
+            }
+
+            case NodeKind::identifier:
+            {
+                auto ident = static_cast<IdentifierNode *>(node);
+                if (this->local_registers.contains(ident->declaration) == false)
+                {
+                    // TODO: Procedures as values
+                    TODO;
+                }
+
+                auto src = this->local_registers.at(ident->declaration);
+                this->move(dst, src, num_lanes(ident->inferred_type()));
+
+                return;
+            }
+
+            case NodeKind::literal:
+            {
+                auto literal = static_cast<LiteralNode *>(node);
+
+                if (std::holds_alternative<uint64_t>(literal->value))
+                {
+                    auto basic_type = node_cast<BasicTypeNode, true>(literal->inferred_type());
+                    this->w.write_d_imm(LOADI, dst, normalize_integer(basic_type, std::get<uint64_t>(literal->value)));
+                    return;
+                }
+
+                if (std::holds_alternative<float>(literal->value))
+                {
+                    auto value = static_cast<double>(std::get<float>(literal->value));
+                    this->w.write_d_imm(LOADI, dst, std::bit_cast<int64_t>(value));
+                    return;
+                }
+
+                if (std::holds_alternative<double>(literal->value))
+                {
+                    this->w.write_d_imm(LOADI, dst, std::bit_cast<int64_t>(std::get<double>(literal->value)));
+                    return;
+                }
+
+                if (std::holds_alternative<bool>(literal->value))
+                {
+                    this->w.write_d_imm(LOADI, dst, std::get<bool>(literal->value) ? 1 : 0);
+                    return;
+                }
+
+                if (std::holds_alternative<std::string>(literal->value))
+                {
+                    auto offset = static_cast<int64_t>(this->program.strings.size());
+                    this->program.strings += std::get<std::string>(literal->value);
+                    this->program.strings.push_back('\0');
+                    this->w.write_d_imm(LOADS, dst, offset);
+                    return;
+                }
+
+                UNREACHED;
+            }
+
+            case NodeKind::procedure_call:
+            {
+                this->generate_call(static_cast<ProcedureCallNode *>(node), dst);
+                return;
+            }
+
+            case NodeKind::type_cast:
+            {
+                this->generate_type_cast(static_cast<TypeCastNode *>(node), dst);
+                return;
+            }
+
+            case NodeKind::slice:
+            {
+                this->generate_slice(static_cast<SliceNode *>(node), dst);
+                return;
+            }
+
+            case NodeKind::member_access:
+            case NodeKind::index:
+            {
+                // The length of an array that has not been folded
+                auto object_type = node->kind == NodeKind::member_access
+                                       ? static_cast<MemberAccessNode *>(node)->object->inferred_type()
+                                       : nullptr;
+                if (auto array = node_cast<ArrayTypeNode>(object_type))
+                {
+                    this->w.write_d_imm(LOADI, dst, array_length(array));
+                    return;
+                }
+
+                auto address = this->generate_address(node);
+                if (is_aggregate(node->inferred_type()))
+                {
+                    this->move(dst, address, 1);
+                    return;
+                }
+
+                this->generate_load(dst, address, node->inferred_type());
+
+                return;
+            }
+
+            default: UNREACHED;
+        }
+    }
+
+    // Returns a register that holds the address of the field, the array element or the struct or array
+    VmRegister generate_address(Node *node)
+    {
+        switch (node->kind)
+        {
+            case NodeKind::member_access:
+            {
+                auto member_access = static_cast<MemberAccessNode *>(node);
+                auto struct_type   = struct_layout(member_access->object->inferred_type());
+                const auto &field  = struct_type->fields[member_access->field_index];
+
+                // a[i].x of a @soa array is the element i of the array of the field
+                if (auto index = node_cast<IndexNode>(member_access->object))
+                {
+                    auto array = node_cast<ArrayTypeNode>(index->array->inferred_type());
+                    if (array != nullptr && array->is_soa)
+                    {
+                        auto offset = soa_field_offset(array, member_access->field_index);
+                        return this->generate_element_address(index, offset, size_of(field.type));
+                    }
+                }
+
+                auto object = this->generate_address(member_access->object);
+                if (field.offset == 0)
+                {
+                    return object;
+                }
+
+                auto address = this->allocate_register();
+                this->w.write_d_a_imm(ADDI, address, object, field.offset);
+
+                return address;
+            }
+
+            case NodeKind::index:
+            {
+                auto index = static_cast<IndexNode *>(node);
+                return this->generate_element_address(index, 0, size_of(index->inferred_type()));
+            }
+
+            // The registers of structs, arrays and slices hold their addresses
+            default: return this->generate_operand(node);
+        }
+    }
+
+    // Returns a register that holds the address of the elements of the array or the slice plus offset plus the index
+    // times stride, checking the index against the number of elements unless it is known to be in bounds
+    VmRegister generate_element_address(IndexNode *index, int64_t offset, int64_t stride)
+    {
+        auto array = this->generate_address(index->array);
+
+        auto literal = node_cast<LiteralNode>(index->index);
+
+        VmRegister value{};
+        if (literal == nullptr || index->needs_bounds_check)
+        {
+            value = this->generate_operand(index->index);
+        }
+
+        if (index->needs_bounds_check)
+        {
+            this->w.write_d_a(CHKLTU, value, this->generate_length(index->array->inferred_type(), array));
+        }
+
+        // A slice holds the address of its elements
+        if (index->array->inferred_type()->kind == NodeKind::slice_type)
+        {
+            auto data = this->allocate_register();
+            this->w.write_d_a_bytes(LOAD, data, array, 8);
+            array = data;
+        }
+
+        auto address = this->allocate_register();
+
+        if (literal != nullptr)
+        {
+            auto constant = static_cast<int64_t>(std::get<uint64_t>(literal->value));
+            this->w.write_d_a_imm(ADDI, address, array, offset + constant * stride);
+            return address;
+        }
+
+        this->w.write_d_imm(LOADI, address, stride);
+        this->w.write_d_a_b(MUL, address, value, address);
+        if (offset != 0)
+        {
+            this->w.write_d_a_imm(ADDI, address, address, offset);
+        }
+
+        this->w.write_d_a_b(ADD, address, array, address);
+
+        return address;
+    }
+
+    // Returns a register that holds the number of elements of the array or of the slice at the address
+    VmRegister generate_length(const Node *type, VmRegister address)
+    {
+        auto length = this->allocate_register();
+        if (auto array = node_cast<ArrayTypeNode>(type))
+        {
+            this->w.write_d_imm(LOADI, length, array_length(array));
+            return length;
+        }
+
+        this->w.write_d_a_imm(ADDI, length, address, SliceTypeNode::length_offset);
+        this->w.write_d_a_bytes(LOAD, length, length, 8);
+
+        return length;
+    }
+
+    // Evaluates a[b:e] into fresh frame memory and moves its address into the register
+    void generate_slice(SliceNode *slice, VmRegister dst)
+    {
+        auto object = this->generate_address(slice->object);
+        auto length = this->generate_length(slice->object->inferred_type(), object);
+
+        // A slice holds the address of its elements, the register of an array is its address
+        auto data = object;
+        if (slice->object->inferred_type()->kind == NodeKind::slice_type)
+        {
+            data = this->allocate_register();
+            this->w.write_d_a_bytes(LOAD, data, object, 8);
+        }
+
+        auto begin = slice->begin != nullptr ? this->generate_operand(slice->begin) : this->allocate_register();
+        if (slice->begin == nullptr)
+        {
+            this->w.write_d_imm(LOADI, begin, 0);
+        }
+
+        auto end = slice->end != nullptr ? this->generate_operand(slice->end) : length;
+
+        // Unsigned comparisons, so that negative bounds fail as well
+        if (slice->needs_bounds_check)
+        {
+            this->w.write_d_a(CHKLEU, begin, end);
+            this->w.write_d_a(CHKLEU, end, length);
+        }
+
+        auto element_type = node_cast<SliceTypeNode, true>(slice->inferred_type())->element_type;
+        auto elements     = this->allocate_register();
+        auto offset       = this->allocate_register();
+        this->w.write_d_imm(LOADI, offset, size_of(element_type));
+        this->w.write_d_a_b(MUL, offset, begin, offset);
+        this->w.write_d_a_b(ADD, elements, data, offset);
+        this->w.write_d_a_b(SUB, length, end, begin);
+
+        auto result = this->allocate_aggregate(slice->inferred_type());
+        this->w.write_d_a_bytes(STORE, result, elements, 8);
+        this->w.write_d_a_imm(ADDI, offset, result, SliceTypeNode::length_offset);
+        this->w.write_d_a_bytes(STORE, offset, length, 8);
+
+        this->move(dst, result, 1);
+    }
+
+    // Loads a value that is not an aggregate from the address into the register(s), vectors lane by lane
+    void generate_load(VmRegister dst, VmRegister address, const Node *type)
+    {
+        if (auto vector_type = node_cast<VectorTypeNode>(type))
+        {
+            auto lane_address = this->allocate_register();
+            for (auto lane = 0; lane < vector_type->length; ++lane)
+            {
+                this->w.write_d_a_imm(ADDI, lane_address, address, lane * vector_type->element_type->size);
+                this->generate_load(dst + lane, lane_address, vector_type->element_type);
+            }
+
+            return;
+        }
+
+        auto basic = node_cast<BasicTypeNode>(type);
+        if (basic != nullptr && basic->type_kind == BasicTypeNode::Kind::floatingpoint && basic->size == 4)
+        {
+            this->w.write_d_a(LOADF, dst, address);
+            return;
+        }
+
+        auto size = size_of(type);
+        this->w.write_d_a_bytes(LOAD, dst, address, static_cast<uint8_t>(size));
+        if (basic != nullptr && basic->type_kind == BasicTypeNode::Kind::signed_integer && size < 8)
+        {
+            this->w.write_d_a_bytes(SEXT, dst, dst, static_cast<uint8_t>(size));
+        }
+    }
+
+    // The inverse of generate_load
+    void generate_store(VmRegister address, VmRegister value, const Node *type)
+    {
+        if (auto vector_type = node_cast<VectorTypeNode>(type))
+        {
+            auto lane_address = this->allocate_register();
+            for (auto lane = 0; lane < vector_type->length; ++lane)
+            {
+                this->w.write_d_a_imm(ADDI, lane_address, address, lane * vector_type->element_type->size);
+                this->generate_store(lane_address, value + lane, vector_type->element_type);
+            }
+
+            return;
+        }
+
+        auto basic = node_cast<BasicTypeNode>(type);
+        if (basic != nullptr && basic->type_kind == BasicTypeNode::Kind::floatingpoint && basic->size == 4)
+        {
+            this->w.write_d_a(STOREF, address, value);
+            return;
+        }
+
+        this->w.write_d_a_bytes(STORE, address, value, static_cast<uint8_t>(size_of(type)));
+    }
+
+    // Emits code that jumps if the condition evaluates to jump_if and falls through otherwise.
+    // The positions of the jump targets to patch are appended to jumps.
+    void generate_branch(Node *condition, bool jump_if, std::vector<int64_t> &jumps)
+    {
+        auto registers_in_use = this->next_register;
+        defer
+        {
+            this->next_register = registers_in_use;
+        };
+
+        if (auto bin_op = node_cast<BinaryOperatorNode>(condition))
+        {
+            switch (bin_op->operator_kind)
+            {
+                case Tt::logical_and:
+                {
+                    if (jump_if == false)
+                    {
+                        this->generate_branch(bin_op->lhs, false, jumps);
+                        this->generate_branch(bin_op->rhs, false, jumps);
+                        return;
+                    }
+
+                    std::vector<int64_t> false_jumps{};
+                    this->generate_branch(bin_op->lhs, false, false_jumps);
+                    this->generate_branch(bin_op->rhs, true, jumps);
+                    this->patch_jumps(false_jumps, this->position());
+
+                    return;
+                }
+
+                case Tt::logical_or:
+                {
+                    if (jump_if)
+                    {
+                        this->generate_branch(bin_op->lhs, true, jumps);
+                        this->generate_branch(bin_op->rhs, true, jumps);
+                        return;
+                    }
+
+                    std::vector<int64_t> true_jumps{};
+                    this->generate_branch(bin_op->lhs, true, true_jumps);
+                    this->generate_branch(bin_op->rhs, false, jumps);
+                    this->patch_jumps(true_jumps, this->position());
+
+                    return;
+                }
+
+                default: break;
+            }
+
+            auto lhs_type = node_cast<BasicTypeNode>(bin_op->lhs->inferred_type());
+            auto is_integer_comparison = is_comparison(bin_op->operator_kind) && lhs_type != nullptr &&
+                                         lhs_type->type_kind != BasicTypeNode::Kind::floatingpoint;
+            if (is_integer_comparison)
+            {
+                auto operator_kind = jump_if ? bin_op->operator_kind : negate_comparison(bin_op->operator_kind);
+                auto is_signed     = lhs_type->type_kind != BasicTypeNode::Kind::unsigned_integer;
+
+                auto a = this->generate_operand(bin_op->lhs);
+
+                auto immediate = integer_immediate(bin_op->rhs, lhs_type);
+                if (immediate.has_value())
+                {
+                    auto op = compare_and_branch_op(operator_kind, is_signed, true);
+                    jumps.push_back(this->w.write_a_imm_target(op, a, immediate.value(), -1));
+                    return;
+                }
+
+                auto b  = this->generate_operand(bin_op->rhs);
+                auto op = compare_and_branch_op(operator_kind, is_signed, false);
+                jumps.push_back(this->w.write_a_b_target(op, a, b, -1));
+
+                return;
+            }
+        }
+
+        if (auto literal = node_cast<LiteralNode>(condition); literal != nullptr &&
+                                                              std::holds_alternative<bool>(literal->value))
+        {
+            if (std::get<bool>(literal->value) == jump_if)
+            {
+                jumps.push_back(this->w.write_target(JMP, -1));
+            }
+
+            return;
+        }
+
+        auto reg = this->generate_operand(condition);
+        jumps.push_back(this->w.write_a_target(jump_if ? JMPNZ : JMPZ, reg, -1));
+    }
+
+    void generate_binary_operator(BinaryOperatorNode *bin_op, VmRegister dst)
+    {
+        assert(Node::types_equal(bin_op->lhs->inferred_type(), bin_op->rhs->inferred_type()));
+
+        switch (bin_op->operator_kind)
+        {
+            case Tt::logical_and:
+            case Tt::logical_or:
+            {
+                std::vector<int64_t> false_jumps{};
+                this->generate_branch(bin_op, false, false_jumps);
+
+                this->w.write_d_imm(LOADI, dst, 1);
+                auto jmp_done = this->w.write_target(JMP, -1);
+
+                this->patch_jumps(false_jumps, this->position());
+                this->w.write_d_imm(LOADI, dst, 0);
+
+                this->w.patch_target(jmp_done, this->position());
+
+                return;
+            }
+
+            case Tt::assign:
+            {
+                // TODO: Assignments are statements in the bytecode compiler
+                TODO;
+            }
+
+            default: break;
+        }
+
+        // The operator is applied to each lane of vectors
+        if (auto vector_type = node_cast<VectorTypeNode>(bin_op->lhs->inferred_type()))
+        {
+            auto type = vector_type->element_type;
+            auto a    = this->generate_operand(bin_op->lhs);
+            auto b    = this->generate_operand(bin_op->rhs);
+            for (auto lane = 0; lane < vector_type->length; ++lane)
+            {
+                this->generate_operator(bin_op->operator_kind, type, dst + lane, a + lane, b + lane);
+            }
+
+            return;
+        }
+
+        auto lhs_type = node_cast<BasicTypeNode, true>(bin_op->lhs->inferred_type());
+        auto a        = this->generate_operand(bin_op->lhs);
+
+        auto is_integer = lhs_type->type_kind != BasicTypeNode::Kind::floatingpoint;
+        if (is_integer && (bin_op->operator_kind == Tt::plus || bin_op->operator_kind == Tt::minus))
+        {
+            auto immediate = integer_immediate(bin_op->rhs, lhs_type);
+            if (immediate.has_value())
+            {
+                auto value = static_cast<uint64_t>(immediate.value());
+                if (bin_op->operator_kind == Tt::minus)
+                {
+                    value = 0 - value;
+                }
+
+                this->w.write_d_a_imm(ADDI, dst, a, static_cast<int64_t>(value));
+                this->normalize(dst, lhs_type);
+
+                return;
+            }
+        }
+
+        auto b = this->generate_operand(bin_op->rhs);
+        this->generate_operator(bin_op->operator_kind, lhs_type, dst, a, b);
+    }
+
+    // Applies an arithmetic, bitwise or comparison operator to operands of the type in registers
+    void generate_operator(Tt operator_kind, const BasicTypeNode *type, VmRegister dst, VmRegister a, VmRegister b)
+    {
+        if (operator_kind == Tt::right_shift && type->type_kind == BasicTypeNode::Kind::signed_integer &&
+            type->size < 8)
+        {
+            // Logical shift of the narrow value, like LLVM's lshr
+            auto zero_extended = this->allocate_register();
+            this->w.write_d_a_bytes(ZEXT, zero_extended, a, type->size);
+            a = zero_extended;
+        }
+
+        switch (type->type_kind)
+        {
+            case BasicTypeNode::Kind::boolean:
+            case BasicTypeNode::Kind::signed_integer:
+            case BasicTypeNode::Kind::unsigned_integer:
+            {
+                auto is_signed = type->type_kind != BasicTypeNode::Kind::unsigned_integer;
+
+                switch (operator_kind)
+                {
+                    case Tt::asterisk:              this->w.write_d_a_b(MUL, dst, a, b); break;
+                    case Tt::slash:                 this->w.write_d_a_b(is_signed ? DIVS : DIVU, dst, a, b); break;
+                    case Tt::mod:                   this->w.write_d_a_b(is_signed ? MODS : MODU, dst, a, b); break;
+                    case Tt::plus:                  this->w.write_d_a_b(ADD, dst, a, b); break;
+                    case Tt::minus:                 this->w.write_d_a_b(SUB, dst, a, b); break;
+                    case Tt::bit_and:               this->w.write_d_a_b(BITAND, dst, a, b); break;
+                    case Tt::bit_or:                this->w.write_d_a_b(BITOR, dst, a, b); break;
+                    case Tt::bit_xor:               this->w.write_d_a_b(BITXOR, dst, a, b); break;
+                    case Tt::left_shift:            this->w.write_d_a_b(LSH, dst, a, b); break;
+                    case Tt::right_shift:           this->w.write_d_a_b(RSH, dst, a, b); break;
+                    case Tt::equal:                 this->w.write_d_a_b(CMPEQ, dst, a, b); return;
+                    case Tt::inequal:               this->w.write_d_a_b(CMPNE, dst, a, b); return;
+                    case Tt::greater_than_or_equal: this->w.write_d_a_b(is_signed ? CMPGE : CMPGEU, dst, a, b); return;
+                    case Tt::greater_than:          this->w.write_d_a_b(is_signed ? CMPGT : CMPGTU, dst, a, b); return;
+                    case Tt::less_than_or_equal:    this->w.write_d_a_b(is_signed ? CMPLE : CMPLEU, dst, a, b); return;
+                    case Tt::less_than:             this->w.write_d_a_b(is_signed ? CMPLT : CMPLTU, dst, a, b); return;
+                    default:                        UNREACHED;
+                }
+
+                this->normalize(dst, type);
+
+                return;
+            }
+
+            case BasicTypeNode::Kind::floatingpoint:
+            {
+                switch (operator_kind)
+                {
+                    case Tt::asterisk:              this->w.write_d_a_b(FMUL, dst, a, b); break;
+                    case Tt::slash:                 this->w.write_d_a_b(FDIV, dst, a, b); break;
+                    case Tt::mod:                   this->w.write_d_a_b(FMOD, dst, a, b); break;
+                    case Tt::plus:                  this->w.write_d_a_b(FADD, dst, a, b); break;
+                    case Tt::minus:                 this->w.write_d_a_b(FSUB, dst, a, b); break;
+                    case Tt::equal:                 this->w.write_d_a_b(FCMPEQ, dst, a, b); return;
+                    case Tt::inequal:               this->w.write_d_a_b(FCMPNE, dst, a, b); return;
+                    case Tt::greater_than_or_equal: this->w.write_d_a_b(FCMPGE, dst, a, b); return;
+                    case Tt::greater_than:          this->w.write_d_a_b(FCMPGT, dst, a, b); return;
+                    case Tt::less_than_or_equal:    this->w.write_d_a_b(FCMPLE, dst, a, b); return;
+                    case Tt::less_than:             this->w.write_d_a_b(FCMPLT, dst, a, b); return;
+                    default:                        UNREACHED;
+                }
+
+                if (type->size == 4)
+                {
+                    this->w.write_d_a(ROUNDF, dst, dst);
+                }
+
+                return;
+            }
+
+            default: UNREACHED;
+        }
+    }
+
+    void generate_type_cast(TypeCastNode *cast, VmRegister dst)
+    {
+        // A scalar that is cast to a vector is set in all lanes, it already has the type of the lanes
+        if (auto vector_type = node_cast<VectorTypeNode>(cast->inferred_type()))
+        {
+            auto src = this->generate_operand(cast->expression);
+            for (auto lane = 0; lane < vector_type->length; ++lane)
+            {
+                this->w.write_d_a(MOV, dst + lane, src);
+            }
+
+            return;
+        }
+
+        auto dest_basic_type = node_cast<BasicTypeNode, true>(cast->inferred_type());
+        auto src_basic_type  = node_cast<BasicTypeNode, true>(cast->expression->inferred_type());
+
+        auto src = this->generate_operand(cast->expression);
+
+        switch (src_basic_type->type_kind)
+        {
+            case BasicTypeNode::Kind::boolean: UNREACHED;
+
+            case BasicTypeNode::Kind::signed_integer:
+            case BasicTypeNode::Kind::unsigned_integer:
+            {
+                switch (dest_basic_type->type_kind)
+                {
+                    case BasicTypeNode::Kind::signed_integer:
+                    case BasicTypeNode::Kind::unsigned_integer:
+                    {
+                        this->normalize_into(dst, src, dest_basic_type);
+                        return;
+                    }
+
+                    case BasicTypeNode::Kind::floatingpoint:
+                    {
+                        auto is_u64 = src_basic_type->type_kind == BasicTypeNode::Kind::unsigned_integer &&
+                                      src_basic_type->size == 8;
+                        this->w.write_d_a(is_u64 ? UTOF : ITOF, dst, src);
+                        if (dest_basic_type->size == 4)
+                        {
+                            this->w.write_d_a(ROUNDF, dst, dst);
+                        }
+
+                        return;
+                    }
+
+                    default: TODO;
+                }
+            }
+
+            case BasicTypeNode::Kind::floatingpoint:
+            {
+                switch (dest_basic_type->type_kind)
+                {
+                    case BasicTypeNode::Kind::floatingpoint:
+                    {
+                        if (dest_basic_type->size == 4)
+                        {
+                            this->w.write_d_a(ROUNDF, dst, src);
+                        }
+                        else if (dst != src)
+                        {
+                            this->w.write_d_a(MOV, dst, src);
+                        }
+
+                        return;
+                    }
+
+                    default: TODO;
+                }
+            }
+
+            default: UNREACHED;
+        }
+    }
+};
+
+void fuse_superinstructions(VmProgram &program)
+{
+    auto &bytecode = program.bytecode;
+
+    // The last instruction of a procedure is a return or a jump, which never starts a superinstruction,
+    // so walking all procedures at once does not fuse across procedure boundaries
+    for (size_t pos = 0; pos < bytecode.size();)
+    {
+        auto op   = static_cast<OpCode>(bytecode[pos]);
+        auto next = pos + instruction_size(op);
+        if (next >= bytecode.size())
+        {
+            break;
+        }
+
+        // The second instruction keeps its op code (or becomes the first instruction of another superinstruction),
+        // so it can still be a jump target
+        auto next_op = static_cast<OpCode>(bytecode[next]);
+        for (const auto &superinstruction : superinstructions)
+        {
+            if (superinstruction.first == op && superinstruction.second == next_op)
+            {
+                bytecode[pos] = superinstruction.op;
+                break;
+            }
+        }
+
+        pos = next;
+    }
+}
+
+struct CalleeCollector : NodeVisitorBase
+{
+    std::vector<DeclarationNode *> procedures{};
+    std::unordered_set<DeclarationNode *> visited{};
+
+    void visit(IdentifierNode *ident) override
+    {
+        auto decl = ident->declaration;
+        if (decl == nullptr || this->visited.contains(decl))
+        {
+            return;
+        }
+
+        auto procedure = node_cast<ProcedureNode>(decl->init_expression);
+        if (procedure == nullptr || procedure->is_external)
+        {
+            return;
+        }
+
+        this->visited.insert(decl);
+        this->procedures.push_back(decl);
+
+        ::visit(procedure->body, *this);
+    }
+};
+
+std::vector<DeclarationNode *> reachable_procedures(Node *node)
+{
+    CalleeCollector collector{};
+    visit(node, collector);
+
+    return std::move(collector.procedures);
+}
+
+VmProgram compile_call_to_bytecode(ProcedureCallNode *call, const BytecodeCompilationOptions &options)
+{
+    SET_TEMPORARILY(current_allocation_phase, AllocationPhase::compile_bytecode);
+
+    VmProgram program{};
+
+    BytecodeCompiler compiler{program};
+    compiler.generate_entry(call);
+
+    if (options.superinstructions)
+    {
+        fuse_superinstructions(program);
+    }
+
+    return program;
+}
+
+VmProgram compile_to_bytecode(ModuleNode *module, const BytecodeCompilationOptions &options)
+{
+    SET_TEMPORARILY(current_allocation_phase, AllocationPhase::compile_bytecode);
+
+    VmProgram program{};
+
+    BytecodeCompiler compiler{program};
+    compiler.generate_module(module);
+
+    if (options.superinstructions)
+    {
+        fuse_superinstructions(program);
+    }
+
+    return program;
+}
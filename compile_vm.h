@@ -0,0 +1,109 @@
+#pragma once
+
+#include "op_code.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using VmRegister = uint16_t;
+
+struct VmProcedure
+{
+    std::string name{};
+    int64_t address{};
+    int64_t num_arguments{};  // In registers, including the result registers
+    int64_t num_results{};    // The registers in front of the arguments that receive a vector result
+    int64_t num_registers{};  // Including the arguments
+    int64_t frame_size{};     // The bytes of frame memory for the structs and arrays of the procedure
+    int64_t frame_alignment = 1;
+};
+
+// How a value is passed to or returned from an external procedure
+enum class VmValueKind : uint8_t
+{
+    none,
+    integer,  // Also pointers and booleans
+    f32,
+    f64,
+};
+
+// A call site of an external procedure. Every call site gets its own entry, because the argument types of
+// variadic procedures differ between the call sites.
+struct VmExternalCall
+{
+    std::string name{};
+    void *address{};
+    std::vector<VmValueKind> argument_kinds{};
+    VmValueKind return_kind{};
+};
+
+struct VmProgram
+{
+    std::vector<uint8_t> bytecode{};
+    std::vector<VmProcedure> procedures{};
+    std::vector<VmExternalCall> external_calls{};
+    std::string strings{};  // The string table: the string literals, each terminated by a zero byte (see LOADS)
+    int64_t main_procedure = -1;
+
+    // Set for programs that were mapped from a bytecode image. Their code and string table are used directly from the
+    // mapping instead of being copied into bytecode and strings.
+    std::shared_ptr<const struct BytecodeImage> image{};
+
+    std::span<const uint8_t> code() const;
+    std::string_view string_table() const;
+};
+
+struct BytecodeWriter
+{
+    std::vector<uint8_t> bytecode{};
+    size_t pos{};
+
+    void write_data(const void *data, size_t length);
+
+    template <typename T>
+    void write(T value)
+    {
+        this->write_data(&value, sizeof(value));
+    }
+
+    // The write_* procedures return the position of the instruction.
+    // The ones with a jump target operand return the position of the target operand for patching instead.
+    int64_t write_op(OpCode op);
+    int64_t write_a(OpCode op, VmRegister a);
+    int64_t write_d_a(OpCode op, VmRegister d, VmRegister a);
+    int64_t write_d_imm(OpCode op, VmRegister d, int64_t imm);
+    int64_t write_d_a_b(OpCode op, VmRegister d, VmRegister a, VmRegister b);
+    int64_t write_d_a_imm(OpCode op, VmRegister d, VmRegister a, int64_t imm);
+    int64_t write_d_a_bytes(OpCode op, VmRegister d, VmRegister a, uint8_t bytes);
+    int64_t write_target(OpCode op, int32_t target);
+    int64_t write_a_target(OpCode op, VmRegister a, int32_t target);
+    int64_t write_a_b_target(OpCode op, VmRegister a, VmRegister b, int32_t target);
+    int64_t write_a_imm_target(OpCode op, VmRegister a, int64_t imm, int32_t target);
+    int64_t write_index_a_d(OpCode op, uint32_t index, VmRegister a, VmRegister d);
+    void patch_target(int64_t target_position, int32_t target);
+};
+
+struct BytecodeCompilationOptions
+{
+    bool superinstructions = true;
+};
+
+// Replaces the op codes of adjacent instructions that form a superinstruction. The fused instructions stay in place,
+// so jumps to the second one still work.
+void fuse_superinstructions(VmProgram &program);
+
+// Compiles a typechecked module for the bytecode interpreter
+VmProgram compile_to_bytecode(struct ModuleNode *module, const BytecodeCompilationOptions &options = {});
+
+// The procedures with a body that the node calls, directly or through other procedures
+std::vector<struct DeclarationNode *> reachable_procedures(struct Node *node);
+
+// Compiles a call for running it at compile time (see #run). The program contains the procedures that the call reaches
+// and an entry procedure without arguments that makes the call and returns its result, which is the main procedure.
+// The arguments of the call must be literals.
+VmProgram compile_call_to_bytecode(struct ProcedureCallNode *call, const BytecodeCompilationOptions &options = {});
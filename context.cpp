@@ -1,10 +1,5 @@
 #include "context.h"
 
-void *operator new(size_t size, Context &context)
-{
-    return context.pool.allocate(size);
-}
-
 // TODO: Do some assertions for the Node* arguments (is statement, type, ...)
 
 BinaryOperatorNode *Context::make_binary_operator(TokenType operator_kind, Node *lhs, Node *rhs)
@@ -12,7 +7,7 @@ BinaryOperatorNode *Context::make_binary_operator(TokenType operator_kind, Node
     assert(lhs != nullptr);
     assert(rhs != nullptr);
 
-    auto result           = new (*this) BinaryOperatorNode{};
+    auto result           = this->allocate_node<BinaryOperatorNode>();
     result->operator_kind = operator_kind;
     result->lhs           = lhs;
     result->rhs           = rhs;
@@ -21,7 +16,7 @@ BinaryOperatorNode *Context::make_binary_operator(TokenType operator_kind, Node
 
 BlockNode *Context::make_block(BlockNode *parent_block, std::vector<Node *> statements)
 {
-    auto result          = new (*this) BlockNode{};
+    auto result          = this->allocate_node<BlockNode>();
     result->parent_block = parent_block;
     result->statements   = std::move(statements);
     return result;
@@ -46,7 +41,7 @@ DeclarationNode *Context::make_declaration(
         init_expression = this->make_nop();
     }
 
-    auto result                   = new (*this) DeclarationNode{};
+    auto result                   = this->allocate_node<DeclarationNode>();
     result->identifier            = identifier;
     result->specified_type        = specified_type;
     result->init_expression       = init_expression;
@@ -54,11 +49,22 @@ DeclarationNode *Context::make_declaration(
     return result;
 }
 
+GenericNode *Context::make_generic(std::vector<std::string_view> type_parameters, AstNode *definition)
+{
+    assert(type_parameters.empty() == false);
+    assert(definition != nullptr);
+
+    auto result             = this->allocate_node<GenericNode>();
+    result->type_parameters = std::move(type_parameters);
+    result->definition      = definition;
+    return result;
+}
+
 IdentifierNode *Context::make_identifier(std::string_view identifier)
 {
     assert(identifier.empty() == false);
 
-    auto result        = new (*this) IdentifierNode{};
+    auto result        = this->allocate_node<IdentifierNode>();
     result->identifier = identifier;
     return result;
 }
@@ -68,13 +74,46 @@ IfStatementNode *Context::make_if(Node *condition, BlockNode *then_block, BlockN
     assert(condition != nullptr);
     assert(then_block != nullptr);
 
-    auto result        = new (*this) IfStatementNode{};
+    auto result        = this->allocate_node<IfStatementNode>();
     result->condition  = condition;
     result->then_block = then_block;
     result->else_block = else_block;
     return result;
 }
 
+IndexNode *Context::make_index(Node *array, Node *index)
+{
+    assert(array != nullptr);
+    assert(index != nullptr);
+
+    auto result   = this->allocate_node<IndexNode>();
+    result->array = array;
+    result->index = index;
+    return result;
+}
+
+SliceNode *Context::make_slice(Node *object, Node *begin, Node *end)
+{
+    assert(object != nullptr);
+
+    auto result    = this->allocate_node<SliceNode>();
+    result->object = object;
+    result->begin  = begin;
+    result->end    = end;
+    return result;
+}
+
+MemberAccessNode *Context::make_member_access(Node *object, std::string_view member)
+{
+    assert(object != nullptr);
+    assert(member.empty() == false);
+
+    auto result    = this->allocate_node<MemberAccessNode>();
+    result->object = object;
+    result->member = member;
+    return result;
+}
+
 WhileLoopNode *Context::make_while(Node *condition, BlockNode *block, Node *prologue)
 {
     assert(condition != nullptr);
@@ -85,7 +124,7 @@ WhileLoopNode *Context::make_while(Node *condition, BlockNode *block, Node *prol
         prologue = this->make_nop();
     }
 
-    auto result       = new (*this) WhileLoopNode{};
+    auto result       = this->allocate_node<WhileLoopNode>();
     result->condition = condition;
     result->body      = block;
     result->prologue  = prologue;
@@ -94,13 +133,13 @@ WhileLoopNode *Context::make_while(Node *condition, BlockNode *block, Node *prol
 
 BreakStatementNode *Context::make_break()
 {
-    auto result = new (*this) BreakStatementNode{};
+    auto result = this->allocate_node<BreakStatementNode>();
     return result;
 }
 
 ContinueStatementNode *Context::make_continue()
 {
-    auto result = new (*this) ContinueStatementNode{};
+    auto result = this->allocate_node<ContinueStatementNode>();
     return result;
 }
 
@@ -110,7 +149,7 @@ LiteralNode *Context::make_literal(std::variant<bool, uint64_t, float, double, s
     assert(std::holds_alternative<float>(value) == false || suffix == 'f');
     assert(std::holds_alternative<double>(value) == false || suffix == '\0');
 
-    auto result    = new (*this) LiteralNode{};
+    auto result    = this->allocate_node<LiteralNode>();
     result->value  = value;
     result->suffix = suffix;
     return result;
@@ -118,21 +157,21 @@ LiteralNode *Context::make_literal(std::variant<bool, uint64_t, float, double, s
 
 LiteralNode *Context::make_bool_literal(bool value)
 {
-    auto result   = new (*this) LiteralNode{};
+    auto result   = this->allocate_node<LiteralNode>();
     result->value = value;
     return result;
 }
 
 LiteralNode *Context::make_sint_literal(uint64_t value)
 {
-    auto result   = new (*this) LiteralNode{};
+    auto result   = this->allocate_node<LiteralNode>();
     result->value = value;
     return result;
 }
 
 LiteralNode *Context::make_uint_literal(uint64_t value)
 {
-    auto result    = new (*this) LiteralNode{};
+    auto result    = this->allocate_node<LiteralNode>();
     result->value  = value;
     result->suffix = 'u';
     return result;
@@ -140,7 +179,7 @@ LiteralNode *Context::make_uint_literal(uint64_t value)
 
 LiteralNode *Context::make_float_literal(float value)
 {
-    auto result    = new (*this) LiteralNode{};
+    auto result    = this->allocate_node<LiteralNode>();
     result->value  = value;
     result->suffix = 'f';
     return result;
@@ -148,14 +187,14 @@ LiteralNode *Context::make_float_literal(float value)
 
 LiteralNode *Context::make_double_literal(double value)
 {
-    auto result   = new (*this) LiteralNode{};
+    auto result   = this->allocate_node<LiteralNode>();
     result->value = value;
     return result;
 }
 
 LiteralNode *Context::make_string_literal(std::string value)
 {
-    auto result   = new (*this) LiteralNode{};
+    auto result   = this->allocate_node<LiteralNode>();
     result->value = value;
     return result;
 }
@@ -164,14 +203,14 @@ ModuleNode *Context::make_module(BlockNode *block)
 {
     assert(block != nullptr);
 
-    auto result   = new (*this) ModuleNode{};
+    auto result   = this->allocate_node<ModuleNode>();
     result->block = block;
     return result;
 }
 
 ModuleNode *Context::make_module(std::vector<DeclarationNode *> declarations)
 {
-    auto result = new (*this) ModuleNode{};
+    auto result = this->allocate_node<ModuleNode>();
 
     std::vector<Node *> statements{};
     for (auto decl : declarations)
@@ -183,25 +222,31 @@ ModuleNode *Context::make_module(std::vector<DeclarationNode *> declarations)
     return result;
 }
 
-ProcedureNode *Context::make_procedure(ProcedureSignatureNode *signature, BlockNode *body, bool is_external)
+ProcedureNode *Context::make_procedure(
+    ProcedureSignatureNode *signature,
+    BlockNode *body,
+    bool is_external,
+    bool is_async)
 {
     assert(signature != nullptr);
     assert((body == nullptr) == is_external);
 
-    auto result         = new (*this) ProcedureNode{};
+    auto result         = this->allocate_node<ProcedureNode>();
     result->signature   = signature;
     result->body        = body;
     result->is_external = is_external;
+    result->is_async    = is_async;
     return result;
 }
 
-ProcedureCallNode *Context::make_procedure_call(Node *procedure, std::vector<Node *> arguments)
+ProcedureCallNode *Context::make_procedure_call(Node *procedure, std::vector<Node *> arguments, bool is_compile_time)
 {
     assert(procedure != nullptr);
 
-    auto result       = new (*this) ProcedureCallNode{};
-    result->procedure = procedure;
-    result->arguments = std::move(arguments);
+    auto result             = this->allocate_node<ProcedureCallNode>();
+    result->procedure       = procedure;
+    result->arguments       = std::move(arguments);
+    result->is_compile_time = is_compile_time;
     return result;
 }
 
@@ -212,7 +257,7 @@ ProcedureSignatureNode *Context::make_procedure_signature(
 {
     assert(return_type != nullptr);
 
-    auto result         = new (*this) ProcedureSignatureNode{};
+    auto result         = this->allocate_node<ProcedureSignatureNode>();
     result->arguments   = std::move(arguments);
     result->is_vararg   = is_vararg;
     result->return_type = return_type;
@@ -226,7 +271,7 @@ ReturnStatementNode *Context::make_return(Node *expression)
         expression = this->make_nop();
     }
 
-    auto result        = new (*this) ReturnStatementNode{};
+    auto result        = this->allocate_node<ReturnStatementNode>();
     result->expression = expression;
     return result;
 }
@@ -235,7 +280,7 @@ GotoStatementNode *Context::make_goto(std::string_view label_identifier)
 {
     assert(label_identifier.empty() == false);
 
-    auto result              = new (*this) GotoStatementNode{};
+    auto result              = this->allocate_node<GotoStatementNode>();
     result->label_identifier = label_identifier;
 
     return result;
@@ -245,7 +290,7 @@ LabelNode *Context::make_label(std::string_view identifier)
 {
     assert(identifier.empty() == false);
 
-    auto result        = new (*this) LabelNode{};
+    auto result        = this->allocate_node<LabelNode>();
     result->identifier = identifier;
 
     return result;
@@ -258,7 +303,7 @@ TypeCastNode *Context::make_type_cast(Node *target_type, Node *expression)
     assert(expression != nullptr);
     assert(expression->is_type() == false);
 
-    auto result         = new (*this) TypeCastNode{};
+    auto result         = this->allocate_node<TypeCastNode>();
     result->target_type = target_type;
     result->expression  = expression;
     return result;
@@ -266,27 +311,61 @@ TypeCastNode *Context::make_type_cast(Node *target_type, Node *expression)
 
 BasicTypeNode *Context::make_basic_type(BasicTypeNode::Kind kind, int64_t size)
 {
-    auto result = new (*this) BasicTypeNode{kind, size};
+    auto result = this->allocate_node<BasicTypeNode>(kind, size);
     return result;
 }
 
+// NOTE: The names of struct types are identifiers until the typechecker resolves them
 PointerTypeNode *Context::make_pointer_type(Node *target_type)
 {
     assert(target_type != nullptr);
-    assert(target_type->is_type());
+    assert(target_type->is_type() || target_type->kind == NodeKind::identifier);
 
-    auto result         = new (*this) PointerTypeNode{};
+    auto result         = this->allocate_node<PointerTypeNode>();
     result->target_type = target_type;
     return result;
 }
 
-ArrayTypeNode *Context::make_array_type(Node *length, Node *element_type)
+ArrayTypeNode *Context::make_array_type(Node *length, Node *element_type, bool is_soa)
 {
     assert(length != nullptr);
     assert(element_type != nullptr);
-    assert(element_type->is_type());
+    assert(element_type->is_type() || element_type->kind == NodeKind::identifier);
+
+    auto result          = this->allocate_node<ArrayTypeNode>();
+    result->length       = length;
+    result->element_type = element_type;
+    result->is_soa       = is_soa;
+    return result;
+}
+
+SliceTypeNode *Context::make_slice_type(Node *element_type)
+{
+    assert(element_type != nullptr);
+    assert(element_type->is_type() || element_type->kind == NodeKind::identifier);
+
+    auto result          = this->allocate_node<SliceTypeNode>();
+    result->element_type = element_type;
+    return result;
+}
+
+StructTypeNode *Context::make_struct_type(std::vector<StructField> fields, bool is_packed, int64_t alignment)
+{
+    assert(alignment >= 0);
+
+    auto result       = this->allocate_node<StructTypeNode>();
+    result->fields    = std::move(fields);
+    result->is_packed = is_packed;
+    result->alignment = alignment;
+    return result;
+}
+
+VectorTypeNode *Context::make_vector_type(int64_t length, BasicTypeNode *element_type)
+{
+    assert(length > 0);
+    assert(element_type != nullptr);
 
-    auto result          = new (*this) ArrayTypeNode{};
+    auto result          = this->allocate_node<VectorTypeNode>();
     result->length       = length;
     result->element_type = element_type;
     return result;
@@ -294,6 +373,6 @@ ArrayTypeNode *Context::make_array_type(Node *length, Node *element_type)
 
 NopNode *Context::make_nop()
 {
-    auto result = new (*this) NopNode{};
+    auto result = this->allocate_node<NopNode>();
     return result;
 }
@@ -3,11 +3,37 @@
 #include "memory_pool.h"
 #include "node.h"
 
+#include <array>
+
 struct Context
 {
-    constexpr static size_t pool_size = 8 * 1024 * 1024;
+    constexpr static size_t pool_chunk_size = 1024 * 1024;
+
+    // The syntax tree of parse and desugar and the nodes, which live as long as the context
+    MemoryPool pool{pool_chunk_size};
+
+    struct NodeStatistics
+    {
+        uint64_t num_nodes{};
+        uint64_t num_bytes{};
+    };
+
+    // The nodes allocated in the pool, indexed by NodeKind (see allocation_tracking.h)
+    std::array<NodeStatistics, num_node_kinds> node_statistics{};
+
+    // Whether indices and slice bounds that cannot be proven to be in bounds are checked at run time
+    // (--no-bounds-checks)
+    bool bounds_checks = true;
+
+    template<typename T, typename... Args>
+    T *allocate_node(Args &&...args)
+    {
+        auto &statistics = this->node_statistics[static_cast<size_t>(T::kind)];
+        ++statistics.num_nodes;
+        statistics.num_bytes += sizeof(T);
 
-    MemoryPool pool{pool_size};
+        return this->pool.make<T>(std::forward<Args>(args)...);
+    }
 
     BinaryOperatorNode *make_binary_operator(TokenType operator_kind, Node *lhs, Node *rhs);
     BlockNode *make_block(BlockNode *parent_block, std::vector<Node *> statements);
@@ -16,8 +42,12 @@ struct Context
         Node *specified_type,
         Node *init_expression,
         bool is_procedure_argument);
+    GenericNode *make_generic(std::vector<std::string_view> type_parameters, AstNode *definition);
     IdentifierNode *make_identifier(std::string_view identifier);
     IfStatementNode *make_if(Node *condition, BlockNode *then_block, BlockNode *else_block);
+    IndexNode *make_index(Node *array, Node *index);
+    SliceNode *make_slice(Node *object, Node *begin, Node *end);
+    MemberAccessNode *make_member_access(Node *object, std::string_view member);
     WhileLoopNode *make_while(Node *condition, BlockNode *block, Node *prologue);
     BreakStatementNode *make_break();
     ContinueStatementNode *make_continue();
@@ -30,8 +60,15 @@ struct Context
     LiteralNode *make_string_literal(std::string value);
     ModuleNode *make_module(BlockNode *block);
     ModuleNode *make_module(std::vector<DeclarationNode *> declarations);
-    ProcedureNode *make_procedure(ProcedureSignatureNode *signature, BlockNode *body, bool is_external);
-    ProcedureCallNode *make_procedure_call(Node *procedure, std::vector<Node *> arguments);
+    ProcedureNode *make_procedure(
+        ProcedureSignatureNode *signature,
+        BlockNode *body,
+        bool is_external,
+        bool is_async = false);
+    ProcedureCallNode *make_procedure_call(
+        Node *procedure,
+        std::vector<Node *> arguments,
+        bool is_compile_time = false);
     ProcedureSignatureNode *make_procedure_signature(
         std::vector<DeclarationNode *> arguments,
         bool is_vararg,
@@ -42,8 +79,10 @@ struct Context
     TypeCastNode *make_type_cast(Node *target_type, Node *expression);
     BasicTypeNode *make_basic_type(BasicTypeNode::Kind kind, int64_t size);
     PointerTypeNode *make_pointer_type(Node *target_type);
-    ArrayTypeNode *make_array_type(Node *length, Node *element_type); // StructTypeNode *make_struct_type();
+    ArrayTypeNode *make_array_type(Node *length, Node *element_type, bool is_soa = false);
+    SliceTypeNode *make_slice_type(Node *element_type);
+    StructTypeNode *make_struct_type(std::vector<StructField> fields, bool is_packed, int64_t alignment);
+    VectorTypeNode *make_vector_type(int64_t length, BasicTypeNode *element_type);
     NopNode *make_nop();
 };
 
-void *operator new(size_t size, Context &context);
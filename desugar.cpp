@@ -26,10 +26,12 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
                     <identifier> += <step>
                 }
             }
+
+            The while loop of a parallel for loop gets its options and runs its iterations concurrently
             */
             auto foa = static_cast<AstForLoop *>(ast);
 
-            auto decl        = new (pool) AstDeclaration{};
+            auto decl        = pool.make<AstDeclaration>();
             decl->identifier = foa->identifier;
 
             if (foa->range_begin != nullptr)
@@ -38,20 +40,20 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
             }
             else
             {
-                auto zero = new (pool) AstLiteral{};
+                auto zero = pool.make<AstLiteral>();
                 zero->value.emplace<uint64_t>(0);
                 decl->init_expression = zero;
             }
 
-            auto counter_identifier        = new (pool) AstIdentifier{};
+            auto counter_identifier        = pool.make<AstIdentifier>();
             counter_identifier->identifier = foa->identifier;
 
-            auto condition           = new (pool) AstBinaryOperator{};
+            auto condition           = pool.make<AstBinaryOperator>();
             condition->lhs           = counter_identifier;
             condition->operator_type = foa->comparison_operator;
             condition->rhs           = foa->range_end;
 
-            auto next_value = new (pool) AstBinaryOperator{};
+            auto next_value = pool.make<AstBinaryOperator>();
 
             switch (foa->comparison_operator)
             {
@@ -79,22 +81,23 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
             }
             else
             {
-                auto one = new (pool) AstLiteral{};
+                auto one = pool.make<AstLiteral>();
                 one->value.emplace<uint64_t>(1);
                 next_value->rhs = one;
             }
 
-            auto prologue           = new (pool) AstBinaryOperator{};
+            auto prologue           = pool.make<AstBinaryOperator>();
             prologue->operator_type = Tt::assign;
             prologue->lhs           = counter_identifier;
             prologue->rhs           = next_value;
 
-            auto whyle       = new (pool) AstWhileLoop{};
+            auto whyle       = pool.make<AstWhileLoop>();
             whyle->condition = condition;
             whyle->block     = foa->block;
             whyle->prologue  = prologue;
+            whyle->parallel  = foa->parallel;
 
-            auto block = new (pool) AstBlock{};
+            auto block = pool.make<AstBlock>();
             block->statements.push_back(decl);
             block->statements.push_back(whyle);
 
@@ -111,7 +114,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *array_type)
             {
-                return new (pool) AstArrayType{std::move(desugared)};
+                return pool.make<AstArrayType>(std::move(desugared));
             }
 
             return array_type;
@@ -127,7 +130,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *bin_op)
             {
-                return new (pool) AstBinaryOperator{std::move(desugared)};
+                return pool.make<AstBinaryOperator>(std::move(desugared));
             }
 
             return bin_op;
@@ -146,7 +149,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *block)
             {
-                return new (pool) AstBlock{std::move(desugared)};
+                return pool.make<AstBlock>(std::move(desugared));
             }
 
             return block;
@@ -172,7 +175,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *decl)
             {
-                return new (pool) AstDeclaration{std::move(desugared)};
+                return pool.make<AstDeclaration>(std::move(desugared));
             }
 
             return decl;
@@ -203,12 +206,28 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *yf)
             {
-                return new (pool) AstIfStatement{std::move(desugared)};
+                return pool.make<AstIfStatement>(std::move(desugared));
             }
 
             return yf;
         }
 
+        case AstKind::index:
+        {
+            auto index = static_cast<AstIndex *>(ast);
+
+            AstIndex desugared{*index};
+            desugared.array = desugar(pool, index->array);
+            desugared.index = desugar(pool, index->index);
+
+            if (desugared != *index)
+            {
+                return pool.make<AstIndex>(std::move(desugared));
+            }
+
+            return index;
+        }
+
         case AstKind::label:
         {
             return ast;
@@ -219,6 +238,21 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
             return ast;
         }
 
+        case AstKind::member_access:
+        {
+            auto member_access = static_cast<AstMemberAccess *>(ast);
+
+            AstMemberAccess desugared{*member_access};
+            desugared.object = desugar(pool, member_access->object);
+
+            if (desugared != *member_access)
+            {
+                return pool.make<AstMemberAccess>(std::move(desugared));
+            }
+
+            return member_access;
+        }
+
         case AstKind::module:
         {
             auto module = static_cast<AstModule *>(ast);
@@ -228,7 +262,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *module)
             {
-                return new (pool) AstModule{std::move(desugared)};
+                return pool.make<AstModule>(std::move(desugared));
             }
 
             return module;
@@ -243,7 +277,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *pointer_type)
             {
-                return new (pool) AstPointerType{std::move(desugared)};
+                return pool.make<AstPointerType>(std::move(desugared));
             }
 
             return pointer_type;
@@ -259,7 +293,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *proc)
             {
-                return new (pool) AstProcedure{std::move(desugared)};
+                return pool.make<AstProcedure>(std::move(desugared));
             }
 
             return proc;
@@ -279,7 +313,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *call)
             {
-                return new (pool) AstProcedureCall{std::move(desugared)};
+                return pool.make<AstProcedureCall>(std::move(desugared));
             }
 
             return call;
@@ -297,7 +331,7 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *signature)
             {
-                return new (pool) AstProcedureSignature{std::move(desugared)};
+                return pool.make<AstProcedureSignature>(std::move(desugared));
             }
 
             return signature;
@@ -312,12 +346,62 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
 
             if (desugared != *retyrn)
             {
-                return new (pool) AstReturnStatement{std::move(desugared)};
+                return pool.make<AstReturnStatement>(std::move(desugared));
             }
 
             return retyrn;
         }
 
+        case AstKind::slice:
+        {
+            auto slice = static_cast<AstSlice *>(ast);
+
+            AstSlice desugared{*slice};
+            desugared.object = desugar(pool, slice->object);
+            desugared.begin  = desugar(pool, slice->begin);
+            desugared.end    = desugar(pool, slice->end);
+
+            if (desugared != *slice)
+            {
+                return pool.make<AstSlice>(std::move(desugared));
+            }
+
+            return slice;
+        }
+
+        case AstKind::slice_type:
+        {
+            auto slice_type = static_cast<AstSliceType *>(ast);
+
+            AstSliceType desugared{*slice_type};
+            desugared.element_type = desugar(pool, slice_type->element_type);
+
+            if (desugared != *slice_type)
+            {
+                return pool.make<AstSliceType>(std::move(desugared));
+            }
+
+            return slice_type;
+        }
+
+        case AstKind::struct_type:
+        {
+            auto struct_type = static_cast<AstStructType *>(ast);
+
+            AstStructType desugared{*struct_type};
+            for (auto &field : desugared.fields)
+            {
+                field.type = desugar(pool, field.type);
+            }
+
+            if (desugared != *struct_type)
+            {
+                return pool.make<AstStructType>(std::move(desugared));
+            }
+
+            return struct_type;
+        }
+
         case AstKind::type_identifier:
         {
             return ast;
@@ -331,9 +415,20 @@ AstNode *desugar(MemoryPool &pool, AstNode *ast)
             desugared.condition = desugar(pool, whyle->condition);
             desugared.block     = ast_cast<AstBlock, true>(desugar(pool, whyle->block));
 
+            if (whyle->parallel != nullptr)
+            {
+                AstParallelOptions parallel{*whyle->parallel};
+                parallel.grain_size = desugar(pool, whyle->parallel->grain_size);
+
+                if (parallel != *whyle->parallel)
+                {
+                    desugared.parallel = pool.make<AstParallelOptions>(std::move(parallel));
+                }
+            }
+
             if (desugared != *whyle)
             {
-                return new (pool) AstWhileLoop{std::move(desugared)};
+                return pool.make<AstWhileLoop>(std::move(desugared));
             }
 
             return whyle;
@@ -0,0 +1,645 @@
+#include "evaluate.h"
+
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+
+int64_t normalize_integer(const BasicTypeNode *type, uint64_t value)
+{
+    if (type->size >= 8)
+    {
+        return static_cast<int64_t>(value);
+    }
+
+    auto bits = type->size * 8;
+    auto mask = (uint64_t{1} << bits) - 1;
+    value &= mask;
+
+    if (type->type_kind == BasicTypeNode::Kind::signed_integer && (value >> (bits - 1)) != 0)
+    {
+        value |= ~mask;
+    }
+
+    return static_cast<int64_t>(value);
+}
+
+// The basic type of a node that has been typechecked without errors
+static const BasicTypeNode *checked_basic_type(const Node *node)
+{
+    if (node->inferred_type() == nullptr || node->is_poisoned())
+    {
+        return nullptr;
+    }
+
+    return node_cast<BasicTypeNode>(node->inferred_type());
+}
+
+static bool is_integer(const BasicTypeNode *type)
+{
+    return type->type_kind == BasicTypeNode::Kind::signed_integer ||
+           type->type_kind == BasicTypeNode::Kind::unsigned_integer;
+}
+
+static std::optional<ConstantValue> evaluate_integer_operator(
+    Tt operator_kind,
+    const BasicTypeNode *type,
+    uint64_t lhs,
+    uint64_t rhs)
+{
+    auto is_signed = type->type_kind == BasicTypeNode::Kind::signed_integer;
+    auto bits      = static_cast<uint64_t>(type->size * 8);
+
+    auto result = [&](uint64_t value) -> ConstantValue
+    { return static_cast<uint64_t>(normalize_integer(type, value)); };
+
+    switch (operator_kind)
+    {
+        case Tt::asterisk: return result(lhs * rhs);
+        case Tt::plus:     return result(lhs + rhs);
+        case Tt::minus:    return result(lhs - rhs);
+        case Tt::bit_and:  return result(lhs & rhs);
+        case Tt::bit_or:   return result(lhs | rhs);
+        case Tt::bit_xor:  return result(lhs ^ rhs);
+
+        case Tt::slash:
+        case Tt::mod:
+        {
+            if (rhs == 0)
+            {
+                return std::nullopt;
+            }
+
+            if (is_signed == false)
+            {
+                return result(operator_kind == Tt::slash ? lhs / rhs : lhs % rhs);
+            }
+
+            // The smallest value divided by -1 overflows, which is undefined behavior in the generated code
+            auto smallest = normalize_integer(type, uint64_t{1} << (bits - 1));
+            if (static_cast<int64_t>(lhs) == smallest && static_cast<int64_t>(rhs) == -1)
+            {
+                return std::nullopt;
+            }
+
+            auto signed_lhs = static_cast<int64_t>(lhs);
+            auto signed_rhs = static_cast<int64_t>(rhs);
+            return result(static_cast<uint64_t>(operator_kind == Tt::slash ? signed_lhs / signed_rhs
+                                                                           : signed_lhs % signed_rhs));
+        }
+
+        case Tt::left_shift:
+        case Tt::right_shift:
+        {
+            // Shifting by the width of the type or more yields poison in LLVM
+            if (rhs >= bits)
+            {
+                return std::nullopt;
+            }
+
+            // NOTE: >> is a logical shift for signed integers as well
+            auto mask = bits == 64 ? ~uint64_t{} : (uint64_t{1} << bits) - 1;
+            return result(operator_kind == Tt::left_shift ? lhs << rhs : (lhs & mask) >> rhs);
+        }
+
+        case Tt::equal:   return lhs == rhs;
+        case Tt::inequal: return lhs != rhs;
+
+        case Tt::less_than:
+            return is_signed ? static_cast<int64_t>(lhs) < static_cast<int64_t>(rhs) : lhs < rhs;
+        case Tt::greater_than:
+            return is_signed ? static_cast<int64_t>(lhs) > static_cast<int64_t>(rhs) : lhs > rhs;
+        case Tt::less_than_or_equal:
+            return is_signed ? static_cast<int64_t>(lhs) <= static_cast<int64_t>(rhs) : lhs <= rhs;
+        case Tt::greater_than_or_equal:
+            return is_signed ? static_cast<int64_t>(lhs) >= static_cast<int64_t>(rhs) : lhs >= rhs;
+
+        default: return std::nullopt;
+    }
+}
+
+template<typename T>
+static std::optional<ConstantValue> evaluate_float_operator(Tt operator_kind, T lhs, T rhs)
+{
+    switch (operator_kind)
+    {
+        case Tt::asterisk: return lhs * rhs;
+        case Tt::slash:    return lhs / rhs;
+        case Tt::mod:      return static_cast<T>(std::fmod(lhs, rhs));
+        case Tt::plus:     return lhs + rhs;
+        case Tt::minus:    return lhs - rhs;
+
+        // NOTE: The comparisons are ordered, they are false if one of the operands is NaN
+        case Tt::equal:                 return lhs == rhs;
+        case Tt::inequal:               return lhs < rhs || lhs > rhs;
+        case Tt::less_than:             return lhs < rhs;
+        case Tt::greater_than:          return lhs > rhs;
+        case Tt::less_than_or_equal:    return lhs <= rhs;
+        case Tt::greater_than_or_equal: return lhs >= rhs;
+
+        default: return std::nullopt;
+    }
+}
+
+struct Evaluator
+{
+    static constexpr int64_t max_steps      = 100'000;
+    static constexpr int64_t max_call_depth = 64;
+
+    enum class Flow
+    {
+        next,
+        break_loop,
+        continue_loop,
+        return_from_procedure,
+        not_constant,
+    };
+
+    std::unordered_map<DeclarationNode *, ConstantValue> *variables{};  // Arguments and locals of the current call
+    const ProcedureSignatureNode *current_signature{};
+    std::optional<ConstantValue> return_value{};
+    int64_t num_steps{};
+    int64_t call_depth{};
+
+    bool step()
+    {
+        ++this->num_steps;
+        return this->num_steps <= max_steps;
+    }
+
+    std::optional<ConstantValue> evaluate(Node *expression)
+    {
+        auto type = checked_basic_type(expression);
+        if (type == nullptr || this->step() == false)
+        {
+            return std::nullopt;
+        }
+
+        switch (expression->kind)
+        {
+            case NodeKind::literal:
+            {
+                auto literal = static_cast<LiteralNode *>(expression);
+
+                if (auto value = std::get_if<uint64_t>(&literal->value); value != nullptr && is_integer(type))
+                {
+                    return static_cast<uint64_t>(normalize_integer(type, *value));
+                }
+
+                if (auto value = std::get_if<bool>(&literal->value))
+                {
+                    return *value;
+                }
+
+                if (auto value = std::get_if<float>(&literal->value))
+                {
+                    return *value;
+                }
+
+                if (auto value = std::get_if<double>(&literal->value))
+                {
+                    return *value;
+                }
+
+                return std::nullopt;
+            }
+
+            case NodeKind::identifier:
+            {
+                auto ident = static_cast<IdentifierNode *>(expression);
+                if (ident->declaration == nullptr)
+                {
+                    return std::nullopt;
+                }
+
+                if (this->variables != nullptr)
+                {
+                    if (auto it = this->variables->find(ident->declaration); it != this->variables->end())
+                    {
+                        return it->second;
+                    }
+                }
+
+                if (ident->declaration->is_constant)
+                {
+                    return this->evaluate(ident->declaration->init_expression);
+                }
+
+                return std::nullopt;
+            }
+
+            case NodeKind::binary_operator: return this->evaluate(static_cast<BinaryOperatorNode *>(expression));
+            case NodeKind::type_cast:       return this->evaluate(static_cast<TypeCastNode *>(expression));
+            case NodeKind::procedure_call:  return this->evaluate(static_cast<ProcedureCallNode *>(expression));
+
+            // The length of an array is part of its type
+            case NodeKind::member_access:
+            {
+                auto member_access = static_cast<MemberAccessNode *>(expression);
+                if (auto array = node_cast<ArrayTypeNode>(member_access->object->inferred_type()))
+                {
+                    return static_cast<uint64_t>(array_length(array));
+                }
+
+                return std::nullopt;
+            }
+
+            default: return std::nullopt;
+        }
+    }
+
+    std::optional<ConstantValue> evaluate(BinaryOperatorNode *bin_op)
+    {
+        if (bin_op->operator_kind == Tt::assign)
+        {
+            return std::nullopt;
+        }
+
+        auto lhs = this->evaluate(bin_op->lhs);
+        if (lhs.has_value() == false)
+        {
+            return std::nullopt;
+        }
+
+        if (bin_op->operator_kind == Tt::logical_and || bin_op->operator_kind == Tt::logical_or)
+        {
+            auto lhs_value = std::get_if<bool>(&lhs.value());
+            if (lhs_value == nullptr)
+            {
+                return std::nullopt;
+            }
+
+            // The right operand is only evaluated if it decides the result
+            if (*lhs_value == (bin_op->operator_kind == Tt::logical_or))
+            {
+                return *lhs_value;
+            }
+
+            auto rhs = this->evaluate(bin_op->rhs);
+            if (rhs.has_value() == false || std::holds_alternative<bool>(rhs.value()) == false)
+            {
+                return std::nullopt;
+            }
+
+            return rhs;
+        }
+
+        auto rhs = this->evaluate(bin_op->rhs);
+        if (rhs.has_value() == false)
+        {
+            return std::nullopt;
+        }
+
+        // The operands have the same type once the implicit casts are in place
+        auto type = checked_basic_type(bin_op->lhs);
+        if (Node::types_equal(type, bin_op->rhs->inferred_type()) == false)
+        {
+            return std::nullopt;
+        }
+
+        switch (type->type_kind)
+        {
+            case BasicTypeNode::Kind::boolean:
+            {
+                auto lhs_value = std::get<bool>(lhs.value());
+                auto rhs_value = std::get<bool>(rhs.value());
+
+                switch (bin_op->operator_kind)
+                {
+                    case Tt::equal:   return lhs_value == rhs_value;
+                    case Tt::inequal: return lhs_value != rhs_value;
+                    default:          return std::nullopt;
+                }
+            }
+
+            case BasicTypeNode::Kind::signed_integer:
+            case BasicTypeNode::Kind::unsigned_integer:
+            {
+                return evaluate_integer_operator(
+                    bin_op->operator_kind,
+                    type,
+                    std::get<uint64_t>(lhs.value()),
+                    std::get<uint64_t>(rhs.value()));
+            }
+
+            case BasicTypeNode::Kind::floatingpoint:
+            {
+                if (type->size == 4)
+                {
+                    return evaluate_float_operator(
+                        bin_op->operator_kind,
+                        std::get<float>(lhs.value()),
+                        std::get<float>(rhs.value()));
+                }
+
+                return evaluate_float_operator(
+                    bin_op->operator_kind,
+                    std::get<double>(lhs.value()),
+                    std::get<double>(rhs.value()));
+            }
+
+            default: return std::nullopt;
+        }
+    }
+
+    std::optional<ConstantValue> evaluate(TypeCastNode *cast)
+    {
+        auto src_type  = checked_basic_type(cast->expression);
+        auto dest_type = checked_basic_type(cast);
+        if (src_type == nullptr || dest_type == nullptr)
+        {
+            return std::nullopt;
+        }
+
+        auto value = this->evaluate(cast->expression);
+        if (value.has_value() == false)
+        {
+            return std::nullopt;
+        }
+
+        auto is_dest_f32 = dest_type->size == 4;
+
+        if (is_integer(src_type))
+        {
+            auto integer = std::get<uint64_t>(value.value());
+
+            if (is_integer(dest_type))
+            {
+                return static_cast<uint64_t>(normalize_integer(dest_type, integer));
+            }
+
+            if (dest_type->type_kind == BasicTypeNode::Kind::floatingpoint)
+            {
+                if (src_type->type_kind == BasicTypeNode::Kind::signed_integer)
+                {
+                    auto signed_integer = static_cast<int64_t>(integer);
+                    return is_dest_f32 ? ConstantValue{static_cast<float>(signed_integer)}
+                                       : ConstantValue{static_cast<double>(signed_integer)};
+                }
+
+                return is_dest_f32 ? ConstantValue{static_cast<float>(integer)}
+                                   : ConstantValue{static_cast<double>(integer)};
+            }
+
+            return std::nullopt;
+        }
+
+        // NOTE: Floating point values that do not fit into the integer type are undefined behavior when cast, so
+        // those casts are never folded
+        if (src_type->type_kind == BasicTypeNode::Kind::floatingpoint &&
+            dest_type->type_kind == BasicTypeNode::Kind::floatingpoint)
+        {
+            auto number = src_type->size == 4 ? static_cast<double>(std::get<float>(value.value()))
+                                              : std::get<double>(value.value());
+            return is_dest_f32 ? ConstantValue{static_cast<float>(number)} : ConstantValue{number};
+        }
+
+        return std::nullopt;
+    }
+
+    std::optional<ConstantValue> evaluate(ProcedureCallNode *call)
+    {
+        if (is_layout_query(call->intrinsic))
+        {
+            return static_cast<uint64_t>(evaluate_layout_query(call));
+        }
+
+        auto ident = node_cast<IdentifierNode>(call->procedure);
+        if (ident == nullptr || ident->declaration == nullptr || ident->declaration->is_global() == false)
+        {
+            return std::nullopt;
+        }
+
+        auto proc = node_cast<ProcedureNode>(ident->declaration->init_expression);
+        if (proc == nullptr || proc->is_external || proc->is_async || proc->inferred_type() == nullptr ||
+            proc->signature->is_vararg || call->arguments.size() != proc->signature->arguments.size() ||
+            this->call_depth >= max_call_depth)
+        {
+            return std::nullopt;
+        }
+
+        std::unordered_map<DeclarationNode *, ConstantValue> arguments{};
+        for (auto i = 0; i < call->arguments.size(); ++i)
+        {
+            auto argument_declaration = proc->signature->arguments[i];
+            auto argument_type        = argument_declaration->init_expression->inferred_type();
+            auto type                 = checked_basic_type(call->arguments[i]);
+            if (argument_type == nullptr || type == nullptr || Node::types_equal(type, argument_type) == false)
+            {
+                return std::nullopt;
+            }
+
+            auto value = this->evaluate(call->arguments[i]);
+            if (value.has_value() == false)
+            {
+                return std::nullopt;
+            }
+
+            arguments.emplace(argument_declaration, value.value());
+        }
+
+        ++this->call_depth;
+        defer
+        {
+            --this->call_depth;
+        };
+
+        SET_TEMPORARILY(this->variables, &arguments);
+        SET_TEMPORARILY(this->current_signature, proc->signature);
+
+        if (this->execute(proc->body) != Flow::return_from_procedure)
+        {
+            return std::nullopt;
+        }
+
+        return std::exchange(this->return_value, std::nullopt);
+    }
+
+    Flow execute(Node *statement)
+    {
+        if (statement->inferred_type() == nullptr || statement->is_poisoned() || this->step() == false)
+        {
+            return Flow::not_constant;
+        }
+
+        switch (statement->kind)
+        {
+            case NodeKind::block:
+            {
+                auto block = static_cast<BlockNode *>(statement);
+
+                // The statements of blocks that are expected to fail to compile are never run
+                if (block->expected_compiler_error_kind != BlockNode::CompilerErrorKind::none)
+                {
+                    return Flow::next;
+                }
+
+                for (auto nested_statement : block->statements)
+                {
+                    if (auto flow = this->execute(nested_statement); flow != Flow::next)
+                    {
+                        return flow;
+                    }
+                }
+
+                return Flow::next;
+            }
+
+            case NodeKind::declaration:
+            {
+                auto decl = static_cast<DeclarationNode *>(statement);
+
+                auto type = checked_basic_type(decl->init_expression);
+                if (type == nullptr ||
+                    (decl->specified_type->kind != NodeKind::nop &&
+                     Node::types_equal(decl->specified_type, type) == false))
+                {
+                    return Flow::not_constant;
+                }
+
+                if (decl->init_expression->kind == NodeKind::nop)
+                {
+                    // Declarations without an initialization expression are zero-initialized
+                    switch (type->type_kind)
+                    {
+                        case BasicTypeNode::Kind::boolean: this->variables->insert_or_assign(decl, false); break;
+                        case BasicTypeNode::Kind::signed_integer:
+                        case BasicTypeNode::Kind::unsigned_integer:
+                            this->variables->insert_or_assign(decl, uint64_t{});
+                            break;
+                        case BasicTypeNode::Kind::floatingpoint:
+                            this->variables->insert_or_assign(
+                                decl,
+                                type->size == 4 ? ConstantValue{0.0f} : ConstantValue{0.0});
+                            break;
+                        default: return Flow::not_constant;
+                    }
+
+                    return Flow::next;
+                }
+
+                auto value = this->evaluate(decl->init_expression);
+                if (value.has_value() == false)
+                {
+                    return Flow::not_constant;
+                }
+
+                this->variables->insert_or_assign(decl, value.value());
+
+                return Flow::next;
+            }
+
+            case NodeKind::binary_operator:
+            {
+                auto bin_op = static_cast<BinaryOperatorNode *>(statement);
+                if (bin_op->operator_kind != Tt::assign)
+                {
+                    return this->evaluate(bin_op).has_value() ? Flow::next : Flow::not_constant;
+                }
+
+                // Only the arguments and locals of the procedure can be assigned to
+                auto ident = node_cast<IdentifierNode>(bin_op->lhs);
+                if (ident == nullptr || this->variables->contains(ident->declaration) == false ||
+                    Node::types_equal(bin_op->lhs->inferred_type(), bin_op->rhs->inferred_type()) == false)
+                {
+                    return Flow::not_constant;
+                }
+
+                auto value = this->evaluate(bin_op->rhs);
+                if (value.has_value() == false)
+                {
+                    return Flow::not_constant;
+                }
+
+                this->variables->insert_or_assign(ident->declaration, value.value());
+
+                return Flow::next;
+            }
+
+            case NodeKind::if_statement:
+            {
+                auto yf = static_cast<IfStatementNode *>(statement);
+
+                auto condition = this->evaluate(yf->condition);
+                if (condition.has_value() == false || std::holds_alternative<bool>(condition.value()) == false)
+                {
+                    return Flow::not_constant;
+                }
+
+                if (std::get<bool>(condition.value()))
+                {
+                    return this->execute(yf->then_block);
+                }
+
+                return yf->else_block != nullptr ? this->execute(yf->else_block) : Flow::next;
+            }
+
+            case NodeKind::while_loop:
+            {
+                auto whyle = static_cast<WhileLoopNode *>(statement);
+
+                while (true)
+                {
+                    auto condition = this->evaluate(whyle->condition);
+                    if (condition.has_value() == false || std::holds_alternative<bool>(condition.value()) == false)
+                    {
+                        return Flow::not_constant;
+                    }
+
+                    if (std::get<bool>(condition.value()) == false)
+                    {
+                        return Flow::next;
+                    }
+
+                    auto flow = this->execute(whyle->body);
+                    if (flow == Flow::break_loop)
+                    {
+                        return Flow::next;
+                    }
+
+                    if (flow == Flow::return_from_procedure || flow == Flow::not_constant)
+                    {
+                        return flow;
+                    }
+
+                    if (auto prologue_flow = this->execute(whyle->prologue); prologue_flow != Flow::next)
+                    {
+                        return Flow::not_constant;
+                    }
+                }
+            }
+
+            case NodeKind::return_statement:
+            {
+                auto retyrn = static_cast<ReturnStatementNode *>(statement);
+
+                // Void procedures have no value
+                auto type = checked_basic_type(retyrn->expression);
+                if (type == nullptr || Node::types_equal(type, this->current_signature->return_type) == false)
+                {
+                    return Flow::not_constant;
+                }
+
+                this->return_value = this->evaluate(retyrn->expression);
+                if (this->return_value.has_value() == false)
+                {
+                    return Flow::not_constant;
+                }
+
+                return Flow::return_from_procedure;
+            }
+
+            case NodeKind::break_statement:    return Flow::break_loop;
+            case NodeKind::continue_statement: return Flow::continue_loop;
+            case NodeKind::nop:                return Flow::next;
+
+            // NOTE: Calls of void procedures, local procedures, goto and labels
+            default: return Flow::not_constant;
+        }
+    }
+};
+
+std::optional<ConstantValue> evaluate_constant(Node *expression)
+{
+    Evaluator evaluator{};
+    return evaluator.evaluate(expression);
+}
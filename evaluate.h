@@ -0,0 +1,29 @@
+#pragma once
+
+#include "node.h"
+
+#include <cstdint>
+#include <optional>
+#include <variant>
+
+// Evaluates typed expressions at compile time, with the semantics of the generated code.
+//
+// Integers are represented with 64 bits, sign extended for signed types and zero extended for unsigned types (like
+// the registers of the VM). f32 values are computed in single precision.
+//
+// Literals, the arithmetic, bitwise, comparison and short circuit operators, the type casts between numerical types
+// (except for floating point to integer casts), the identifiers of constant declarations, the layout queries
+// (sizeof, alignof and offsetof) and the lengths of arrays are evaluated directly.
+// Calls to procedures are evaluated by interpreting the body of the procedure, as long as it is pure: it only uses its
+// arguments, locals and constant declarations and only calls pure procedures. Operations that trap or are undefined
+// at run time (division by zero, shifting by the width of the type or more) are not constant.
+//
+// The evaluation of an expression is limited to a number of steps, a procedure that runs for too long is not evaluated
+// and runs at run time instead.
+
+using ConstantValue = std::variant<bool, uint64_t, float, double>;
+
+std::optional<ConstantValue> evaluate_constant(Node *expression);
+
+// Truncates the value to the size of the integer type and extends it to 64 bits again according to the signedness
+int64_t normalize_integer(const BasicTypeNode *type, uint64_t value);
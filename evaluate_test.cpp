@@ -0,0 +1,120 @@
+#include "context.h"
+#include "frontend.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+static const auto source = R"(
+factorial := proc(n: i64) i64
+{
+    result := 1
+    while n > 1 {
+        result = result * n
+        n = n - 1
+    }
+
+    return result
+}
+
+count := proc(n: i64) i64
+{
+    i := 0
+    while i < n {
+        i = i + 1
+    }
+
+    return i
+}
+
+main := proc() void
+{
+    sum := 2 + 3 * 4
+    small: i8 = 3 - 5
+    half := 1f / 2f
+    condition := 1 < 2 && 2.5 > 2f
+    call := factorial(5)
+    long_call := count(1000000)
+    zero := 0
+    division := 1 / zero
+    elements: [sum * 2]u8
+}
+)"sv;
+
+TEST_CASE("Constant expressions are folded while typechecking", "[evaluate]")
+{
+    Context ctx{};
+    auto module_node = analyze_source(ctx, source);
+    REQUIRE(module_node != nullptr);
+
+    auto main = node_cast<ProcedureNode, true>(module_node->block->find_declaration("main")->init_expression);
+
+    auto init_expression = [&](std::string_view identifier)
+    { return main->body->find_declaration(identifier, false)->init_expression; };
+
+    auto literal_value = [&](std::string_view identifier)
+    {
+        auto literal = node_cast<LiteralNode>(init_expression(identifier));
+        REQUIRE(literal != nullptr);
+        return literal->value;
+    };
+
+    CHECK(std::get<uint64_t>(literal_value("sum")) == 14);
+    CHECK(std::get<uint64_t>(literal_value("small")) == 0xfe);  // Truncated to the size of the type
+    CHECK(Node::types_equal(init_expression("small")->inferred_type(), &BuiltinTypes::i8));
+    CHECK(std::get<float>(literal_value("half")) == 0.5f);
+    CHECK(std::get<bool>(literal_value("condition")) == true);
+    CHECK(std::get<uint64_t>(literal_value("call")) == 120);
+
+    // Too many steps and division by zero are left to run time
+    CHECK(init_expression("long_call")->kind == NodeKind::procedure_call);
+    CHECK(init_expression("division")->kind == NodeKind::binary_operator);
+
+    auto elements = main->body->find_declaration("elements", false);
+    auto array    = node_cast<ArrayTypeNode, true>(elements->specified_type);
+    auto length   = node_cast<LiteralNode>(array->length);
+    REQUIRE(length != nullptr);
+    CHECK(std::get<uint64_t>(length->value) == 28);
+}
+
+TEST_CASE("Array lengths must be constant", "[evaluate]")
+{
+    Context ctx{};
+    CHECK(analyze_source(ctx, "main := proc() void { a := 1 a = 2 elements: [a]u8 }"sv) == nullptr);
+    CHECK(analyze_source(ctx, "main := proc() void { elements: [0 - 1]u8 }"sv) == nullptr);
+    CHECK(analyze_source(ctx, "main := proc() void { elements: [2.5]u8 }"sv) == nullptr);
+}
+
+TEST_CASE("Calls with #run are replaced with their result", "[evaluate]")
+{
+    Context ctx{};
+    auto module_node = analyze_source(ctx, R"(
+count := proc(n: i64) i64
+{
+    i := 0
+    while i < n {
+        i = i + 1
+    }
+
+    return i
+}
+
+nothing := proc() void
+{
+}
+
+main := proc() void
+{
+    value := #run count(1000000)
+    #run nothing()
+}
+)"sv);
+    REQUIRE(module_node != nullptr);
+
+    auto main  = node_cast<ProcedureNode, true>(module_node->block->find_declaration("main")->init_expression);
+    auto value = node_cast<LiteralNode>(main->body->find_declaration("value", false)->init_expression);
+    REQUIRE(value != nullptr);
+    CHECK(std::get<uint64_t>(value->value) == 1000000);
+    CHECK(main->body->statements[1]->kind == NodeKind::nop);
+
+    auto non_constant_argument = "f := proc(x: i64) i64 { return x } main := proc() void { a := 1 a = 2 b := #run f(a) }"sv;
+    CHECK(analyze_source(ctx, non_constant_argument) == nullptr);
+}
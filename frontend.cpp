@@ -0,0 +1,63 @@
+#include "frontend.h"
+
+#include "allocation_tracking.h"
+#include "desugar.h"
+#include "parse.h"
+#include "typecheck.h"
+
+ModuleNode *analyze_source(Context &ctx, std::string_view source)
+{
+    AstModule *module{};
+    {
+        SET_TEMPORARILY(current_allocation_phase, AllocationPhase::parse);
+        module = parse_module(source, ctx.pool);
+    }
+
+    if (module == nullptr)
+    {
+        std::cout << "Parsing failed" << std::endl;
+        return nullptr;
+    }
+
+    {
+        SET_TEMPORARILY(current_allocation_phase, AllocationPhase::desugar);
+        module = ast_cast<AstModule, true>(desugar(ctx.pool, module));
+    }
+
+    ModuleNode *module_node{};
+    {
+        SET_TEMPORARILY(current_allocation_phase, AllocationPhase::convert);
+        NodeConverter node_converter{ctx};
+        module_node = node_cast<ModuleNode>(node_converter.make_node(module));
+    }
+
+    SET_TEMPORARILY(current_allocation_phase, AllocationPhase::typecheck);
+
+    DeclarationRegistrar registrar{ctx};
+    registrar.register_declarations(module_node);
+    if (registrar.has_error())
+    {
+        std::cout << "Semantic analysis failed:" << std::endl;  // TODO
+        for (const auto &error : registrar.errors)
+        {
+            std::cout << error << std::endl;
+        }
+
+        return nullptr;
+    }
+
+    TypeChecker type_checker{ctx};
+    type_checker.typecheck(module_node);
+    if (type_checker.errors.empty() == false)
+    {
+        std::cout << "Typechecking failed:" << std::endl;
+        for (const auto &error : type_checker.errors)
+        {
+            std::cout << error << std::endl;
+        }
+
+        return nullptr;
+    }
+
+    return module_node;
+}
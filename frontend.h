@@ -0,0 +1,9 @@
+#pragma once
+
+#include "context.h"
+
+#include <string_view>
+
+// Runs all compiler passes up to (and including) typechecking.
+// Returns nullptr and prints the errors if any of the passes fails.
+ModuleNode *analyze_source(Context &ctx, std::string_view source);
@@ -1,37 +1,74 @@
 #include "compile_ir.h"
-#include "desugar.h"
+#include "compile_vm.h"
+#include "frontend.h"
 #include "integration_tests_interop.h"
 #include "jit.h"
 #include "lex.h"
-#include "parse.h"
+#include "mixed_program.h"
+#include "runtime.h"
 #include "string_util.h"
-#include "typecheck.h"
+#include "vm.h"
 
+#include <algorithm>
+#include <atomic>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
+#include <chrono>
 #include <filesystem>
 #include <llvm/IR/Module.h>
+#include <mutex>
+#include <thread>
 
 // TODO: Implement some way of converting the program to a C program and compare the output
 
 namespace fs = std::filesystem;
 
-static std::string current_test_output{};
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// What a test program did when it ran on one of the backends
+struct TestRun
+{
+    std::string output{};
+    std::vector<std::string> failures{};
+    double compile_ms{};  // Including parsing and type checking
+    double run_ms{};
+};
+
+// The test programs run concurrently. test_output() and test_fail() are recorded in the run that is the thread context
+// of the calling thread (see thread_context), which the threads that a program starts inherit. They may call from
+// several threads at once, so the runs are only changed with the sink mutex held.
+static std::mutex sink_mutex{};
+// The events of threads without a run, which cannot be attributed to a test
+static std::vector<std::string> unattributed_events{};
 
 static int _init = []
 {
     register_integration_tests_sink(
         [](TestEvent event)
         {
+            std::lock_guard lock{sink_mutex};
+
+            auto run = static_cast<TestRun *>(thread_context());
+            if (run == nullptr)
+            {
+                unattributed_events.push_back("test_output or test_fail called on a thread that no test started");
+                return;
+            }
+
             if (std::holds_alternative<FailureTestEvent>(event))
             {
                 auto failure = std::get<FailureTestEvent>(event);
-                std::cout << "test_fail called: " << failure.message << std::endl;
-                REQUIRE(false);
+                run->failures.push_back(std::format("test_fail called: {}", failure.message));
             }
             else if (std::holds_alternative<OutputTestEvent>(event))
             {
                 auto output = std::get<OutputTestEvent>(event);
-                current_test_output += output.output;
+                run->output += output.output;
             }
             else
             {
@@ -41,8 +78,9 @@ static int _init = []
     return 1;
 }();
 
-TEST_CASE("Integration tests", "[integration]")
+static std::vector<fs::path> integration_test_paths()
 {
+    std::vector<fs::path> paths{};
     for (auto it = fs::directory_iterator{"../integration-tests"}; it != fs::directory_iterator{}; ++it)
     {
         if (it->is_regular_file() == false)
@@ -55,95 +93,253 @@ TEST_CASE("Integration tests", "[integration]")
             continue;
         }
 
-        // if (it->path().string().ends_with("000-basics.fsl") == false)
-        // {
-        //     continue;
-        // }
+        paths.push_back(it->path());
+    }
 
-        SECTION(it->path().string())
-        {
-            defer
-            {
-                current_test_output.clear();
-            };
+    std::sort(paths.begin(), paths.end());
 
-            auto source = read_file_as_string(it->path().string());
-            REQUIRE(source.has_value());
+    return paths;
+}
 
-            Lexer lexer{source.value()};
-            auto token = lexer.next_token();
-            REQUIRE(token.type == Tt::multi_line_comment);
+static std::string required_output_of(std::string_view source)
+{
+    Lexer lexer{source};
+    auto token = lexer.next_token();
+    REQUIRE(token.type == Tt::multi_line_comment);
 
-            auto comment = token.text();
+    auto comment = token.text();
 
-            auto marker = "OUTPUT:\n"sv;
-            auto begin  = comment.find(marker);
-            REQUIRE(begin != std::string_view::npos);
+    auto marker = "OUTPUT:\n"sv;
+    auto begin  = comment.find(marker);
+    REQUIRE(begin != std::string_view::npos);
 
-            begin += marker.length();
+    begin += marker.length();
 
-            auto end = comment.rfind("*/");
-            REQUIRE(end != std::string_view::npos);
+    auto end = comment.rfind("*/");
+    REQUIRE(end != std::string_view::npos);
 
-            auto required_output = comment.substr(begin, end - begin);
+    return std::string{comment.substr(begin, end - begin)};
+}
 
-            Context ctx{};
+struct IntegrationTest
+{
+    fs::path path{};
+    std::string source{};
+    std::string required_output{};
 
-            auto module = parse_module(source.value());
-            if (module == nullptr)
-            {
-                std::cout << "Parsing failed" << std::endl;
-                REQUIRE(false);
-            }
+    TestRun jit{};
+    TestRun interpreter{};
+    TestRun mixed{};
+};
 
-            module = ast_cast<AstModule, true>(desugar(ctx.pool, module));
+// NOTE: Nothing in here may use the Catch2 assertion macros because they are not thread-safe.
+// Every backend gets its own AST because compiling annotates the nodes.
+template<typename Compile, typename Run>
+static TestRun run_test(const IntegrationTest &test, Compile compile, Run run)
+{
+    TestRun result{};
+    set_thread_context(&result);
+    defer
+    {
+        set_thread_context(nullptr);
+    };
 
-            NodeConverter node_converter{ctx};
-            auto module_node = node_cast<ModuleNode>(node_converter.make_node(module));
+    auto start = Clock::now();
 
-            DeclarationRegistrar registrar{ctx};
-            registrar.register_declarations(module_node);
-            if (registrar.has_error())
-            {
-                std::cout << "Semantic analysis failed:" << std::endl;  // TODO
-                for (const auto &error : registrar.errors)
-                {
-                    std::cout << error << std::endl;
-                }
+    Context ctx{};
+    auto module_node = analyze_source(ctx, test.source);
+    if (module_node == nullptr)
+    {
+        result.failures.push_back("Analysis failed");
+        return result;
+    }
 
-                REQUIRE(false);
-            }
+    // Every backend aborts the process on a program without a main procedure, which would end all tests
+    if (module_node->block->declarations.contains("main") == false)
+    {
+        result.failures.push_back(std::format("{} has no main procedure", test.path.string()));
+        return result;
+    }
 
-            TypeChecker type_checker{ctx};
-            type_checker.typecheck(module_node);
-            if (type_checker.errors.empty() == false)
-            {
-                std::cout << "Typechecking failed:" << std::endl;
-                for (const auto &error : type_checker.errors)
-                {
-                    std::cout << error << std::endl;
-                }
+    auto program      = compile(module_node);
+    result.compile_ms = milliseconds_since(start);
 
-                REQUIRE(false);
-            }
+    start = Clock::now();
+    run(program, result);
+    result.run_ms = milliseconds_since(start);
+
+    return result;
+}
 
-            auto compilation_result = compile_to_ir(module_node);
+// Every test program is added to its own library of the shared JIT session and removed again after it ran
+static TestRun run_with_jit(Jit &jit, const IntegrationTest &test)
+{
+    Jit::Library *library{};
+    defer
+    {
+        if (library != nullptr)
+        {
+            jit.remove_library(library);
+        }
+    };
+
+    return run_test(
+        test,
+        [&](ModuleNode *module_node)
+        {
+            auto compilation_result = compile_to_ir(module_node, IrCompilationOptions{.internalize = true});
             // compilation_result.module->print(llvm::outs(), nullptr);
 
-            Jit jit{};
-            jit.add_module(std::move(compilation_result.context), std::move(compilation_result.module));
-            auto main_address = jit.get_symbol_address("main");
-            auto main         = reinterpret_cast<void (*)()>(main_address);
-            REQUIRE(main != nullptr);
+            library = jit.create_library(test.path.string());
+            jit.add_module(library, std::move(compilation_result.context), std::move(compilation_result.module));
+
+            return reinterpret_cast<void (*)()>(jit.find_symbol_address(library, "main"));
+        },
+        [&](auto main, TestRun &result)
+        {
+            if (main == nullptr)
+            {
+                result.failures.push_back(std::format("{} has no main procedure", test.path.string()));
+                return;
+            }
 
             main();
+        });
+}
+
+static TestRun run_with_interpreter(const IntegrationTest &test)
+{
+    return run_test(
+        test,
+        [](ModuleNode *module_node) { return compile_to_bytecode(module_node); },
+        [](VmProgram &program, TestRun &)
+        {
+            Vm vm{};
+            run_main(&vm, &program);
+        });
+}
+
+// Every procedure is compiled on its first call, so all calls between interpreted and compiled procedures are taken.
+// The procedures are compiled while the program runs, so all of the time is run time.
+static TestRun run_mixed(Jit &jit, const IntegrationTest &test)
+{
+    return run_test(
+        test,
+        [](ModuleNode *module_node) { return module_node; },
+        [&](ModuleNode *module_node, TestRun &)
+        {
+            MixedProgram program{jit, module_node, MixedProgramOptions{.hot_threshold = 1, .background = false}};
+            program.run_main();
+        });
+}
+
+static std::vector<IntegrationTest> load_integration_tests()
+{
+    std::vector<IntegrationTest> tests{};
+    for (const auto &path : integration_test_paths())
+    {
+        auto source = read_file_as_string(path.string());
+        REQUIRE(source.has_value());
+
+        auto required_output = required_output_of(source.value());
+
+        tests.push_back(IntegrationTest{
+            .path            = path,
+            .source          = std::move(source.value()),
+            .required_output = std::move(required_output),
+        });
+    }
+
+    return tests;
+}
+
+// The test programs are compiled and run on a pool of threads that share one JIT session
+TEST_CASE("Integration tests", "[integration]")
+{
+    auto tests = load_integration_tests();
+    REQUIRE(tests.empty() == false);
+
+    Jit jit{};
+
+    std::atomic<size_t> next_test{};
+    auto worker = [&]
+    {
+        for (auto i = next_test++; i < tests.size(); i = next_test++)
+        {
+            auto &test       = tests[i];
+            test.jit         = run_with_jit(jit, test);
+            test.interpreter = run_with_interpreter(test);
+            test.mixed       = run_mixed(jit, test);
+        }
+    };
+
+    auto num_workers = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, tests.size());
+
+    std::vector<std::thread> workers{};
+    for (size_t i = 0; i < num_workers; ++i)
+    {
+        workers.emplace_back(worker);
+    }
 
-            // std::cout << "============================" << std::endl;
-            // std::cout << "Got test output: " << std::endl;
-            // std::cout << current_test_output << std::endl;
-            // std::cout << "============================" << std::endl;
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+
+    CHECK(unattributed_events == std::vector<std::string>{});
+
+    std::cout << std::format(
+                     "{:<40} {:>14} {:>10} {:>14} {:>10} {:>10}",
+                     "Test (ms)",
+                     "JIT compile",
+                     "JIT run",
+                     "VM compile",
+                     "VM run",
+                     "Mixed")
+              << std::endl;
+
+    for (const auto &test : tests)
+    {
+        std::cout << std::format(
+                         "{:<40} {:>14.2f} {:>10.2f} {:>14.2f} {:>10.2f} {:>10.2f}",
+                         test.path.filename().string(),
+                         test.jit.compile_ms,
+                         test.jit.run_ms,
+                         test.interpreter.compile_ms,
+                         test.interpreter.run_ms,
+                         test.mixed.compile_ms + test.mixed.run_ms)
+                  << std::endl;
 
-            REQUIRE(current_test_output == required_output);
+        for (auto [backend, run] : {
+                 std::pair{"JIT", &test.jit},
+                 std::pair{"Interpreter", &test.interpreter},
+                 std::pair{"Mixed", &test.mixed},
+             })
+        {
+            INFO(std::format("{} ({})", test.path.string(), backend));
+
+            CHECK(run->failures == std::vector<std::string>{});
+            CHECK(run->output == test.required_output);
         }
     }
 }
+
+// Measures the end-to-end latency (analysis, compilation and execution) of the integration test programs with both
+// backends. Hidden by default, run with: tests "[benchmark]"
+TEST_CASE("Integration tests JIT vs. interpreter", "[.][benchmark]")
+{
+    Jit jit{};
+
+    for (const auto &test : load_integration_tests())
+    {
+        BENCHMARK(std::format("{} (JIT)", test.path.filename().string()))
+        {
+            return run_with_jit(jit, test);
+        };
+
+        BENCHMARK(std::format("{} (interpreter)", test.path.filename().string()))
+        {
+            return run_with_interpreter(test);
+        };
+    }
+}
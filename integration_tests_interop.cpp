@@ -1,8 +1,10 @@
 #include "integration_tests_interop.h"
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 #include <functional>
+#include <string>
 
 static std::vector<std::function<void(TestEvent)>> sinks{};
 
@@ -18,18 +20,22 @@ extern "C"
 
     void test_output(const char *format, ...)
     {
-        // TODO: Dynamic buffer size
-        constexpr size_t buffer_size = 8 * 1024 * 1024;
-        static const auto buffer     = new char[buffer_size];
-
         va_list va_args;
         va_start(va_args, format);
-        vsnprintf(buffer, buffer_size, format, va_args);
+
+        // The first pass only measures the output
+        va_list measure_args;
+        va_copy(measure_args, va_args);
+        auto length = vsnprintf(nullptr, 0, format, measure_args);
+        va_end(measure_args);
+
+        std::string output(static_cast<size_t>(std::max(length, 0)), '\0');
+        vsnprintf(output.data(), output.size() + 1, format, va_args);
         va_end(va_args);
 
         for (const auto &sink : sinks)
         {
-            sink(OutputTestEvent{buffer});
+            sink(OutputTestEvent{output});
         }
     }
 }
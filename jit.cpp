@@ -1,7 +1,10 @@
 #include "jit.h"
 
+#include "allocation_tracking.h"
 #include "basics.h"
+#include "runtime.h"
 
+#include <array>
 #include <iostream>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
@@ -9,6 +12,7 @@
 #include <llvm/ExecutionEngine/Orc/Core.h>
 #include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
 #include <llvm/ExecutionEngine/Orc/IRCompileLayer.h>
+#include <llvm/ExecutionEngine/Orc/IRTransformLayer.h>
 #include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
 #include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
@@ -16,6 +20,10 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/NoFolder.h>
 #include <llvm/IR/Value.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Target/TargetMachine.h>
+#include <mutex>
+#include <unordered_map>
 
 using namespace llvm;
 using namespace llvm::orc;
@@ -29,18 +37,154 @@ static int _initted = []
     return 1;
 }();
 
+// Like ConcurrentIRCompiler, but instead of creating a new target machine for every module that is
+// compiled, target machines are kept in a pool and reused. Creating a target machine is one of the
+// more expensive parts of compiling a small module.
+struct PooledTargetMachineCompiler : IRCompileLayer::IRCompiler
+{
+    JITTargetMachineBuilder target_machine_builder;
+    std::mutex mutex{};
+    std::vector<std::unique_ptr<TargetMachine>> idle_target_machines{};
+
+    explicit PooledTargetMachineCompiler(JITTargetMachineBuilder target_machine_builder)
+        : IRCompiler(irManglingOptionsFromTargetOptions(target_machine_builder.getOptions()))
+        , target_machine_builder{std::move(target_machine_builder)}
+    {
+    }
+
+    Expected<std::unique_ptr<MemoryBuffer>> operator()(Module &module) override
+    {
+        std::unique_ptr<TargetMachine> target_machine{};
+
+        {
+            std::lock_guard lock{this->mutex};
+            if (this->idle_target_machines.empty() == false)
+            {
+                target_machine = std::move(this->idle_target_machines.back());
+                this->idle_target_machines.pop_back();
+            }
+        }
+
+        if (target_machine == nullptr)
+        {
+            auto created = this->target_machine_builder.createTargetMachine();
+            if (!created)
+            {
+                return created.takeError();
+            }
+
+            target_machine = std::move(*created);
+        }
+
+        SET_TEMPORARILY(current_allocation_phase, AllocationPhase::codegen);
+
+        SimpleCompiler compiler{*target_machine};
+        auto result = compiler(module);
+
+        std::lock_guard lock{this->mutex};
+        this->idle_target_machines.push_back(std::move(target_machine));
+
+        return result;
+    }
+};
+
+// Runs the module pipeline that build creates with the pass builder on the module
+template<typename BuildPipeline>
+static void run_pipeline(Module &module, BuildPipeline build)
+{
+    LoopAnalysisManager loop_analysis_manager{};
+    FunctionAnalysisManager function_analysis_manager{};
+    CGSCCAnalysisManager cgscc_analysis_manager{};
+    ModuleAnalysisManager module_analysis_manager{};
+
+    PassBuilder pass_builder{};
+    pass_builder.registerModuleAnalyses(module_analysis_manager);
+    pass_builder.registerCGSCCAnalyses(cgscc_analysis_manager);
+    pass_builder.registerFunctionAnalyses(function_analysis_manager);
+    pass_builder.registerLoopAnalyses(loop_analysis_manager);
+    pass_builder.crossRegisterProxies(
+        loop_analysis_manager,
+        function_analysis_manager,
+        cgscc_analysis_manager,
+        module_analysis_manager);
+
+    auto module_pass_manager = build(pass_builder);
+    module_pass_manager.run(module, module_analysis_manager);
+}
+
+void optimize_module(Module &module, int optimization_level)
+{
+    assert(optimization_level >= 1 && optimization_level <= 3);
+
+    SET_TEMPORARILY(current_allocation_phase, AllocationPhase::optimize);
+
+    // NOTE: Branch weights, entry counts and the profile summary that compile_to_ir attaches when compiling
+    // with a profile are picked up by this pipeline (block placement, inlining, hot/cold splitting)
+    auto level = std::array{OptimizationLevel::O1, OptimizationLevel::O2, OptimizationLevel::O3};
+    run_pipeline(
+        module,
+        [&](PassBuilder &pass_builder)
+        { return pass_builder.buildPerModuleDefaultPipeline(level[optimization_level - 1]); });
+}
+
+void lower_coroutines(Module &module)
+{
+    if (module.getFunction("llvm.coro.begin") == nullptr)
+    {
+        return;
+    }
+
+    SET_TEMPORARILY(current_allocation_phase, AllocationPhase::optimize);
+
+    // The -O0 pipeline only runs the passes that are required for code generation, which includes the coroutine passes
+    run_pipeline(
+        module,
+        [](PassBuilder &pass_builder) { return pass_builder.buildO0DefaultPipeline(OptimizationLevel::O0); });
+}
+
+struct Jit::Library
+{
+    JITDylib *dylib{};
+    ResourceTrackerSP resource_tracker{};
+};
+
 struct Jit::Impl
 {
     std::optional<ExecutionSession> execution_session{};
     std::optional<RTDyldObjectLinkingLayer> object_layer{};
     std::optional<IRCompileLayer> compile_layer{};
+    std::optional<IRTransformLayer> transform_layer{};
 
     std::optional<MangleAndInterner> mangle{};
     std::optional<DataLayout> data_layout{};
 
     JITDylib *main_jit_dy_lib{};
 
-    explicit Impl()
+    // Libraries can be created, used and removed from multiple threads at once
+    std::mutex libraries_mutex{};
+    std::unordered_map<Library *, std::unique_ptr<Library>> libraries{};
+
+    // Compiled programs call the functions of the runtime library (see runtime.h)
+    void define_runtime_symbols(JITDylib &dylib)
+    {
+        SymbolMap symbols{};
+        for (const auto &symbol : runtime_symbols)
+        {
+            symbols[(*this->mangle)(symbol.name)] = ExecutorSymbolDef{
+                ExecutorAddr::fromPtr(symbol.address),
+                JITSymbolFlags::Exported | JITSymbolFlags::Callable};
+        }
+
+        cantFail(dylib.define(absoluteSymbols(std::move(symbols))));
+    }
+
+    bool has_library(Library *library)
+    {
+        std::lock_guard lock{this->libraries_mutex};
+        return this->libraries.contains(library);
+    }
+
+    explicit Impl(const JitOptions &options)
     {
         auto executor_process_control = SelfExecutorProcessControl::Create();
         if (!executor_process_control)
@@ -78,12 +222,33 @@ struct Jit::Impl
         this->compile_layer.emplace(
             this->execution_session.value(),
             this->object_layer.value(),
-            std::make_unique<ConcurrentIRCompiler>(std::move(*jit_target_machine_builder)));
+            std::make_unique<PooledTargetMachineCompiler>(std::move(*jit_target_machine_builder)));
+
+        this->transform_layer.emplace(this->execution_session.value(), this->compile_layer.value());
+        this->transform_layer->setTransform(
+            [optimize = options.optimize](ThreadSafeModule module, const MaterializationResponsibility &)
+                -> Expected<ThreadSafeModule>
+            {
+                module.withModuleDo(
+                    [&](Module &module)
+                    {
+                        if (optimize)
+                        {
+                            optimize_module(module);
+                        }
+                        else
+                        {
+                            lower_coroutines(module);
+                        }
+                    });
+                return std::move(module);
+            });
 
         this->main_jit_dy_lib = &this->execution_session->createBareJITDylib("<main>");
 
         this->main_jit_dy_lib->addGenerator(
             cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(this->data_layout.value().getGlobalPrefix())));
+        this->define_runtime_symbols(*this->main_jit_dy_lib);
     }
 
     ~Impl()
@@ -95,8 +260,8 @@ struct Jit::Impl
     }
 };
 
-Jit::Jit()
-    : impl{std::make_unique<Jit::Impl>()}
+Jit::Jit(const JitOptions &options)
+    : impl{std::make_unique<Jit::Impl>(options)}
 {
 }
 
@@ -104,7 +269,7 @@ Jit::~Jit() = default;
 
 void Jit::add_module(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module)
 {
-    auto error = this->impl->compile_layer->add(
+    auto error = this->impl->transform_layer->add(
         *this->impl->main_jit_dy_lib,
         ThreadSafeModule{std::move(module), std::move(context)});
     if (error)
@@ -116,16 +281,107 @@ void Jit::add_module(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr
 
 void *Jit::get_symbol_address(std::string_view name)
 {
-    auto def = this->impl->execution_session->lookup({this->impl->main_jit_dy_lib}, (*this->impl->mangle)("main"));
+    auto def = this->impl->execution_session->lookup({this->impl->main_jit_dy_lib}, (*this->impl->mangle)(name));
     if (!def)
     {
-        std::cout << "Error looking up main symbol definition: " << toString(def.takeError()) << std::endl;
+        std::cout << "Error looking up " << name << " symbol definition: " << toString(def.takeError()) << std::endl;
         FATAL("Failed to lookup symbol definition");
     }
 
     return def->getAddress().toPtr<void *>();
 }
 
+Jit::Library *Jit::create_library(std::string_view name)
+{
+    auto dylib = this->impl->execution_session->createJITDylib(std::string{name});
+    if (!dylib)
+    {
+        std::cout << "Failed to create JITDylib " << name << ": " << toString(dylib.takeError()) << std::endl;
+        FATAL("Failed to create JIT library");
+    }
+
+    dylib->addGenerator(cantFail(
+        DynamicLibrarySearchGenerator::GetForCurrentProcess(this->impl->data_layout.value().getGlobalPrefix())));
+    this->impl->define_runtime_symbols(dylib.get());
+
+    auto library              = std::make_unique<Library>();
+    library->dylib            = &dylib.get();
+    library->resource_tracker = library->dylib->createResourceTracker();
+
+    auto result = library.get();
+
+    std::lock_guard lock{this->impl->libraries_mutex};
+    this->impl->libraries.emplace(result, std::move(library));
+
+    return result;
+}
+
+void Jit::add_module(
+    Library *library,
+    std::unique_ptr<llvm::LLVMContext> context,
+    std::unique_ptr<llvm::Module> module)
+{
+    assert(this->impl->has_library(library));
+
+    auto error = this->impl->transform_layer->add(
+        library->resource_tracker,
+        ThreadSafeModule{std::move(module), std::move(context)});
+    if (error)
+    {
+        std::cout << "Failed to add the module to the compile layer: " << toString(std::move(error)) << std::endl;
+        FATAL("Failed to add module to JIT library");
+    }
+}
+
+void *Jit::get_symbol_address(Library *library, std::string_view name)
+{
+    assert(this->impl->has_library(library));
+
+    auto def = this->impl->execution_session->lookup({library->dylib}, (*this->impl->mangle)(name));
+    if (!def)
+    {
+        std::cout << "Error looking up " << name << " symbol definition: " << toString(def.takeError()) << std::endl;
+        FATAL("Failed to lookup symbol definition");
+    }
+
+    return def->getAddress().toPtr<void *>();
+}
+
+void *Jit::find_symbol_address(Library *library, std::string_view name)
+{
+    assert(this->impl->has_library(library));
+
+    auto def = this->impl->execution_session->lookup({library->dylib}, (*this->impl->mangle)(name));
+    if (!def)
+    {
+        consumeError(def.takeError());
+        return nullptr;
+    }
+
+    return def->getAddress().toPtr<void *>();
+}
+
+// Frees the code and data of all modules in the library and removes the library from the session
+void Jit::remove_library(Library *library)
+{
+    assert(this->impl->has_library(library));
+
+    if (auto error = library->resource_tracker->remove())
+    {
+        std::cout << "Failed to remove the resources of the JIT library: " << toString(std::move(error)) << std::endl;
+        FATAL("Failed to remove JIT library");
+    }
+
+    if (auto error = this->impl->execution_session->removeJITDylib(*library->dylib))
+    {
+        std::cout << "Failed to remove the JITDylib: " << toString(std::move(error)) << std::endl;
+        FATAL("Failed to remove JIT library");
+    }
+
+    std::lock_guard lock{this->impl->libraries_mutex};
+    this->impl->libraries.erase(library);
+}
+
 
 #if 0
 void run_main_jit(std::unique_ptr<llvm::LLVMContext> &&context, std::unique_ptr<llvm::Module> &&module)
@@ -9,16 +9,41 @@ namespace llvm
     class LLVMContext;
 }  // namespace llvm
 
+struct JitOptions
+{
+    // Run the LLVM -O2 pipeline on every module before it is compiled to machine code
+    bool optimize{};
+};
+
 struct Jit
 {
     struct Impl;
 
+    // A separate JITDylib inside of the JIT's execution session. Programs that are added to their own
+    // library can be removed again without tearing down the whole session.
+    // Different libraries may be created, compiled, used and removed on different threads concurrently.
+    // The library names must be unique within the session.
+    struct Library;
+
     std::unique_ptr<Impl> impl;
 
-    explicit Jit();
+    explicit Jit(const JitOptions &options = {});
     ~Jit();
     void add_module(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module);
     void *get_symbol_address(std::string_view name);
+
+    Library *create_library(std::string_view name);
+    void add_module(Library *library, std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module);
+    void *get_symbol_address(Library *library, std::string_view name);
+    // Like get_symbol_address, but nullptr instead of aborting if the library has no symbol with the name
+    void *find_symbol_address(Library *library, std::string_view name);
+    void remove_library(Library *library);
 };
 
+// Runs the LLVM -O<optimization_level> pipeline (1 to 3) on the module
+void optimize_module(llvm::Module &module, int optimization_level = 2);
+// Splits the coroutines of async procedures (see compile_ir.cpp) into the functions that the machine code is generated
+// for, which optimize_module does as well. The JIT does either one before it compiles a module.
+void lower_coroutines(llvm::Module &module);
+
 // void run_main_jit(std::unique_ptr<llvm::LLVMContext> &&context, std::unique_ptr<llvm::Module> &&module);
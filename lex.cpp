@@ -128,8 +128,9 @@ Token Lexer::next_token()
     }
 
     // NOTE: We must look for numerical literals before the simple tokens because otherwise we'd interpret 1.23 as '1', '.', '23'
+    // A point that is not followed by a digit is '.' or '...' (like in 'a.x')
     auto has_point = *this->cursor.at == '.';
-    if (is_digit(*this->cursor.at) || has_point && this->cursor.at[1] != '.')  // Check that we are not at '...'
+    if (is_digit(*this->cursor.at) || has_point && is_digit(this->cursor.at[1]))
     {
         next(this->cursor);
         if (*this->cursor.at == 'x')
@@ -223,6 +224,9 @@ Token Lexer::next_token()
         std::make_tuple(">", Tt::greater_than),
         std::make_tuple("<", Tt::less_than),
         std::make_tuple(":", Tt::colon),
+        std::make_tuple("#", Tt::hash),
+        std::make_tuple("@", Tt::at),
+        std::make_tuple(".", Tt::dot),
     };
     // clang-format on
 
@@ -242,6 +246,7 @@ Token Lexer::next_token()
         std::string_view text{start.at, this->cursor.at};
 
         std::string_view keywords[] = {
+            "async",
             "break",
             "continue",
             "else",
@@ -250,8 +255,10 @@ Token Lexer::next_token()
             "for",
             "goto",
             "if",
+            "parallel",
             "proc",
             "return",
+            "struct",
             "true",
             "while",
         };
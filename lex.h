@@ -34,7 +34,10 @@ enum class TokenType
 
     colon,  // :
     comma,  // ,
+    dot,  // .
     triple_dot,  // ...
+    hash,  // #
+    at,  // @
 
     parenthesis_open,  // (
     parenthesis_close,  // )
@@ -70,7 +73,10 @@ inline std::string_view to_string(TokenType type)
         case Tt::bit_xor:               return "bit_xor";
         case Tt::bit_or:                return "bit_or";
         case Tt::comma:                 return "comma";
+        case Tt::dot:                   return "dot";
         case Tt::triple_dot:            return "triple_dot";
+        case Tt::hash:                  return "hash";
+        case Tt::at:                    return "at";
         case Tt::parenthesis_open:      return "parenthesis_open";
         case Tt::parenthesis_close:     return "parenthesis_close";
         case Tt::brace_open:            return "brace_open";
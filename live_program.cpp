@@ -0,0 +1,442 @@
+#include "live_program.h"
+
+#include "compile_ir.h"
+#include "frontend.h"
+#include "jit.h"
+
+#include <algorithm>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <unordered_set>
+
+// Hashes the structure of a subtree so that two versions of a procedure can be compared across compilations
+struct StructuralHasher : NodeVisitorBase
+{
+    size_t hash = 14695981039346656037ull;
+
+    void combine(size_t value) { this->hash = (this->hash ^ value) * 1099511628211ull; }
+    void combine(std::string_view value) { this->combine(std::hash<std::string_view>{}(value)); }
+    void combine(Node *node) { this->combine(static_cast<size_t>(node->kind)); }
+
+    void visit(ArrayTypeNode *array_type) override
+    {
+        this->combine(array_type);
+        this->combine(array_type->is_soa);
+    }
+
+    void visit(BasicTypeNode *basic_type) override
+    {
+        this->combine(basic_type);
+        this->combine(static_cast<size_t>(basic_type->type_kind));
+        this->combine(static_cast<size_t>(basic_type->size));
+    }
+
+    void visit(BinaryOperatorNode *binary_operator) override
+    {
+        this->combine(binary_operator);
+        this->combine(static_cast<size_t>(binary_operator->operator_kind));
+    }
+
+    void visit(BlockNode *block) override
+    {
+        this->combine(block);
+        this->combine(block->statements.size());
+        this->combine(static_cast<size_t>(block->expected_compiler_error_kind));
+    }
+
+    void visit(BreakStatementNode *break_statement) override { this->combine(break_statement); }
+
+    void visit(ContinueStatementNode *continue_statement) override { this->combine(continue_statement); }
+
+    void visit(DeclarationNode *declaration) override
+    {
+        this->combine(declaration);
+        this->combine(declaration->identifier);
+        this->combine(declaration->is_procedure_argument);
+        this->combine(declaration->specified_type != nullptr);
+        this->combine(declaration->init_expression != nullptr);
+    }
+
+    // The instances are hashed as the declarations that they are
+    void visit(GenericNode *generic) override { this->combine(generic); }
+
+    void visit(GotoStatementNode *goto_statement) override
+    {
+        this->combine(goto_statement);
+        this->combine(goto_statement->label_identifier);
+    }
+
+    // The same name can refer to different instances of a generic procedure
+    void visit(IdentifierNode *identifier) override
+    {
+        this->combine(identifier);
+        this->combine(identifier->identifier);
+        if (identifier->declaration != nullptr)
+        {
+            this->combine(identifier->declaration->identifier);
+        }
+    }
+
+    void visit(IfStatementNode *if_statement) override
+    {
+        this->combine(if_statement);
+        this->combine(if_statement->else_block != nullptr);
+    }
+
+    void visit(IndexNode *index) override { this->combine(index); }
+
+    void visit(LabelNode *label) override
+    {
+        this->combine(label);
+        this->combine(label->identifier);
+    }
+
+    void visit(LiteralNode *literal) override
+    {
+        this->combine(literal);
+        this->combine(literal->value.index());
+        this->combine(std::visit(
+            [](const auto &value)
+            {
+                using T = std::decay_t<decltype(value)>;
+                return std::hash<T>{}(value);
+            },
+            literal->value));
+        this->combine(static_cast<size_t>(literal->suffix));
+    }
+
+    void visit(MemberAccessNode *member_access) override
+    {
+        this->combine(member_access);
+        this->combine(member_access->member);
+    }
+
+    void visit(ModuleNode *module) override { this->combine(module); }
+
+    void visit(NopNode *nop) override { this->combine(nop); }
+
+    void visit(PointerTypeNode *pointer_type) override { this->combine(pointer_type); }
+
+    void visit(ProcedureCallNode *procedure_call) override
+    {
+        this->combine(procedure_call);
+        this->combine(procedure_call->arguments.size());
+        this->combine(static_cast<size_t>(procedure_call->memory_order));
+    }
+
+    void visit(ProcedureNode *procedure) override
+    {
+        this->combine(procedure);
+        this->combine(procedure->is_external);
+        this->combine(procedure->is_async);
+        this->combine(procedure->is_inline);
+        this->combine(procedure->is_noinline);
+        this->combine(procedure->is_hot);
+        this->combine(procedure->is_cold);
+        this->combine(procedure->is_flatten);
+    }
+
+    void visit(ProcedureSignatureNode *procedure_signature) override
+    {
+        this->combine(procedure_signature);
+        this->combine(procedure_signature->arguments.size());
+        this->combine(procedure_signature->is_vararg);
+        this->combine(procedure_signature->return_type != nullptr);
+    }
+
+    void visit(ReturnStatementNode *return_statement) override
+    {
+        this->combine(return_statement);
+        this->combine(return_statement->expression != nullptr);
+        this->combine(return_statement->is_tail_call);
+    }
+
+    void visit(SliceNode *slice) override
+    {
+        this->combine(slice);
+        this->combine(slice->begin != nullptr);
+        this->combine(slice->end != nullptr);
+    }
+
+    void visit(SliceTypeNode *slice_type) override { this->combine(slice_type); }
+
+    // The layout decides the code of the procedures that use the struct
+    void visit(StructTypeNode *struct_type) override
+    {
+        this->combine(struct_type);
+        this->combine(struct_type->identifier);
+        this->combine(static_cast<size_t>(struct_type->size));
+        this->combine(static_cast<size_t>(struct_type->alignment));
+        for (const auto &field : struct_type->fields)
+        {
+            this->combine(field.identifier);
+            this->combine(Node::type_to_string(field.type));
+            this->combine(static_cast<size_t>(field.offset));
+        }
+    }
+
+    void visit(TypeCastNode *type_cast) override { this->combine(type_cast); }
+
+    void visit(VectorTypeNode *vector_type) override
+    {
+        this->combine(vector_type);
+        this->combine(static_cast<size_t>(vector_type->length));
+    }
+
+    void visit(WhileLoopNode *while_loop) override
+    {
+        this->combine(while_loop);
+
+        // NOTE: The visitor does not descend into the prologue
+        this->combine(while_loop->prologue != nullptr);
+        StructuralHasher prologue_hasher{};
+        ::visit(while_loop->prologue, prologue_hasher);
+        this->combine(prologue_hasher.hash);
+
+        this->combine(while_loop->is_parallel);
+        this->combine(while_loop->grain_size != nullptr);
+        for (const auto &reduction : while_loop->reductions)
+        {
+            this->combine(static_cast<size_t>(reduction.kind));
+        }
+    }
+};
+
+static size_t structural_hash(Node *node)
+{
+    StructuralHasher hasher{};
+    visit(node, hasher);
+    return hasher.hash;
+}
+
+LiveProgram::LiveProgram(Jit &jit, const LiveProgramOptions &options)
+    : jit{jit}
+    , options{options}
+{
+}
+
+LiveProgram::~LiveProgram() = default;
+
+std::optional<std::vector<std::string>> LiveProgram::update(std::string source)
+{
+    // NOTE: The tree refers to the source, so it is kept on the heap where it does not move
+    auto owned_source = std::make_unique<std::string>(std::move(source));
+    auto ctx          = std::make_unique<Context>();
+    auto module_node  = analyze_source(*ctx, *owned_source);
+    if (module_node == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    struct ProcedureVersion
+    {
+        DeclarationNode *declaration{};
+        size_t hash{};
+        size_t signature_hash{};
+    };
+
+    std::vector<ProcedureVersion> procedures{};
+    for (auto statement : module_node->block->statements)
+    {
+        auto decl = node_cast<DeclarationNode>(statement);
+        if (decl == nullptr)
+        {
+            continue;
+        }
+
+        auto procedure = node_cast<ProcedureNode>(decl->init_expression);
+        if (procedure == nullptr || procedure->is_external)
+        {
+            continue;
+        }
+
+        procedures.push_back(ProcedureVersion{
+            .declaration    = decl,
+            .hash           = structural_hash(procedure),
+            .signature_hash = structural_hash(procedure->signature),
+        });
+    }
+
+    // Callers have been compiled against the old signature of their callee, so if any signature changed,
+    // everything is recompiled
+    auto recompile_all = false;
+    for (const auto &procedure : procedures)
+    {
+        auto it = this->slots.find(std::string{procedure.declaration->identifier});
+        if (it != this->slots.end() && it->second->signature_hash != procedure.signature_hash)
+        {
+            recompile_all = true;
+        }
+    }
+
+    std::unordered_set<std::string_view> changed{};
+    for (const auto &procedure : procedures)
+    {
+        auto it = this->slots.find(std::string{procedure.declaration->identifier});
+        if (recompile_all || it == this->slots.end() || it->second->hash != procedure.hash)
+        {
+            changed.insert(procedure.declaration->identifier);
+        }
+    }
+
+    std::vector<DeclarationNode *> to_compile{};
+    for (const auto &procedure : procedures)
+    {
+        if (changed.contains(procedure.declaration->identifier))
+        {
+            to_compile.push_back(procedure.declaration);
+        }
+    }
+
+    for (auto declaration : to_compile)
+    {
+        // Code that is still running may count into the old counters, so they are retired instead of freed
+        auto it = this->profile.procedures.find(std::string{declaration->identifier});
+        if (it != this->profile.procedures.end())
+        {
+            this->retired_counters.push_back(std::move(it->second));
+            this->profile.procedures.erase(it);
+        }
+    }
+
+    this->compile_procedures(module_node, to_compile, false);
+
+    std::vector<std::string> recompiled_procedures{};
+    for (const auto &procedure : procedures)
+    {
+        if (changed.contains(procedure.declaration->identifier) == false)
+        {
+            continue;
+        }
+
+        auto &slot           = this->slots.at(std::string{procedure.declaration->identifier});
+        slot->hash           = procedure.hash;
+        slot->signature_hash = procedure.signature_hash;
+
+        recompiled_procedures.push_back(std::string{procedure.declaration->identifier});
+    }
+
+    // Nothing refers to the tree of the previous version anymore
+    this->ctx         = std::move(ctx);
+    this->source      = std::move(owned_source);
+    this->module_node = module_node;
+
+    return recompiled_procedures;
+}
+
+void *LiveProgram::procedure_address(std::string_view name) const
+{
+    auto it = this->slots.find(std::string{name});
+    if (it == this->slots.end())
+    {
+        return nullptr;
+    }
+
+    return it->second->address.load(std::memory_order_acquire);
+}
+
+std::vector<std::string> LiveProgram::promote_hot_procedures()
+{
+    if (this->options.hot_threshold == 0 || this->module_node == nullptr)
+    {
+        return {};
+    }
+
+    std::vector<DeclarationNode *> hot_procedures{};
+    for (auto statement : this->module_node->block->statements)
+    {
+        auto decl = node_cast<DeclarationNode>(statement);
+        if (decl == nullptr)
+        {
+            continue;
+        }
+
+        auto slot_it    = this->slots.find(std::string{decl->identifier});
+        auto counters   = this->profile.find(decl->identifier);
+        auto is_hot     = counters != nullptr && counters->entry_count() >= this->options.hot_threshold;
+        auto is_tier_up = slot_it != this->slots.end() && slot_it->second->is_optimized == false;
+        if (is_hot && is_tier_up)
+        {
+            hot_procedures.push_back(decl);
+        }
+    }
+
+    if (hot_procedures.empty())
+    {
+        return {};
+    }
+
+    this->compile_procedures(this->module_node, hot_procedures, true);
+
+    std::vector<std::string> promoted_procedures{};
+    for (auto declaration : hot_procedures)
+    {
+        this->slots.at(std::string{declaration->identifier})->is_optimized = true;
+        promoted_procedures.push_back(std::string{declaration->identifier});
+    }
+
+    return promoted_procedures;
+}
+
+void LiveProgram::compile_procedures(
+    ModuleNode *module_node,
+    const std::vector<DeclarationNode *> &declarations,
+    bool optimize)
+{
+    if (declarations.empty())
+    {
+        return;
+    }
+
+    for (auto declaration : declarations)
+    {
+        auto &slot = this->slots[std::string{declaration->identifier}];
+        if (slot == nullptr)
+        {
+            slot = std::make_unique<Slot>();
+        }
+
+        slot->is_optimized = optimize;
+    }
+
+    IrCompilationOptions options{
+        .procedure_slot = [&](DeclarationNode *declaration)
+        {
+            auto &slot = this->slots[std::string{declaration->identifier}];
+            if (slot == nullptr)
+            {
+                slot = std::make_unique<Slot>();
+            }
+
+            return &slot->address;
+        },
+        .should_compile_procedure = [&](DeclarationNode *declaration)
+        { return std::find(declarations.begin(), declarations.end(), declaration) != declarations.end(); },
+    };
+
+    if (optimize)
+    {
+        // The optimized tier is not instrumented anymore, it is compiled with the counts collected so far
+        options.optimization_profile = &this->profile;
+    }
+    else if (this->options.hot_threshold != 0)
+    {
+        options.instrumentation_profile = &this->profile;
+    }
+
+    auto compilation_result = compile_to_ir(module_node, options);
+    if (optimize)
+    {
+        optimize_module(*compilation_result.module);
+    }
+
+    // NOTE: Old libraries are never removed because procedures that are still executing may live in them
+    auto library = this->jit.create_library(std::format("<live-{}>", this->generation++));
+    this->jit.add_module(library, std::move(compilation_result.context), std::move(compilation_result.module));
+
+    for (auto declaration : declarations)
+    {
+        this->slots.at(std::string{declaration->identifier})
+            ->address.store(this->jit.get_symbol_address(library, declaration->identifier), std::memory_order_release);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "context.h"
+#include "profile.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Jit;
+
+struct LiveProgramOptions
+{
+    // When not 0, procedures are first compiled without optimizations, but with counters (see Profile).
+    // Once a procedure was entered this many times, promote_hot_procedures() recompiles it with optimizations,
+    // using the counts collected so far.
+    uint64_t hot_threshold{};
+};
+
+// A program whose procedures can be replaced while it is running.
+// All calls between procedures of the program go through one slot per procedure, and updating the
+// source only recompiles the procedures that actually changed and swaps the addresses in their slots.
+// A procedure that is currently executing (e.g. main() or a running loop) keeps running the old code
+// until it returns - the next call picks up the new code.
+struct LiveProgram
+{
+    struct Slot
+    {
+        std::atomic<void *> address{};
+        size_t hash{};
+        size_t signature_hash{};
+        bool is_optimized{};
+    };
+
+    Jit &jit;
+    LiveProgramOptions options;
+
+    explicit LiveProgram(Jit &jit, const LiveProgramOptions &options = {});
+    ~LiveProgram();
+
+    // Returns the names of the procedures that were recompiled or std::nullopt if the source did not compile,
+    // in which case the program keeps running the previous version
+    std::optional<std::vector<std::string>> update(std::string source);
+
+    // Returns the names of the procedures that were recompiled with optimizations
+    std::vector<std::string> promote_hot_procedures();
+
+    void *procedure_address(std::string_view name) const;
+
+    // The counters of the procedures that have not been promoted yet (and the counts that the promoted ones were
+    // compiled with). Running code keeps incrementing them while they are read, so the counts are approximate.
+    inline const Profile &collected_profile() const { return this->profile; }
+
+private:
+    std::unique_ptr<Context> ctx{};
+    std::unique_ptr<std::string> source{};
+    ModuleNode *module_node{};
+    Profile profile{};
+    // A deque, because adding to it must not move the counters that running code still increments (see Profile)
+    std::deque<Profile::ProcedureCounters> retired_counters{};
+    std::unordered_map<std::string, std::unique_ptr<Slot>> slots{};
+    int generation{};
+
+    void compile_procedures(ModuleNode *module_node, const std::vector<DeclarationNode *> &declarations, bool optimize);
+};
@@ -1,29 +1,252 @@
+#include "allocation_tracking.h"
+#include "bytecode_image.h"
 #include "compile_ir.h"
-#include "desugar.h"
+#include "compile_vm.h"
+#include "frontend.h"
 #include "jit.h"
-#include "parse.h"
+#include "live_program.h"
+#include "mixed_program.h"
+#include "profile.h"
 #include "string_util.h"
-#include "typecheck.h"
+#include "vm.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdarg>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <llvm/IR/Module.h>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
 
-int main(int argc, char **argv)
+using Clock = std::chrono::steady_clock;
+
+static double milliseconds_since(Clock::time_point start)
 {
-    std::cout << "This is the fasel compiler." << std::endl;
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
 
-    if (argc != 2)
+// The resident set size of the process right now, unlike ru_maxrss, which only ever grows
+static int64_t current_rss_kib()
+{
+    std::ifstream statm{"/proc/self/statm"};
+
+    int64_t size_pages     = 0;
+    int64_t resident_pages = 0;
+    if ((statm >> size_pages >> resident_pages).fail())
     {
-        std::cerr << "Usage: fasel <main source file>" << std::endl;
+        return 0;
+    }
+
+    return resident_pages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+// Service mode: reads one source file path per line from stdin and compiles and runs each program
+// in its own JIT library of a single, long-lived JIT session. The library is removed again after
+// main() returned, and the AST goes with the Context of the program, so the session does not grow
+// with the number of programs (benchmarks/serve_memory.cpp checks that).
+static int serve()
+{
+    Jit jit{};
+
+    auto num_programs = 0;
+    auto num_failures = 0;
+
+    std::string path{};
+    while (std::getline(std::cin, path))
+    {
+        if (path.empty())
+        {
+            continue;
+        }
+
+        auto start = Clock::now();
+
+        auto source_file = read_file_as_string(path);
+        if (source_file.has_value() == false)
+        {
+            ++num_failures;
+            continue;
+        }
+
+        auto source = std::move(source_file.value());
+
+        Context ctx{};
+
+        auto module_node = analyze_source(ctx, source);
+        if (module_node == nullptr)
+        {
+            ++num_failures;
+            continue;
+        }
+
+        auto compilation_result = compile_to_ir(module_node, IrCompilationOptions{.internalize = true});
+
+        auto library = jit.create_library(std::format("<program-{}>", num_programs));
+        jit.add_module(library, std::move(compilation_result.context), std::move(compilation_result.module));
+        auto main = reinterpret_cast<void (*)()>(jit.get_symbol_address(library, "main"));
+
+        auto compile_ms = milliseconds_since(start);
+        start           = Clock::now();
+
+        main();
+
+        auto run_ms = milliseconds_since(start);
+
+        jit.remove_library(library);
+        ++num_programs;
+
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+
+        std::cout << std::format(
+                         "[{}] {}: compile {:.3f} ms, run {:.3f} ms, rss {} KiB, max rss {} KiB",
+                         num_programs,
+                         path,
+                         compile_ms,
+                         run_ms,
+                         current_rss_kib(),
+                         usage.ru_maxrss)
+                  << std::endl;
+    }
+
+    std::cout << std::format("Served {} programs ({} failed)", num_programs, num_failures) << std::endl;
+
+    return num_failures == 0 ? 0 : 1;
+}
+
+// Watch mode: runs the program and recompiles the procedures that changed whenever the source file is saved.
+// The running program picks up the new code on the next call of a changed procedure.
+// Procedures start out unoptimized and instrumented and get recompiled with optimizations once they are hot.
+static int watch(int argc, char **argv)
+{
+    const char *path              = nullptr;
+    const char *dump_profile_path = nullptr;
+    LiveProgramOptions options{.hot_threshold = 1000};
+    for (auto i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--hot-threshold") == 0 && i + 1 < argc)
+        {
+            options.hot_threshold = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--dump-profile") == 0 && i + 1 < argc)
+        {
+            dump_profile_path = argv[++i];
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+
+    if (path == nullptr)
+    {
+        std::cerr << "Missing source file" << std::endl;
         return 1;
     }
 
-    auto path = argv[1];
-    std::cout << "Compiling file: " << path << std::endl;
+    auto source_file = read_file_as_string(path);
+    if (source_file.has_value() == false)
+    {
+        std::cerr << "Failed to read source file" << std::endl;
+        return 1;
+    }
+
+    Jit jit{};
+    LiveProgram program{jit, options};
+    if (program.update(std::move(source_file.value())).has_value() == false)
+    {
+        return 1;
+    }
+
+    auto main = reinterpret_cast<void (*)()>(program.procedure_address("main"));
+    if (main == nullptr)
+    {
+        std::cerr << "The program does not have a main procedure" << std::endl;
+        return 1;
+    }
+
+    std::atomic<bool> is_done{};
+    std::thread runner{[&]
+                       {
+                           main();
+                           is_done = true;
+                       }};
 
+    auto last_write_time = std::filesystem::last_write_time(path);
+    while (is_done == false)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+
+        auto promotion_start     = Clock::now();
+        auto promoted_procedures = program.promote_hot_procedures();
+        if (promoted_procedures.empty() == false)
+        {
+            std::cout << std::format(
+                "Optimized {} hot procedure(s) in {:.3f} ms:",
+                promoted_procedures.size(),
+                milliseconds_since(promotion_start));
+            for (const auto &name : promoted_procedures)
+            {
+                std::cout << " " << name;
+            }
+            std::cout << std::endl;
+        }
+
+        std::error_code error{};
+        auto write_time = std::filesystem::last_write_time(path, error);
+        if (error || write_time == last_write_time)
+        {
+            continue;
+        }
+
+        last_write_time = write_time;
+
+        source_file = read_file_as_string(path);
+        if (source_file.has_value() == false)
+        {
+            continue;
+        }
+
+        auto start                 = Clock::now();
+        auto recompiled_procedures = program.update(std::move(source_file.value()));
+        if (recompiled_procedures.has_value() == false)
+        {
+            std::cout << "Reload failed, the previous version keeps running" << std::endl;
+            continue;
+        }
+
+        std::cout << std::format(
+                         "Reloaded {} procedure(s) in {:.3f} ms:",
+                         recompiled_procedures->size(),
+                         milliseconds_since(start));
+        for (const auto &name : recompiled_procedures.value())
+        {
+            std::cout << " " << name;
+        }
+        std::cout << std::endl;
+    }
+
+    runner.join();
+
+    if (dump_profile_path != nullptr && program.collected_profile().write(dump_profile_path) == false)
+    {
+        return 1;
+    }
+
+    std::cout << "Done" << std::endl;
+
+    return 0;
+}
+
+// Compiles the program for the bytecode interpreter and writes it to a bytecode image, which --interpret runs
+// without the frontend
+static int emit_bytecode(const char *output_path, const char *path)
+{
     auto source_file = read_file_as_string(path);
     if (source_file.has_value() == false)
     {
@@ -33,56 +256,305 @@ int main(int argc, char **argv)
 
     auto source = std::move(source_file.value());
 
-#if 0
-    Lexer lexer{source.get()};
-    for (auto i = 0;; ++i)
+    Context ctx{};
+
+    auto module_node = analyze_source(ctx, source);
+    if (module_node == nullptr)
     {
-        auto token = lexer.next_token();
-        std::cout << "Token " << i << ": " << token.to_string() << std::endl;
-        if (token.type == Tt::eof)
+        return 1;
+    }
+
+    auto program = compile_to_bytecode(module_node);
+    verify_program(&program);
+
+    if (write_bytecode_image(program, output_path) == false)
+    {
+        return 1;
+    }
+
+    std::cout << std::format("Wrote {} bytes of bytecode to {}", program.code().size(), output_path) << std::endl;
+
+    return 0;
+}
+
+// Interpreter mode: runs the program on the bytecode interpreter instead of compiling it to machine code.
+// The program is either a source file or a bytecode image (see --emit-bytecode).
+// With --op-pairs, the superinstructions are disabled and the most frequent pairs of adjacent instructions are printed,
+// which are the candidates for new superinstructions.
+static int interpret(int argc, char **argv)
+{
+    const char *path      = nullptr;
+    auto profile_op_pairs = false;
+    for (auto i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--op-pairs") == 0)
         {
-            break;
+            profile_op_pairs = true;
+        }
+        else
+        {
+            path = argv[i];
         }
     }
-#endif
+
+    if (path == nullptr)
+    {
+        std::cerr << "Missing source file" << std::endl;
+        return 1;
+    }
+
+    VmProgram program{};
+    if (is_bytecode_image(path))
+    {
+        auto image = map_bytecode_image(path);
+        if (image.has_value() == false)
+        {
+            return 1;
+        }
+
+        program = std::move(image.value());
+    }
+    else
+    {
+        auto source_file = read_file_as_string(path);
+        if (source_file.has_value() == false)
+        {
+            std::cerr << "Failed to read source file" << std::endl;
+            return 1;
+        }
+
+        auto source = std::move(source_file.value());
+
+        Context ctx{};
+
+        auto module_node = analyze_source(ctx, source);
+        if (module_node == nullptr)
+        {
+            return 1;
+        }
+
+        program = compile_to_bytecode(module_node, BytecodeCompilationOptions{.superinstructions = !profile_op_pairs});
+    }
+
+    Vm vm{.profile_op_pairs = profile_op_pairs};
+    run_main(&vm, &program);
+
+    std::cout << std::format("Dispatched {} instructions", vm.num_dispatches) << std::endl;
+
+    if (profile_op_pairs)
+    {
+        std::vector<std::pair<uint64_t, size_t>> pairs{};
+        for (size_t i = 0; i < vm.op_pair_counts.size(); ++i)
+        {
+            if (vm.op_pair_counts[i] != 0)
+            {
+                pairs.emplace_back(vm.op_pair_counts[i], i);
+            }
+        }
+
+        std::sort(pairs.begin(), pairs.end(), std::greater{});
+        pairs.resize(std::min<size_t>(pairs.size(), 20));
+
+        for (auto [count, index] : pairs)
+        {
+            std::cout << std::format(
+                             "{:>14} {:5.1f}%  {} {}",
+                             count,
+                             100.0 * count / vm.num_dispatches,
+                             to_string(static_cast<OpCode>(index / num_op_codes)),
+                             to_string(static_cast<OpCode>(index % num_op_codes)))
+                      << std::endl;
+        }
+    }
+
+    std::cout << "Done" << std::endl;
+
+    return 0;
+}
+
+// Mixed mode: starts the program on the bytecode interpreter and compiles hot procedures to machine code in the
+// background while it is running
+static int mixed(int argc, char **argv)
+{
+    const char *path = nullptr;
+    MixedProgramOptions options{};
+    for (auto i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--hot-threshold") == 0 && i + 1 < argc)
+        {
+            options.hot_threshold = std::max<uint64_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+
+    if (path == nullptr)
+    {
+        std::cerr << "Missing source file" << std::endl;
+        return 1;
+    }
+
+    auto source_file = read_file_as_string(path);
+    if (source_file.has_value() == false)
+    {
+        std::cerr << "Failed to read source file" << std::endl;
+        return 1;
+    }
+
+    auto source = std::move(source_file.value());
 
     Context ctx{};
 
-    auto module = parse_module(source);
-    if (module == nullptr)
+    auto module_node = analyze_source(ctx, source);
+    if (module_node == nullptr)
     {
-        std::cout << "Parsing failed" << std::endl;
         return 1;
     }
 
-    module = ast_cast<AstModule, true>(desugar(ctx.pool, module));
+    Jit jit{};
+    MixedProgram program{jit, module_node, options};
+    program.run_main();
+
+    std::cout << std::format("Dispatched {} instructions, compiled:", program.vm.num_dispatches);
+    for (const auto &name : program.compiled_procedures())
+    {
+        std::cout << " " << name;
+    }
+    std::cout << std::endl;
 
-    NodeConverter node_converter{ctx};
-    auto module_node = node_cast<ModuleNode>(node_converter.make_node(module));
+    std::cout << "Done" << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::cout << "This is the fasel compiler." << std::endl;
+
+    if (argc == 2 && strcmp(argv[1], "--serve") == 0)
+    {
+        return serve();
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--watch") == 0)
+    {
+        return watch(argc - 2, argv + 2);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--interpret") == 0)
+    {
+        return interpret(argc - 2, argv + 2);
+    }
 
-    DeclarationRegistrar registrar{ctx};
-    registrar.register_declarations(module_node);
-    if (registrar.has_error())
+    if (argc >= 3 && strcmp(argv[1], "--mixed") == 0)
     {
-        std::cout << "Semantic analysis failed:" << std::endl;  // TODO
-        for (const auto &error : registrar.errors)
+        return mixed(argc - 2, argv + 2);
+    }
+
+    if (argc == 4 && strcmp(argv[1], "--emit-bytecode") == 0)
+    {
+        return emit_bytecode(argv[2], argv[3]);
+    }
+
+    const char *path                  = nullptr;
+    const char *profile_generate_path = nullptr;
+    const char *profile_use_path      = nullptr;
+    auto print_allocations            = false;
+    auto bounds_checks                = true;
+    JitOptions jit_options{};
+    for (auto i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-O") == 0)
+        {
+            jit_options.optimize = true;
+        }
+        else if (strcmp(argv[i], "--allocation-stats") == 0)
         {
-            std::cout << error << std::endl;
+            print_allocations = true;
         }
+        else if (strcmp(argv[i], "--no-bounds-checks") == 0)
+        {
+            bounds_checks = false;
+        }
+        else if (strcmp(argv[i], "--profile-generate") == 0 && i + 1 < argc)
+        {
+            profile_generate_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile-use") == 0 && i + 1 < argc)
+        {
+            profile_use_path     = argv[++i];
+            jit_options.optimize = true;
+        }
+        else if (path == nullptr && argv[i][0] != '-')
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = nullptr;
+            break;
+        }
+    }
+
+    if (path == nullptr || (profile_generate_path != nullptr && profile_use_path != nullptr))
+    {
+        std::cerr << "Usage: fasel [-O] [--allocation-stats] [--no-bounds-checks] "
+                     "[--profile-generate <profile> | --profile-use <profile>] <main source file>"
+                  << std::endl;
+        std::cerr << "             (--allocation-stats prints the memory allocated by each phase of the compiler,"
+                  << std::endl;
+        std::cerr << "              --no-bounds-checks leaves out the run time checks of indices and slices)" << std::endl;
+        std::cerr << "       fasel --serve  (reads source file paths from stdin, one per line)" << std::endl;
+        std::cerr << "       fasel --watch [--hot-threshold <calls>] [--dump-profile <profile>] <main source file>"
+                  << std::endl;
+        std::cerr << "             (reloads changed procedures while running, optimizes hot ones)" << std::endl;
+        std::cerr << "       fasel --interpret [--op-pairs] <main source file | bytecode image>" << std::endl;
+        std::cerr << "             (runs the program on the bytecode interpreter, optionally profiling instruction pairs)"
+                  << std::endl;
+        std::cerr << "       fasel --emit-bytecode <bytecode image> <main source file>" << std::endl;
+        std::cerr << "       fasel --mixed [--hot-threshold <calls and loop iterations>] <main source file>" << std::endl;
+        std::cerr << "             (starts on the bytecode interpreter, compiles hot procedures in the background)"
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << "Compiling file: " << path << std::endl;
 
+    auto source_file = read_file_as_string(path);
+    if (source_file.has_value() == false)
+    {
+        std::cerr << "Failed to read source file" << std::endl;
         return 1;
     }
 
-    TypeChecker type_checker{ctx};
-    type_checker.typecheck(module_node);
-    if (type_checker.errors.empty() == false)
+    auto source = std::move(source_file.value());
+
+    if (print_allocations)
+    {
+        enable_allocation_tracking();
+    }
+
+#if 0
+    Lexer lexer{source.get()};
+    for (auto i = 0;; ++i)
     {
-        std::cout << "Typechecking failed:" << std::endl;
-        for (const auto &error : type_checker.errors)
+        auto token = lexer.next_token();
+        std::cout << "Token " << i << ": " << token.to_string() << std::endl;
+        if (token.type == Tt::eof)
         {
-            std::cout << error << std::endl;
+            break;
         }
+    }
+#endif
+
+    Context ctx{};
+    ctx.bounds_checks = bounds_checks;
 
+    auto module_node = analyze_source(ctx, source);
+    if (module_node == nullptr)
+    {
         return 1;
     }
 
@@ -92,15 +564,47 @@ int main(int argc, char **argv)
     //               << std::endl;
     // }
 
-    auto compilation_result = compile_to_ir(module_node);
+    Profile profile{};
+    IrCompilationOptions options{.internalize = true};
+    if (profile_generate_path != nullptr)
+    {
+        options.instrumentation_profile = &profile;
+    }
+
+    if (profile_use_path != nullptr)
+    {
+        auto profile_file = Profile::read(profile_use_path);
+        if (profile_file.has_value() == false)
+        {
+            return 1;
+        }
+
+        profile                      = std::move(profile_file.value());
+        options.optimization_profile = &profile;
+    }
+
+    auto compilation_result = compile_to_ir(module_node, options);
     compilation_result.module->print(llvm::outs(), nullptr);
 
-    Jit jit{};
+    Jit jit{jit_options};
     jit.add_module(std::move(compilation_result.context), std::move(compilation_result.module));
     auto main_address = jit.get_symbol_address("main");
     auto main         = reinterpret_cast<void (*)()>(main_address);
 
-    main();
+    {
+        SET_TEMPORARILY(current_allocation_phase, AllocationPhase::run);
+        main();
+    }
+
+    if (print_allocations)
+    {
+        print_allocation_statistics(std::cout, ctx, module_node);
+    }
+
+    if (profile_generate_path != nullptr && profile.write(profile_generate_path) == false)
+    {
+        return 1;
+    }
 
     std::cout << "Done" << std::endl;
 
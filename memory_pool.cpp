@@ -2,27 +2,56 @@
 
 #include "basics.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 
-MemoryPool::MemoryPool(size_t capacity)
-    : capacity{capacity}
-    , memory_start{static_cast<char *>(malloc(capacity))}
+MemoryPool::MemoryPool(size_t chunk_size)
+    : chunk_size{chunk_size}
 {
-    this->cursor = this->memory_start;
 }
 
-void *MemoryPool::allocate(size_t bytes)
+MemoryPool::~MemoryPool()
 {
-    if (this->cursor + bytes > this->memory_start + this->capacity)
+    this->reset();
+
+    for (auto chunk : this->chunks)
+    {
+        free(chunk.start);
+    }
+}
+
+void MemoryPool::add_chunk(size_t size)
+{
+    auto start = static_cast<char *>(malloc(size));
+    if (start == nullptr)
     {
         FATAL("Memory pool out of memory");
     }
 
-    auto result = this->cursor;
-    this->cursor += bytes;
+    this->chunks.push_back(Chunk{.start = start, .size = size});
+    this->cursor    = start;
+    this->chunk_end = start + size;
+}
+
+void *MemoryPool::allocate(size_t bytes, size_t alignment)
+{
+    auto padding = (alignment - reinterpret_cast<uintptr_t>(this->cursor) % alignment) % alignment;
+    if (this->cursor == nullptr || bytes + padding > static_cast<size_t>(this->chunk_end - this->cursor))
+    {
+        // The rest of the current chunk stays unused
+        this->add_chunk(std::max(this->chunk_size, bytes + alignment - 1));
+        padding = (alignment - reinterpret_cast<uintptr_t>(this->cursor) % alignment) % alignment;
+    }
+
+    auto result  = this->cursor + padding;
+    this->cursor = result + bytes;
+    this->used += padding + bytes;
+
+    ++this->num_allocations;
+    this->peak_bytes = std::max(this->peak_bytes, this->used);
+    this->bytes_by_phase[static_cast<size_t>(current_allocation_phase)] += padding + bytes;
 
-    // TODO: Alignment?
     // memset(result, 0x0, bytes);
 
     return result;
@@ -34,17 +63,43 @@ std::span<char> MemoryPool::allocate_span(size_t bytes)
     return std::span<char>{result, bytes};
 }
 
-void MemoryPool::reset(char *where)
+void MemoryPool::reset()
 {
-    if (where < this->memory_start || where > this->memory_start + this->capacity)
+    while (this->destructors.empty() == false)
     {
-        FATAL("Memory pool reset out of bounds");
+        auto destructor = this->destructors.back();
+        this->destructors.pop_back();
+        destructor.destroy(destructor.object);
     }
 
-    this->cursor = where;
+    if (this->chunks.empty())
+    {
+        return;
+    }
+
+    for (size_t i = 1; i < this->chunks.size(); ++i)
+    {
+        free(this->chunks[i].start);
+    }
+
+    this->chunks.resize(1);
+    this->cursor    = this->chunks[0].start;
+    this->chunk_end = this->chunks[0].start + this->chunks[0].size;
+    this->used      = 0;
 }
 
-void *operator new(size_t size, MemoryPool &pool)
+size_t MemoryPool::used_bytes() const
 {
-    return pool.allocate(size);
+    return this->used;
+}
+
+size_t MemoryPool::capacity() const
+{
+    size_t result = 0;
+    for (auto chunk : this->chunks)
+    {
+        result += chunk.size;
+    }
+
+    return result;
 }
@@ -1,19 +1,75 @@
 #pragma once
 
+#include "allocation_tracking.h"
+
+#include <array>
 #include <cstddef>
+#include <new>
 #include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+// Allocates objects one after another in chunks of memory, which it frees all at once. It takes a new chunk whenever
+// the current one is full, allocations that are larger than a chunk get a chunk of their own.
 struct MemoryPool
 {
-    size_t capacity{};
-    char *memory_start{};
-    char *cursor{};
+    size_t chunk_size{};
+
+    // Statistics, the peak survives resets
+    size_t num_allocations{};
+    size_t peak_bytes{};
+    std::array<size_t, num_allocation_phases> bytes_by_phase{};  // See current_allocation_phase
 
-    explicit MemoryPool(size_t capacity);
+    explicit MemoryPool(size_t chunk_size);
+    MemoryPool(const MemoryPool &) = delete;
+    MemoryPool &operator=(const MemoryPool &) = delete;
+    ~MemoryPool();
 
-    void *allocate(size_t bytes);
+    void *allocate(size_t bytes, size_t alignment = 1);
     std::span<char> allocate_span(size_t bytes);
-    void reset(char *where);
-};
+    // Destroys the objects in the pool and frees the chunks but the first, which is reused
+    void reset();
+
+    size_t used_bytes() const;  // Including the padding for alignment
+    size_t capacity() const;    // The size of all chunks
+
+    // Constructs an object in the pool. The pool destroys it when it is reset or destroyed itself, so the memory that
+    // the object owns (like the elements of its vectors) is freed along with the pool.
+    template<typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        auto object = new (this->allocate(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+        if constexpr (std::is_trivially_destructible_v<T> == false)
+        {
+            this->destructors.push_back(Destructor{
+                .object  = object,
+                .destroy = [](void *object) { static_cast<T *>(object)->~T(); },
+            });
+        }
+
+        return object;
+    }
 
-void *operator new(size_t size, MemoryPool &pool);
+private:
+    struct Chunk
+    {
+        char *start{};
+        size_t size{};
+    };
+
+    struct Destructor
+    {
+        void *object{};
+        void (*destroy)(void *object){};
+    };
+
+    std::vector<Chunk> chunks{};
+    char *cursor{};  // The free memory of the last chunk
+    char *chunk_end{};
+    size_t used{};
+
+    std::vector<Destructor> destructors{};  // In the order in which the objects were constructed
+
+    void add_chunk(size_t size);
+};
@@ -0,0 +1,249 @@
+#include "mixed_program.h"
+
+#include "jit.h"
+#include "node.h"
+
+#include <algorithm>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+static int64_t enter_interpreter(void *context, int64_t procedure_index, int64_t *arguments)
+{
+    // Compiled code also runs on spawned threads and on the workers of parallel loops, each thread needs an
+    // interpreter of its own. The interpreters of spawned threads are running already.
+    auto main_vm = static_cast<Vm *>(context);
+    auto vm      = current_vm();
+    if (vm == nullptr || vm->tiers != main_vm->tiers)
+    {
+        thread_local std::unique_ptr<Vm> worker_vm{};
+        if (worker_vm == nullptr || worker_vm->tiers != main_vm->tiers)
+        {
+            worker_vm = create_thread_vm(main_vm);
+        }
+
+        vm = worker_vm.get();
+    }
+
+    const auto &procedure = vm->program->procedures[procedure_index];
+
+    // A vector result is returned in the slots in front of the arguments
+    return call_procedure(
+        vm,
+        procedure_index,
+        std::span{arguments, static_cast<size_t>(procedure.num_arguments)},
+        std::span{arguments, static_cast<size_t>(procedure.num_results)});
+}
+
+struct TaskIntrinsicFinder : NodeVisitorBase
+{
+    bool has_task_intrinsic{};
+
+    bool is_done() const override { return this->has_task_intrinsic; }
+
+    void visit(ProcedureCallNode *call) override
+    {
+        this->has_task_intrinsic = this->has_task_intrinsic || is_task_intrinsic(call->intrinsic);
+    }
+};
+
+// Tasks are resumed by the code that created them (see TaskResume), so the procedures that create or suspend tasks
+// of the interpreter stay in the interpreter
+static bool uses_tasks(ProcedureNode *procedure)
+{
+    if (procedure->is_async)
+    {
+        return true;
+    }
+
+    TaskIntrinsicFinder finder{};
+    visit(procedure->body, finder);
+
+    return finder.has_task_intrinsic;
+}
+
+MixedProgram::MixedProgram(Jit &jit, ModuleNode *module_node, const MixedProgramOptions &options)
+    : jit{jit}
+    , options{options}
+    , module_node{module_node}
+{
+    assert(options.hot_threshold != 0);
+
+    this->program = compile_to_bytecode(module_node);
+
+    // The procedures of the bytecode program are the procedures of the module that are not external, in order
+    for (auto statement : module_node->block->statements)
+    {
+        auto decl      = node_cast<DeclarationNode>(statement);
+        auto procedure = decl != nullptr ? node_cast<ProcedureNode>(decl->init_expression) : nullptr;
+        if (procedure == nullptr || procedure->is_external)
+        {
+            continue;
+        }
+
+        assert(this->program.procedures[this->declarations.size()].name == decl->identifier);
+
+        this->procedure_indices[decl] = static_cast<int64_t>(this->declarations.size());
+        this->declarations.push_back(decl);
+        this->slots.emplace_back(nullptr);
+        this->is_interpreted_only.push_back(uses_tasks(procedure));
+    }
+
+    this->bridge = InterpreterBridge{
+        .enter           = enter_interpreter,
+        .context         = &this->vm,
+        .procedure_index = [this](DeclarationNode *declaration) { return this->procedure_indices.at(declaration); },
+    };
+
+    this->vm.hot_threshold    = options.hot_threshold;
+    this->vm.on_hot_procedure = [this](int64_t procedure_index)
+    {
+        // The procedures that spawned threads start with and the procedures that use tasks are not compiled
+        if (procedure_index >= static_cast<int64_t>(this->declarations.size()) ||
+            this->is_interpreted_only[procedure_index])
+        {
+            return;
+        }
+
+        if (this->options.background == false)
+        {
+            std::lock_guard lock{this->compile_mutex};
+            this->compile({procedure_index});
+            return;
+        }
+
+        {
+            std::lock_guard lock{this->mutex};
+            this->queue.push_back(procedure_index);
+        }
+
+        this->condition.notify_one();
+    };
+
+    if (options.background)
+    {
+        this->compiler = std::thread{[this] { this->compile_in_background(); }};
+    }
+}
+
+MixedProgram::~MixedProgram()
+{
+    {
+        std::lock_guard lock{this->mutex};
+        this->is_stopping = true;
+    }
+
+    this->condition.notify_one();
+
+    if (this->compiler.joinable())
+    {
+        this->compiler.join();
+    }
+}
+
+void MixedProgram::run_main()
+{
+    ::run_main(&this->vm, &this->program);
+}
+
+std::vector<std::string> MixedProgram::compiled_procedures()
+{
+    std::lock_guard lock{this->mutex};
+    return this->compiled;
+}
+
+void MixedProgram::compile_in_background()
+{
+    while (true)
+    {
+        std::vector<int64_t> batch{};
+
+        {
+            std::unique_lock lock{this->mutex};
+            this->condition.wait(lock, [this] { return this->is_stopping || this->queue.empty() == false; });
+
+            if (this->is_stopping)
+            {
+                return;
+            }
+
+            // Everything that became hot in the meantime is compiled in one module
+            std::swap(batch, this->queue);
+        }
+
+        this->compile(batch);
+    }
+}
+
+void MixedProgram::compile(const std::vector<int64_t> &hot_procedures)
+{
+    // The interpreters of several threads may report a procedure
+    std::vector<int64_t> batch{};
+    for (auto index : hot_procedures)
+    {
+        auto is_compiled = this->vm.tiers[index].native_entry.load(std::memory_order_acquire) != nullptr;
+        if (is_compiled == false && std::find(batch.begin(), batch.end(), index) == batch.end())
+        {
+            batch.push_back(index);
+        }
+    }
+
+    if (batch.empty())
+    {
+        return;
+    }
+
+    auto is_in_batch = [&](int64_t procedure_index)
+    { return std::find(batch.begin(), batch.end(), procedure_index) != batch.end(); };
+
+    IrCompilationOptions options{
+        .procedure_slot = [this](DeclarationNode *declaration)
+        { return &this->slots[this->procedure_indices.at(declaration)]; },
+        .should_compile_procedure = [&](DeclarationNode *declaration)
+        { return is_in_batch(this->procedure_indices.at(declaration)); },
+        .interpreter_bridge = &this->bridge,
+    };
+
+    auto compilation_result = compile_to_ir(this->module_node, options);
+    if (this->options.optimize)
+    {
+        optimize_module(*compilation_result.module);
+    }
+
+    // NOTE: Libraries are never removed because the interpreter or compiled code may be executing them
+    // NOTE: The library names are unique across all mixed programs because they may share a JIT session
+    static std::atomic<int> next_library{};
+    auto library = this->jit.create_library(std::format("<mixed-{}>", next_library++));
+    this->jit.add_module(library, std::move(compilation_result.context), std::move(compilation_result.module));
+
+    // Every module has a procedure for each slot: the compiled procedure or one that calls the interpreter.
+    // The latter are only needed until the procedure is compiled. Compiled code never calls async procedures.
+    for (size_t i = 0; i < this->declarations.size(); ++i)
+    {
+        auto procedure = node_cast<ProcedureNode, true>(this->declarations[i]->init_expression);
+        if (procedure->is_async)
+        {
+            continue;
+        }
+
+        if (is_in_batch(static_cast<int64_t>(i)) || this->slots[i].load(std::memory_order_acquire) == nullptr)
+        {
+            auto address = this->jit.get_symbol_address(library, this->declarations[i]->identifier);
+            this->slots[i].store(address, std::memory_order_release);
+        }
+    }
+
+    std::vector<std::string> names{};
+    for (auto index : batch)
+    {
+        const auto &name  = this->declarations[index]->identifier;
+        auto native_entry = this->jit.get_symbol_address(library, std::format("{}.from_interpreter", name));
+        this->vm.tiers[index].native_entry.store(
+            reinterpret_cast<Vm::NativeEntry>(native_entry),
+            std::memory_order_release);
+
+        names.push_back(std::string{name});
+    }
+
+    std::lock_guard lock{this->mutex};
+    this->compiled.insert(this->compiled.end(), names.begin(), names.end());
+}
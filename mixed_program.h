@@ -0,0 +1,69 @@
+#pragma once
+
+#include "compile_ir.h"
+#include "compile_vm.h"
+#include "vm.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Jit;
+
+struct MixedProgramOptions
+{
+    // The number of calls and backward jumps after which a procedure is compiled to machine code
+    uint64_t hot_threshold = 1000;
+
+    bool optimize = true;
+
+    // Compile on a background thread while the interpreter keeps running. Otherwise the interpreter waits for the
+    // compilation, which makes the point at which a procedure switches to machine code deterministic.
+    bool background = true;
+};
+
+// A program that starts running on the bytecode interpreter and moves its hot procedures to machine code.
+// The interpreter calls compiled procedures through their native entries (see Vm::ProcedureTier), compiled procedures
+// call each other through one slot per procedure like in LiveProgram, and the slots of the procedures that are still
+// interpreted point to code that calls back into the interpreter (see InterpreterBridge).
+// There is no on-stack replacement: a procedure that is running while it gets compiled (e.g. main()) finishes in the
+// interpreter, the machine code is used from its next call on.
+struct MixedProgram
+{
+    Jit &jit;
+    MixedProgramOptions options;
+    Vm vm{};
+
+    MixedProgram(Jit &jit, struct ModuleNode *module_node, const MixedProgramOptions &options = {});
+    ~MixedProgram();
+
+    void run_main();
+
+    // The names of the procedures that have been compiled to machine code so far
+    std::vector<std::string> compiled_procedures();
+
+private:
+    struct ModuleNode *module_node{};
+    VmProgram program{};
+    InterpreterBridge bridge{};
+    std::vector<struct DeclarationNode *> declarations{};  // Indexed like the procedures of the bytecode program
+    std::unordered_map<struct DeclarationNode *, int64_t> procedure_indices{};
+    std::deque<std::atomic<void *>> slots{};
+    std::vector<bool> is_interpreted_only{};  // The procedures that use tasks (see uses_tasks)
+
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    std::vector<int64_t> queue{};
+    std::vector<std::string> compiled{};
+    bool is_stopping{};
+    std::thread compiler{};
+    std::mutex compile_mutex{};  // Spawned threads may compile in the foreground at the same time
+
+    void compile_in_background();
+    void compile(const std::vector<int64_t> &hot_procedures);
+};
@@ -1,5 +1,7 @@
 #include "node.h"
 
+#include <algorithm>
+
 void Node::set_inferred_type(Node *inferred_type)
 {
     assert(
@@ -16,7 +18,8 @@ Node *Node::inferred_type() const
 bool Node::is_type() const
 {
     return this->kind == NodeKind::basic_type || this->kind == NodeKind::pointer_type ||
-           this->kind == NodeKind::array_type || this->kind == NodeKind::procedure_signature ||
+           this->kind == NodeKind::array_type || this->kind == NodeKind::slice_type ||
+           this->kind == NodeKind::vector_type || this->kind == NodeKind::procedure_signature ||
            this->kind == NodeKind::struct_type || this->kind == NodeKind::nop;
 }
 
@@ -81,7 +84,24 @@ bool Node::types_equal(const Node *lhs, const Node *rhs)
             auto lhs_length = std::get<uint64_t>(lhs_length_literal->value);
             auto rhs_length = std::get<uint64_t>(rhs_length_literal->value);
 
-            return lhs_length == rhs_length;
+            return lhs_length == rhs_length && lhs_array->is_soa == rhs_array->is_soa;
+        }
+
+        case NodeKind::slice_type:
+        {
+            auto lhs_slice = static_cast<const SliceTypeNode *>(lhs);
+            auto rhs_slice = static_cast<const SliceTypeNode *>(rhs);
+
+            return types_equal(lhs_slice->element_type, rhs_slice->element_type);
+        }
+
+        case NodeKind::vector_type:
+        {
+            auto lhs_vector = static_cast<const VectorTypeNode *>(lhs);
+            auto rhs_vector = static_cast<const VectorTypeNode *>(rhs);
+
+            return lhs_vector->length == rhs_vector->length &&
+                   types_equal(lhs_vector->element_type, rhs_vector->element_type);
         }
 
         case NodeKind::procedure_signature:
@@ -120,8 +140,7 @@ bool Node::types_equal(const Node *lhs, const Node *rhs)
 
         case NodeKind::struct_type:
         {
-            // TODO
-            UNREACHED;
+            return lhs == rhs;
         }
 
         case NodeKind::nop:
@@ -185,13 +204,35 @@ std::string Node::type_to_string(const Node *type)
         case NodeKind::array_type:
         {
             auto array_type = static_cast<const ArrayTypeNode *>(type);
-            // TODO
-            return "[...]" + type_to_string(array_type->element_type);
+
+            auto length_literal = node_cast<LiteralNode>(array_type->length);
+            auto length         = length_literal != nullptr && std::holds_alternative<uint64_t>(length_literal->value)
+                                      ? std::to_string(std::get<uint64_t>(length_literal->value))
+                                      : std::string{"..."};
+
+            return std::format(
+                "{}[{}]{}",
+                array_type->is_soa ? "@soa " : "",
+                length,
+                type_to_string(array_type->element_type));
+        }
+
+        case NodeKind::slice_type:
+        {
+            auto slice_type = static_cast<const SliceTypeNode *>(type);
+            return "[]" + type_to_string(slice_type->element_type);
+        }
+
+        case NodeKind::vector_type:
+        {
+            auto vector_type = static_cast<const VectorTypeNode *>(type);
+            return std::format("v{}{}", vector_type->length, type_to_string(vector_type->element_type));
         }
 
         case NodeKind::struct_type:
         {
-            TODO;
+            auto struct_type = static_cast<const StructTypeNode *>(type);
+            return struct_type->identifier.empty() ? std::string{"struct {...}"} : std::string{struct_type->identifier};
         }
 
         case NodeKind::nop:
@@ -203,6 +244,158 @@ std::string Node::type_to_string(const Node *type)
     }
 }
 
+int64_t StructTypeNode::find_field(std::string_view identifier) const
+{
+    for (auto i = 0; i < this->fields.size(); ++i)
+    {
+        if (this->fields[i].identifier == identifier)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int64_t StructTypeNode::field_alignment(const StructField &field) const
+{
+    if (field.alignment != 0)
+    {
+        return field.alignment;
+    }
+
+    return this->is_packed ? 1 : align_of(field.type);
+}
+
+int64_t array_length(const ArrayTypeNode *array)
+{
+    auto literal = node_cast<LiteralNode, true>(array->length);
+    return static_cast<int64_t>(std::get<uint64_t>(literal->value));
+}
+
+int64_t size_of(const Node *type)
+{
+    switch (type->kind)
+    {
+        case NodeKind::basic_type:          return static_cast<const BasicTypeNode *>(type)->size;
+        case NodeKind::pointer_type:        return 8;
+        case NodeKind::procedure_signature: return 8;
+        case NodeKind::slice_type:          return 16;
+
+        case NodeKind::vector_type:
+        {
+            auto vector_type = static_cast<const VectorTypeNode *>(type);
+            return vector_type->length * vector_type->element_type->size;
+        }
+
+        case NodeKind::array_type:
+        {
+            auto array = static_cast<const ArrayTypeNode *>(type);
+            if (array->is_soa)
+            {
+                auto struct_type = node_cast<StructTypeNode, true>(array->element_type);
+                auto end         = soa_field_offset(array, static_cast<int64_t>(struct_type->fields.size()));
+                return (end + struct_type->alignment - 1) / struct_type->alignment * struct_type->alignment;
+            }
+
+            return array_length(array) * size_of(array->element_type);
+        }
+
+        case NodeKind::struct_type:
+        {
+            auto struct_type = static_cast<const StructTypeNode *>(type);
+            assert(struct_type->has_layout());
+            return struct_type->size;
+        }
+
+        default: UNREACHED;
+    }
+}
+
+int64_t align_of(const Node *type)
+{
+    switch (type->kind)
+    {
+        case NodeKind::array_type:  return align_of(static_cast<const ArrayTypeNode *>(type)->element_type);
+        case NodeKind::struct_type: return static_cast<const StructTypeNode *>(type)->alignment;
+        case NodeKind::slice_type:  return 8;
+
+        // Vectors are aligned to their size (which is a power of two) like in LLVM
+        default: return size_of(type);
+    }
+}
+
+int64_t soa_field_offset(const ArrayTypeNode *array, int64_t field_index)
+{
+    auto struct_type = node_cast<StructTypeNode, true>(array->element_type);
+    auto length      = array_length(array);
+
+    int64_t offset{};
+    for (auto i = 0; i <= field_index && i < struct_type->fields.size(); ++i)
+    {
+        auto &field    = struct_type->fields[i];
+        auto alignment = struct_type->field_alignment(field);
+        offset         = (offset + alignment - 1) / alignment * alignment;
+
+        if (i < field_index)
+        {
+            offset += length * size_of(field.type);
+        }
+    }
+
+    return offset;
+}
+
+int64_t evaluate_layout_query(const ProcedureCallNode *call)
+{
+    auto type = call->arguments[0];
+
+    switch (call->intrinsic)
+    {
+        case Intrinsic::size_of:  return size_of(type);
+        case Intrinsic::align_of: return align_of(type);
+
+        case Intrinsic::offset_of:
+        {
+            auto struct_type = node_cast<StructTypeNode, true>(type);
+            auto field       = node_cast<IdentifierNode, true>(call->arguments[1]);
+            return struct_type->fields[struct_type->find_field(field->identifier)].offset;
+        }
+
+        default: UNREACHED;
+    }
+}
+
+ThreadEnvironment thread_environment(const ProcedureCallNode *call)
+{
+    ThreadEnvironment environment{};
+    for (auto argument : call->arguments)
+    {
+        auto type      = argument->inferred_type();
+        auto alignment = align_of(type);
+        auto offset    = (environment.size + alignment - 1) / alignment * alignment;
+
+        environment.offsets.push_back(offset);
+        environment.size      = offset + size_of(type);
+        environment.alignment = std::max(environment.alignment, alignment);
+    }
+
+    return environment;
+}
+
+ProcedureNode *async_procedure(const Node *node)
+{
+    auto call  = node_cast<ProcedureCallNode>(node);
+    auto ident = call != nullptr ? node_cast<IdentifierNode>(call->procedure) : nullptr;
+    if (ident == nullptr || ident->declaration == nullptr || call->intrinsic != Intrinsic::none)
+    {
+        return nullptr;
+    }
+
+    auto procedure = node_cast<ProcedureNode>(ident->declaration->init_expression);
+    return procedure != nullptr && procedure->is_async ? procedure : nullptr;
+}
+
 DeclarationNode *BlockNode::find_declaration(std::string_view name, bool recurse) const
 {
     auto it = this->declarations.find(std::string{name});
@@ -4,6 +4,7 @@
 #include "lex.h"
 
 #include <cstdint>
+#include <deque>
 
 namespace llvm
 {
@@ -11,7 +12,9 @@ namespace llvm
     class BasicBlock;
 }  // namespace llvm
 
+struct AstNode;
 struct BlockNode;
+struct StructTypeNode;
 
 enum class NodeKind
 {
@@ -20,27 +23,72 @@ enum class NodeKind
     block,
     continue_statement,
     declaration,
+    generic,
     goto_statement,
     identifier,
     if_statement,
+    index,
     label,
     literal,
+    member_access,
     module,
     procedure,
     procedure_call,
     procedure_signature,
     return_statement,
+    slice,
     type_cast,
     while_loop,
 
     basic_type,
     pointer_type,
     array_type,
+    slice_type,
+    vector_type,
     struct_type,
 
     nop,
 };
 
+constexpr size_t num_node_kinds = static_cast<size_t>(NodeKind::nop) + 1;
+
+inline std::string_view to_string(NodeKind kind)
+{
+    switch (kind)
+    {
+        case NodeKind::binary_operator:     return "binary_operator";
+        case NodeKind::break_statement:     return "break_statement";
+        case NodeKind::block:               return "block";
+        case NodeKind::continue_statement:  return "continue_statement";
+        case NodeKind::declaration:         return "declaration";
+        case NodeKind::generic:             return "generic";
+        case NodeKind::goto_statement:      return "goto_statement";
+        case NodeKind::identifier:          return "identifier";
+        case NodeKind::if_statement:        return "if_statement";
+        case NodeKind::index:               return "index";
+        case NodeKind::label:               return "label";
+        case NodeKind::literal:             return "literal";
+        case NodeKind::member_access:       return "member_access";
+        case NodeKind::module:              return "module";
+        case NodeKind::procedure:           return "procedure";
+        case NodeKind::procedure_call:      return "procedure_call";
+        case NodeKind::procedure_signature: return "procedure_signature";
+        case NodeKind::return_statement:    return "return_statement";
+        case NodeKind::slice:               return "slice";
+        case NodeKind::type_cast:           return "type_cast";
+        case NodeKind::while_loop:          return "while_loop";
+        case NodeKind::basic_type:          return "basic_type";
+        case NodeKind::pointer_type:        return "pointer_type";
+        case NodeKind::array_type:          return "array_type";
+        case NodeKind::slice_type:          return "slice_type";
+        case NodeKind::vector_type:         return "vector_type";
+        case NodeKind::struct_type:         return "struct_type";
+        case NodeKind::nop:                 return "nop";
+    }
+
+    UNREACHED;
+}
+
 struct Node
 {
     NodeKind kind{};
@@ -140,6 +188,7 @@ struct DeclarationNode : NodeOfKind<NodeKind::declaration>
     Node *specified_type{};
     Node *init_expression{};
     bool is_procedure_argument{};
+    bool is_constant{};  // Initialized with a literal and never assigned to, set by the typechecker
     BlockNode *containing_block{};
 
     llvm::Value *named_value{};
@@ -175,7 +224,27 @@ inline bool DeclarationNode::is_global() const
 struct IdentifierNode : NodeOfKind<NodeKind::identifier>
 {
     std::string_view identifier{};
-    DeclarationNode *declaration{};
+    std::vector<Node *> type_arguments{};  // The explicit or inferred type arguments of a generic declaration
+    DeclarationNode *declaration{};        // The declaration of the instance if the identifier refers to a generic
+};
+
+// A generic procedure or struct (proc<T type>(...) or struct<T type> {...}). The definition is kept as syntax and
+// converted once per combination of type arguments, with the type parameters replaced by the type arguments. The
+// typechecker creates the instances when they are used and appends their declarations to the module, the generic
+// itself has no code.
+struct GenericNode : NodeOfKind<NodeKind::generic>
+{
+    struct Instance
+    {
+        std::vector<Node *> type_arguments{};
+        std::string identifier{};  // <name><<type>, ...>
+        DeclarationNode *declaration{};
+        bool has_errors{};
+    };
+
+    std::vector<std::string_view> type_parameters{};
+    AstNode *definition{};
+    std::deque<Instance> instances{};  // A deque, the declarations refer to the identifiers of the instances
 };
 
 struct IfStatementNode : NodeOfKind<NodeKind::if_statement>
@@ -185,11 +254,32 @@ struct IfStatementNode : NodeOfKind<NodeKind::if_statement>
     BlockNode *else_block{};
 };
 
+// @reduce(<operator>, <variable>) of a parallel for loop: every thread works on its own copy of the variable, which
+// starts out as the identity of the operator, and the copies are combined with the variable at the end
+struct Reduction
+{
+    enum class Kind
+    {
+        sum,
+        min,
+        max,
+    };
+
+    Kind kind{};
+    IdentifierNode *variable{};
+};
+
 struct WhileLoopNode : NodeOfKind<NodeKind::while_loop>
 {
     Node *condition{};
     BlockNode *body{};
     Node *prologue{};
+
+    // Desugared parallel for loops run their iterations concurrently, see TypeChecker::check_parallel_loop
+    bool is_parallel{};
+    Node *grain_size{};  // nullptr to let the runtime choose
+    std::vector<Reduction> reductions{};
+    std::vector<DeclarationNode *> captures{};  // The local variables that the body reads, set by the typechecker
 };
 
 struct BreakStatementNode : NodeOfKind<NodeKind::break_statement>
@@ -218,17 +308,132 @@ struct ProcedureNode : NodeOfKind<NodeKind::procedure>
     ProcedureSignatureNode *signature{};
     BlockNode *body{};
     bool is_external{};
+    bool is_async{};     // Calls create tasks instead of running the procedure (see Intrinsic::run)
+    bool is_inline{};    // @inline: always inlined into its callers
+    bool is_noinline{};  // @noinline: never inlined
+    bool is_hot{};       // @hot: called often, optimized for speed
+    bool is_cold{};      // @cold: rarely called, optimized for size and kept out of the way of the hot code
+    bool is_flatten{};   // @flatten: the calls in its body are inlined into it
+};
+
+// The builtin procedures, calls to them are resolved by the typechecker (see VectorTypeNode)
+enum class Intrinsic
+{
+    none,
+    make_vector,  // v4f32(x, y, z, w) or v4f32(x): the vector with the given lanes, or all lanes set to x
+    extract,      // extract(v, lane): the value of the lane
+    insert,       // insert(v, lane, x): v with the lane set to x
+    shuffle,      // shuffle(a, b, lanes...): the lanes of a followed by those of b, picked by constant indices
+    swizzle,      // swizzle(v, lanes...): the lanes of v, picked by constant indices
+    select,       // select(mask, a, b): the lanes of a where the mask is set, the lanes of b elsewhere
+    reduce_add,   // reduce_add(v): the sum of the lanes, from the first to the last
+    reduce_mul,   // reduce_mul(v): the product of the lanes, from the first to the last
+    reduce_min,   // reduce_min(v): the smallest lane
+    reduce_max,   // reduce_max(v): the largest lane
+    any,          // any(mask): whether a lane of the mask is set
+    all,          // all(mask): whether all lanes of the mask are set
+
+    // The layout of a type, folded to u64 literals by the typechecker (see StructTypeNode)
+    size_of,      // sizeof(T): the size of a value of the type in bytes
+    align_of,     // alignof(T): the alignment of the type in bytes
+    offset_of,    // offsetof(T, field): the offset of the field in the struct type in bytes
+
+    // Atomic operations on a variable, a field or an array element x, the last argument is the memory order (see
+    // MemoryOrder). The read-modify-write operations return the previous value of x.
+    atomic_load,              // atomic_load(x, order): the value of x
+    atomic_store,             // atomic_store(x, value, order): sets x to the value
+    atomic_exchange,          // atomic_exchange(x, value, order): sets x to the value
+    atomic_compare_exchange,  // atomic_compare_exchange(x, expected, desired, order): x = desired if x == expected
+    atomic_add,               // atomic_add(x, value, order): adds the value to x
+    atomic_sub,               // atomic_sub(x, value, order): subtracts the value from x
+    atomic_and,               // atomic_and(x, value, order): sets x to x & value
+    atomic_or,                // atomic_or(x, value, order): sets x to x | value
+    atomic_xor,               // atomic_xor(x, value, order): sets x to x ^ value
+    atomic_min,               // atomic_min(x, value, order): sets x to the smaller of x and the value
+    atomic_max,               // atomic_max(x, value, order): sets x to the larger of x and the value
+    atomic_fence,             // atomic_fence(order): orders the memory accesses before and after it
+
+    // Threads of the runtime library (see runtime.h)
+    spawn,  // spawn(f(arguments...)): calls the procedure on a new thread and returns the handle of the thread, a u64
+    join,   // join(thread): waits until the thread returns, every thread has to be joined exactly once
+
+    // Tasks, the calls of async procedures. A task runs until it awaits another task that is not done or yields, then
+    // the executor of the runtime library runs the next task that is ready on the same thread (see runtime.h).
+    // The frames of the tasks are allocated from the arena of run, the calls are the last arguments.
+    run,    // run(arena, f(arguments...)): runs the task and the tasks it starts until all are done, returns its result
+    start,  // start(f(arguments...)): starts the task and returns its handle, a u64, f cannot return a value
+    await,  // await(f(arguments...)) or await(task): starts the task if it is a call and waits until it is done
+    yield,  // yield(): lets the other tasks that are ready run first
+};
+
+inline bool is_layout_query(Intrinsic intrinsic)
+{
+    return intrinsic == Intrinsic::size_of || intrinsic == Intrinsic::align_of || intrinsic == Intrinsic::offset_of;
+}
+
+inline bool is_atomic(Intrinsic intrinsic)
+{
+    return intrinsic >= Intrinsic::atomic_load && intrinsic <= Intrinsic::atomic_fence;
+}
+
+inline bool is_task_intrinsic(Intrinsic intrinsic)
+{
+    return intrinsic >= Intrinsic::run && intrinsic <= Intrinsic::yield;
+}
+
+// The memory orders of the atomic intrinsics, they mean the same as the ones of C++. A compare-exchange that fails
+// only reads, with the strongest order that is valid for a load.
+enum class MemoryOrder
+{
+    none,
+    relaxed,
+    acquire,
+    release,
+    acq_rel,
+    seq_cst,
 };
 
 struct ProcedureCallNode : NodeOfKind<NodeKind::procedure_call>
 {
     Node *procedure{};
     std::vector<Node *> arguments{};
+    bool is_compile_time{};  // #run, the typechecker runs the call and replaces it with its result
+    Intrinsic intrinsic{};   // Set by the typechecker, the procedure is an identifier without a declaration then
+                             // (the first argument of a layout query is replaced with the type)
+    std::vector<int64_t> lanes{};  // The constant lane indices of extract, insert, shuffle and swizzle
+    MemoryOrder memory_order{};    // The order of an atomic intrinsic, the typechecker removes its argument
+};
+
+// <object>.<member>, the object is a struct
+struct MemberAccessNode : NodeOfKind<NodeKind::member_access>
+{
+    Node *object{};
+    std::string_view member{};
+    int64_t field_index = -1;  // Set by the typechecker
+};
+
+// <array>[<index>], the index is an integer
+struct IndexNode : NodeOfKind<NodeKind::index>
+{
+    Node *array{};
+    Node *index{};
+    bool needs_bounds_check = true;  // Cleared by the typechecker if the index is known to be in bounds
+};
+
+// <object>[<begin>:<end>], the elements begin to end (exclusive) of an array or a slice as a slice. The bounds default
+// to 0 and the length of the object.
+struct SliceNode : NodeOfKind<NodeKind::slice>
+{
+    Node *object{};
+    Node *begin{};  // nullptr if omitted
+    Node *end{};    // nullptr if omitted
+    bool needs_bounds_check = true;
 };
 
 struct ReturnStatementNode : NodeOfKind<NodeKind::return_statement>
 {
     Node *expression{};
+    bool is_tail_call{};  // The called procedure returns to the caller of the procedure directly (see TypeChecker)
 };
 
 struct TypeCastNode : NodeOfKind<NodeKind::type_cast>
@@ -290,17 +495,138 @@ struct PointerTypeNode : NodeOfKind<NodeKind::pointer_type>
     Node *target_type{};
 };
 
+// [N]T, or @soa [N]T with a struct element type: the elements are stored as one array per field, in the order of the
+// fields (each aligned like the field), and a[i].x stays the way to access them. The elements of such an array can
+// only be accessed through their fields.
 struct ArrayTypeNode : NodeOfKind<NodeKind::array_type>
 {
     Node *length{};
     Node *element_type{};
+    bool is_soa{};
+};
+
+// []T, the address of the first element and the number of elements. Arrays that are not @soa convert to slices of
+// all their elements implicitly. A slice is laid out like 'struct { data: *T length: i64 }' (see struct_layout), its
+// fields can be read but not assigned.
+struct SliceTypeNode : NodeOfKind<NodeKind::slice_type>
+{
+    constexpr static int64_t data_offset   = 0;
+    constexpr static int64_t length_offset = 8;
+
+    Node *element_type{};
+    StructTypeNode *layout{};  // Created by the typechecker
+};
+
+// A fixed number of lanes of a numerical type or of bool (a mask), written v<lanes><element type> (e.g. v4f32).
+// The operators work on the lanes element-wise, comparisons produce masks. A scalar operand is converted to the
+// element type and set into all lanes. The other operations are intrinsics (see Intrinsic).
+struct VectorTypeNode : NodeOfKind<NodeKind::vector_type>
+{
+    constexpr static int64_t max_length = 64;
+
+    int64_t length{};
+    BasicTypeNode *element_type{};
+
+    // The number of lanes is a power of two
+    static bool is_valid_length(int64_t length)
+    {
+        return length >= 2 && length <= max_length && (length & (length - 1)) == 0;
+    }
 };
 
+// The number of lanes of a vector type, 1 for all other types
+inline int64_t num_lanes(const Node *type)
+{
+    auto vector_type = node_cast<VectorTypeNode>(type);
+    return vector_type != nullptr ? vector_type->length : 1;
+}
+
+// The element type of a vector type, the type itself for basic types
+inline const BasicTypeNode *lane_type(const Node *type)
+{
+    if (auto vector_type = node_cast<VectorTypeNode>(type))
+    {
+        return vector_type->element_type;
+    }
+
+    return node_cast<BasicTypeNode, true>(type);
+}
+
+struct StructField
+{
+    std::string_view identifier{};
+    Node *type{};
+    int64_t alignment{};  // @align(N), 0 for the alignment of the type
+    int64_t offset = -1;
+};
+
+// The fields are laid out in order like in C: each field is placed at the next offset that is a multiple of its
+// alignment and the size is rounded up to a multiple of the alignment of the struct, the largest alignment of the
+// fields. In a @packed struct the fields have an alignment of 1 unless it is specified with @align(N), @align(N) on
+// the struct raises its alignment. The layout is computed by the typechecker.
+// Struct types are nominal, two struct types are only equal if they are the same node.
 struct StructTypeNode : NodeOfKind<NodeKind::struct_type>
 {
-    // TODO
+    std::string_view identifier{};  // The name of the declaration of the type, empty for anonymous structs
+    std::vector<StructField> fields{};
+    bool is_packed{};
+    int64_t alignment{};  // @align(N) or the largest alignment of the fields once the layout has been computed
+    int64_t size = -1;
+
+    inline bool has_layout() const { return this->size >= 0; }
+
+    // The index of the field or -1
+    int64_t find_field(std::string_view identifier) const;
+
+    int64_t field_alignment(const StructField &field) const;
+};
+
+// Structs, arrays and slices, their values are held in memory instead of registers
+inline bool is_aggregate(const Node *type)
+{
+    return type->kind == NodeKind::struct_type || type->kind == NodeKind::array_type ||
+           type->kind == NodeKind::slice_type;
+}
+
+// The struct whose fields the members of a value of the type are, nullptr if the type has no members
+inline const StructTypeNode *struct_layout(const Node *type)
+{
+    if (auto slice_type = node_cast<SliceTypeNode>(type))
+    {
+        return slice_type->layout;
+    }
+
+    return node_cast<StructTypeNode>(type);
+}
+
+// The number of elements of the array type, its length expression has been folded to a literal by the typechecker
+int64_t array_length(const ArrayTypeNode *array);
+
+// The size of a value of the type in memory and its alignment, both in bytes. The layout of struct types must have
+// been computed.
+int64_t size_of(const Node *type);
+int64_t align_of(const Node *type);
+
+// The offset of the array of the field in a @soa array, relative to the start of the array
+int64_t soa_field_offset(const ArrayTypeNode *array, int64_t field_index);
+
+// The value of a call to sizeof, alignof or offsetof whose arguments have been resolved by the typechecker
+int64_t evaluate_layout_query(const ProcedureCallNode *call);
+
+// The memory that spawn(f(...)) copies the arguments of the call to, so the new thread can read them after the calling
+// thread moved on. The arguments are laid out like the fields of a struct.
+struct ThreadEnvironment
+{
+    std::vector<int64_t> offsets{};  // One per argument
+    int64_t size{};
+    int64_t alignment = 1;
 };
 
+ThreadEnvironment thread_environment(const ProcedureCallNode *call);
+
+// The procedure that the node calls if it is a call to an async procedure (see Intrinsic::run), nullptr otherwise
+ProcedureNode *async_procedure(const Node *node);
+
 // This node is implicitly created for optional expressions that have been omitted
 // (like the init expression of a local variable)
 struct NopNode : NodeOfKind<NodeKind::nop>
@@ -354,11 +680,14 @@ struct NodeVisitorBase
     inline virtual void visit(BreakStatementNode *break_statement) { }
     inline virtual void visit(ContinueStatementNode *continue_statement) { }
     inline virtual void visit(DeclarationNode *declaration) { }
+    inline virtual void visit(GenericNode *generic) { }
     inline virtual void visit(GotoStatementNode *goto_statement) { }
     inline virtual void visit(IdentifierNode *identifier) { }
     inline virtual void visit(IfStatementNode *if_statement) { }
+    inline virtual void visit(IndexNode *index) { }
     inline virtual void visit(LabelNode *label) { }
     inline virtual void visit(LiteralNode *literal) { }
+    inline virtual void visit(MemberAccessNode *member_access) { }
     inline virtual void visit(ModuleNode *module) { }
     inline virtual void visit(NopNode *nop) { }
     inline virtual void visit(PointerTypeNode *pointer_type) { }
@@ -366,8 +695,11 @@ struct NodeVisitorBase
     inline virtual void visit(ProcedureNode *procedure) { }
     inline virtual void visit(ProcedureSignatureNode *procedure_signature) { }
     inline virtual void visit(ReturnStatementNode *return_statement) { }
+    inline virtual void visit(SliceNode *slice) { }
+    inline virtual void visit(SliceTypeNode *slice_type) { }
     inline virtual void visit(StructTypeNode *struct_type) { }
     inline virtual void visit(TypeCastNode *type_cast) { }
+    inline virtual void visit(VectorTypeNode *vector_type) { }
     inline virtual void visit(WhileLoopNode *while_loop) { }
 };
 
@@ -479,6 +811,18 @@ inline void visit(Node *node, NodeVisitorBase &visitor)
         return;
     }
 
+    // The instances are not visited here but as the declarations of the module that they are appended to
+    if (auto generic = node_cast<GenericNode>(node))
+    {
+        visitor.visit(generic);
+        if (visitor.is_done())
+        {
+            return;
+        }
+
+        return;
+    }
+
     if (auto goto_statement = node_cast<GotoStatementNode>(node))
     {
         visitor.visit(goto_statement);
@@ -516,6 +860,20 @@ inline void visit(Node *node, NodeVisitorBase &visitor)
         return;
     }
 
+    if (auto index = node_cast<IndexNode>(node))
+    {
+        visitor.visit(index);
+        if (visitor.is_done())
+        {
+            return;
+        }
+
+        visit(index->array, visitor);
+        visit(index->index, visitor);
+
+        return;
+    }
+
     if (auto label = node_cast<LabelNode>(node))
     {
         visitor.visit(label);
@@ -538,6 +896,19 @@ inline void visit(Node *node, NodeVisitorBase &visitor)
         return;
     }
 
+    if (auto member_access = node_cast<MemberAccessNode>(node))
+    {
+        visitor.visit(member_access);
+        if (visitor.is_done())
+        {
+            return;
+        }
+
+        visit(member_access->object, visitor);
+
+        return;
+    }
+
     if (auto module = node_cast<ModuleNode>(node))
     {
         visitor.visit(module);
@@ -649,14 +1020,42 @@ inline void visit(Node *node, NodeVisitorBase &visitor)
         return;
     }
 
+    if (auto slice = node_cast<SliceNode>(node))
+    {
+        visitor.visit(slice);
+        if (visitor.is_done())
+        {
+            return;
+        }
+
+        visit(slice->object, visitor);
+        visit(slice->begin, visitor);
+        visit(slice->end, visitor);
+
+        return;
+    }
+
+    if (auto slice_type = node_cast<SliceTypeNode>(node))
+    {
+        visitor.visit(slice_type);
+        if (visitor.is_done())
+        {
+            return;
+        }
+
+        visit(slice_type->element_type, visitor);
+
+        return;
+    }
+
     if (auto struct_type = node_cast<StructTypeNode>(node))
     {
-        TODO;
-        // f(struct_type);
+        visitor.visit(struct_type);
 
-        // visit(struct_type->xxx, f);
+        // NOTE: The types of the fields are not visited, a struct type can be reached again through them (like in
+        // 'Node := struct { next: *Node }')
 
-        // return;
+        return;
     }
 
     if (auto type_cast = node_cast<TypeCastNode>(node))
@@ -673,6 +1072,19 @@ inline void visit(Node *node, NodeVisitorBase &visitor)
         return;
     }
 
+    if (auto vector_type = node_cast<VectorTypeNode>(node))
+    {
+        visitor.visit(vector_type);
+        if (visitor.is_done())
+        {
+            return;
+        }
+
+        visit(vector_type->element_type, visitor);
+
+        return;
+    }
+
     if (auto while_loop = node_cast<WhileLoopNode>(node))
     {
         visitor.visit(while_loop);
@@ -683,6 +1095,13 @@ inline void visit(Node *node, NodeVisitorBase &visitor)
 
         visit(while_loop->condition, visitor);
         visit(while_loop->body, visitor);
+        visit(while_loop->prologue, visitor);
+        visit(while_loop->grain_size, visitor);
+
+        for (auto &reduction : while_loop->reductions)
+        {
+            visit(reduction.variable, visitor);
+        }
 
         return;
     }
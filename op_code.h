@@ -0,0 +1,389 @@
+#pragma once
+
+#include "basics.h"
+
+#include <cassert>
+#include <cstdint>
+
+// Instructions of the bytecode interpreter (see vm.h).
+// The interpreter is register based: every procedure has a frame of 64 bit registers, the arguments are the first
+// registers, followed by the locals and the temporaries. Integers narrower than 64 bits are kept sign- or
+// zero-extended depending on their signedness, booleans are 0 or 1, and all floating point values are kept as
+// doubles - f32 results are rounded to float precision with ROUNDF, which gives the same result as computing in float.
+//
+// The operands follow the op code in the order of the op format (see OpFormat):
+// d, a, b:  destination and source registers (u16)
+// imm:      64 bit immediate
+// bytes:    width of an integer in bytes (u8)
+// target:   absolute bytecode position of a jump target (i32)
+// index:    procedure or external call index (u32)
+//
+// NOTE: Bytecode images (see bytecode_image.h) store the op codes, bump bytecode_image_version when changing them.
+enum OpCode : uint8_t
+{
+    // Moves
+    MOV,    // d, a:      d = a;
+    LOADI,  // d, imm:    d = imm;
+    LOADS,  // d, imm:    d = address of the string at offset imm in the string table;
+
+    // Integer arithmetic
+    ADD,     // d, a, b:   d = a + b;
+    ADDI,    // d, a, imm: d = a + imm;
+    SUB,     // d, a, b:   d = a - b;
+    MUL,     // d, a, b:   d = a * b;
+    DIVS,    // d, a, b:   d = (i64)a / (i64)b;
+    DIVU,    // d, a, b:   d = (u64)a / (u64)b;
+    MODS,    // d, a, b:   d = (i64)a % (i64)b;
+    MODU,    // d, a, b:   d = (u64)a % (u64)b;
+    BITAND,  // d, a, b:   d = a & b;
+    BITOR,   // d, a, b:   d = a | b;
+    BITXOR,  // d, a, b:   d = a ^ b;
+    LSH,     // d, a, b:   d = a << b;
+    RSH,     // d, a, b:   d = (u64)a >> b;
+
+    // Integer width conversion
+    SEXT,  // d, a, bytes: d = a truncated to bytes and sign extended;
+    ZEXT,  // d, a, bytes: d = a truncated to bytes and zero extended;
+
+    // Integer comparisons
+    CMPEQ,   // d, a, b: d = a == b;
+    CMPNE,   // d, a, b: d = a != b;
+    CMPLT,   // d, a, b: d = (i64)a < (i64)b;
+    CMPLE,   // d, a, b: d = (i64)a <= (i64)b;
+    CMPGT,   // d, a, b: d = (i64)a > (i64)b;
+    CMPGE,   // d, a, b: d = (i64)a >= (i64)b;
+    CMPLTU,  // d, a, b: d = (u64)a < (u64)b;
+    CMPLEU,  // d, a, b: d = (u64)a <= (u64)b;
+    CMPGTU,  // d, a, b: d = (u64)a > (u64)b;
+    CMPGEU,  // d, a, b: d = (u64)a >= (u64)b;
+
+    // Floating point arithmetic and (ordered) comparisons
+    FADD,    // d, a, b: d = a + b;
+    FSUB,    // d, a, b: d = a - b;
+    FMUL,    // d, a, b: d = a * b;
+    FDIV,    // d, a, b: d = a / b;
+    FMOD,    // d, a, b: d = fmod(a, b);
+    FCMPEQ,  // d, a, b: d = a == b;
+    FCMPNE,  // d, a, b: d = a < b || a > b;
+    FCMPLT,  // d, a, b: d = a < b;
+    FCMPLE,  // d, a, b: d = a <= b;
+    FCMPGT,  // d, a, b: d = a > b;
+    FCMPGE,  // d, a, b: d = a >= b;
+
+    // Floating point conversion
+    ROUNDF,  // d, a: d = (f64)(f32)a;
+    ITOF,    // d, a: d = (f64)(i64)a;
+    UTOF,    // d, a: d = (f64)(u64)a;
+
+    // Memory. Structs and arrays live in the frame memory of the procedure (see VmProcedure::frame_size), their
+    // registers hold their addresses. f64 values and pointers are loaded and stored with 8 bytes.
+    ADDR,    // d, imm:      d = address of the frame memory + imm;
+    LOAD,    // d, a, bytes: d = the integer of the size at address a, zero extended;
+    LOADF,   // d, a:        d = (f64) the f32 at address a;
+    STORE,   // d, a, bytes: stores a truncated to bytes at address d;
+    STOREF,  // d, a:        stores (f32)a at address d;
+    COPY,    // d, a, imm:   copies imm bytes from address a to address d;
+    ZERO,    // d, imm:      sets imm bytes at address d to 0;
+
+    // Bounds checks of indices and slices, the program is aborted if they fail
+    CHKLTU,  // d, a: checks (u64)d < (u64)a;
+    CHKLEU,  // d, a: checks (u64)d <= (u64)a;
+
+    // (Conditional) jumping
+    JMP,    // target:    jmp target;
+    JMPZ,   // a, target: if a == 0 jmp target;
+    JMPNZ,  // a, target: if a != 0 jmp target;
+
+    // Fused integer compare and branch
+    JEQ,   // a, b, target: if a == b jmp target;
+    JNE,   // a, b, target: if a != b jmp target;
+    JLT,   // a, b, target: if (i64)a < (i64)b jmp target;
+    JLE,   // a, b, target: if (i64)a <= (i64)b jmp target;
+    JGT,   // a, b, target: if (i64)a > (i64)b jmp target;
+    JGE,   // a, b, target: if (i64)a >= (i64)b jmp target;
+    JLTU,  // a, b, target: if (u64)a < (u64)b jmp target;
+    JLEU,  // a, b, target: if (u64)a <= (u64)b jmp target;
+    JGTU,  // a, b, target: if (u64)a > (u64)b jmp target;
+    JGEU,  // a, b, target: if (u64)a >= (u64)b jmp target;
+
+    // Fused integer compare with an immediate and branch
+    JEQI,   // a, imm, target: if a == imm jmp target;
+    JNEI,   // a, imm, target: if a != imm jmp target;
+    JLTI,   // a, imm, target: if (i64)a < (i64)imm jmp target;
+    JLEI,   // a, imm, target: if (i64)a <= (i64)imm jmp target;
+    JGTI,   // a, imm, target: if (i64)a > (i64)imm jmp target;
+    JGEI,   // a, imm, target: if (i64)a >= (i64)imm jmp target;
+    JLTUI,  // a, imm, target: if (u64)a < (u64)imm jmp target;
+    JLEUI,  // a, imm, target: if (u64)a <= (u64)imm jmp target;
+    JGTUI,  // a, imm, target: if (u64)a > (u64)imm jmp target;
+    JGEUI,  // a, imm, target: if (u64)a >= (u64)imm jmp target;
+
+    // Procedures
+    CALL,   // index, a, d: calls the procedure with the arguments in the registers starting at a, d = return value;
+    CALLX,  // index, a, d: calls the external (C) procedure of the call site with the arguments starting at a,
+            //              d = return value;
+    TCALL,  // index, a, d: replaces the frame with the one of the procedure, which takes the arguments starting at a
+            //              and returns to the caller (see ReturnStatementNode), or calls native code like CALL;
+    SPAWN,  // index, a, d: calls the procedure on a new thread, in an interpreter of its own, with the address of a
+            //              copy of the argument block, whose address, size and alignment are in the registers starting
+            //              at a, d = thread;
+    TASK,   // index, a, d: creates the task of the async procedure with the arguments starting at a and runs it until
+            //              it suspends for the first time, d = task (see Intrinsic::run);
+    AWAIT,  // d, a: suspends the task of the procedure until the task a is done, d = result of a, fails if another
+            //       task awaits a;
+    YIELD,  // suspends the task of the procedure, the executor resumes it after the other tasks that are ready;
+    RUN,    // d, a: runs the executor until no task is ready, d = result of the task a, fails if a is not done;
+    RET,    // a: returns a;
+    RETV,   // returns nothing;
+
+    // Superinstructions (see fuse_superinstructions), picked from the most frequent pairs of adjacent instructions.
+    // A superinstruction replaces the op code of the first instruction and has its operands, the second instruction
+    // follows unchanged. Both are executed with a single dispatch.
+    ADDI_JLTI,  // ADDI; JLTI (loop counter step and condition)
+    ADDI_CALL,  // ADDI; CALL (argument computation and call)
+    ADD_RET,    // ADD; RET
+    LOADI_MUL,  // LOADI; MUL (multiplication with a constant)
+    MUL_ADD,    // MUL; ADD
+};
+
+constexpr size_t num_op_codes = MUL_ADD + 1;
+
+struct Superinstruction
+{
+    OpCode op;
+    OpCode first;
+    OpCode second;
+};
+
+constexpr Superinstruction superinstructions[] = {
+    {ADDI_JLTI, ADDI, JLTI},
+    {ADDI_CALL, ADDI, CALL},
+    {ADD_RET, ADD, RET},
+    {LOADI_MUL, LOADI, MUL},
+    {MUL_ADD, MUL, ADD},
+};
+
+// The instruction that a superinstruction starts with, or the op code itself if it is not a superinstruction
+constexpr OpCode first_op_of(OpCode op)
+{
+    for (const auto &superinstruction : superinstructions)
+    {
+        if (superinstruction.op == op)
+        {
+            return superinstruction.first;
+        }
+    }
+
+    return op;
+}
+
+enum class OpFormat : uint8_t
+{
+    none,
+    a,
+    d_a,
+    d_imm,
+    d_a_b,
+    d_a_imm,
+    d_a_bytes,
+    target,
+    a_target,
+    a_b_target,
+    a_imm_target,
+    index_a_d,
+};
+
+inline const char *to_string(OpCode op)
+{
+    switch (op)
+    {
+        case OpCode::MOV:    return "MOV";
+        case OpCode::LOADI:  return "LOADI";
+        case OpCode::LOADS:  return "LOADS";
+        case OpCode::ADD:    return "ADD";
+        case OpCode::ADDI:   return "ADDI";
+        case OpCode::SUB:    return "SUB";
+        case OpCode::MUL:    return "MUL";
+        case OpCode::DIVS:   return "DIVS";
+        case OpCode::DIVU:   return "DIVU";
+        case OpCode::MODS:   return "MODS";
+        case OpCode::MODU:   return "MODU";
+        case OpCode::BITAND: return "BITAND";
+        case OpCode::BITOR:  return "BITOR";
+        case OpCode::BITXOR: return "BITXOR";
+        case OpCode::LSH:    return "LSH";
+        case OpCode::RSH:    return "RSH";
+        case OpCode::SEXT:   return "SEXT";
+        case OpCode::ZEXT:   return "ZEXT";
+        case OpCode::CMPEQ:  return "CMPEQ";
+        case OpCode::CMPNE:  return "CMPNE";
+        case OpCode::CMPLT:  return "CMPLT";
+        case OpCode::CMPLE:  return "CMPLE";
+        case OpCode::CMPGT:  return "CMPGT";
+        case OpCode::CMPGE:  return "CMPGE";
+        case OpCode::CMPLTU: return "CMPLTU";
+        case OpCode::CMPLEU: return "CMPLEU";
+        case OpCode::CMPGTU: return "CMPGTU";
+        case OpCode::CMPGEU: return "CMPGEU";
+        case OpCode::FADD:   return "FADD";
+        case OpCode::FSUB:   return "FSUB";
+        case OpCode::FMUL:   return "FMUL";
+        case OpCode::FDIV:   return "FDIV";
+        case OpCode::FMOD:   return "FMOD";
+        case OpCode::FCMPEQ: return "FCMPEQ";
+        case OpCode::FCMPNE: return "FCMPNE";
+        case OpCode::FCMPLT: return "FCMPLT";
+        case OpCode::FCMPLE: return "FCMPLE";
+        case OpCode::FCMPGT: return "FCMPGT";
+        case OpCode::FCMPGE: return "FCMPGE";
+        case OpCode::ROUNDF: return "ROUNDF";
+        case OpCode::ITOF:   return "ITOF";
+        case OpCode::UTOF:   return "UTOF";
+        case OpCode::ADDR:   return "ADDR";
+        case OpCode::LOAD:   return "LOAD";
+        case OpCode::LOADF:  return "LOADF";
+        case OpCode::STORE:  return "STORE";
+        case OpCode::STOREF: return "STOREF";
+        case OpCode::COPY:   return "COPY";
+        case OpCode::ZERO:   return "ZERO";
+        case OpCode::CHKLTU: return "CHKLTU";
+        case OpCode::CHKLEU: return "CHKLEU";
+        case OpCode::JMP:    return "JMP";
+        case OpCode::JMPZ:   return "JMPZ";
+        case OpCode::JMPNZ:  return "JMPNZ";
+        case OpCode::JEQ:    return "JEQ";
+        case OpCode::JNE:    return "JNE";
+        case OpCode::JLT:    return "JLT";
+        case OpCode::JLE:    return "JLE";
+        case OpCode::JGT:    return "JGT";
+        case OpCode::JGE:    return "JGE";
+        case OpCode::JLTU:   return "JLTU";
+        case OpCode::JLEU:   return "JLEU";
+        case OpCode::JGTU:   return "JGTU";
+        case OpCode::JGEU:   return "JGEU";
+        case OpCode::JEQI:   return "JEQI";
+        case OpCode::JNEI:   return "JNEI";
+        case OpCode::JLTI:   return "JLTI";
+        case OpCode::JLEI:   return "JLEI";
+        case OpCode::JGTI:   return "JGTI";
+        case OpCode::JGEI:   return "JGEI";
+        case OpCode::JLTUI:  return "JLTUI";
+        case OpCode::JLEUI:  return "JLEUI";
+        case OpCode::JGTUI:  return "JGTUI";
+        case OpCode::JGEUI:  return "JGEUI";
+        case OpCode::CALL:   return "CALL";
+        case OpCode::CALLX:  return "CALLX";
+        case OpCode::TCALL:  return "TCALL";
+        case OpCode::SPAWN:  return "SPAWN";
+        case OpCode::TASK:   return "TASK";
+        case OpCode::AWAIT:  return "AWAIT";
+        case OpCode::YIELD:  return "YIELD";
+        case OpCode::RUN:    return "RUN";
+        case OpCode::RET:    return "RET";
+        case OpCode::RETV:   return "RETV";
+
+        case OpCode::ADDI_JLTI: return "ADDI_JLTI";
+        case OpCode::ADDI_CALL: return "ADDI_CALL";
+        case OpCode::ADD_RET:   return "ADD_RET";
+        case OpCode::LOADI_MUL: return "LOADI_MUL";
+        case OpCode::MUL_ADD:   return "MUL_ADD";
+    }
+
+    UNREACHED;
+};
+
+constexpr OpFormat op_format(OpCode op)
+{
+    op = first_op_of(op);
+
+    switch (op)
+    {
+        case OpCode::RETV:
+        case OpCode::YIELD: return OpFormat::none;
+
+        case OpCode::RET: return OpFormat::a;
+
+        case OpCode::MOV:
+        case OpCode::ROUNDF:
+        case OpCode::ITOF:
+        case OpCode::UTOF:
+        case OpCode::LOADF:
+        case OpCode::STOREF:
+        case OpCode::CHKLTU:
+        case OpCode::CHKLEU:
+        case OpCode::AWAIT:
+        case OpCode::RUN:    return OpFormat::d_a;
+
+        case OpCode::LOADI:
+        case OpCode::LOADS:
+        case OpCode::ADDR:
+        case OpCode::ZERO:  return OpFormat::d_imm;
+
+        case OpCode::ADDI:
+        case OpCode::COPY: return OpFormat::d_a_imm;
+
+        case OpCode::SEXT:
+        case OpCode::ZEXT:
+        case OpCode::LOAD:
+        case OpCode::STORE: return OpFormat::d_a_bytes;
+
+        case OpCode::JMP: return OpFormat::target;
+
+        case OpCode::JMPZ:
+        case OpCode::JMPNZ: return OpFormat::a_target;
+
+        case OpCode::JEQ:
+        case OpCode::JNE:
+        case OpCode::JLT:
+        case OpCode::JLE:
+        case OpCode::JGT:
+        case OpCode::JGE:
+        case OpCode::JLTU:
+        case OpCode::JLEU:
+        case OpCode::JGTU:
+        case OpCode::JGEU: return OpFormat::a_b_target;
+
+        case OpCode::JEQI:
+        case OpCode::JNEI:
+        case OpCode::JLTI:
+        case OpCode::JLEI:
+        case OpCode::JGTI:
+        case OpCode::JGEI:
+        case OpCode::JLTUI:
+        case OpCode::JLEUI:
+        case OpCode::JGTUI:
+        case OpCode::JGEUI: return OpFormat::a_imm_target;
+
+        case OpCode::CALL:
+        case OpCode::CALLX:
+        case OpCode::TCALL:
+        case OpCode::SPAWN:
+        case OpCode::TASK:  return OpFormat::index_a_d;
+
+        default: return OpFormat::d_a_b;
+    }
+}
+
+// The size of the instruction in bytes, including the op code
+constexpr size_t instruction_size(OpCode op)
+{
+    constexpr size_t reg = sizeof(uint16_t), imm = sizeof(int64_t), target = sizeof(int32_t);
+
+    switch (op_format(op))
+    {
+        case OpFormat::none:         return 1;
+        case OpFormat::a:            return 1 + reg;
+        case OpFormat::d_a:          return 1 + 2 * reg;
+        case OpFormat::d_imm:        return 1 + reg + imm;
+        case OpFormat::d_a_b:        return 1 + 3 * reg;
+        case OpFormat::d_a_imm:      return 1 + 2 * reg + imm;
+        case OpFormat::d_a_bytes:    return 1 + 2 * reg + 1;
+        case OpFormat::target:       return 1 + target;
+        case OpFormat::a_target:     return 1 + reg + target;
+        case OpFormat::a_b_target:   return 1 + 2 * reg + target;
+        case OpFormat::a_imm_target: return 1 + reg + imm + target;
+        case OpFormat::index_a_d:    return 1 + sizeof(uint32_t) + 2 * reg;
+    }
+
+    UNREACHED;
+}
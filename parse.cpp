@@ -2,6 +2,7 @@
 
 #include "string_util.h"
 
+#include <bit>
 #include <charconv>
 #include <format>
 #include <iostream>
@@ -10,15 +11,22 @@
 
 struct Parser
 {
-    // TODO: operator new(size_t, Parser &) and then allocate all AST nodes with the memory pool
-    explicit Parser(const Lexer &lexer)
+    Parser(const Lexer &lexer, MemoryPool &pool)
         : lexer{lexer}
+        , pool{&pool}
     {
     }
 
     Lexer lexer;
+    MemoryPool *pool{};  // Owns the AST nodes
     const char *error_context{};
 
+    template<typename T, typename... Args>
+    T *make(Args &&...args) const
+    {
+        return this->pool->make<T>(std::forward<Args>(args)...);
+    }
+
     void arm(const char *context) { this->error_context = context; }
 
     [[nodiscard]] Parser quiet()
@@ -130,6 +138,8 @@ Parser parse_decl(Parser p, AstDeclaration &out_decl);
 Parser parse_block(Parser p, AstBlock &out_block, bool allow_raw_statement);
 Parser parse_type(Parser p, AstNode *&out_type);
 Parser parse_compiler_error_block(Parser p, AstBlock &out_block);
+Parser parse_expression_suffix(Parser p, AstNode *lhs, AstNode **node);
+Parser parse_parallel_annotation(Parser p, AstParallelOptions &out_options);
 
 Parser parse_statement(Parser p, AstNode *&out_statement)
 {
@@ -138,7 +148,7 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
     AstDeclaration decl{};
     if (p >>= parse_decl(p.quiet(), decl))
     {
-        out_statement = new AstDeclaration{std::move(decl)};
+        out_statement = p.make<AstDeclaration>(std::move(decl));
         return p;
     }
 
@@ -159,7 +169,7 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
             return start;
         }
 
-        yf.then_block = new AstBlock{std::move(then_block)};
+        yf.then_block = p.make<AstBlock>(std::move(then_block));
 
         if (p >>= p.quiet().parse_keyword("else"))
         {
@@ -170,10 +180,10 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
                 return start;
             }
 
-            yf.else_block = new AstBlock{std::move(else_block)};
+            yf.else_block = p.make<AstBlock>(std::move(else_block));
         }
 
-        out_statement = new AstIfStatement{std::move(yf)};
+        out_statement = p.make<AstIfStatement>(std::move(yf));
         return p;
     }
 
@@ -194,16 +204,22 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
             return start;
         }
 
-        whyle.block = new AstBlock{std::move(block)};
+        whyle.block = p.make<AstBlock>(std::move(block));
 
-        out_statement = new AstWhileLoop{std::move(whyle)};
+        out_statement = p.make<AstWhileLoop>(std::move(whyle));
         return p;
     }
 
-    if (p >>= p.quiet().parse_keyword("for"))
+    auto is_parallel = p >>= p.quiet().parse_keyword("parallel");
+    if (is_parallel || (p >>= p.quiet().parse_keyword("for")))
     {
         p.arm("parsing for loop");
 
+        if (is_parallel && !(p >>= p.parse_keyword("for")))
+        {
+            return start;
+        }
+
         AstForLoop foa{};
 
         if (!(p >>= p.parse_token(Tt::identifier, &foa.identifier)))
@@ -253,27 +269,39 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
             }
         }
 
+        if (is_parallel)
+        {
+            foa.parallel = p.make<AstParallelOptions>();
+            while (p.peek_token().type == Tt::at)
+            {
+                if (!(p >>= parse_parallel_annotation(p, *foa.parallel)))
+                {
+                    return start;
+                }
+            }
+        }
+
         AstBlock block{};
         if (!(p >>= parse_block(p, block, true)))
         {
             return start;
         }
 
-        foa.block = new AstBlock{std::move(block)};
+        foa.block = p.make<AstBlock>(std::move(block));
 
-        out_statement = new AstForLoop{std::move(foa)};
+        out_statement = p.make<AstForLoop>(std::move(foa));
         return p;
     }
 
     if (p >>= p.quiet().parse_keyword("break"))
     {
-        out_statement = new AstBreakStatement{};
+        out_statement = p.make<AstBreakStatement>();
         return p;
     }
 
     if (p >>= p.quiet().parse_keyword("continue"))
     {
-        out_statement = new AstContinueStatement{};
+        out_statement = p.make<AstContinueStatement>();
         return p;
     }
 
@@ -282,9 +310,24 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
         p.arm("parsing return statement");
 
         AstReturnStatement retyrn{};
-        p >>= parse_expr(p.quiet(), retyrn.expression);  // Empty return for void
 
-        out_statement = new AstReturnStatement{std::move(retyrn)};
+        // 'tail' is no keyword, it only makes a tail call when it is followed by a call on the same line
+        auto tail = p.quiet();
+        Token identifier{};
+        if ((tail >>= tail.parse_token(Tt::identifier, &identifier)) && identifier.text() == "tail" &&
+            tail.peek_token().pos.line == identifier.pos.line && (tail >>= parse_expr(tail, retyrn.expression)) &&
+            retyrn.expression->kind == AstKind::procedure_call)
+        {
+            retyrn.is_tail_call = true;
+            p                   = tail;
+        }
+        else
+        {
+            retyrn.expression = nullptr;
+            p >>= parse_expr(p.quiet(), retyrn.expression);  // Empty return for void
+        }
+
+        out_statement = p.make<AstReturnStatement>(std::move(retyrn));
         return p;
     }
 
@@ -298,7 +341,7 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
             return start;
         }
 
-        auto result        = new AstLabel{};
+        auto result        = p.make<AstLabel>();
         result->identifier = identifier.text();
         out_statement      = result;
         return p;
@@ -314,7 +357,7 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
             return start;
         }
 
-        auto result              = new AstGotoStatement{};
+        auto result              = p.make<AstGotoStatement>();
         result->label_identifier = identifier.text();
         out_statement            = result;
         return p;
@@ -323,13 +366,13 @@ Parser parse_statement(Parser p, AstNode *&out_statement)
     AstBlock block{};
     if (p >>= parse_block(p.quiet(), block, false))
     {
-        out_statement = new AstBlock{std::move(block)};
+        out_statement = p.make<AstBlock>(std::move(block));
         return p;
     }
 
     if (p >>= parse_compiler_error_block(p.quiet(), block))
     {
-        out_statement = new AstBlock{std::move(block)};
+        out_statement = p.make<AstBlock>(std::move(block));
         return p;
     }
 
@@ -438,7 +481,265 @@ Parser parse_compiler_error_block(Parser p, AstBlock &out_block)
     return p;
 }
 
-Parser parse_proc_signature(Parser p, AstProcedureSignature &out_signature)
+// Parses one annotation that controls the layout of a struct: @align(N) or @packed, which is only allowed if
+// out_is_packed is not null (before the fields of a struct)
+Parser parse_layout_annotation(Parser p, bool *out_is_packed, uint64_t &out_alignment)
+{
+    auto start = p;
+
+    if (!(p >>= p.quiet().parse_token(Tt::at)))
+    {
+        return start;
+    }
+
+    p.arm("parsing annotation");
+
+    Token identifier{};
+    if (!(p >>= p.parse_token(Tt::identifier, &identifier)))
+    {
+        return start;
+    }
+
+    if (identifier.text() == "packed" && out_is_packed != nullptr)
+    {
+        *out_is_packed = true;
+        return p;
+    }
+
+    if (identifier.text() != "align")
+    {
+        p.error(start, std::format("Invalid annotation @{}", identifier.text()));
+        return start;
+    }
+
+    Token number{};
+    if (!(p >>= p.parse_token(Tt::parenthesis_open)) || !(p >>= p.parse_token(Tt::number_literal, &number)))
+    {
+        return start;
+    }
+
+    uint64_t alignment{};
+    auto end    = number.pos.at + number.length;
+    auto result = std::from_chars(number.pos.at, end, alignment);
+    if (result.ec != std::errc{} || result.ptr != end || std::has_single_bit(alignment) == false)
+    {
+        p.error(start, "The argument of @align must be a power of two");
+        return start;
+    }
+
+    if (!(p >>= p.parse_token(Tt::parenthesis_close)))
+    {
+        return start;
+    }
+
+    out_alignment = alignment;
+    return p;
+}
+
+// Parses one annotation of a parallel for loop: @grain(<expression>) or @reduce(<operator>, <identifier>), where the
+// operator is one of +, min and max
+Parser parse_parallel_annotation(Parser p, AstParallelOptions &out_options)
+{
+    auto start = p;
+
+    if (!(p >>= p.quiet().parse_token(Tt::at)))
+    {
+        return start;
+    }
+
+    p.arm("parsing annotation");
+
+    Token identifier{};
+    if (!(p >>= p.parse_token(Tt::identifier, &identifier)) || !(p >>= p.parse_token(Tt::parenthesis_open)))
+    {
+        return start;
+    }
+
+    if (identifier.text() == "grain")
+    {
+        if (out_options.grain_size != nullptr)
+        {
+            p.error(start, "Duplicate annotation @grain");
+            return start;
+        }
+
+        if (!(p >>= parse_expr(p, out_options.grain_size)))
+        {
+            return start;
+        }
+    }
+    else if (identifier.text() == "reduce")
+    {
+        AstReduction reduction{};
+
+        reduction.operator_token = p.next_token();
+
+        auto type = reduction.operator_token.type;
+        auto text = reduction.operator_token.text();
+        if (type != Tt::plus && (type != Tt::identifier || (text != "min" && text != "max")))
+        {
+            p.error(start, "The operator of @reduce must be one of +, min and max");
+            return start;
+        }
+
+        if (!(p >>= p.parse_token(Tt::comma)) || !(p >>= p.parse_token(Tt::identifier, &reduction.identifier)))
+        {
+            return start;
+        }
+
+        out_options.reductions.push_back(reduction);
+    }
+    else
+    {
+        p.error(start, std::format("Invalid annotation @{}", identifier.text()));
+        return start;
+    }
+
+    if (!(p >>= p.parse_token(Tt::parenthesis_close)))
+    {
+        return start;
+    }
+
+    return p;
+}
+
+// Parses the type parameters of a generic procedure or struct: <T type, U type, ...>
+Parser parse_type_parameters(Parser p, std::vector<Token> &out_type_parameters)
+{
+    auto start = p;
+
+    if (!(p >>= p.quiet().parse_token(Tt::less_than)))
+    {
+        return start;
+    }
+
+    p.arm("parsing type parameters");
+
+    while (true)
+    {
+        Token parameter{};
+        Token kind{};
+        if (!(p >>= p.parse_token(Tt::identifier, &parameter)) || !(p >>= p.parse_token(Tt::identifier, &kind)))
+        {
+            return start;
+        }
+
+        if (kind.text() != "type")
+        {
+            p.error(start, std::format("Expected the kind type of the type parameter {}", parameter.text()));
+            return start;
+        }
+
+        out_type_parameters.push_back(parameter);
+
+        if (p >>= p.quiet().parse_token(Tt::greater_than))
+        {
+            return p;
+        }
+
+        if (!(p >>= p.parse_token(Tt::comma)))
+        {
+            return start;
+        }
+    }
+}
+
+// Parses the type arguments of the instance of a generic procedure or struct: <i64, *u8, ...>. Nested type arguments
+// have to be closed with '> >', because '>>' is the right shift operator.
+Parser parse_type_arguments(Parser p, std::vector<AstNode *> &out_type_arguments)
+{
+    auto start = p;
+
+    if (!(p >>= p.quiet().parse_token(Tt::less_than)))
+    {
+        return start;
+    }
+
+    while (true)
+    {
+        AstNode *argument{};
+        if (!(p >>= parse_type(p, argument)))
+        {
+            return start;
+        }
+
+        out_type_arguments.push_back(argument);
+
+        if (p >>= p.quiet().parse_token(Tt::greater_than))
+        {
+            return p;
+        }
+
+        if (!(p >>= p.parse_token(Tt::comma)))
+        {
+            return start;
+        }
+    }
+}
+
+Parser parse_struct_type(Parser p, AstStructType &out_struct)
+{
+    auto start = p;
+
+    if (!(p >>= p.quiet().parse_keyword("struct")))
+    {
+        return start;
+    }
+
+    p.arm("parsing struct type");
+
+    if (p.peek_token().type == Tt::less_than && !(p >>= parse_type_parameters(p, out_struct.type_parameters)))
+    {
+        return start;
+    }
+
+    while (p.peek_token().type == Tt::at)
+    {
+        if (!(p >>= parse_layout_annotation(p, &out_struct.is_packed, out_struct.alignment)))
+        {
+            return start;
+        }
+    }
+
+    if (!(p >>= p.parse_token(Tt::brace_open)))
+    {
+        return start;
+    }
+
+    while (true)
+    {
+        if (p >>= p.quiet().parse_token(Tt::brace_close))
+        {
+            return p;
+        }
+
+        AstStructField field{};
+        while (p.peek_token().type == Tt::at)
+        {
+            if (!(p >>= parse_layout_annotation(p, nullptr, field.alignment)))
+            {
+                return start;
+            }
+        }
+
+        if (!(p >>= p.parse_token(Tt::identifier, &field.identifier)) || !(p >>= p.parse_token(Tt::colon)))
+        {
+            return start;
+        }
+
+        if (!(p >>= parse_type(p, field.type)))
+        {
+            return start;
+        }
+
+        p >>= p.quiet().parse_token(Tt::comma);  // The fields can be separated by commas
+
+        out_struct.fields.push_back(field);
+    }
+}
+
+// The type parameters are only allowed if out_type_parameters is not null (for the definitions of procedures)
+Parser parse_proc_signature(Parser p, AstProcedureSignature &out_signature, std::vector<Token> *out_type_parameters)
 {
     auto start = p;
 
@@ -449,6 +750,12 @@ Parser parse_proc_signature(Parser p, AstProcedureSignature &out_signature)
 
     p.arm("parsing procedure signature");
 
+    if (out_type_parameters != nullptr && p.peek_token().type == Tt::less_than &&
+        !(p >>= parse_type_parameters(p, *out_type_parameters)))
+    {
+        return start;
+    }
+
     if (!(p >>= p.parse_token(Tt::parenthesis_open)))
     {
         return start;
@@ -485,7 +792,7 @@ Parser parse_proc_signature(Parser p, AstProcedureSignature &out_signature)
         }
 
         arg.is_procedure_argument = true;
-        out_signature.arguments.push_back(new AstDeclaration{std::move(arg)});
+        out_signature.arguments.push_back(p.make<AstDeclaration>(std::move(arg)));
 
         if (!(p >>= p.quiet().parse_token(Tt::comma)))
         {
@@ -503,20 +810,88 @@ Parser parse_proc_signature(Parser p, AstProcedureSignature &out_signature)
     return p;
 }
 
+// Parses one annotation of a procedure: @inline, @noinline, @hot, @cold or @flatten
+Parser parse_procedure_annotation(Parser p, AstProcedure &out_proc)
+{
+    auto start = p;
+
+    if (!(p >>= p.quiet().parse_token(Tt::at)))
+    {
+        return start;
+    }
+
+    p.arm("parsing annotation");
+
+    Token identifier{};
+    if (!(p >>= p.parse_token(Tt::identifier, &identifier)))
+    {
+        return start;
+    }
+
+    bool *flag{};
+    if (identifier.text() == "inline")
+    {
+        flag = &out_proc.is_inline;
+    }
+    else if (identifier.text() == "noinline")
+    {
+        flag = &out_proc.is_noinline;
+    }
+    else if (identifier.text() == "hot")
+    {
+        flag = &out_proc.is_hot;
+    }
+    else if (identifier.text() == "cold")
+    {
+        flag = &out_proc.is_cold;
+    }
+    else if (identifier.text() == "flatten")
+    {
+        flag = &out_proc.is_flatten;
+    }
+    else
+    {
+        p.error(start, std::format("Invalid annotation @{}", identifier.text()));
+        return start;
+    }
+
+    if (*flag)
+    {
+        p.error(start, std::format("Duplicate annotation @{}", identifier.text()));
+        return start;
+    }
+
+    *flag = true;
+    return p;
+}
+
 Parser parse_proc(Parser p, AstProcedure &out_proc)
 {
     auto start = p;
 
     AstProcedureSignature signature{};
-    if (!(p >>= parse_proc_signature(p.quiet(), signature)))
+    if (!(p >>= parse_proc_signature(p.quiet(), signature, &out_proc.type_parameters)))
     {
         return start;
     }
 
-    out_proc.signature = new AstProcedureSignature{std::move(signature)};
+    out_proc.signature = p.make<AstProcedureSignature>(std::move(signature));
 
     p.arm("parsing procedure");
 
+    while (p.peek_token().type == Tt::at)
+    {
+        if (!(p >>= parse_procedure_annotation(p, out_proc)))
+        {
+            return start;
+        }
+    }
+
+    if (p >>= p.quiet().parse_keyword("async"))
+    {
+        out_proc.is_async = true;
+    }
+
     if (p >>= p.quiet().parse_keyword("external"))
     {
         out_proc.is_external = true;
@@ -529,7 +904,7 @@ Parser parse_proc(Parser p, AstProcedure &out_proc)
         return start;
     }
 
-    out_proc.body = new AstBlock{std::move(body)};
+    out_proc.body = p.make<AstBlock>(std::move(body));
 
     return p;
 }
@@ -634,7 +1009,7 @@ Parser parse_primary_expr(Parser p, AstNode *&out_primary_expr)
 
         literal.suffix = suffix;
 
-        out_primary_expr = new AstLiteral{std::move(literal)};
+        out_primary_expr = p.make<AstLiteral>(std::move(literal));
         return p;
     }
 
@@ -685,21 +1060,76 @@ Parser parse_primary_expr(Parser p, AstNode *&out_primary_expr)
 
         literal.value.emplace<std::string>(escaped_string.data());
 
-        out_primary_expr = new AstLiteral{std::move(literal)};
+        out_primary_expr = p.make<AstLiteral>(std::move(literal));
+        return p;
+    }
+
+    if (p >>= p.quiet().parse_token(Tt::hash))
+    {
+        // #run <procedure call>
+        p.arm("parsing #run");
+
+        if (!(p >>= p.parse_token(Tt::identifier, &token)))
+        {
+            return start;
+        }
+
+        if (token.text() != "run")
+        {
+            p.error(start, std::format("Unknown directive #{}", token.text()));
+            return start;
+        }
+
+        AstNode *expression{};
+        if (!(p >>= parse_primary_expr(p, expression)))
+        {
+            return start;
+        }
+
+        while (p >>= parse_expression_suffix(p.quiet(), expression, &expression))
+        {
+        }
+
+        auto call = ast_cast<AstProcedureCall>(expression);
+        if (call == nullptr)
+        {
+            p.error(start, "#run expects a procedure call");
+            return start;
+        }
+
+        call->is_compile_time = true;
+
+        out_primary_expr = call;
         return p;
     }
 
     if (p >>= p.quiet().parse_token(Tt::identifier, &token))
     {
-        auto ident        = new AstIdentifier{};
+        auto ident        = p.make<AstIdentifier>();
         ident->identifier = token;
         out_primary_expr  = ident;
+
+        // Explicit type arguments of a generic procedure, which are only taken as such if they are followed by
+        // something that cannot continue a comparison, so that 'a < b' is still parsed as a comparison
+        auto arguments = p.quiet();
+        std::vector<AstNode *> type_arguments{};
+        if (arguments.peek_token().type == Tt::less_than &&
+            (arguments >>= parse_type_arguments(arguments, type_arguments)))
+        {
+            auto next = arguments.peek_token().type;
+            if (next == Tt::parenthesis_open || next == Tt::parenthesis_close || next == Tt::comma)
+            {
+                ident->type_arguments = std::move(type_arguments);
+                p >>= arguments;
+            }
+        }
+
         return p;
     }
 
     if (p >>= p.quiet().parse_keyword("true"))
     {
-        auto literal   = new AstLiteral{};
+        auto literal   = p.make<AstLiteral>();
         literal->token = token;
         literal->value.emplace<bool>(true);
 
@@ -708,7 +1138,7 @@ Parser parse_primary_expr(Parser p, AstNode *&out_primary_expr)
     }
     else if (p >>= p.quiet().parse_keyword("false"))
     {
-        auto literal   = new AstLiteral{};
+        auto literal   = p.make<AstLiteral>();
         literal->token = token;
         literal->value.emplace<bool>(false);
 
@@ -738,7 +1168,14 @@ Parser parse_primary_expr(Parser p, AstNode *&out_primary_expr)
     AstProcedure proc{};
     if (p >>= parse_proc(p.quiet(), proc))
     {
-        out_primary_expr = new AstProcedure{std::move(proc)};
+        out_primary_expr = p.make<AstProcedure>(std::move(proc));
+        return p;
+    }
+
+    AstStructType struct_type{};
+    if (p >>= parse_struct_type(p.quiet(), struct_type))
+    {
+        out_primary_expr = p.make<AstStructType>(std::move(struct_type));
         return p;
     }
 
@@ -789,7 +1226,66 @@ Parser parse_expression_suffix(Parser p, AstNode *lhs, AstNode **node)
             }
         }
 
-        *node = new AstProcedureCall{std::move(call)};
+        *node = p.make<AstProcedureCall>(std::move(call));
+        return p;
+    }
+
+    if (p >>= p.quiet().parse_token(Tt::dot))
+    {
+        p.arm("parsing member access");
+
+        AstMemberAccess member_access{};
+        member_access.object = lhs;
+
+        if (!(p >>= p.parse_token(Tt::identifier, &member_access.member)))
+        {
+            return start;
+        }
+
+        *node = p.make<AstMemberAccess>(std::move(member_access));
+        return p;
+    }
+
+    if (p >>= p.quiet().parse_token(Tt::bracket_open))
+    {
+        p.arm("parsing index");
+
+        AstNode *begin{};
+        if (p.peek_token().type != Tt::colon && !(p >>= parse_expr(p, begin)))
+        {
+            return start;
+        }
+
+        if (p >>= p.quiet().parse_token(Tt::colon))
+        {
+            AstSlice slice{};
+            slice.object = lhs;
+            slice.begin  = begin;
+
+            if (p.peek_token().type != Tt::bracket_close && !(p >>= parse_expr(p, slice.end)))
+            {
+                return start;
+            }
+
+            if (!(p >>= p.parse_token(Tt::bracket_close)))
+            {
+                return start;
+            }
+
+            *node = p.make<AstSlice>(std::move(slice));
+            return p;
+        }
+
+        AstIndex index{};
+        index.array = lhs;
+        index.index = begin;
+
+        if (!(p >>= p.parse_token(Tt::bracket_close)))
+        {
+            return start;
+        }
+
+        *node = p.make<AstIndex>(std::move(index));
         return p;
     }
 
@@ -807,7 +1303,9 @@ Parser parse_binary_expr(Parser p, AstNode *&out_node, int prev_prec)
     {
         return start;
     }
-    p >>= parse_expression_suffix(p.quiet(), lhs, &lhs);
+    while (p >>= parse_expression_suffix(p.quiet(), lhs, &lhs))
+    {
+    }
 
     while (true)
     {
@@ -829,7 +1327,7 @@ Parser parse_binary_expr(Parser p, AstNode *&out_node, int prev_prec)
             return start;
         }
 
-        auto bin_op           = new AstBinaryOperator{};
+        auto bin_op           = p.make<AstBinaryOperator>();
         bin_op->operator_type = op.type;
         bin_op->lhs           = lhs;
         bin_op->rhs           = rhs;
@@ -854,9 +1352,14 @@ Parser parse_type(Parser p, AstNode *&out_type)
     Token identifier{};
     if (p >>= p.quiet().parse_token(Tt::identifier, &identifier))
     {
-        auto type        = new AstTypeIdentifier{};
+        auto type        = p.make<AstTypeIdentifier>();
         type->identifier = identifier;
 
+        if (p.peek_token().type == Tt::less_than && !(p >>= parse_type_arguments(p, type->type_arguments)))
+        {
+            return start;
+        }
+
         out_type = type;
 
         return p;
@@ -870,13 +1373,26 @@ Parser parse_type(Parser p, AstNode *&out_type)
             return start;
         }
 
-        out_type = new AstPointerType{std::move(type)};
+        out_type = p.make<AstPointerType>(std::move(type));
 
         return p;
     }
 
     if (p >>= p.quiet().parse_token(Tt::bracket_open))
     {
+        if (p >>= p.quiet().parse_token(Tt::bracket_close))
+        {
+            AstSliceType type{};
+            if (!(p >>= parse_type(p, type.element_type)))
+            {
+                return start;
+            }
+
+            out_type = p.make<AstSliceType>(std::move(type));
+
+            return p;
+        }
+
         AstArrayType type{};
 
         // TODO: Could be empty or '..'
@@ -895,15 +1411,56 @@ Parser parse_type(Parser p, AstNode *&out_type)
             return start;
         }
 
-        out_type = new AstArrayType{std::move(type)};
+        out_type = p.make<AstArrayType>(std::move(type));
+
+        return p;
+    }
+
+    if (p >>= p.quiet().parse_token(Tt::at))
+    {
+        p.arm("parsing array annotation");
+
+        if (!(p >>= p.parse_token(Tt::identifier, &identifier)))
+        {
+            return start;
+        }
+
+        if (identifier.text() != "soa")
+        {
+            p.error(start, std::format("Invalid annotation @{}", identifier.text()));
+            return start;
+        }
 
+        AstNode *type{};
+        if (!(p >>= parse_type(p, type)))
+        {
+            return start;
+        }
+
+        auto array = ast_cast<AstArrayType>(type);
+        if (array == nullptr)
+        {
+            p.error(start, "@soa must be followed by an array type");
+            return start;
+        }
+
+        array->is_soa = true;
+
+        out_type = array;
         return p;
     }
 
     AstProcedureSignature signature{};
-    if (p >>= parse_proc_signature(p.quiet(), signature))
+    if (p >>= parse_proc_signature(p.quiet(), signature, nullptr))
+    {
+        out_type = p.make<AstProcedureSignature>(std::move(signature));
+        return p;
+    }
+
+    AstStructType struct_type{};
+    if (p >>= parse_struct_type(p.quiet(), struct_type))
     {
-        out_type = new AstProcedureSignature{std::move(signature)};
+        out_type = p.make<AstStructType>(std::move(struct_type));
         return p;
     }
 
@@ -951,7 +1508,7 @@ Parser parse_module(Parser p, AstModule &out_module)
 
     p.arm("parsing module");
 
-    out_module.block = new AstBlock{};
+    out_module.block = p.make<AstBlock>();
 
     while (true)
     {
@@ -961,7 +1518,7 @@ Parser parse_module(Parser p, AstModule &out_module)
             return start;
         }
 
-        out_module.block->statements.push_back(new AstDeclaration{decl});
+        out_module.block->statements.push_back(p.make<AstDeclaration>(decl));
 
         if (p.peek_token().type == Tt::eof)
         {
@@ -972,10 +1529,10 @@ Parser parse_module(Parser p, AstModule &out_module)
     return p;
 }
 
-AstModule *parse_module(std::string_view source)
+AstModule *parse_module(std::string_view source, MemoryPool &pool)
 {
     Lexer lexer{source};
-    Parser p{lexer};
+    Parser p{lexer, pool};
 
     AstModule module{};
     if (!(p >>= parse_module(p, module)))
@@ -985,5 +1542,5 @@ AstModule *parse_module(std::string_view source)
         return nullptr;
     }
 
-    return new AstModule{std::move(module)};
+    return p.make<AstModule>(std::move(module));
 }
@@ -2,6 +2,7 @@
 
 #include "basics.h"
 #include "lex.h"
+#include "memory_pool.h"
 
 #include <vector>
 
@@ -17,14 +18,19 @@ enum class AstKind
     goto_statement,
     identifier,
     if_statement,
+    index,
     label,
     literal,
+    member_access,
     module,
     pointer_type,
     procedure,
     procedure_call,
     procedure_signature,
     return_statement,
+    slice,
+    slice_type,
+    struct_type,
     type_identifier,
     while_loop,
 };
@@ -43,14 +49,19 @@ inline std::string_view to_string(AstKind kind)
         case AstKind::goto_statement:      return "jumpto";
         case AstKind::identifier:          return "identifier";
         case AstKind::if_statement:        return "if_statement";
+        case AstKind::index:               return "index";
         case AstKind::label:               return "label";
         case AstKind::literal:             return "literal";
+        case AstKind::member_access:       return "member_access";
         case AstKind::module:              return "module";
         case AstKind::pointer_type:        return "pointer_type";
         case AstKind::procedure:           return "procedure";
         case AstKind::procedure_call:      return "procedure_call";
         case AstKind::procedure_signature: return "procedure_signature";
         case AstKind::return_statement:    return "return_statement";
+        case AstKind::slice:               return "slice";
+        case AstKind::slice_type:          return "slice_type";
+        case AstKind::struct_type:         return "struct_type";
         case AstKind::type_identifier:     return "type_identifier";
         case AstKind::while_loop:          return "while_loop";
     }
@@ -117,6 +128,7 @@ TNode *ast_cast(AstNode *node)
 struct AstTypeIdentifier : AstOfKind<AstKind::type_identifier>
 {
     Token identifier{};
+    std::vector<AstNode *> type_arguments{};  // <identifier><<type>, ...>, the instance of a generic struct
 
     auto operator<=>(const AstTypeIdentifier &) const = default;
 };
@@ -128,14 +140,43 @@ struct AstPointerType : AstOfKind<AstKind::pointer_type>
     auto operator<=>(const AstPointerType &) const = default;
 };
 
-struct AstArrayType : AstOfKind<AstKind::type_identifier>
+struct AstArrayType : AstOfKind<AstKind::array_type>
 {
     AstNode *length_expression{};
     AstNode *element_type{};
+    bool is_soa{};  // @soa [N]T: the fields of the struct elements are stored in one array per field
 
     auto operator<=>(const AstArrayType &) const = default;
 };
 
+// []T, a pointer to elements and their number
+struct AstSliceType : AstOfKind<AstKind::slice_type>
+{
+    AstNode *element_type{};
+
+    auto operator<=>(const AstSliceType &) const = default;
+};
+
+struct AstStructField
+{
+    Token identifier{};
+    AstNode *type{};
+    uint64_t alignment{};  // @align(N) before the field, 0 for the alignment of the type
+
+    auto operator<=>(const AstStructField &) const = default;
+};
+
+// struct<T type, ...> @packed @align(N) { <field>: <type> ... }, the type parameters and both annotations are optional
+struct AstStructType : AstOfKind<AstKind::struct_type>
+{
+    std::vector<Token> type_parameters{};
+    std::vector<AstStructField> fields{};
+    bool is_packed{};
+    uint64_t alignment{};
+
+    auto operator<=>(const AstStructType &) const = default;
+};
+
 struct AstDeclaration : AstOfKind<AstKind::declaration>
 {
     Token identifier{};
@@ -211,11 +252,30 @@ struct AstIfStatement : AstOfKind<AstKind::if_statement>
     auto operator<=>(const AstIfStatement &) const = default;
 };
 
+// @reduce(<operator>, <identifier>), the operator is one of +, min and max (see Reduction)
+struct AstReduction
+{
+    Token operator_token{};
+    Token identifier{};
+
+    auto operator<=>(const AstReduction &) const = default;
+};
+
+// parallel for <identifier> <range_begin>:<operator><range_end> @grain(<expression>) @reduce(...)... <block>
+struct AstParallelOptions
+{
+    AstNode *grain_size{};  // The number of iterations that are not split further, nullptr to let the runtime choose
+    std::vector<AstReduction> reductions{};
+
+    auto operator<=>(const AstParallelOptions &) const = default;
+};
+
 struct AstWhileLoop : AstOfKind<AstKind::while_loop>
 {
     AstNode *condition{};
     AstBlock *block{};
-    AstNode *prologue{};  // NOTE: Only used by desugared for loop at the moment
+    AstNode *prologue{};             // NOTE: Only used by desugared for loop at the moment
+    AstParallelOptions *parallel{};  // NOTE: Only used by desugared parallel for loops
 
     auto operator<=>(const AstWhileLoop &) const = default;
 };
@@ -229,6 +289,7 @@ struct AstForLoop : AstOfKind<AstKind::for_loop>
     AstNode *range_end{};
     AstNode *step{};
     AstBlock *block{};
+    AstParallelOptions *parallel{};  // nullptr unless the iterations may run concurrently
 
     auto operator<=>(const AstForLoop &) const = default;
 };
@@ -246,6 +307,7 @@ struct AstContinueStatement : AstOfKind<AstKind::continue_statement>
 struct AstReturnStatement : AstOfKind<AstKind::return_statement>
 {
     AstNode *expression{};
+    bool is_tail_call{};  // return tail f(...)
 
     auto operator<=>(const AstReturnStatement &) const = default;
 };
@@ -253,15 +315,25 @@ struct AstReturnStatement : AstOfKind<AstKind::return_statement>
 struct AstIdentifier : AstOfKind<AstKind::identifier>
 {
     Token identifier{};
+    std::vector<AstNode *> type_arguments{};  // <identifier><<type>, ...>(...), the instance of a generic procedure
 
     auto operator<=>(const AstIdentifier &) const = default;
 };
 
+// proc<T type, ...>(<arguments>) <return type> @<annotation>... async external <body>, the type parameters and the
+// annotations are optional
 struct AstProcedure : AstOfKind<AstKind::procedure>
 {
+    std::vector<Token> type_parameters{};
     AstProcedureSignature *signature{};
     AstBlock *body{};
     bool is_external{};
+    bool is_async{};
+    bool is_inline{};    // @inline
+    bool is_noinline{};  // @noinline
+    bool is_hot{};       // @hot
+    bool is_cold{};      // @cold
+    bool is_flatten{};   // @flatten
 
     auto operator<=>(const AstProcedure &) const = default;
 };
@@ -270,10 +342,37 @@ struct AstProcedureCall : AstOfKind<AstKind::procedure_call>
 {
     AstNode *procedure{};
     std::vector<AstNode *> arguments{};
+    bool is_compile_time{};  // #run
 
     auto operator<=>(const AstProcedureCall &) const = default;
 };
 
+struct AstMemberAccess : AstOfKind<AstKind::member_access>
+{
+    AstNode *object{};
+    Token member{};
+
+    auto operator<=>(const AstMemberAccess &) const = default;
+};
+
+struct AstIndex : AstOfKind<AstKind::index>
+{
+    AstNode *array{};
+    AstNode *index{};
+
+    auto operator<=>(const AstIndex &) const = default;
+};
+
+// <object>[<begin>:<end>], both bounds are optional
+struct AstSlice : AstOfKind<AstKind::slice>
+{
+    AstNode *object{};
+    AstNode *begin{};
+    AstNode *end{};
+
+    auto operator<=>(const AstSlice &) const = default;
+};
+
 struct AstModule : AstOfKind<AstKind::module>
 {
     AstBlock *block{};
@@ -281,7 +380,8 @@ struct AstModule : AstOfKind<AstKind::module>
     auto operator<=>(const AstModule &) const = default;
 };
 
-AstModule *parse_module(std::string_view source);
+// The nodes are allocated in the pool, which owns them
+AstModule *parse_module(std::string_view source, MemoryPool &pool);
 
 
 #if 0
@@ -0,0 +1,94 @@
+#include "profile.h"
+
+#include "basics.h"
+
+#include <fstream>
+#include <sstream>
+
+// The profile is a text file with one line per procedure: <name> <number of counters> <counters...>
+constexpr static std::string_view profile_magic = "fasel-profile-1";
+
+const Profile::ProcedureCounters *Profile::find(std::string_view procedure_name) const
+{
+    auto it = this->procedures.find(std::string{procedure_name});
+    if (it == this->procedures.end())
+    {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+bool Profile::write(std::string_view path) const
+{
+    std::ofstream file{std::string{path}};
+    if (file.is_open() == false)
+    {
+        std::cerr << "Could not open profile file " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    file << profile_magic << "\n";
+    for (const auto &[name, procedure] : this->procedures)
+    {
+        file << name << " " << procedure.counters.size();
+        for (size_t i = 0; i < procedure.counters.size(); ++i)
+        {
+            file << " " << procedure.count(i);
+        }
+        file << "\n";
+    }
+
+    return file.good();
+}
+
+std::optional<Profile> Profile::read(std::string_view path)
+{
+    std::ifstream file{std::string{path}};
+    if (file.is_open() == false)
+    {
+        std::cerr << "Could not open profile file " << path << std::endl;
+        return std::nullopt;
+    }
+
+    std::string line{};
+    if (!std::getline(file, line) || line != profile_magic)
+    {
+        std::cerr << "Not a profile file: " << path << std::endl;
+        return std::nullopt;
+    }
+
+    Profile profile{};
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+
+        std::istringstream stream{line};
+
+        std::string name{};
+        size_t num_counters{};
+        if (!(stream >> name >> num_counters))
+        {
+            std::cerr << "Malformed profile file: " << path << std::endl;
+            return std::nullopt;
+        }
+
+        auto &procedure = profile.procedures[name];
+        for (size_t i = 0; i < num_counters; ++i)
+        {
+            uint64_t counter{};
+            if (!(stream >> counter))
+            {
+                std::cerr << "Malformed profile file: " << path << std::endl;
+                return std::nullopt;
+            }
+
+            procedure.counters.push_back(counter);
+        }
+    }
+
+    return profile;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Execution counts of the procedures of a program, collected by instrumented code (see IrCompilationOptions)
+struct Profile
+{
+    struct ProcedureCounters
+    {
+        // counters[0] counts the entries into the procedure, then there are two counters for each conditional
+        // branch in the order the branches are generated: how often the condition was true and how often it was false.
+        // NOTE: A deque, because instrumented code refers to the counters by address, so they must not move.
+        // Instrumented code may run on several threads (parallel for, spawn) and increments the counters atomically,
+        // so they are read with count while it runs.
+        std::deque<uint64_t> counters{};
+
+        inline uint64_t count(size_t index) const
+        {
+            return std::atomic_ref{const_cast<uint64_t &>(this->counters[index])}.load(std::memory_order_relaxed);
+        }
+
+        inline uint64_t entry_count() const { return this->counters.empty() ? 0 : this->count(0); }
+        inline size_t num_branches() const { return this->counters.empty() ? 0 : (this->counters.size() - 1) / 2; }
+    };
+
+    std::unordered_map<std::string, ProcedureCounters> procedures{};
+
+    const ProcedureCounters *find(std::string_view procedure_name) const;
+
+    bool write(std::string_view path) const;
+    static std::optional<Profile> read(std::string_view path);
+};
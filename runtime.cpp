@@ -0,0 +1,614 @@
+#include "runtime.h"
+
+#include "basics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+static thread_local void *current_thread_context{};
+
+void *thread_context()
+{
+    return current_thread_context;
+}
+
+void set_thread_context(void *context)
+{
+    current_thread_context = context;
+}
+
+// A parallel for loop that is running
+struct ParallelLoop
+{
+    ParallelLoopBody body{};
+    void *environment{};
+    void *context{};  // The thread context of the thread that runs the loop (see thread_context)
+    int64_t grain_size{};
+    std::atomic<int64_t> num_remaining{};  // The number of iterations that are not done yet
+};
+
+// A range of iterations of a parallel for loop
+struct LoopTask
+{
+    ParallelLoop *loop{};
+    int64_t begin{};
+    int64_t end{};
+};
+
+struct TaskQueue
+{
+    std::mutex mutex{};
+    std::deque<LoopTask> tasks{};
+};
+
+// A work-stealing thread pool: every thread takes tasks from the back of its own queue and steals from the front of
+// the other queues when its own queue is empty. Threads split their ranges in halves and push the second half to the
+// back of their queue, so the front holds the largest ranges, which are the ones worth stealing.
+struct ThreadPool
+{
+    std::vector<std::unique_ptr<TaskQueue>> queues{};  // One per worker and a last one for all other threads
+    std::vector<std::thread> workers{};
+
+    std::atomic<int64_t> num_queued{};
+    std::mutex sleep_mutex{};
+    std::condition_variable wake_up{};
+    bool is_stopping{};  // Guarded by sleep_mutex
+
+    static thread_local size_t current_queue;
+
+    explicit ThreadPool(size_t num_workers)
+    {
+        for (size_t i = 0; i < num_workers + 1; ++i)
+        {
+            this->queues.push_back(std::make_unique<TaskQueue>());
+        }
+
+        for (size_t i = 0; i < num_workers; ++i)
+        {
+            this->workers.emplace_back(
+                [this, i]
+                {
+                    current_queue = i;
+                    this->work();
+                });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock{this->sleep_mutex};
+            this->is_stopping = true;
+        }
+
+        this->wake_up.notify_all();
+        for (auto &worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    size_t num_threads() const { return this->workers.size() + 1; }
+
+    void push(LoopTask task)
+    {
+        {
+            auto &queue = *this->queues[current_queue];
+            std::lock_guard lock{queue.mutex};
+            queue.tasks.push_back(task);
+        }
+
+        this->num_queued.fetch_add(1);
+
+        // NOTE: Taking the lock makes sure that a worker that is about to sleep sees the task or gets the notification
+        {
+            std::lock_guard lock{this->sleep_mutex};
+        }
+
+        this->wake_up.notify_one();
+    }
+
+    std::optional<LoopTask> pop()
+    {
+        for (size_t i = 0; i < this->queues.size(); ++i)
+        {
+            auto index  = (current_queue + i) % this->queues.size();
+            auto &queue = *this->queues[index];
+
+            std::lock_guard lock{queue.mutex};
+            if (queue.tasks.empty())
+            {
+                continue;
+            }
+
+            LoopTask task{};
+            if (i == 0)
+            {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            else
+            {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            }
+
+            this->num_queued.fetch_sub(1);
+            return task;
+        }
+
+        return std::nullopt;
+    }
+
+    void run(LoopTask task)
+    {
+        auto loop = task.loop;
+        while (task.end - task.begin > loop->grain_size)
+        {
+            auto middle = task.begin + (task.end - task.begin) / 2;
+            this->push(LoopTask{.loop = loop, .begin = middle, .end = task.end});
+            task.end = middle;
+        }
+
+        {
+            SET_TEMPORARILY(current_thread_context, loop->context);
+            loop->body(loop->environment, task.begin, task.end);
+        }
+
+        loop->num_remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            if (auto task = this->pop())
+            {
+                this->run(task.value());
+                continue;
+            }
+
+            std::unique_lock lock{this->sleep_mutex};
+            this->wake_up.wait(lock, [this] { return this->is_stopping || this->num_queued.load() > 0; });
+            if (this->is_stopping)
+            {
+                return;
+            }
+        }
+    }
+
+    // The calling thread works on the tasks of all loops until the loop is done
+    void run_loop(ParallelLoop &loop, int64_t begin, int64_t end)
+    {
+        this->run(LoopTask{.loop = &loop, .begin = begin, .end = end});
+
+        while (loop.num_remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (auto task = this->pop())
+            {
+                this->run(task.value());
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+thread_local size_t ThreadPool::current_queue = SIZE_MAX;
+
+// One thread per core unless the environment variable FASEL_NUM_THREADS says otherwise
+static size_t num_threads_to_use()
+{
+    if (auto value = std::getenv("FASEL_NUM_THREADS"))
+    {
+        if (auto num_threads = std::strtoull(value, nullptr, 10); num_threads > 0)
+        {
+            return num_threads;
+        }
+    }
+
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+static ThreadPool &thread_pool()
+{
+    // The calling thread works as well
+    static ThreadPool pool{num_threads_to_use() - 1};
+
+    if (ThreadPool::current_queue == SIZE_MAX)
+    {
+        ThreadPool::current_queue = pool.num_threads() - 1;
+    }
+
+    return pool;
+}
+
+void fasel_parallel_for(ParallelLoopBody body, void *environment, int64_t begin, int64_t end, int64_t grain_size)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+
+    auto &pool = thread_pool();
+
+    // About 8 tasks per thread leave room for balancing the load
+    auto num_iterations = end - begin;
+    if (grain_size <= 0)
+    {
+        grain_size = std::max<int64_t>(num_iterations / static_cast<int64_t>(8 * pool.num_threads()), 1);
+    }
+
+    if (pool.num_threads() == 1 || num_iterations <= grain_size)
+    {
+        body(environment, begin, end);
+        return;
+    }
+
+    ParallelLoop loop{
+        .body        = body,
+        .environment = environment,
+        .context     = current_thread_context,
+        .grain_size  = grain_size,
+    };
+    loop.num_remaining = num_iterations;
+    pool.run_loop(loop, begin, end);
+}
+
+static std::mutex reduction_mutex{};
+
+void fasel_reduction_lock()
+{
+    reduction_mutex.lock();
+}
+
+void fasel_reduction_unlock()
+{
+    reduction_mutex.unlock();
+}
+
+// The registers of the interpreter hold integers sign- or zero-extended to 64 bits and floating point numbers as
+// doubles
+template<typename T>
+static T from_register(int64_t value)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        return static_cast<T>(std::bit_cast<double>(value));
+    }
+    else
+    {
+        return static_cast<T>(value);
+    }
+}
+
+template<typename T>
+static int64_t to_register(T value)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        return std::bit_cast<int64_t>(static_cast<double>(value));
+    }
+    else
+    {
+        return static_cast<int64_t>(value);
+    }
+}
+
+template<typename T>
+static int64_t apply_atomic(AtomicOperation operation, std::atomic_ref<T> target, T value, T desired)
+{
+    switch (operation)
+    {
+        case AtomicOperation::load:     return to_register(target.load());
+        case AtomicOperation::exchange: return to_register(target.exchange(value));
+        case AtomicOperation::add:      return to_register(target.fetch_add(value));
+        case AtomicOperation::sub:      return to_register(target.fetch_sub(value));
+
+        case AtomicOperation::store:
+        {
+            target.store(value);
+            return 0;
+        }
+
+        case AtomicOperation::compare_exchange:
+        {
+            target.compare_exchange_strong(value, desired);
+            return to_register(value);
+        }
+
+        case AtomicOperation::min:
+        case AtomicOperation::max:
+        {
+            auto previous = target.load();
+            while (operation == AtomicOperation::min ? value < previous : value > previous)
+            {
+                if (target.compare_exchange_weak(previous, value))
+                {
+                    break;
+                }
+            }
+
+            return to_register(previous);
+        }
+
+        default: break;
+    }
+
+    if constexpr (std::is_integral_v<T>)
+    {
+        switch (operation)
+        {
+            case AtomicOperation::bit_and: return to_register(target.fetch_and(value));
+            case AtomicOperation::bit_or:  return to_register(target.fetch_or(value));
+            case AtomicOperation::bit_xor: return to_register(target.fetch_xor(value));
+            default:                       break;
+        }
+    }
+
+    std::abort();
+}
+
+template<typename T>
+static int64_t atomic_operation(AtomicOperation operation, void *address, int64_t value, int64_t desired)
+{
+    return apply_atomic(
+        operation,
+        std::atomic_ref<T>{*static_cast<T *>(address)},
+        from_register<T>(value),
+        from_register<T>(desired));
+}
+
+int64_t fasel_atomic(AtomicOperation operation, AtomicType type, void *address, int64_t value, int64_t desired)
+{
+    if (operation == AtomicOperation::fence)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return 0;
+    }
+
+    switch (type)
+    {
+        case AtomicType::i8:  return atomic_operation<int8_t>(operation, address, value, desired);
+        case AtomicType::i16: return atomic_operation<int16_t>(operation, address, value, desired);
+        case AtomicType::i32: return atomic_operation<int32_t>(operation, address, value, desired);
+        case AtomicType::i64: return atomic_operation<int64_t>(operation, address, value, desired);
+        case AtomicType::u8:  return atomic_operation<uint8_t>(operation, address, value, desired);
+        case AtomicType::u16: return atomic_operation<uint16_t>(operation, address, value, desired);
+        case AtomicType::u32: return atomic_operation<uint32_t>(operation, address, value, desired);
+        case AtomicType::u64: return atomic_operation<uint64_t>(operation, address, value, desired);
+        case AtomicType::f32: return atomic_operation<float>(operation, address, value, desired);
+        case AtomicType::f64: return atomic_operation<double>(operation, address, value, desired);
+    }
+
+    std::abort();
+}
+
+// A thread that a program started, the handles that programs hold point to these
+struct Thread
+{
+    std::thread thread{};
+};
+
+uint64_t spawn_thread(const void *environment, int64_t size, int64_t alignment, std::function<void(void *)> body)
+{
+    // The caller may reuse the memory of the environment as soon as this returns
+    auto align = std::align_val_t{static_cast<size_t>(alignment)};
+    auto copy  = ::operator new(static_cast<size_t>(std::max<int64_t>(size, 1)), align);
+    if (size > 0)
+    {
+        memcpy(copy, environment, static_cast<size_t>(size));
+    }
+
+    auto thread    = new Thread{};
+    thread->thread = std::thread{
+        [copy, align, body = std::move(body), context = current_thread_context]
+        {
+            current_thread_context = context;
+            body(copy);
+            ::operator delete(copy, align);
+        }};
+
+    return reinterpret_cast<uint64_t>(thread);
+}
+
+uint64_t fasel_thread_spawn(ThreadEntry entry, const void *environment, int64_t size, int64_t alignment)
+{
+    return spawn_thread(environment, size, alignment, entry);
+}
+
+void fasel_thread_join(uint64_t thread)
+{
+    auto handle = reinterpret_cast<Thread *>(thread);
+    handle->thread.join();
+    delete handle;
+}
+
+uint64_t fasel_mutex_create()
+{
+    return reinterpret_cast<uint64_t>(new std::mutex{});
+}
+
+void fasel_mutex_destroy(uint64_t mutex)
+{
+    delete reinterpret_cast<std::mutex *>(mutex);
+}
+
+void fasel_mutex_lock(uint64_t mutex)
+{
+    reinterpret_cast<std::mutex *>(mutex)->lock();
+}
+
+void fasel_mutex_unlock(uint64_t mutex)
+{
+    reinterpret_cast<std::mutex *>(mutex)->unlock();
+}
+
+uint64_t fasel_condition_create()
+{
+    return reinterpret_cast<uint64_t>(new std::condition_variable{});
+}
+
+void fasel_condition_destroy(uint64_t condition)
+{
+    delete reinterpret_cast<std::condition_variable *>(condition);
+}
+
+void fasel_condition_wait(uint64_t condition, uint64_t mutex)
+{
+    // The program holds the mutex before and after the call
+    std::unique_lock lock{*reinterpret_cast<std::mutex *>(mutex), std::adopt_lock};
+    reinterpret_cast<std::condition_variable *>(condition)->wait(lock);
+    lock.release();
+}
+
+void fasel_condition_notify_one(uint64_t condition)
+{
+    reinterpret_cast<std::condition_variable *>(condition)->notify_one();
+}
+
+void fasel_condition_notify_all(uint64_t condition)
+{
+    reinterpret_cast<std::condition_variable *>(condition)->notify_all();
+}
+
+// A task that is ready to continue
+struct ReadyTask
+{
+    TaskResume resume{};
+    void *task{};
+};
+
+// The executor of a run (see fasel_executor_begin)
+struct Executor
+{
+    uint8_t *arena_start{};
+    uint8_t *arena{};  // The free memory of the arena
+    uint8_t *arena_end{};
+    std::deque<ReadyTask> ready{};
+    Executor *previous{};  // The executor of the run that this one is nested in
+};
+
+static thread_local Executor *current_executor{};
+
+void fasel_executor_begin(void *arena, int64_t size)
+{
+    auto start = static_cast<uint8_t *>(arena);
+    auto end   = start + size;
+
+    // The tasks of the enclosing runs are suspended, not done, so their frames must survive the nested run
+    for (auto executor = current_executor; executor != nullptr; executor = executor->previous)
+    {
+        if (start < executor->arena_end && executor->arena_start < end)
+        {
+            FATAL("A nested run cannot use the arena of a run that it is nested in");
+        }
+    }
+
+    current_executor = new Executor{
+        .arena_start = start,
+        .arena       = start,
+        .arena_end   = end,
+        .previous    = current_executor,
+    };
+}
+
+void fasel_executor_run()
+{
+    auto executor = current_executor;
+    while (executor->ready.empty() == false)
+    {
+        auto ready = executor->ready.front();
+        executor->ready.pop_front();
+        ready.resume(ready.task);
+    }
+
+    current_executor = executor->previous;
+    delete executor;
+}
+
+void *fasel_task_allocate(int64_t size, int64_t alignment)
+{
+    auto executor = current_executor;
+    if (executor == nullptr)
+    {
+        FATAL("Tasks can only be created by run or by other tasks");
+    }
+
+    auto mask    = static_cast<uintptr_t>(alignment - 1);
+    auto address = (reinterpret_cast<uintptr_t>(executor->arena) + mask) & ~mask;
+    if (address + size > reinterpret_cast<uintptr_t>(executor->arena_end))
+    {
+        FATAL("The arena of the tasks is full");
+    }
+
+    executor->arena = reinterpret_cast<uint8_t *>(address + size);
+
+    return reinterpret_cast<void *>(address);
+}
+
+void fasel_task_schedule(TaskResume resume, void *task)
+{
+    current_executor->ready.push_back(ReadyTask{.resume = resume, .task = task});
+}
+
+void fasel_task_fail(TaskError error)
+{
+    switch (error)
+    {
+        case TaskError::awaited_twice: FATAL("A task can only be awaited by one task at a time");
+        case TaskError::not_done:      FATAL("The task of run is not done, its tasks await each other");
+    }
+
+    UNREACHED;
+}
+
+const std::array<RuntimeSymbol, 20> runtime_symbols{
+    RuntimeSymbol{"fasel_parallel_for", reinterpret_cast<void *>(&fasel_parallel_for)},
+    RuntimeSymbol{"fasel_reduction_lock", reinterpret_cast<void *>(&fasel_reduction_lock)},
+    RuntimeSymbol{"fasel_reduction_unlock", reinterpret_cast<void *>(&fasel_reduction_unlock)},
+    RuntimeSymbol{"fasel_atomic", reinterpret_cast<void *>(&fasel_atomic)},
+    RuntimeSymbol{"fasel_thread_spawn", reinterpret_cast<void *>(&fasel_thread_spawn)},
+    RuntimeSymbol{"fasel_thread_join", reinterpret_cast<void *>(&fasel_thread_join)},
+    RuntimeSymbol{"fasel_mutex_create", reinterpret_cast<void *>(&fasel_mutex_create)},
+    RuntimeSymbol{"fasel_mutex_destroy", reinterpret_cast<void *>(&fasel_mutex_destroy)},
+    RuntimeSymbol{"fasel_mutex_lock", reinterpret_cast<void *>(&fasel_mutex_lock)},
+    RuntimeSymbol{"fasel_mutex_unlock", reinterpret_cast<void *>(&fasel_mutex_unlock)},
+    RuntimeSymbol{"fasel_condition_create", reinterpret_cast<void *>(&fasel_condition_create)},
+    RuntimeSymbol{"fasel_condition_destroy", reinterpret_cast<void *>(&fasel_condition_destroy)},
+    RuntimeSymbol{"fasel_condition_wait", reinterpret_cast<void *>(&fasel_condition_wait)},
+    RuntimeSymbol{"fasel_condition_notify_one", reinterpret_cast<void *>(&fasel_condition_notify_one)},
+    RuntimeSymbol{"fasel_condition_notify_all", reinterpret_cast<void *>(&fasel_condition_notify_all)},
+    RuntimeSymbol{"fasel_executor_begin", reinterpret_cast<void *>(&fasel_executor_begin)},
+    RuntimeSymbol{"fasel_executor_run", reinterpret_cast<void *>(&fasel_executor_run)},
+    RuntimeSymbol{"fasel_task_allocate", reinterpret_cast<void *>(&fasel_task_allocate)},
+    RuntimeSymbol{"fasel_task_schedule", reinterpret_cast<void *>(&fasel_task_schedule)},
+    RuntimeSymbol{"fasel_task_fail", reinterpret_cast<void *>(&fasel_task_fail)},
+};
+
+void *find_runtime_symbol(std::string_view name)
+{
+    for (const auto &symbol : runtime_symbols)
+    {
+        if (symbol.name == name)
+        {
+            return symbol.address;
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+// The runtime library of compiled programs. The JIT resolves the references of compiled code to the functions below
+// (see runtime_symbols), the interpreter resolves the external procedures of programs to them first (see
+// find_runtime_symbol).
+
+// The body of a parallel for loop that was outlined into a procedure of its own (see compile_ir.cpp), runs the
+// iterations begin to end (exclusive). The environment holds the addresses of the variables that the body uses.
+using ParallelLoopBody = void (*)(void *environment, int64_t begin, int64_t end);
+
+// A procedure that spawn(f(...)) outlined into a procedure of its own (see compile_ir.cpp), loads the arguments from
+// the environment and calls f with them
+using ThreadEntry = void (*)(void *environment);
+
+// Continues a suspended task (see Intrinsic::run) until it suspends again or returns. The executor resumes tasks
+// through the function that scheduled them, because only compiled code can resume the coroutines of compiled code
+// and only the interpreter its own tasks.
+using TaskResume = void (*)(void *task);
+
+// The operations and the types of fasel_atomic
+enum class AtomicOperation : int64_t
+{
+    load,
+    store,
+    exchange,
+    compare_exchange,
+    add,
+    sub,
+    bit_and,
+    bit_or,
+    bit_xor,
+    min,
+    max,
+    fence,
+};
+
+enum class AtomicType : int64_t
+{
+    i8,
+    i16,
+    i32,
+    i64,
+    u8,
+    u16,
+    u32,
+    u64,
+    f32,
+    f64,
+};
+
+// The ways in which the tasks of a run can fail (see fasel_task_fail)
+enum class TaskError : int64_t
+{
+    awaited_twice,  // A task awaited a task that another task already awaits
+    not_done,       // The executor ran out of ready tasks before the task of run was done
+};
+
+extern "C"
+{
+    // Runs the iterations begin to end (exclusive) of a parallel for loop on the worker threads and the calling thread
+    // and returns when all of them are done. Ranges of up to grain_size iterations are not split further, a grain size
+    // of 0 or less lets the runtime choose.
+    void fasel_parallel_for(ParallelLoopBody body, void *environment, int64_t begin, int64_t end, int64_t grain_size);
+
+    // Held while the iterations of a parallel for loop combine their results of reductions with the variables
+    void fasel_reduction_lock();
+    void fasel_reduction_unlock();
+
+    // The atomic intrinsics of the interpreter on values in memory (see compile_vm.cpp), always sequentially
+    // consistent. The values and the previous value that is returned have the representation of the registers of the
+    // interpreter (see op_code.h), the value is the expected value of a compare-exchange.
+    int64_t fasel_atomic(AtomicOperation operation, AtomicType type, void *address, int64_t value, int64_t desired);
+
+    // Starts a thread that calls the entry with a copy of the environment of the given size and alignment. The
+    // returned handle has to be joined exactly once.
+    uint64_t fasel_thread_spawn(ThreadEntry entry, const void *environment, int64_t size, int64_t alignment);
+    // Waits until the thread returns and frees it
+    void fasel_thread_join(uint64_t thread);
+
+    // Mutexes and condition variables for programs, which declare these as external procedures. The handles are
+    // created with *_create and freed with *_destroy.
+    uint64_t fasel_mutex_create();
+    void fasel_mutex_destroy(uint64_t mutex);
+    void fasel_mutex_lock(uint64_t mutex);
+    void fasel_mutex_unlock(uint64_t mutex);
+
+    uint64_t fasel_condition_create();
+    void fasel_condition_destroy(uint64_t condition);
+    // Unlocks the mutex while it waits, the mutex is locked again when it returns. It may return without a
+    // notification, so the condition that is waited for has to be checked again.
+    void fasel_condition_wait(uint64_t condition, uint64_t mutex);
+    void fasel_condition_notify_one(uint64_t condition);
+    void fasel_condition_notify_all(uint64_t condition);
+
+    // The executor of run, which runs the tasks on the calling thread. The tasks that are created after begin allocate
+    // their frames from the arena, run resumes the tasks that are ready in the order in which they became ready until
+    // there are none left and ends the executor, after which the arena can be reused. The executors of nested runs
+    // are stacked. A run nested in a task (through a procedure that the task calls) needs an arena of its own: the
+    // frames of the outer tasks are still alive in the arena of the outer run, so begin aborts the program if the
+    // arenas overlap.
+    void fasel_executor_begin(void *arena, int64_t size);
+    void fasel_executor_run();
+
+    // Allocates memory for a task from the arena of the executor
+    void *fasel_task_allocate(int64_t size, int64_t alignment);
+    // Queues the task for being resumed through the function by the executor
+    void fasel_task_schedule(TaskResume resume, void *task);
+    // Aborts the program. A task has a single waiter, so only one task at a time can await it, and run only returns
+    // the result of a task that is done.
+    [[noreturn]] void fasel_task_fail(TaskError error);
+}
+
+// An opaque pointer that the embedder of the runtime associates with the calling thread (the integration tests keep the
+// run of the test there). The threads that programs start and the threads that run the iterations of their parallel
+// for loops take it over from the thread that starts them, so it is set wherever code of the program runs.
+void *thread_context();
+void set_thread_context(void *context);
+
+// Starts a thread that calls the body with a copy of the environment, like fasel_thread_spawn. The interpreter uses
+// this to run the procedure in an interpreter of its own.
+uint64_t spawn_thread(const void *environment, int64_t size, int64_t alignment, std::function<void(void *)> body);
+
+struct RuntimeSymbol
+{
+    std::string_view name{};
+    void *address{};
+};
+
+extern const std::array<RuntimeSymbol, 20> runtime_symbols;
+
+// The address of the function of the runtime library with the name, nullptr if there is none
+void *find_runtime_symbol(std::string_view name);
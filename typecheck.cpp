@@ -1,6 +1,11 @@
 #include "typecheck.h"
 
+#include "compile_vm.h"
 #include "parse.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <bit>
 
 enum class BinaryOperatorCategory
 {
@@ -70,6 +75,172 @@ bool spread_poison(const Node *possibly_infected, Node *spread_to)
     return false;
 }
 
+// Parses the name of a vector type: 'v', the number of lanes and the name of the element type (e.g. v4f32 or v8bool)
+static VectorTypeNode *make_vector_type(Context &ctx, std::string_view name)
+{
+    if (name.starts_with('v') == false)
+    {
+        return nullptr;
+    }
+
+    auto digits_end = name.find_first_not_of("0123456789", 1);
+    if (digits_end == 1 || digits_end > 3 || digits_end == std::string_view::npos)
+    {
+        return nullptr;
+    }
+
+    auto length = std::stoll(std::string{name.substr(1, digits_end - 1)});
+    if (VectorTypeNode::is_valid_length(length) == false)
+    {
+        return nullptr;
+    }
+
+    for (auto [type, type_name] : BuiltinTypes::type_names)
+    {
+        auto is_element_type = type->is_numerical() || type->type_kind == BasicTypeNode::Kind::boolean;
+        if (is_element_type && name.substr(digits_end) == type_name)
+        {
+            return ctx.make_vector_type(length, type);
+        }
+    }
+
+    return nullptr;
+}
+
+static const std::vector<std::tuple<Intrinsic, std::string_view>> intrinsic_names = {
+    std::make_tuple(Intrinsic::extract, "extract"),
+    std::make_tuple(Intrinsic::insert, "insert"),
+    std::make_tuple(Intrinsic::shuffle, "shuffle"),
+    std::make_tuple(Intrinsic::swizzle, "swizzle"),
+    std::make_tuple(Intrinsic::select, "select"),
+    std::make_tuple(Intrinsic::reduce_add, "reduce_add"),
+    std::make_tuple(Intrinsic::reduce_mul, "reduce_mul"),
+    std::make_tuple(Intrinsic::reduce_min, "reduce_min"),
+    std::make_tuple(Intrinsic::reduce_max, "reduce_max"),
+    std::make_tuple(Intrinsic::any, "any"),
+    std::make_tuple(Intrinsic::all, "all"),
+    std::make_tuple(Intrinsic::size_of, "sizeof"),
+    std::make_tuple(Intrinsic::align_of, "alignof"),
+    std::make_tuple(Intrinsic::offset_of, "offsetof"),
+    std::make_tuple(Intrinsic::atomic_load, "atomic_load"),
+    std::make_tuple(Intrinsic::atomic_store, "atomic_store"),
+    std::make_tuple(Intrinsic::atomic_exchange, "atomic_exchange"),
+    std::make_tuple(Intrinsic::atomic_compare_exchange, "atomic_compare_exchange"),
+    std::make_tuple(Intrinsic::atomic_add, "atomic_add"),
+    std::make_tuple(Intrinsic::atomic_sub, "atomic_sub"),
+    std::make_tuple(Intrinsic::atomic_and, "atomic_and"),
+    std::make_tuple(Intrinsic::atomic_or, "atomic_or"),
+    std::make_tuple(Intrinsic::atomic_xor, "atomic_xor"),
+    std::make_tuple(Intrinsic::atomic_min, "atomic_min"),
+    std::make_tuple(Intrinsic::atomic_max, "atomic_max"),
+    std::make_tuple(Intrinsic::atomic_fence, "atomic_fence"),
+    std::make_tuple(Intrinsic::spawn, "spawn"),
+    std::make_tuple(Intrinsic::join, "join"),
+    std::make_tuple(Intrinsic::run, "run"),
+    std::make_tuple(Intrinsic::start, "start"),
+    std::make_tuple(Intrinsic::await, "await"),
+    std::make_tuple(Intrinsic::yield, "yield"),
+};
+
+static const std::vector<std::tuple<MemoryOrder, std::string_view>> memory_order_names = {
+    std::make_tuple(MemoryOrder::relaxed, "relaxed"),
+    std::make_tuple(MemoryOrder::acquire, "acquire"),
+    std::make_tuple(MemoryOrder::release, "release"),
+    std::make_tuple(MemoryOrder::acq_rel, "acq_rel"),
+    std::make_tuple(MemoryOrder::seq_cst, "seq_cst"),
+};
+
+// The variable, field or element that the call operates on if it is a call to an atomic intrinsic. The collectors
+// that run before the calls are resolved use this, so calls to procedures with the same name count as well.
+static Node *atomic_target(ProcedureCallNode *call)
+{
+    auto ident = node_cast<IdentifierNode>(call->procedure);
+    if (ident == nullptr || call->arguments.empty())
+    {
+        return nullptr;
+    }
+
+    for (auto [intrinsic, name] : intrinsic_names)
+    {
+        if (ident->identifier == name && is_atomic(intrinsic))
+        {
+            return call->arguments[0];
+        }
+    }
+
+    return nullptr;
+}
+
+// Whether values of the type can be stored in memory, as fields of structs and elements of arrays
+static bool has_memory_layout(const Node *type)
+{
+    switch (type->kind)
+    {
+        case NodeKind::basic_type:
+        {
+            auto basic = static_cast<const BasicTypeNode *>(type);
+            return basic->is_numerical() || basic->type_kind == BasicTypeNode::Kind::boolean;
+        }
+
+        // NOTE: Masks have no layout in memory
+        case NodeKind::vector_type:
+        {
+            return static_cast<const VectorTypeNode *>(type)->element_type->type_kind != BasicTypeNode::Kind::boolean;
+        }
+
+        case NodeKind::pointer_type:
+        case NodeKind::array_type:
+        case NodeKind::slice_type:
+        case NodeKind::struct_type:
+        {
+            return true;
+        }
+
+        default: return false;
+    }
+}
+
+// Variables, the fields of assignable structs, the elements of assignable arrays and the elements of slices
+static bool is_assignable(const Node *node)
+{
+    switch (node->kind)
+    {
+        case NodeKind::identifier: return true;
+
+        // The fields of slices and the lengths of arrays can only be read
+        case NodeKind::member_access:
+        {
+            auto object = static_cast<const MemberAccessNode *>(node)->object;
+            return object->inferred_type()->kind == NodeKind::struct_type && is_assignable(object);
+        }
+
+        // The elements of a slice are not part of its value
+        case NodeKind::index:
+        {
+            auto array = static_cast<const IndexNode *>(node)->array;
+            return array->inferred_type()->kind == NodeKind::slice_type || is_assignable(array);
+        }
+
+        default: return false;
+    }
+}
+
+// The type parameters of the definition of a generic procedure or struct, nullptr if it is not generic
+static const std::vector<Token> *generic_type_parameters(const AstNode *ast)
+{
+    const std::vector<Token> *type_parameters{};
+    if (ast != nullptr && ast->kind == AstKind::procedure)
+    {
+        type_parameters = &static_cast<const AstProcedure *>(ast)->type_parameters;
+    }
+    else if (ast != nullptr && ast->kind == AstKind::struct_type)
+    {
+        type_parameters = &static_cast<const AstStructType *>(ast)->type_parameters;
+    }
+
+    return type_parameters != nullptr && type_parameters->empty() == false ? type_parameters : nullptr;
+}
+
 Node *NodeConverter::make_node(AstNode *ast)
 {
     switch (ast->kind)
@@ -109,6 +280,19 @@ Node *NodeConverter::make_node(AstNode *ast)
         {
             auto decl = static_cast<AstDeclaration *>(ast);
 
+            // Generics are converted once per instance (see TypeChecker::instantiate)
+            if (auto type_parameters = generic_type_parameters(decl->init_expression))
+            {
+                std::vector<std::string_view> parameter_names{};
+                for (const auto &parameter : *type_parameters)
+                {
+                    parameter_names.push_back(parameter.text());
+                }
+
+                auto generic = this->ctx.make_generic(std::move(parameter_names), decl->init_expression);
+                return this->ctx.make_declaration(decl->identifier.text(), this->ctx.make_nop(), generic, false);
+            }
+
             Node *specified_type{};
             Node *init_expr{};
 
@@ -137,7 +321,21 @@ Node *NodeConverter::make_node(AstNode *ast)
         case AstKind::identifier:
         {
             auto ident = static_cast<AstIdentifier *>(ast);
-            return this->ctx.make_identifier(ident->identifier.text());
+
+            // A type parameter, which can be the first argument of sizeof, alignof and offsetof
+            auto type_argument = this->type_arguments.find(ident->identifier.text());
+            if (type_argument != this->type_arguments.end() && ident->type_arguments.empty())
+            {
+                return type_argument->second;
+            }
+
+            auto result = this->ctx.make_identifier(ident->identifier.text());
+            for (auto argument : ident->type_arguments)
+            {
+                result->type_arguments.push_back(this->make_node(argument));
+            }
+
+            return result;
         }
 
         case AstKind::if_statement:
@@ -169,7 +367,36 @@ Node *NodeConverter::make_node(AstNode *ast)
                 prologue = this->make_node(whyle->prologue);
             }
 
-            return this->ctx.make_while(condition, block, prologue);
+            auto result = this->ctx.make_while(condition, block, prologue);
+            if (whyle->parallel != nullptr)
+            {
+                result->is_parallel = true;
+
+                if (whyle->parallel->grain_size != nullptr)
+                {
+                    result->grain_size = this->make_node(whyle->parallel->grain_size);
+                }
+
+                for (const auto &reduction : whyle->parallel->reductions)
+                {
+                    auto kind = Reduction::Kind::sum;
+                    if (reduction.operator_token.text() == "min")
+                    {
+                        kind = Reduction::Kind::min;
+                    }
+                    else if (reduction.operator_token.text() == "max")
+                    {
+                        kind = Reduction::Kind::max;
+                    }
+
+                    result->reductions.push_back(Reduction{
+                        .kind     = kind,
+                        .variable = this->ctx.make_identifier(reduction.identifier.text()),
+                    });
+                }
+            }
+
+            return result;
         }
 
 #if 0
@@ -224,7 +451,14 @@ Node *NodeConverter::make_node(AstNode *ast)
                 body = node_cast<BlockNode, true>(this->make_node(proc->body));
             }
 
-            return this->ctx.make_procedure(signature, body, proc->is_external);
+            auto result         = this->ctx.make_procedure(signature, body, proc->is_external, proc->is_async);
+            result->is_inline   = proc->is_inline;
+            result->is_noinline = proc->is_noinline;
+            result->is_hot      = proc->is_hot;
+            result->is_cold     = proc->is_cold;
+            result->is_flatten  = proc->is_flatten;
+
+            return result;
         }
 
         case AstKind::procedure_call:
@@ -239,7 +473,7 @@ Node *NodeConverter::make_node(AstNode *ast)
                 arguments.push_back(this->make_node(argument));
             }
 
-            return this->ctx.make_procedure_call(procedure, std::move(arguments));
+            return this->ctx.make_procedure_call(procedure, std::move(arguments), call->is_compile_time);
         }
 
         case AstKind::procedure_signature:
@@ -272,7 +506,9 @@ Node *NodeConverter::make_node(AstNode *ast)
                 expression = this->make_node(retyrn->expression);
             }
 
-            return this->ctx.make_return(expression);
+            auto node          = this->ctx.make_return(expression);
+            node->is_tail_call = retyrn->is_tail_call;
+            return node;
         }
 
         case AstKind::module:
@@ -288,7 +524,6 @@ Node *NodeConverter::make_node(AstNode *ast)
         {
             auto type_ident = static_cast<AstTypeIdentifier *>(ast);
 
-            auto found = false;
             for (auto [type, name] : BuiltinTypes::type_names)
             {
                 if (type_ident->identifier.text() == name)
@@ -297,11 +532,76 @@ Node *NodeConverter::make_node(AstNode *ast)
                 }
             }
 
-            // TODO: Error reporting
-            std::cout << "Type '" << type_ident->identifier.text()
-                      << "' not found (custom type names are not implemented yet)" << std::endl;
+            if (auto vector_type = make_vector_type(this->ctx, type_ident->identifier.text()))
+            {
+                return vector_type;
+            }
+
+            auto type_argument = this->type_arguments.find(type_ident->identifier.text());
+            if (type_argument != this->type_arguments.end() && type_ident->type_arguments.empty())
+            {
+                return type_argument->second;
+            }
+
+            // The name of a struct type or an instance of a generic struct, resolved by the typechecker
+            auto result = this->ctx.make_identifier(type_ident->identifier.text());
+            for (auto argument : type_ident->type_arguments)
+            {
+                result->type_arguments.push_back(this->make_node(argument));
+            }
 
-            return nullptr;
+            return result;
+        }
+
+        case AstKind::struct_type:
+        {
+            auto struct_type = static_cast<AstStructType *>(ast);
+
+            std::vector<StructField> fields{};
+            for (auto &field : struct_type->fields)
+            {
+                fields.push_back(
+                    StructField{
+                        .identifier = field.identifier.text(),
+                        .type       = this->make_node(field.type),
+                        .alignment  = static_cast<int64_t>(field.alignment),
+                    });
+            }
+
+            return this->ctx.make_struct_type(
+                std::move(fields),
+                struct_type->is_packed,
+                static_cast<int64_t>(struct_type->alignment));
+        }
+
+        case AstKind::member_access:
+        {
+            auto member_access = static_cast<AstMemberAccess *>(ast);
+
+            auto object = this->make_node(member_access->object);
+
+            return this->ctx.make_member_access(object, member_access->member.text());
+        }
+
+        case AstKind::index:
+        {
+            auto index = static_cast<AstIndex *>(ast);
+
+            auto array = this->make_node(index->array);
+            auto value = this->make_node(index->index);
+
+            return this->ctx.make_index(array, value);
+        }
+
+        case AstKind::slice:
+        {
+            auto slice = static_cast<AstSlice *>(ast);
+
+            auto object = this->make_node(slice->object);
+            auto begin  = slice->begin != nullptr ? this->make_node(slice->begin) : nullptr;
+            auto end    = slice->end != nullptr ? this->make_node(slice->end) : nullptr;
+
+            return this->ctx.make_slice(object, begin, end);
         }
 
         case AstKind::pointer_type:
@@ -320,7 +620,16 @@ Node *NodeConverter::make_node(AstNode *ast)
             auto length       = this->make_node(array->length_expression);
             auto element_type = this->make_node(array->element_type);
 
-            return this->ctx.make_array_type(length, element_type);
+            return this->ctx.make_array_type(length, element_type, array->is_soa);
+        }
+
+        case AstKind::slice_type:
+        {
+            auto slice_type = static_cast<AstSliceType *>(ast);
+
+            auto element_type = this->make_node(slice_type->element_type);
+
+            return this->ctx.make_slice_type(element_type);
         }
 
         case AstKind::label:
@@ -386,6 +695,18 @@ void DeclarationRegistrar::visit(DeclarationNode *declaration)
         return;
     }
 
+    if (declaration->init_expression->kind == NodeKind::struct_type && this->current_block->is_global() == false)
+    {
+        this->error(declaration, "Structs can only be defined at module scope");
+        return;
+    }
+
+    if (declaration->init_expression->kind == NodeKind::generic && this->current_block->is_global() == false)
+    {
+        this->error(declaration, "Generic procedures and structs can only be defined at module scope");
+        return;
+    }
+
     auto [it, ok] = this->current_block->declarations.emplace(std::string{declaration->identifier}, declaration);
     if (ok == false)
     {
@@ -439,6 +760,134 @@ void DeclarationRegistrar::visit(ProcedureNode *procedure)
 // TypeChecker
 //
 
+// Collects the names of the variables that are assigned to anywhere in the module. Declarations with one of these
+// names are never constant, even if only a variable with the same name in another scope is assigned to.
+struct AssignmentCollector : NodeVisitorBase
+{
+    std::unordered_set<std::string_view> &assigned_identifiers;
+
+    explicit AssignmentCollector(std::unordered_set<std::string_view> &assigned_identifiers)
+        : assigned_identifiers{assigned_identifiers}
+    {
+    }
+
+    void visit(BinaryOperatorNode *bin_op) override
+    {
+        if (bin_op->operator_kind == Tt::assign)
+        {
+            this->add(bin_op->lhs);
+        }
+    }
+
+    // The targets of atomic operations are shared with other threads
+    void visit(ProcedureCallNode *call) override
+    {
+        if (auto target = atomic_target(call))
+        {
+            this->add(target);
+        }
+    }
+
+    void add(Node *target)
+    {
+        // Assigning to a field or an element assigns to the variable that holds it
+        while (target->kind == NodeKind::member_access || target->kind == NodeKind::index)
+        {
+            target = target->kind == NodeKind::member_access ? static_cast<MemberAccessNode *>(target)->object
+                                                             : static_cast<IndexNode *>(target)->array;
+        }
+
+        if (auto ident = node_cast<IdentifierNode>(target))
+        {
+            this->assigned_identifiers.insert(ident->identifier);
+        }
+    }
+};
+
+// Collects the variables that a loop body assigns to directly (not through one of their fields or elements) and
+// whether it contains labels, which could be jumped to without checking the condition of the loop
+struct LoopBodyCollector : NodeVisitorBase
+{
+    std::unordered_set<std::string_view> assigned_identifiers{};
+    bool has_labels{};
+
+    void visit(BinaryOperatorNode *bin_op) override
+    {
+        auto ident = node_cast<IdentifierNode>(bin_op->lhs);
+        if (bin_op->operator_kind == Tt::assign && ident != nullptr)
+        {
+            this->assigned_identifiers.insert(ident->identifier);
+        }
+    }
+
+    void visit(ProcedureCallNode *call) override
+    {
+        auto target = atomic_target(call);
+        if (auto ident = target != nullptr ? node_cast<IdentifierNode>(target) : nullptr)
+        {
+            this->assigned_identifiers.insert(ident->identifier);
+        }
+    }
+
+    void visit(LabelNode *label) override { this->has_labels = true; }
+};
+
+// Recognizes counted loops (see CountedLoop), the condition and the prologue of the loop must have been typechecked.
+// The counter is a local 64 bit integer, it cannot overflow before it reaches an end that is a valid length.
+static std::optional<CountedLoop> as_counted_loop(WhileLoopNode *loop)
+{
+    auto condition = node_cast<BinaryOperatorNode>(loop->condition);
+    auto increment = node_cast<BinaryOperatorNode>(loop->prologue);
+    if (condition == nullptr || increment == nullptr || increment->operator_kind != Tt::assign ||
+        (condition->operator_kind != Tt::less_than && condition->operator_kind != Tt::less_than_or_equal))
+    {
+        return std::nullopt;
+    }
+
+    auto counter = node_cast<IdentifierNode>(condition->lhs);
+    auto target  = node_cast<IdentifierNode>(increment->lhs);
+    auto sum     = node_cast<BinaryOperatorNode>(increment->rhs);
+    if (counter == nullptr || counter->declaration == nullptr || target == nullptr ||
+        target->declaration != counter->declaration || sum == nullptr || sum->operator_kind != Tt::plus)
+    {
+        return std::nullopt;
+    }
+
+    auto decl    = counter->declaration;
+    auto addend  = node_cast<IdentifierNode>(sum->lhs);
+    auto step    = node_cast<LiteralNode>(sum->rhs);
+    auto start   = node_cast<LiteralNode>(decl->init_expression);
+    auto type    = node_cast<BasicTypeNode>(decl->init_expression->inferred_type());
+    auto is_long = type != nullptr && type->size == 8 &&
+                   (type->type_kind == BasicTypeNode::Kind::signed_integer ||
+                    type->type_kind == BasicTypeNode::Kind::unsigned_integer);
+    if (addend == nullptr || addend->declaration != decl || step == nullptr || start == nullptr || is_long == false ||
+        decl->is_global())
+    {
+        return std::nullopt;
+    }
+
+    if (normalize_integer(type, std::get<uint64_t>(step->value)) <= 0 ||
+        normalize_integer(type, std::get<uint64_t>(start->value)) < 0)
+    {
+        return std::nullopt;
+    }
+
+    LoopBodyCollector collector{};
+    visit(loop->body, collector);
+
+    if (collector.has_labels || collector.assigned_identifiers.contains(decl->identifier))
+    {
+        return std::nullopt;
+    }
+
+    return CountedLoop{
+        .counter              = decl,
+        .condition            = condition,
+        .assigned_identifiers = std::move(collector.assigned_identifiers),
+    };
+}
+
 bool TypeChecker::do_implicit_cast_if_necessary(Node *&node, Node *type)
 {
     assert(type->is_type());
@@ -452,6 +901,20 @@ bool TypeChecker::do_implicit_cast_if_necessary(Node *&node, Node *type)
         return true;
     }
 
+    // An array is converted to a slice of all its elements
+    auto src_array  = node_cast<ArrayTypeNode>(node->inferred_type());
+    auto dest_slice = node_cast<SliceTypeNode>(type);
+    if (src_array != nullptr && dest_slice != nullptr && src_array->is_soa == false &&
+        Node::types_equal(src_array->element_type, dest_slice->element_type))
+    {
+        auto slice                = this->ctx.make_slice(node, nullptr, nullptr);
+        slice->needs_bounds_check = false;
+        slice->set_inferred_type(type);
+        node = slice;
+
+        return true;
+    }
+
     auto can_cast = false;
 
     auto src_basic  = node_cast<BasicTypeNode>(node->inferred_type());
@@ -461,6 +924,19 @@ bool TypeChecker::do_implicit_cast_if_necessary(Node *&node, Node *type)
         can_cast = src_basic->is_numerical() && dest_basic->is_numerical();
     }
 
+    // A scalar is converted to the element type and set into all lanes of the vector
+    auto dest_vector = node_cast<VectorTypeNode>(type);
+    if (src_basic != nullptr && dest_vector != nullptr &&
+        (src_basic->is_numerical() || src_basic->type_kind == BasicTypeNode::Kind::boolean))
+    {
+        if (this->do_implicit_cast_if_necessary(node, dest_vector->element_type) == false)
+        {
+            return false;
+        }
+
+        can_cast = true;
+    }
+
     // TODO
 
     if (can_cast)
@@ -468,6 +944,8 @@ bool TypeChecker::do_implicit_cast_if_necessary(Node *&node, Node *type)
         auto cast = this->ctx.make_type_cast(type, node);
         cast->set_inferred_type(type);
         node = cast;
+
+        this->fold_constant(node);
     }
     else
     {
@@ -530,31 +1008,1843 @@ Node *TypeChecker::coerce_types(BinaryOperatorNode *bin_op)
                     rhs_basic->type_kind == BasicTypeNode::Kind::floatingpoint;
     auto max_size = std::max(lhs_basic->size, rhs_basic->size);
 
-    assert(max_size == 1 || max_size == 2 || max_size == 4 || max_size == 8);
+    assert(max_size == 1 || max_size == 2 || max_size == 4 || max_size == 8);
+
+    auto type_kind = is_float ? BasicTypeNode::Kind::floatingpoint : lhs_basic->type_kind;
+    BasicTypeNode *type{};
+    for (auto [builtin_type, name] : BuiltinTypes::type_names)
+    {
+        if (builtin_type->type_kind == type_kind && builtin_type->size == max_size)
+        {
+            type = builtin_type;
+        }
+    }
+
+    if (this->do_implicit_cast_if_necessary(bin_op->lhs, type) == false)
+    {
+        spread_poison(bin_op->lhs, bin_op);
+        return &BuiltinTypes::poison;
+    }
+
+    if (this->do_implicit_cast_if_necessary(bin_op->rhs, type) == false)
+    {
+        spread_poison(bin_op->rhs, bin_op);
+        return &BuiltinTypes::poison;
+    }
+
+    return type;
+}
+
+// Typechecks a binary operator with a vector operand. The other operand is a vector of the same type or a scalar that
+// is set into all lanes. The operator works on each lane like on scalars of the element type, comparisons result in
+// masks.
+void TypeChecker::typecheck_vector_operator(BinaryOperatorNode *bin_op)
+{
+    auto type = node_cast<VectorTypeNode>(bin_op->lhs->inferred_type());
+    if (type == nullptr)
+    {
+        type = node_cast<VectorTypeNode, true>(bin_op->rhs->inferred_type());
+    }
+
+    auto element_kind = type->element_type->type_kind;
+
+    auto is_valid_operator = false;
+    switch (bin_op_category(bin_op->operator_kind))
+    {
+        case BinaryOperatorCategory::arithmetic:
+        case BinaryOperatorCategory::comparison:
+        {
+            is_valid_operator = type->element_type->is_numerical();
+            break;
+        }
+
+        case BinaryOperatorCategory::bitwise_operation:
+        {
+            // The lanes of masks can be combined, but not shifted
+            auto is_shift = bin_op->operator_kind == Tt::left_shift || bin_op->operator_kind == Tt::right_shift;
+            is_valid_operator = element_kind == BasicTypeNode::Kind::unsigned_integer ||
+                                (element_kind == BasicTypeNode::Kind::boolean && is_shift == false);
+            break;
+        }
+
+        default: break;
+    }
+
+    if (is_valid_operator == false)
+    {
+        this->error(
+            bin_op,
+            true,
+            std::format(
+                "Invalid operand type for binary operator on vectors (left: {}, right: {})",
+                Node::type_to_string(bin_op->lhs->inferred_type()),
+                Node::type_to_string(bin_op->rhs->inferred_type())));
+        return;
+    }
+
+    if (this->do_implicit_cast_if_necessary(bin_op->lhs, type) == false ||
+        this->do_implicit_cast_if_necessary(bin_op->rhs, type) == false)
+    {
+        bin_op->set_inferred_type(&BuiltinTypes::poison);
+        return;
+    }
+
+    if (bin_op_category(bin_op->operator_kind) == BinaryOperatorCategory::comparison)
+    {
+        bin_op->set_inferred_type(this->ctx.make_vector_type(type->length, &BuiltinTypes::boolean));
+        return;
+    }
+
+    bin_op->set_inferred_type(type);
+}
+
+// Typechecks a call to a vector intrinsic (see Intrinsic) and resolves it. The lane indices must be constant.
+void TypeChecker::typecheck_intrinsic(ProcedureCallNode *call)
+{
+    auto ident = node_cast<IdentifierNode, true>(call->procedure);
+
+    for (auto [intrinsic, name] : intrinsic_names)
+    {
+        if (ident->identifier == name)
+        {
+            call->intrinsic = intrinsic;
+        }
+    }
+
+    // The arguments of the layout queries are names, not values
+    if (is_layout_query(call->intrinsic))
+    {
+        this->typecheck_layout_query(call);
+        return;
+    }
+
+    if (is_atomic(call->intrinsic))
+    {
+        this->typecheck_atomic(call);
+        return;
+    }
+
+    // The task of the procedure suspends to wait for other tasks, outlined parallel for loops have no task
+    auto is_suspending = call->intrinsic == Intrinsic::start || call->intrinsic == Intrinsic::await ||
+                         call->intrinsic == Intrinsic::yield;
+    if (is_suspending && (this->current_procedure == nullptr || this->current_procedure->is_async == false))
+    {
+        this->error(call, true, std::format("{} can only be used in async procedures", ident->identifier));
+        return;
+    }
+
+    if (is_suspending && this->current_parallel_loop != nullptr)
+    {
+        this->error(call, true, std::format("{} cannot be used in parallel for loops", ident->identifier));
+        return;
+    }
+
+    for (auto &argument : call->arguments)
+    {
+        // Only the task intrinsics can call async procedures
+        auto task_call = is_task_intrinsic(call->intrinsic) ? node_cast<ProcedureCallNode>(argument) : nullptr;
+        SET_TEMPORARILY(this->current_task_call, task_call);
+
+        this->typecheck(argument);
+        if (spread_poison(argument, call))
+        {
+            return;
+        }
+
+        // The call of a spawn is made by the new thread, the call of a task by the executor
+        if (call->intrinsic != Intrinsic::spawn && async_procedure(argument) == nullptr)
+        {
+            this->fold_constant(argument);
+        }
+    }
+
+    auto argument_error = [&](std::string_view expected)
+    {
+        this->error(
+            call,
+            true,
+            std::format("Invalid arguments for {}, expected {}", ident->identifier, expected));
+    };
+
+    auto vector_argument = [&](size_t index, std::optional<BasicTypeNode::Kind> element_kind = std::nullopt)
+    {
+        auto type = node_cast<VectorTypeNode>(call->arguments[index]->inferred_type());
+        if (type != nullptr && element_kind.has_value() && type->element_type->type_kind != element_kind.value())
+        {
+            return static_cast<VectorTypeNode *>(nullptr);
+        }
+
+        return type;
+    };
+
+    // Appends the lane indices in the arguments from first_argument to end_argument to the lanes of the call
+    auto collect_lanes = [&](size_t first_argument, size_t end_argument, int64_t num_lanes)
+    {
+        for (auto i = first_argument; i < end_argument; ++i)
+        {
+            auto literal = node_cast<LiteralNode>(call->arguments[i]);
+            auto type    = node_cast<BasicTypeNode>(call->arguments[i]->inferred_type());
+            if (literal == nullptr || std::holds_alternative<uint64_t>(literal->value) == false)
+            {
+                return false;
+            }
+
+            auto lane = normalize_integer(type, std::get<uint64_t>(literal->value));
+            if (lane < 0 || lane >= num_lanes)
+            {
+                return false;
+            }
+
+            call->lanes.push_back(lane);
+        }
+
+        return true;
+    };
+
+    if (auto vector_type = make_vector_type(this->ctx, ident->identifier))
+    {
+        call->intrinsic = Intrinsic::make_vector;
+
+        if (call->arguments.size() != 1 && call->arguments.size() != vector_type->length)
+        {
+            argument_error(std::format("one value for all lanes or {} values", vector_type->length));
+            return;
+        }
+
+        for (auto &argument : call->arguments)
+        {
+            if (this->do_implicit_cast_if_necessary(argument, vector_type->element_type) == false)
+            {
+                call->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+        }
+
+        call->set_inferred_type(vector_type);
+        return;
+    }
+
+    auto num_arguments = call->arguments.size();
+
+    switch (call->intrinsic)
+    {
+        case Intrinsic::extract:
+        {
+            auto type = num_arguments == 2 ? vector_argument(0) : nullptr;
+            if (type == nullptr || collect_lanes(1, 2, type->length) == false)
+            {
+                argument_error("a vector and a constant lane index");
+                return;
+            }
+
+            call->set_inferred_type(type->element_type);
+            return;
+        }
+
+        case Intrinsic::insert:
+        {
+            auto type = num_arguments == 3 ? vector_argument(0) : nullptr;
+            if (type == nullptr || collect_lanes(1, 2, type->length) == false)
+            {
+                argument_error("a vector, a constant lane index and a value");
+                return;
+            }
+
+            if (this->do_implicit_cast_if_necessary(call->arguments[2], type->element_type) == false)
+            {
+                call->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+
+            call->set_inferred_type(type);
+            return;
+        }
+
+        case Intrinsic::shuffle:
+        case Intrinsic::swizzle:
+        {
+            auto is_shuffle     = call->intrinsic == Intrinsic::shuffle;
+            auto first_lane     = is_shuffle ? 2 : 1;
+            auto type           = num_arguments > first_lane ? vector_argument(0) : nullptr;
+            auto has_two_inputs = type != nullptr && is_shuffle &&
+                                  Node::types_equal(call->arguments[1]->inferred_type(), type);
+
+            auto is_valid = type != nullptr && (is_shuffle == false || has_two_inputs) &&
+                            collect_lanes(first_lane, num_arguments, is_shuffle ? 2 * type->length : type->length) &&
+                            VectorTypeNode::is_valid_length(static_cast<int64_t>(call->lanes.size()));
+            if (is_valid == false)
+            {
+                argument_error(
+                    is_shuffle ? "two vectors of the same type and constant lane indices (into both vectors)"
+                               : "a vector and constant lane indices");
+                return;
+            }
+
+            call->set_inferred_type(
+                this->ctx.make_vector_type(static_cast<int64_t>(call->lanes.size()), type->element_type));
+            return;
+        }
+
+        case Intrinsic::select:
+        {
+            auto mask_type = num_arguments == 3 ? vector_argument(0, BasicTypeNode::Kind::boolean) : nullptr;
+            auto type      = num_arguments == 3 ? vector_argument(1) : nullptr;
+            if (mask_type == nullptr || type == nullptr || mask_type->length != type->length)
+            {
+                argument_error("a mask and two values with as many lanes");
+                return;
+            }
+
+            if (this->do_implicit_cast_if_necessary(call->arguments[2], type) == false)
+            {
+                call->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+
+            call->set_inferred_type(type);
+            return;
+        }
+
+        case Intrinsic::reduce_add:
+        case Intrinsic::reduce_mul:
+        case Intrinsic::reduce_min:
+        case Intrinsic::reduce_max:
+        {
+            auto type = num_arguments == 1 ? vector_argument(0) : nullptr;
+            if (type == nullptr || type->element_type->is_numerical() == false)
+            {
+                argument_error("a vector of numbers");
+                return;
+            }
+
+            call->set_inferred_type(type->element_type);
+            return;
+        }
+
+        case Intrinsic::any:
+        case Intrinsic::all:
+        {
+            if (num_arguments != 1 || vector_argument(0, BasicTypeNode::Kind::boolean) == nullptr)
+            {
+                argument_error("a mask");
+                return;
+            }
+
+            call->set_inferred_type(&BuiltinTypes::boolean);
+            return;
+        }
+
+        // The arguments are evaluated by the calling thread, the procedure runs on the new one
+        case Intrinsic::spawn:
+        {
+            ProcedureNode *procedure{};
+            auto procedure_call = num_arguments == 1 ? node_cast<ProcedureCallNode>(call->arguments[0]) : nullptr;
+            auto callee = procedure_call != nullptr ? node_cast<IdentifierNode>(procedure_call->procedure) : nullptr;
+            if (callee != nullptr && callee->declaration != nullptr && procedure_call->intrinsic == Intrinsic::none)
+            {
+                procedure = node_cast<ProcedureNode>(callee->declaration->init_expression);
+            }
+
+            if (procedure == nullptr || procedure->is_external || procedure->signature->is_vararg)
+            {
+                argument_error("a call to a procedure that is not external");
+                return;
+            }
+
+            if (Node::types_equal(procedure->signature->return_type, &BuiltinTypes::voyd) == false)
+            {
+                this->error(call, true, "The procedure of a thread cannot return a value");
+                return;
+            }
+
+            call->set_inferred_type(&BuiltinTypes::u64);
+            return;
+        }
+
+        case Intrinsic::join:
+        {
+            if (num_arguments != 1)
+            {
+                argument_error("a thread");
+                return;
+            }
+
+            if (this->do_implicit_cast_if_necessary(call->arguments[0], &BuiltinTypes::u64) == false)
+            {
+                call->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+
+            call->set_inferred_type(&BuiltinTypes::voyd);
+            return;
+        }
+
+        case Intrinsic::run:
+        {
+            if (num_arguments != 2 || async_procedure(call->arguments[1]) == nullptr)
+            {
+                argument_error("an arena and a call to an async procedure");
+                return;
+            }
+
+            auto arena_type = this->make_slice_type(&BuiltinTypes::u8);
+            if (this->do_implicit_cast_if_necessary(call->arguments[0], arena_type) == false)
+            {
+                call->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+
+            call->set_inferred_type(call->arguments[1]->inferred_type());
+            return;
+        }
+
+        // Nothing awaits the result of a started task
+        case Intrinsic::start:
+        {
+            if (num_arguments != 1 || async_procedure(call->arguments[0]) == nullptr)
+            {
+                argument_error("a call to an async procedure");
+                return;
+            }
+
+            if (Node::types_equal(call->arguments[0]->inferred_type(), &BuiltinTypes::voyd) == false)
+            {
+                this->error(call, true, "The procedure of a started task cannot return a value");
+                return;
+            }
+
+            call->set_inferred_type(&BuiltinTypes::u64);
+            return;
+        }
+
+        case Intrinsic::await:
+        {
+            if (num_arguments != 1)
+            {
+                argument_error("a call to an async procedure or a task");
+                return;
+            }
+
+            if (async_procedure(call->arguments[0]) != nullptr)
+            {
+                call->set_inferred_type(call->arguments[0]->inferred_type());
+                return;
+            }
+
+            if (this->do_implicit_cast_if_necessary(call->arguments[0], &BuiltinTypes::u64) == false)
+            {
+                call->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+
+            call->set_inferred_type(&BuiltinTypes::voyd);
+            return;
+        }
+
+        case Intrinsic::yield:
+        {
+            if (num_arguments != 0)
+            {
+                argument_error("no arguments");
+                return;
+            }
+
+            call->set_inferred_type(&BuiltinTypes::voyd);
+            return;
+        }
+
+        default: UNREACHED;
+    }
+}
+
+// The alignment that the code generators know the address of the variable, the field or the array element to have
+static int64_t known_alignment(const Node *node)
+{
+    // The alignment of an address that is offset from an address with the alignment
+    auto offset_alignment = [](int64_t alignment, int64_t offset)
+    { return offset == 0 ? alignment : std::min(alignment, offset & -offset); };
+
+    switch (node->kind)
+    {
+        case NodeKind::member_access:
+        {
+            auto member_access = static_cast<const MemberAccessNode *>(node);
+            auto struct_type   = struct_layout(member_access->object->inferred_type());
+            const auto &field  = struct_type->fields[member_access->field_index];
+
+            // a[i].x of a @soa array is the element i of the array of the field
+            if (auto index = node_cast<IndexNode>(member_access->object))
+            {
+                auto array = node_cast<ArrayTypeNode>(index->array->inferred_type());
+                if (array != nullptr && array->is_soa)
+                {
+                    auto offset    = soa_field_offset(array, member_access->field_index);
+                    auto alignment = offset_alignment(known_alignment(index->array), offset);
+                    return offset_alignment(alignment, size_of(field.type));
+                }
+            }
+
+            return offset_alignment(known_alignment(member_access->object), field.offset);
+        }
+
+        // The elements of slices are aligned like their type
+        case NodeKind::index:
+        {
+            auto index        = static_cast<const IndexNode *>(node);
+            auto element_type = index->inferred_type();
+            auto alignment    = index->array->inferred_type()->kind == NodeKind::slice_type
+                                    ? align_of(element_type)
+                                    : known_alignment(index->array);
+
+            return offset_alignment(alignment, size_of(element_type));
+        }
+
+        default: return align_of(node->inferred_type());
+    }
+}
+
+// Typechecks a call to an atomic intrinsic (see Intrinsic) and resolves its memory order. The operations work on
+// integers of all sizes, loads, stores, exchanges and additions and subtractions on floating point numbers as well and
+// loads, stores, exchanges and compare-exchanges on pointers. The target must be aligned to its size.
+void TypeChecker::typecheck_atomic(ProcedureCallNode *call)
+{
+    auto ident = node_cast<IdentifierNode, true>(call->procedure);
+
+    // The number of values after the operand, atomic_fence has no operand
+    auto num_values = 1;
+    switch (call->intrinsic)
+    {
+        case Intrinsic::atomic_load:             num_values = 0; break;
+        case Intrinsic::atomic_compare_exchange: num_values = 2; break;
+        case Intrinsic::atomic_fence:            num_values = -1; break;
+        default:                                 break;
+    }
+
+    auto argument_error = [&]
+    {
+        std::string_view operands[] = {
+            "a variable, a field or an array element and ",
+            "a variable, a field or an array element, a value and ",
+            "a variable, a field or an array element, the expected value, the desired value and ",
+        };
+
+        this->error(
+            call,
+            true,
+            std::format(
+                "Invalid arguments for {}, expected {}the memory order (relaxed, acquire, release, acq_rel or seq_cst)",
+                ident->identifier,
+                num_values < 0 ? "" : operands[num_values]));
+    };
+
+    // The memory order is a name, not a value
+    auto has_order  = call->arguments.size() == static_cast<size_t>(num_values + 2);
+    auto order_name = has_order ? node_cast<IdentifierNode>(call->arguments.back()) : nullptr;
+    for (auto [order, name] : memory_order_names)
+    {
+        if (order_name != nullptr && order_name->identifier == name)
+        {
+            call->memory_order = order;
+        }
+    }
+
+    if (call->memory_order == MemoryOrder::none)
+    {
+        argument_error();
+        return;
+    }
+
+    call->arguments.pop_back();
+
+    // Loads cannot release and stores cannot acquire, a fence that orders nothing is meaningless
+    auto order          = call->memory_order;
+    auto releases       = order == MemoryOrder::release || order == MemoryOrder::acq_rel;
+    auto acquires       = order == MemoryOrder::acquire || order == MemoryOrder::acq_rel;
+    auto is_valid_order = (call->intrinsic != Intrinsic::atomic_load || releases == false) &&
+                          (call->intrinsic != Intrinsic::atomic_store || acquires == false) &&
+                          (call->intrinsic != Intrinsic::atomic_fence || order != MemoryOrder::relaxed);
+    if (is_valid_order == false)
+    {
+        this->error(
+            call,
+            true,
+            std::format("The memory order {} is not valid for {}", order_name->identifier, ident->identifier));
+        return;
+    }
+
+    if (call->intrinsic == Intrinsic::atomic_fence)
+    {
+        call->set_inferred_type(&BuiltinTypes::voyd);
+        return;
+    }
+
+    auto target = call->arguments[0];
+    if (this->typecheck_and_spread_poison(target, call))
+    {
+        return;
+    }
+
+    if (is_assignable(target) == false || (target->kind == NodeKind::identifier &&
+                                           static_cast<IdentifierNode *>(target)->declaration->is_procedure_argument))
+    {
+        argument_error();
+        return;
+    }
+
+    auto type  = target->inferred_type();
+    auto basic = node_cast<BasicTypeNode>(type);
+
+    auto is_integer = basic != nullptr && (basic->type_kind == BasicTypeNode::Kind::signed_integer ||
+                                           basic->type_kind == BasicTypeNode::Kind::unsigned_integer);
+    auto is_float   = basic != nullptr && basic->type_kind == BasicTypeNode::Kind::floatingpoint;
+    auto is_pointer = type->kind == NodeKind::pointer_type;
+
+    auto is_valid_type = is_integer;
+    switch (call->intrinsic)
+    {
+        case Intrinsic::atomic_load:
+        case Intrinsic::atomic_store:
+        case Intrinsic::atomic_exchange:
+        {
+            is_valid_type = is_integer || is_float || is_pointer;
+            break;
+        }
+
+        case Intrinsic::atomic_compare_exchange: is_valid_type = is_integer || is_pointer; break;
+
+        case Intrinsic::atomic_add:
+        case Intrinsic::atomic_sub:
+        {
+            is_valid_type = is_integer || is_float;
+            break;
+        }
+
+        default: break;
+    }
+
+    if (is_valid_type == false)
+    {
+        this->error(
+            call,
+            true,
+            std::format("Invalid operand type {} for {}", Node::type_to_string(type), ident->identifier));
+        return;
+    }
+
+    // NOTE: Misaligned atomic operations would need a lock
+    if (known_alignment(target) < size_of(type))
+    {
+        this->error(
+            call,
+            true,
+            std::format(
+                "The operand of {} must be aligned to its size ({} bytes)",
+                ident->identifier,
+                size_of(type)));
+        return;
+    }
+
+    for (size_t i = 1; i < call->arguments.size(); ++i)
+    {
+        if (this->typecheck_and_spread_poison(call->arguments[i], call))
+        {
+            return;
+        }
+
+        this->fold_constant(call->arguments[i]);
+
+        if (this->do_implicit_cast_if_necessary(call->arguments[i], type) == false)
+        {
+            call->set_inferred_type(&BuiltinTypes::poison);
+            return;
+        }
+    }
+
+    call->set_inferred_type(call->intrinsic == Intrinsic::atomic_store ? &BuiltinTypes::voyd : type);
+}
+
+// Typechecks sizeof(T), alignof(T) or offsetof(T, field) and replaces the name of the type with the type, the call is
+// folded to a literal of type u64
+void TypeChecker::typecheck_layout_query(ProcedureCallNode *call)
+{
+    auto ident         = node_cast<IdentifierNode, true>(call->procedure);
+    auto is_offset_of  = call->intrinsic == Intrinsic::offset_of;
+    auto num_arguments = is_offset_of ? 2 : 1;
+    auto first         = call->arguments.size() == num_arguments ? call->arguments[0] : nullptr;
+    auto type_name     = node_cast<IdentifierNode>(first);
+
+    auto argument_error = [&]
+    {
+        this->error(
+            call,
+            true,
+            std::format(
+                "Invalid arguments for {}, expected {}",
+                ident->identifier,
+                is_offset_of ? "the name of a struct type and the name of one of its fields" : "the name of a type"));
+    };
+
+    // In instances of generics, the type parameters have been replaced with their types
+    if (type_name == nullptr && (first == nullptr || first->is_type() == false))
+    {
+        argument_error();
+        return;
+    }
+
+    // The builtin types and vector types are not declared, their names are identifiers here
+    Node *type = type_name == nullptr ? first : nullptr;
+    for (auto [builtin_type, name] : BuiltinTypes::type_names)
+    {
+        if (type_name != nullptr && type_name->identifier == name)
+        {
+            type = builtin_type;
+        }
+    }
+
+    if (type == nullptr)
+    {
+        type = make_vector_type(this->ctx, type_name->identifier);
+    }
+
+    if (type == nullptr)
+    {
+        type = type_name;
+        if (this->resolve_type(type) == false)
+        {
+            call->set_inferred_type(&BuiltinTypes::poison);
+            return;
+        }
+    }
+
+    if (has_memory_layout(type) == false)
+    {
+        this->error(
+            call,
+            true,
+            std::format("The type {} has no layout in memory", Node::type_to_string(type)));
+        return;
+    }
+
+    if (is_offset_of)
+    {
+        auto struct_type = node_cast<StructTypeNode>(type);
+        auto field_name  = node_cast<IdentifierNode>(call->arguments[1]);
+        if (struct_type == nullptr || field_name == nullptr || struct_type->find_field(field_name->identifier) < 0)
+        {
+            argument_error();
+            return;
+        }
+    }
+
+    call->arguments[0] = type;
+    call->set_inferred_type(&BuiltinTypes::u64);
+}
+
+// Typechecks a[i] where a is an array or a slice and i an integer. The elements of @soa arrays are only allowed as the
+// object of a member access (a[i].x).
+void TypeChecker::typecheck_index(IndexNode *index, bool is_member_object)
+{
+    this->typecheck(index->array);
+    this->typecheck(index->index);
+    this->fold_constant(index->index);
+
+    if (spread_poison(index->array, index) || spread_poison(index->index, index))
+    {
+        return;
+    }
+
+    auto array = node_cast<ArrayTypeNode>(index->array->inferred_type());
+    auto slice = node_cast<SliceTypeNode>(index->array->inferred_type());
+    if (array == nullptr && slice == nullptr)
+    {
+        this->error(
+            index,
+            true,
+            std::format(
+                "Only arrays and slices can be indexed (received expression of type {})",
+                Node::type_to_string(index->array->inferred_type())));
+        return;
+    }
+
+    auto index_type = node_cast<BasicTypeNode>(index->index->inferred_type());
+    if (index_type == nullptr || (index_type->type_kind != BasicTypeNode::Kind::signed_integer &&
+                                  index_type->type_kind != BasicTypeNode::Kind::unsigned_integer))
+    {
+        this->error(
+            index,
+            true,
+            std::format(
+                "The index must be an integer (received expression of type {})",
+                Node::type_to_string(index->index->inferred_type())));
+        return;
+    }
+
+    if (array != nullptr && array->is_soa && is_member_object == false)
+    {
+        this->error(index, true, "The elements of @soa arrays can only be accessed through their fields (like a[i].x)");
+        return;
+    }
+
+    if (auto literal = node_cast<LiteralNode>(index->index))
+    {
+        auto value = normalize_integer(index_type, std::get<uint64_t>(literal->value));
+        if (value < 0 || (array != nullptr && value >= array_length(array)))
+        {
+            this->error(
+                index,
+                true,
+                std::format(
+                    "The index {} is out of bounds for the type {}",
+                    value,
+                    Node::type_to_string(index->array->inferred_type())));
+            return;
+        }
+    }
+
+    index->set_inferred_type(array != nullptr ? array->element_type : slice->element_type);
+    index->needs_bounds_check = this->ctx.bounds_checks && this->is_in_bounds(index) == false;
+}
+
+// Typechecks a[b:e] where a is an array that is not @soa or a slice and the bounds are integers. The bounds are
+// checked at compile time as far as they are constant, the others at run time.
+void TypeChecker::typecheck_slice(SliceNode *slice)
+{
+    this->typecheck(slice->object);
+    if (spread_poison(slice->object, slice))
+    {
+        return;
+    }
+
+    for (auto bound : {&slice->begin, &slice->end})
+    {
+        if (*bound == nullptr)
+        {
+            continue;
+        }
+
+        this->typecheck(*bound);
+        this->fold_constant(*bound);
+
+        if (spread_poison(*bound, slice))
+        {
+            return;
+        }
+    }
+
+    auto array      = node_cast<ArrayTypeNode>(slice->object->inferred_type());
+    auto slice_type = node_cast<SliceTypeNode>(slice->object->inferred_type());
+    if ((array == nullptr || array->is_soa) && slice_type == nullptr)
+    {
+        this->error(
+            slice,
+            true,
+            std::format(
+                "Only slices and arrays that are not @soa can be sliced (received expression of type {})",
+                Node::type_to_string(slice->object->inferred_type())));
+        return;
+    }
+
+    // The omitted bounds are the start and the end of the array or slice
+    std::optional<int64_t> begin = slice->begin == nullptr ? std::optional<int64_t>{0} : std::nullopt;
+    std::optional<int64_t> end   = slice->end == nullptr && array != nullptr ? std::optional{array_length(array)}
+                                                                               : std::nullopt;
+
+    for (auto [bound, value] : {std::make_tuple(slice->begin, &begin), std::make_tuple(slice->end, &end)})
+    {
+        if (bound == nullptr)
+        {
+            continue;
+        }
+
+        auto type = node_cast<BasicTypeNode>(bound->inferred_type());
+        if (type == nullptr || (type->type_kind != BasicTypeNode::Kind::signed_integer &&
+                                type->type_kind != BasicTypeNode::Kind::unsigned_integer))
+        {
+            this->error(
+                slice,
+                true,
+                std::format(
+                    "The bounds of a slice must be integers (received expression of type {})",
+                    Node::type_to_string(bound->inferred_type())));
+            return;
+        }
+
+        if (auto literal = node_cast<LiteralNode>(bound))
+        {
+            *value = normalize_integer(type, std::get<uint64_t>(literal->value));
+        }
+    }
+
+    auto is_out_of_bounds = (begin.has_value() && begin.value() < 0) || (end.has_value() && end.value() < 0) ||
+                            (begin.has_value() && end.has_value() && begin.value() > end.value()) ||
+                            (array != nullptr && end.has_value() && end.value() > array_length(array));
+    if (is_out_of_bounds)
+    {
+        this->error(
+            slice,
+            true,
+            std::format(
+                "The bounds of the slice are out of bounds for the type {}",
+                Node::type_to_string(slice->object->inferred_type())));
+        return;
+    }
+
+    // a[:] and a[0:] of a slice are the slice itself
+    auto is_whole_slice = slice_type != nullptr && slice->end == nullptr && begin == 0;
+    auto is_in_bounds   = (begin.has_value() && end.has_value()) || is_whole_slice;
+
+    slice->needs_bounds_check = this->ctx.bounds_checks && is_in_bounds == false;
+    slice->set_inferred_type(slice_type != nullptr ? slice_type : this->make_slice_type(array->element_type));
+}
+
+// Whether the index of a[i] is known to be within the bounds of a: it is a constant index into an array (these are
+// checked by typecheck_index) or the counter of a counted loop whose end is a constant not greater than the length of
+// the array or the length of the slice a itself. In the latter case, the slice must be a local variable that the loop
+// does not assign to, so that its length in the condition is the length it has when it is indexed.
+bool TypeChecker::is_in_bounds(IndexNode *index)
+{
+    auto array = node_cast<ArrayTypeNode>(index->array->inferred_type());
+    if (array != nullptr && index->index->kind == NodeKind::literal)
+    {
+        return true;
+    }
+
+    auto counter = node_cast<IdentifierNode>(index->index);
+    if (counter == nullptr || counter->declaration == nullptr)
+    {
+        return false;
+    }
+
+    auto loop = std::ranges::find_if(
+        this->counted_loops.rbegin(),
+        this->counted_loops.rend(),
+        [&](const CountedLoop &counted_loop) { return counted_loop.counter == counter->declaration; });
+    if (loop == this->counted_loops.rend())
+    {
+        return false;
+    }
+
+    auto end          = loop->condition->rhs;
+    auto is_inclusive = loop->condition->operator_kind == Tt::less_than_or_equal;
+
+    if (array != nullptr)
+    {
+        auto literal  = node_cast<LiteralNode>(end);
+        auto end_type = node_cast<BasicTypeNode>(end->inferred_type());
+        if (literal == nullptr || std::holds_alternative<uint64_t>(literal->value) == false)
+        {
+            return false;
+        }
+
+        auto value = normalize_integer(end_type, std::get<uint64_t>(literal->value));
+        return value >= 0 && (is_inclusive ? value < array_length(array) : value <= array_length(array));
+    }
+
+    auto slice  = node_cast<IdentifierNode>(index->array);
+    auto length = node_cast<MemberAccessNode>(end);
+    auto object = length != nullptr ? node_cast<IdentifierNode>(length->object) : nullptr;
+    if (is_inclusive || slice == nullptr || slice->declaration == nullptr || object == nullptr ||
+        object->declaration != slice->declaration || length->member != "length")
+    {
+        return false;
+    }
+
+    // NOTE: The arguments of procedures are registered in the global block
+    auto decl     = slice->declaration;
+    auto is_local = decl->is_procedure_argument || decl->is_global() == false;
+
+    return is_local && loop->assigned_identifiers.contains(decl->identifier) == false;
+}
+
+// Collects what the body of a parallel for loop declares, reads and assigns to directly
+struct ParallelBodyCollector : NodeVisitorBase
+{
+    std::unordered_set<DeclarationNode *> declarations{};
+    std::vector<IdentifierNode *> identifiers{};
+    std::vector<IdentifierNode *> assigned_identifiers{};
+
+    void visit(DeclarationNode *declaration) override { this->declarations.insert(declaration); }
+    void visit(IdentifierNode *identifier) override { this->identifiers.push_back(identifier); }
+
+    void visit(BinaryOperatorNode *bin_op) override
+    {
+        auto ident = node_cast<IdentifierNode>(bin_op->lhs);
+        if (bin_op->operator_kind == Tt::assign && ident != nullptr)
+        {
+            this->assigned_identifiers.push_back(ident);
+        }
+    }
+};
+
+// The iterations of a parallel for loop run concurrently and in no particular order, so the loop must count up by 1
+// and the body must not assign to the variables that the iterations share, except for the variables of reductions
+// (the elements and fields of shared variables can be assigned to). The body was typechecked already. Records the
+// variables of the procedure that the body reads, which the code generators pass to the outlined body.
+void TypeChecker::check_parallel_loop(WhileLoopNode *whyle)
+{
+    auto condition = node_cast<BinaryOperatorNode, true>(whyle->condition);
+    auto increment = node_cast<BinaryOperatorNode>(whyle->prologue);
+    auto sum       = increment != nullptr ? node_cast<BinaryOperatorNode>(increment->rhs) : nullptr;
+    auto step      = sum != nullptr ? node_cast<LiteralNode>(sum->rhs) : nullptr;
+    if ((condition->operator_kind != Tt::less_than && condition->operator_kind != Tt::less_than_or_equal) ||
+        sum == nullptr || sum->operator_kind != Tt::plus || step == nullptr ||
+        std::holds_alternative<uint64_t>(step->value) == false || std::get<uint64_t>(step->value) != 1)
+    {
+        this->error(whyle, false, "A parallel for loop must count up by 1 (with '<' or '<=' and without a step)");
+        return;
+    }
+
+    auto counter = node_cast<IdentifierNode, true>(condition->lhs)->declaration;
+    if (Node::types_equal(counter->init_expression->inferred_type(), &BuiltinTypes::i64) == false)
+    {
+        this->error(
+            whyle,
+            false,
+            std::format(
+                "The counter of a parallel for loop must be of type i64, received {}",
+                Node::type_to_string(counter->init_expression->inferred_type())));
+        return;
+    }
+
+    if (whyle->grain_size != nullptr)
+    {
+        this->typecheck(whyle->grain_size);
+        this->fold_constant(whyle->grain_size);
+
+        auto type = node_cast<BasicTypeNode>(whyle->grain_size->inferred_type());
+        if (type == nullptr || (type->type_kind != BasicTypeNode::Kind::signed_integer &&
+                                type->type_kind != BasicTypeNode::Kind::unsigned_integer))
+        {
+            this->error(whyle, false, "The grain size of a parallel for loop must be an integer");
+            return;
+        }
+
+        this->do_implicit_cast_if_necessary(whyle->grain_size, &BuiltinTypes::i64);
+    }
+
+    // NOTE: The arguments of procedures are registered in the global block
+    auto is_local = [](DeclarationNode *decl)
+    {
+        return (decl->is_procedure_argument || decl->is_global() == false) &&
+               decl->init_expression->kind != NodeKind::struct_type;
+    };
+
+    std::unordered_set<DeclarationNode *> reduced{};
+    for (auto &reduction : whyle->reductions)
+    {
+        this->typecheck(reduction.variable);
+
+        auto decl = reduction.variable->declaration;
+        if (decl == nullptr)
+        {
+            return;
+        }
+
+        // Arguments cannot be assigned to
+        if (is_local(decl) == false || decl->is_procedure_argument || decl == counter)
+        {
+            this->error(
+                whyle,
+                false,
+                std::format("The reduction variable '{}' must be a local variable", decl->identifier));
+            return;
+        }
+
+        auto type = node_cast<BasicTypeNode>(reduction.variable->inferred_type());
+        if (type == nullptr || type->is_numerical() == false)
+        {
+            this->error(
+                whyle,
+                false,
+                std::format(
+                    "The reduction variable '{}' must be a number, received {}",
+                    decl->identifier,
+                    Node::type_to_string(reduction.variable->inferred_type())));
+            return;
+        }
+
+        if (reduced.insert(decl).second == false)
+        {
+            this->error(whyle, false, std::format("Duplicate reduction of '{}'", decl->identifier));
+            return;
+        }
+    }
+
+    ParallelBodyCollector collector{};
+    visit(whyle->body, collector);
+
+    auto is_shared = [&](DeclarationNode *decl)
+    { return decl != nullptr && is_local(decl) && collector.declarations.contains(decl) == false; };
+
+    for (auto ident : collector.assigned_identifiers)
+    {
+        if (is_shared(ident->declaration) && reduced.contains(ident->declaration) == false)
+        {
+            this->error(
+                ident,
+                false,
+                std::format(
+                    "The iterations of a parallel for loop share '{}' and cannot assign to it (use @reduce)",
+                    ident->identifier));
+            return;
+        }
+    }
+
+    std::unordered_set<DeclarationNode *> captured{};
+    for (auto ident : collector.identifiers)
+    {
+        auto decl = ident->declaration;
+        if (is_shared(decl) && decl != counter && reduced.contains(decl) == false && captured.insert(decl).second)
+        {
+            whyle->captures.push_back(decl);
+        }
+    }
+}
+
+// return tail f(...) replaces the frame of the procedure with the one of f, which returns to the caller of the
+// procedure in its place, so f needs the same signature. The callee gets the addresses of copies of struct, array and
+// slice arguments, which cannot be in the frame that is replaced, so only the ones that the procedure received itself
+// can be passed on. Pointers into the frame must not be passed either, which is up to the program.
+void TypeChecker::check_tail_call(ReturnStatementNode *retyrn)
+{
+    auto procedure = this->current_procedure;
+    auto call      = node_cast<ProcedureCallNode>(retyrn->expression);
+    auto ident     = call != nullptr ? node_cast<IdentifierNode>(call->procedure) : nullptr;
+    auto callee    = ident != nullptr && ident->declaration != nullptr
+                         ? node_cast<ProcedureNode>(ident->declaration->init_expression)
+                         : nullptr;
+    if (callee == nullptr || call->intrinsic != Intrinsic::none || call->is_compile_time)
+    {
+        this->error(retyrn, false, "The expression of a tail call must be a call of a procedure");
+        return;
+    }
+
+    if (procedure->is_async)
+    {
+        this->error(retyrn, false, "Async procedures cannot make tail calls");
+        return;
+    }
+
+    if (callee->is_async || callee->is_external)
+    {
+        this->error(retyrn, false, "The procedure of a tail call cannot be async or external");
+        return;
+    }
+
+    if (Node::types_equal(callee->signature, procedure->signature) == false || procedure->signature->is_vararg)
+    {
+        this->error(
+            retyrn,
+            false,
+            std::format(
+                "The procedure of a tail call must have the signature of the calling procedure without varargs "
+                "(signature of the procedure: {}, signature of the callee: {})",
+                Node::type_to_string(procedure->signature),
+                Node::type_to_string(callee->signature)));
+        return;
+    }
+
+    std::unordered_set<DeclarationNode *> passed_on{};
+    for (auto argument : call->arguments)
+    {
+        if (is_aggregate(argument->inferred_type()) == false)
+        {
+            continue;
+        }
+
+        auto argument_ident = node_cast<IdentifierNode>(argument);
+        auto declaration    = argument_ident != nullptr ? argument_ident->declaration : nullptr;
+        if (std::ranges::find(procedure->signature->arguments, declaration) == procedure->signature->arguments.end() ||
+            passed_on.insert(declaration).second == false)
+        {
+            this->error(
+                retyrn,
+                false,
+                "The struct, array and slice arguments of a tail call must be arguments of the calling procedure, "
+                "each passed on once");
+            return;
+        }
+    }
+}
+
+// Replaces an expression that has a constant value with a literal of the same type. The operands of the expression
+// must have been folded already (the typechecker folds bottom up), so only expressions whose operands are literals
+// are evaluated.
+void TypeChecker::fold_constant(Node *&expression)
+{
+    if (expression->inferred_type() == nullptr || expression->is_poisoned() || expression->kind == NodeKind::literal)
+    {
+        return;
+    }
+
+    auto type = node_cast<BasicTypeNode>(expression->inferred_type());
+
+    if (auto call = node_cast<ProcedureCallNode>(expression); call != nullptr && call->is_compile_time)
+    {
+        auto is_value_type =
+            type != nullptr && (type->is_numerical() || type->type_kind == BasicTypeNode::Kind::boolean);
+        if (is_value_type == false)
+        {
+            this->error(
+                call,
+                false,
+                std::format(
+                    "The value of #run must be a number or a boolean (received {})",
+                    Node::type_to_string(call->inferred_type())));
+            return;
+        }
+
+        auto result = this->run_at_compile_time(call);
+        if (result.has_value() == false)
+        {
+            return;
+        }
+
+        // NOTE: The interpreter holds f32 values as f64
+        ConstantValue value{};
+        switch (type->type_kind)
+        {
+            case BasicTypeNode::Kind::boolean: value = result.value() != 0; break;
+            case BasicTypeNode::Kind::floatingpoint:
+            {
+                auto number = std::bit_cast<double>(result.value());
+                value       = type->size == 4 ? ConstantValue{static_cast<float>(number)} : ConstantValue{number};
+                break;
+            }
+            default: value = static_cast<uint64_t>(normalize_integer(type, static_cast<uint64_t>(result.value())));
+        }
+
+        expression = this->make_constant_literal(value, type);
+        return;
+    }
+
+    if (type == nullptr || (type->is_numerical() == false && type->type_kind != BasicTypeNode::Kind::boolean))
+    {
+        return;
+    }
+
+    auto is_literal = [](const Node *node) { return node->kind == NodeKind::literal; };
+
+    auto has_constant_operands = false;
+    switch (expression->kind)
+    {
+        case NodeKind::identifier:
+        {
+            auto decl             = static_cast<IdentifierNode *>(expression)->declaration;
+            has_constant_operands = decl != nullptr && decl->is_constant;
+            break;
+        }
+
+        case NodeKind::binary_operator:
+        {
+            auto bin_op = static_cast<BinaryOperatorNode *>(expression);
+            if (bin_op->operator_kind == Tt::logical_and || bin_op->operator_kind == Tt::logical_or)
+            {
+                // The left operand might decide the result on its own
+                has_constant_operands = is_literal(bin_op->lhs);
+            }
+            else
+            {
+                has_constant_operands =
+                    bin_op->operator_kind != Tt::assign && is_literal(bin_op->lhs) && is_literal(bin_op->rhs);
+            }
+
+            break;
+        }
+
+        case NodeKind::type_cast:
+        {
+            has_constant_operands = is_literal(static_cast<TypeCastNode *>(expression)->expression);
+            break;
+        }
+
+        case NodeKind::procedure_call:
+        {
+            auto call             = static_cast<ProcedureCallNode *>(expression);
+            has_constant_operands = is_layout_query(call->intrinsic) || std::ranges::all_of(call->arguments, is_literal);
+            break;
+        }
+
+        // The length of an array
+        case NodeKind::member_access:
+        {
+            auto object           = static_cast<MemberAccessNode *>(expression)->object;
+            has_constant_operands = object->inferred_type()->kind == NodeKind::array_type;
+            break;
+        }
+
+        default: break;
+    }
+
+    if (has_constant_operands == false)
+    {
+        return;
+    }
+
+    auto value = evaluate_constant(expression);
+    if (value.has_value() == false)
+    {
+        return;
+    }
+
+    expression = this->make_constant_literal(value.value(), type);
+}
+
+// Runs a call marked with #run on the bytecode interpreter and returns its result in the representation of the
+// registers of the interpreter
+std::optional<int64_t> TypeChecker::run_at_compile_time(ProcedureCallNode *call)
+{
+    if (std::ranges::all_of(call->arguments, [](Node *argument) { return argument->kind == NodeKind::literal; }) ==
+        false)
+    {
+        this->error(call, false, "The arguments of #run must be constant");
+        return std::nullopt;
+    }
+
+    for (auto decl : reachable_procedures(call))
+    {
+        if (this->procedures_in_progress.contains(node_cast<ProcedureNode, true>(decl->init_expression)))
+        {
+            this->error(
+                call,
+                false,
+                std::format("#run cannot call '{}' while it is being typechecked (recursive #run)", decl->identifier));
+            return std::nullopt;
+        }
+    }
+
+    if (this->errors.empty() == false)
+    {
+        // The procedures may not be fully typed, the program does not compile anyway
+        return std::nullopt;
+    }
+
+    auto program = compile_call_to_bytecode(call);
+
+    Vm vm{};
+    load_program(&vm, &program);
+
+    return call_procedure(&vm, program.main_procedure);
+}
+
+LiteralNode *TypeChecker::make_constant_literal(const ConstantValue &value, BasicTypeNode *type)
+{
+    LiteralNode *literal{};
+
+    if (auto integer = std::get_if<uint64_t>(&value))
+    {
+        // NOTE: Integer literals hold the value truncated to the size of their type
+        auto mask   = type->size >= 8 ? ~uint64_t{} : (uint64_t{1} << (type->size * 8)) - 1;
+        auto suffix = type->type_kind == BasicTypeNode::Kind::unsigned_integer ? 'u' : '\0';
+        literal     = this->ctx.make_literal(*integer & mask, suffix);
+    }
+    else if (auto number = std::get_if<float>(&value))
+    {
+        literal = this->ctx.make_float_literal(*number);
+    }
+    else if (auto number = std::get_if<double>(&value))
+    {
+        literal = this->ctx.make_double_literal(*number);
+    }
+    else
+    {
+        literal = this->ctx.make_bool_literal(std::get<bool>(value));
+    }
+
+    literal->set_inferred_type(type);
+
+    return literal;
+}
+
+// Resolves the names of the struct types in the type and folds the length expressions of its array types to literals.
+// The struct types the type contains by value must have a layout, which rules out structs that contain themselves.
+// Returns false on errors.
+// NOTE: The type nodes themselves are not typechecked because the builtin types are shared by all nodes that use them
+bool TypeChecker::resolve_type(Node *&type, bool needs_layout)
+{
+    if (auto ident = node_cast<IdentifierNode>(type))
+    {
+        auto decl    = this->current_block->find_declaration(ident->identifier);
+        auto generic = decl != nullptr ? node_cast<GenericNode>(decl->init_expression) : nullptr;
+        if (generic != nullptr && generic->definition->kind == AstKind::struct_type)
+        {
+            decl = this->instantiate(decl, ident->type_arguments, ident);
+            if (decl == nullptr)
+            {
+                return false;
+            }
+        }
+        else if (decl != nullptr && ident->type_arguments.empty() == false)
+        {
+            this->error(ident, false, std::format("The type '{}' is not generic", ident->identifier));
+            return false;
+        }
+
+        auto struct_type = decl != nullptr ? node_cast<StructTypeNode>(decl->init_expression) : nullptr;
+        if (struct_type == nullptr)
+        {
+            this->error(ident, false, std::format("Could not find the type '{}'", ident->identifier));
+            return false;
+        }
+
+        // The struct type might be used before its declaration has been typechecked
+        if (struct_type->inferred_type() == nullptr && this->structs_in_progress.contains(struct_type) == false)
+        {
+            SET_TEMPORARILY(this->current_block, decl->containing_block);
+            this->typecheck(decl);
+        }
+
+        type = struct_type;
+    }
+
+    if (auto struct_type = node_cast<StructTypeNode>(type))
+    {
+        if (this->structs_in_progress.contains(struct_type))
+        {
+            if (needs_layout)
+            {
+                this->error(
+                    struct_type,
+                    false,
+                    std::format("The struct {} contains itself", Node::type_to_string(struct_type)));
+            }
+
+            return needs_layout == false;
+        }
+
+        if (struct_type->inferred_type() == nullptr)
+        {
+            this->typecheck(struct_type);
+        }
+
+        return struct_type->is_poisoned() == false;
+    }
+
+    if (auto pointer = node_cast<PointerTypeNode>(type))
+    {
+        return this->resolve_type(pointer->target_type, false);
+    }
+
+    // Like pointers, slices do not contain their elements
+    if (auto slice = node_cast<SliceTypeNode>(type))
+    {
+        if (this->resolve_type(slice->element_type, false) == false)
+        {
+            return false;
+        }
+
+        if (has_memory_layout(slice->element_type) == false)
+        {
+            this->error(
+                slice,
+                false,
+                std::format("Slices cannot have elements of type {}", Node::type_to_string(slice->element_type)));
+            return false;
+        }
+
+        if (slice->layout == nullptr)
+        {
+            std::vector<StructField> fields{
+                StructField{.identifier = "data", .type = this->ctx.make_pointer_type(slice->element_type)},
+                StructField{.identifier = "length", .type = &BuiltinTypes::i64},
+            };
+
+            slice->layout = this->ctx.make_struct_type(std::move(fields), false, 0);
+            this->typecheck(slice->layout);
+        }
+
+        return true;
+    }
+
+    auto array = node_cast<ArrayTypeNode>(type);
+    if (array == nullptr)
+    {
+        return true;
+    }
+
+    if (array->length->inferred_type() == nullptr)
+    {
+        this->typecheck(array->length);
+        this->fold_constant(array->length);
+    }
+
+    if (array->length->is_poisoned())
+    {
+        return false;
+    }
+
+    auto length_type = node_cast<BasicTypeNode>(array->length->inferred_type());
+    auto literal     = node_cast<LiteralNode>(array->length);
+
+    auto is_constant_length =
+        length_type != nullptr && literal != nullptr &&
+        (length_type->type_kind == BasicTypeNode::Kind::unsigned_integer ||
+         (length_type->type_kind == BasicTypeNode::Kind::signed_integer &&
+          normalize_integer(length_type, std::get<uint64_t>(literal->value)) >= 0));
+    if (is_constant_length == false)
+    {
+        this->error(
+            array,
+            false,
+            std::format(
+                "The length of an array type must be a constant non-negative integer expression (received expression of type {})",
+                Node::type_to_string(array->length->inferred_type())));
+        return false;
+    }
+
+    if (this->resolve_type(array->element_type) == false)
+    {
+        return false;
+    }
+
+    if (has_memory_layout(array->element_type) == false)
+    {
+        this->error(
+            array,
+            false,
+            std::format("Arrays cannot have elements of type {}", Node::type_to_string(array->element_type)));
+        return false;
+    }
+
+    if (array->is_soa && array->element_type->kind != NodeKind::struct_type)
+    {
+        this->error(
+            array,
+            false,
+            std::format(
+                "The elements of @soa arrays must be structs (received {})",
+                Node::type_to_string(array->element_type)));
+        return false;
+    }
+
+    return true;
+}
+
+// Instances that instantiate further instances beyond this depth most likely do so without end (like a generic
+// procedure that calls itself with a pointer to its type parameter)
+constexpr int64_t max_instantiation_depth = 64;
+
+// Returns the declaration of the instance of the generic declaration with the type arguments. The instances are
+// converted from the syntax of the definition, typechecked and appended to the module when they are first used, later
+// uses with equal type arguments refer to the same instance. Returns nullptr after reporting an error.
+DeclarationNode *TypeChecker::instantiate(DeclarationNode *declaration, std::vector<Node *> type_arguments, Node *site)
+{
+    auto generic = node_cast<GenericNode, true>(declaration->init_expression);
+
+    if (type_arguments.size() != generic->type_parameters.size())
+    {
+        this->error(
+            site,
+            false,
+            std::format(
+                "'{}' expects {} type arguments (received {})",
+                declaration->identifier,
+                generic->type_parameters.size(),
+                type_arguments.size()));
+        return nullptr;
+    }
+
+    for (auto &argument : type_arguments)
+    {
+        if (this->resolve_type(argument, false) == false)
+        {
+            return nullptr;
+        }
+
+        if (has_memory_layout(argument) == false)
+        {
+            this->error(
+                site,
+                false,
+                std::format("The type {} cannot be a type argument", Node::type_to_string(argument)));
+            return nullptr;
+        }
+    }
+
+    for (const auto &instance : generic->instances)
+    {
+        if (std::ranges::equal(instance.type_arguments, type_arguments, Node::types_equal) == false)
+        {
+            continue;
+        }
+
+        if (instance.has_errors)
+        {
+            this->error(site, false, std::format("The instance {} has errors", instance.identifier));
+            return nullptr;
+        }
+
+        return instance.declaration;
+    }
+
+    if (this->instantiation_depth >= max_instantiation_depth)
+    {
+        this->error(
+            site,
+            false,
+            std::format(
+                "Too many nested instances of '{}' (the type arguments grow without end)",
+                declaration->identifier));
+        return nullptr;
+    }
+
+    auto &instance = generic->instances.emplace_back();
+
+    std::string type_argument_names{};
+    for (auto argument : type_arguments)
+    {
+        type_argument_names += (type_argument_names.empty() ? "" : ", ") + Node::type_to_string(argument);
+    }
+
+    instance.identifier     = std::format("{}<{}>", declaration->identifier, type_argument_names);
+    instance.type_arguments = std::move(type_arguments);
+
+    auto module_block = declaration->containing_block;
+    assert(module_block->is_global());
+
+    NodeConverter converter{this->ctx};
+    converter.current_block = module_block;
+    for (auto i = 0; i < generic->type_parameters.size(); ++i)
+    {
+        converter.type_arguments.emplace(generic->type_parameters[i], instance.type_arguments[i]);
+    }
+
+    auto definition      = converter.make_node(generic->definition);
+    instance.declaration = this->ctx.make_declaration(instance.identifier, this->ctx.make_nop(), definition, false);
+
+    // The instance is registered before it is typechecked, so that it can refer to itself
+    DeclarationRegistrar registrar{this->ctx};
+    registrar.current_block = module_block;
+    visit(instance.declaration, registrar);
+
+    AssignmentCollector assignment_collector{this->assigned_identifiers};
+    visit(instance.declaration, assignment_collector);
+
+    module_block->statements.push_back(instance.declaration);
+
+    auto num_errors_before = this->errors.size();
+    this->errors.insert(this->errors.end(), registrar.errors.begin(), registrar.errors.end());
+
+    if (registrar.has_error() == false)
+    {
+        SET_TEMPORARILY(this->current_block, module_block);
+        SET_TEMPORARILY(this->current_task_call, nullptr);
+
+        ++this->instantiation_depth;
+        defer
+        {
+            --this->instantiation_depth;
+        };
+
+        this->typecheck(instance.declaration);
+    }
+
+    instance.has_errors = this->errors.size() != num_errors_before;
+    if (instance.has_errors)
+    {
+        // The backends must not see the instance
+        std::erase(module_block->statements, instance.declaration);
+        module_block->declarations.erase(instance.identifier);
+
+        this->error(site, false, std::format("The instance {} has errors", instance.identifier));
+        return nullptr;
+    }
+
+    return instance.declaration;
+}
+
+// Infers the type arguments of a call to a generic procedure that does not specify them from the types of the
+// arguments and stores them in the identifier of the procedure
+bool TypeChecker::infer_type_arguments(ProcedureCallNode *call, IdentifierNode *ident, GenericNode *generic)
+{
+    auto definition = ast_cast<AstProcedure>(generic->definition);
+    if (definition == nullptr)
+    {
+        // A generic struct, which cannot be called
+        return true;
+    }
+
+    std::unordered_map<std::string_view, Node *> inferred{};
+
+    const auto &parameters = definition->signature->arguments;
+    for (auto i = 0; i < call->arguments.size() && i < parameters.size(); ++i)
+    {
+        this->typecheck(call->arguments[i]);
+        if (call->arguments[i]->is_poisoned() == false)
+        {
+            this->match_type_parameters(parameters[i]->type, call->arguments[i]->inferred_type(), generic, inferred);
+        }
+    }
+
+    for (auto parameter : generic->type_parameters)
+    {
+        auto it = inferred.find(parameter);
+        if (it == inferred.end())
+        {
+            this->error(
+                call,
+                true,
+                std::format("Could not infer the type argument {} of '{}'", parameter, ident->identifier));
+            return false;
+        }
+
+        ident->type_arguments.push_back(it->second);
+    }
+
+    return true;
+}
+
+// Matches the syntax of the type of a parameter of a generic procedure with the type of the argument that is passed
+// for it and records the types that the type parameters stand for, the leftmost argument decides
+void TypeChecker::match_type_parameters(
+    AstNode *parameter_type,
+    Node *argument_type,
+    const GenericNode *generic,
+    std::unordered_map<std::string_view, Node *> &inferred)
+{
+    switch (parameter_type->kind)
+    {
+        case AstKind::type_identifier:
+        {
+            auto type_ident = static_cast<AstTypeIdentifier *>(parameter_type);
+            auto name       = type_ident->identifier.text();
+
+            if (type_ident->type_arguments.empty())
+            {
+                if (std::ranges::find(generic->type_parameters, name) != generic->type_parameters.end())
+                {
+                    inferred.emplace(name, argument_type);
+                }
+
+                return;
+            }
+
+            // <name><A, ...> matches the instances of the generic struct with the name
+            auto decl           = this->current_block->find_declaration(name);
+            auto struct_generic = decl != nullptr ? node_cast<GenericNode>(decl->init_expression) : nullptr;
+            if (struct_generic == nullptr)
+            {
+                return;
+            }
+
+            for (const auto &instance : struct_generic->instances)
+            {
+                if (instance.declaration == nullptr || instance.declaration->init_expression != argument_type)
+                {
+                    continue;
+                }
+
+                auto num_arguments = std::min(type_ident->type_arguments.size(), instance.type_arguments.size());
+                for (auto i = 0; i < num_arguments; ++i)
+                {
+                    this->match_type_parameters(
+                        type_ident->type_arguments[i],
+                        instance.type_arguments[i],
+                        generic,
+                        inferred);
+                }
+            }
+
+            return;
+        }
+
+        case AstKind::pointer_type:
+        {
+            if (auto pointer = node_cast<PointerTypeNode>(argument_type))
+            {
+                auto target_type = static_cast<AstPointerType *>(parameter_type)->target_type;
+                this->match_type_parameters(target_type, pointer->target_type, generic, inferred);
+            }
+
+            return;
+        }
+
+        // Arrays are passed as slices of all their elements
+        case AstKind::slice_type:
+        case AstKind::array_type:
+        {
+            auto element_type = parameter_type->kind == AstKind::slice_type
+                                    ? static_cast<AstSliceType *>(parameter_type)->element_type
+                                    : static_cast<AstArrayType *>(parameter_type)->element_type;
+
+            if (auto slice = node_cast<SliceTypeNode>(argument_type))
+            {
+                this->match_type_parameters(element_type, slice->element_type, generic, inferred);
+            }
+            else if (auto array = node_cast<ArrayTypeNode>(argument_type))
+            {
+                this->match_type_parameters(element_type, array->element_type, generic, inferred);
+            }
+
+            return;
+        }
+
+        default: return;
+    }
+}
 
-    auto type_kind = is_float ? BasicTypeNode::Kind::floatingpoint : lhs_basic->type_kind;
-    BasicTypeNode *type{};
-    for (auto [builtin_type, name] : BuiltinTypes::type_names)
+// Resolves the types of the fields of the struct and computes their offsets, the size and the alignment of the struct
+bool TypeChecker::compute_layout(StructTypeNode *struct_type)
+{
+    int64_t offset{};
+    auto alignment = std::max(struct_type->alignment, int64_t{1});
+
+    for (auto i = 0; i < struct_type->fields.size(); ++i)
     {
-        if (builtin_type->type_kind == type_kind && builtin_type->size == max_size)
+        auto &field = struct_type->fields[i];
+
+        if (struct_type->find_field(field.identifier) != i)
         {
-            type = builtin_type;
+            this->error(
+                struct_type,
+                false,
+                std::format(
+                    "The struct {} has more than one field called '{}'",
+                    Node::type_to_string(struct_type),
+                    field.identifier));
+            return false;
         }
-    }
 
-    if (this->do_implicit_cast_if_necessary(bin_op->lhs, type) == false)
-    {
-        spread_poison(bin_op->lhs, bin_op);
-        return &BuiltinTypes::poison;
-    }
+        if (this->resolve_type(field.type) == false)
+        {
+            return false;
+        }
 
-    if (this->do_implicit_cast_if_necessary(bin_op->rhs, type) == false)
-    {
-        spread_poison(bin_op->rhs, bin_op);
-        return &BuiltinTypes::poison;
+        if (has_memory_layout(field.type) == false)
+        {
+            this->error(
+                struct_type,
+                false,
+                std::format(
+                    "The field '{}' of the struct {} cannot be of type {}",
+                    field.identifier,
+                    Node::type_to_string(struct_type),
+                    Node::type_to_string(field.type)));
+            return false;
+        }
+
+        auto field_alignment = struct_type->field_alignment(field);
+        offset               = (offset + field_alignment - 1) / field_alignment * field_alignment;
+        field.offset         = offset;
+        offset += size_of(field.type);
+        alignment = std::max(alignment, field_alignment);
     }
 
-    return type;
+    struct_type->alignment = alignment;
+    struct_type->size      = (offset + alignment - 1) / alignment * alignment;
+
+    return true;
+}
+
+// Makes the type of the slices of arrays and slices with the element type
+SliceTypeNode *TypeChecker::make_slice_type(Node *element_type)
+{
+    Node *type = this->ctx.make_slice_type(element_type);
+
+    auto is_resolved = this->resolve_type(type);
+    assert(is_resolved);
+
+    return static_cast<SliceTypeNode *>(type);
 }
 
 void TypeChecker::typecheck(Node *node)
@@ -586,6 +2876,13 @@ void TypeChecker::typecheck_internal(Node *node)
             this->typecheck(bin_op->lhs);
             this->typecheck(bin_op->rhs);
 
+            if (bin_op->operator_kind != Tt::assign)
+            {
+                this->fold_constant(bin_op->lhs);
+            }
+
+            this->fold_constant(bin_op->rhs);
+
             if (spread_poison(bin_op->lhs, bin_op))
             {
                 return;
@@ -596,6 +2893,14 @@ void TypeChecker::typecheck_internal(Node *node)
                 return;
             }
 
+            auto has_vector_operand = bin_op->lhs->inferred_type()->kind == NodeKind::vector_type ||
+                                      bin_op->rhs->inferred_type()->kind == NodeKind::vector_type;
+            if (has_vector_operand && bin_op->operator_kind != Tt::assign)
+            {
+                this->typecheck_vector_operator(bin_op);
+                return;
+            }
+
             auto lhs_basic = node_cast<const BasicTypeNode>(bin_op->lhs->inferred_type());
             auto rhs_basic = node_cast<const BasicTypeNode>(bin_op->rhs->inferred_type());
 
@@ -683,6 +2988,15 @@ void TypeChecker::typecheck_internal(Node *node)
                 {
                     bin_op->set_inferred_type(&BuiltinTypes::voyd);
 
+                    if (is_assignable(bin_op->lhs) == false)
+                    {
+                        this->error(
+                            bin_op,
+                            false,
+                            "The left side of an assignment must be a variable, a field or an array element");
+                        return;
+                    }
+
                     if (this->do_implicit_cast_if_necessary(bin_op->rhs, bin_op->lhs->inferred_type()) == false)
                     {
                         this->error(
@@ -714,9 +3028,19 @@ void TypeChecker::typecheck_internal(Node *node)
             SET_TEMPORARILY(this->current_block, block);
 
             auto num_errors_before = this->errors.size();
-            for (auto statement : block->statements)
+            // NOTE: Instances of generics are appended to the statements of the module while they are typechecked
+            for (auto i = 0; i < block->statements.size(); ++i)
             {
-                this->typecheck(statement);
+                this->typecheck(block->statements[i]);
+
+                // A #run statement is only run for its side effects, nothing is left of it at run time
+                auto call = node_cast<ProcedureCallNode>(block->statements[i]);
+                if (call != nullptr && call->is_compile_time && call->is_poisoned() == false &&
+                    this->run_at_compile_time(call).has_value())
+                {
+                    block->statements[i] = this->ctx.make_nop();
+                    this->typecheck(block->statements[i]);
+                }
             }
 
             if (block->expected_compiler_error_kind == BlockNode::CompilerErrorKind::typecheck)
@@ -744,12 +3068,25 @@ void TypeChecker::typecheck_internal(Node *node)
 
             assert(this->current_block != nullptr);
 
+            if (auto struct_type = node_cast<StructTypeNode>(decl->init_expression))
+            {
+                struct_type->identifier = decl->identifier;
+            }
+
+            if (this->resolve_type(decl->specified_type) == false)
+            {
+                decl->init_expression->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+
             this->typecheck(decl->init_expression);
             if (decl->init_expression->is_poisoned())
             {
                 return;
             }
 
+            this->fold_constant(decl->init_expression);
+
             if (decl->identifier == "main" && decl->is_global())
             {
                 auto proc = node_cast<ProcedureNode>(decl->init_expression);
@@ -787,6 +3124,10 @@ void TypeChecker::typecheck_internal(Node *node)
                 }
             }
 
+            // A variable that is never assigned to keeps the value it is initialized with, so its uses can be folded
+            decl->is_constant = decl->init_expression->kind == NodeKind::literal &&
+                                this->assigned_identifiers.contains(decl->identifier) == false;
+
             return;
         }
 
@@ -817,17 +3158,116 @@ void TypeChecker::typecheck_internal(Node *node)
             }
 
             assert(decl->init_expression->inferred_type() != nullptr);
+
+            auto generic = node_cast<GenericNode>(decl->init_expression);
+            if (generic != nullptr && generic->definition->kind == AstKind::procedure)
+            {
+                decl = this->instantiate(decl, ident->type_arguments, ident);
+                if (decl == nullptr)
+                {
+                    ident->set_inferred_type(&BuiltinTypes::poison);
+                    return;
+                }
+
+                ident->declaration = decl;
+            }
+            else if (ident->type_arguments.empty() == false)
+            {
+                this->error(ident, true, std::format("'{}' is not a generic procedure", ident->identifier));
+                return;
+            }
+
+            auto is_type = decl->init_expression->kind == NodeKind::struct_type ||
+                           decl->init_expression->kind == NodeKind::generic;
+            if (is_type)
+            {
+                this->error(ident, true, std::format("The type '{}' cannot be used as a value", ident->identifier));
+                return;
+            }
+
             ident->set_inferred_type(decl->init_expression->inferred_type());
 
             return;
         }
 
+        case NodeKind::member_access:
+        {
+            auto member_access = static_cast<MemberAccessNode *>(node);
+
+            if (auto index = node_cast<IndexNode>(member_access->object))
+            {
+                this->typecheck_index(index, true);
+            }
+            else
+            {
+                this->typecheck(member_access->object);
+            }
+
+            if (spread_poison(member_access->object, member_access))
+            {
+                return;
+            }
+
+            auto object_type = member_access->object->inferred_type();
+
+            // The length of an array is part of its type, the member access is folded to a literal
+            if (object_type->kind == NodeKind::array_type && member_access->member == "length")
+            {
+                member_access->set_inferred_type(&BuiltinTypes::i64);
+                return;
+            }
+
+            auto struct_type = struct_layout(object_type);
+            if (struct_type == nullptr)
+            {
+                this->error(
+                    member_access,
+                    true,
+                    std::format(
+                        "Only the fields of structs and slices can be accessed (received expression of type {})",
+                        Node::type_to_string(object_type)));
+                return;
+            }
+
+            member_access->field_index = struct_type->find_field(member_access->member);
+            if (member_access->field_index < 0)
+            {
+                this->error(
+                    member_access,
+                    true,
+                    std::format(
+                        "The type {} has no field called '{}'",
+                        Node::type_to_string(object_type),
+                        member_access->member));
+                return;
+            }
+
+            member_access->set_inferred_type(struct_type->fields[member_access->field_index].type);
+
+            return;
+        }
+
+        case NodeKind::index:
+        {
+            this->typecheck_index(static_cast<IndexNode *>(node), false);
+
+            return;
+        }
+
+        case NodeKind::slice:
+        {
+            this->typecheck_slice(static_cast<SliceNode *>(node));
+
+            return;
+        }
+
         case NodeKind::if_statement:
         {
             auto yf = static_cast<IfStatementNode *>(node);
             yf->set_inferred_type(&BuiltinTypes::voyd);
 
             this->typecheck(yf->condition);
+            this->fold_constant(yf->condition);
             if (Node::types_equal(yf->condition->inferred_type(), &BuiltinTypes::boolean) == false)
             {
                 this->error(
@@ -855,6 +3295,7 @@ void TypeChecker::typecheck_internal(Node *node)
             whyle->set_inferred_type(&BuiltinTypes::voyd);
 
             this->typecheck(whyle->condition);
+            this->fold_constant(whyle->condition);
             if (Node::types_equal(whyle->condition->inferred_type(), &BuiltinTypes::boolean) == false)
             {
                 this->error(
@@ -867,7 +3308,29 @@ void TypeChecker::typecheck_internal(Node *node)
             }
 
             this->typecheck(whyle->prologue);
-            this->typecheck(whyle->body);
+
+            // The body of a counted loop might index with the counter without checking the bounds
+            auto counted_loop = this->ctx.bounds_checks ? as_counted_loop(whyle) : std::nullopt;
+            if (counted_loop.has_value())
+            {
+                this->counted_loops.push_back(std::move(counted_loop.value()));
+            }
+
+            {
+                SET_TEMPORARILY(this->current_loop, whyle);
+                SET_TEMPORARILY(this->current_parallel_loop, whyle->is_parallel ? whyle : this->current_parallel_loop);
+                this->typecheck(whyle->body);
+            }
+
+            if (counted_loop.has_value())
+            {
+                this->counted_loops.pop_back();
+            }
+
+            if (whyle->is_parallel)
+            {
+                this->check_parallel_loop(whyle);
+            }
 
             return;
         }
@@ -929,6 +3392,14 @@ void TypeChecker::typecheck_internal(Node *node)
             assert((proc->body == nullptr) == proc->is_external);
 
             SET_TEMPORARILY(this->current_procedure, proc);
+            SET_TEMPORARILY(this->current_loop, nullptr);
+            SET_TEMPORARILY(this->current_parallel_loop, nullptr);
+
+            this->procedures_in_progress.insert(proc);
+            defer
+            {
+                this->procedures_in_progress.erase(proc);
+            };
 
             this->typecheck_and_spread_poison(proc->signature, proc);
 
@@ -939,7 +3410,75 @@ void TypeChecker::typecheck_internal(Node *node)
                 proc->set_inferred_type(proc->signature);
             }
 
-            if (proc->is_external == false)
+            if (proc->is_inline && proc->is_noinline)
+            {
+                this->error(proc, false, "A procedure cannot be both @inline and @noinline");
+                return;
+            }
+
+            if (proc->is_hot && proc->is_cold)
+            {
+                this->error(proc, false, "A procedure cannot be both @hot and @cold");
+                return;
+            }
+
+            if (proc->is_external && (proc->is_inline || proc->is_flatten))
+            {
+                this->error(proc, false, "External procedures have no body that could be inlined or flattened");
+                return;
+            }
+
+            if (proc->is_async)
+            {
+                if (proc->is_external)
+                {
+                    this->error(proc, false, "Async procedures cannot be external");
+                    return;
+                }
+
+                // Coroutines can only be inlined once they have been split into their parts
+                if (proc->is_inline)
+                {
+                    this->error(proc, false, "Async procedures cannot be @inline");
+                    return;
+                }
+
+                // The result is kept in the task until it is awaited
+                auto return_type = proc->signature->return_type;
+                if (is_aggregate(return_type) || return_type->kind == NodeKind::vector_type)
+                {
+                    this->error(proc, false, "Async procedures cannot return structs, arrays, slices or vectors");
+                    return;
+                }
+            }
+
+            if (proc->is_external)
+            {
+                auto signature_has = [&](auto predicate)
+                {
+                    return predicate(proc->signature->return_type) ||
+                           std::ranges::any_of(
+                               proc->signature->arguments,
+                               [&](DeclarationNode *argument)
+                               { return predicate(argument->init_expression->inferred_type()); });
+                };
+
+                if (signature_has([](Node *type) { return type->kind == NodeKind::vector_type; }))
+                {
+                    this->error(proc, false, "Vectors cannot be passed to or returned from external procedures");
+                    return;
+                }
+
+                if (signature_has([](Node *type) { return is_aggregate(type); }))
+                {
+                    this->error(
+                        proc,
+                        false,
+                        "Structs, arrays and slices cannot be passed to or returned from external procedures");
+                    return;
+                }
+            }
+            else
             {
                 this->typecheck(proc->body);
 
@@ -972,6 +3511,30 @@ void TypeChecker::typecheck_internal(Node *node)
         {
             auto call = static_cast<ProcedureCallNode *>(node);
 
+            // Declarations take precedence over the intrinsics
+            auto ident = node_cast<IdentifierNode>(call->procedure);
+            if (ident != nullptr && this->current_block->find_declaration(ident->identifier) == nullptr)
+            {
+                auto is_intrinsic = make_vector_type(this->ctx, ident->identifier) != nullptr ||
+                                    std::ranges::any_of(
+                                        intrinsic_names,
+                                        [&](auto entry) { return std::get<1>(entry) == ident->identifier; });
+                if (is_intrinsic)
+                {
+                    this->typecheck_intrinsic(call);
+                    return;
+                }
+            }
+
+            // The type arguments of generic procedures that are not given are inferred from the arguments
+            auto decl    = ident != nullptr ? this->current_block->find_declaration(ident->identifier) : nullptr;
+            auto generic = decl != nullptr ? node_cast<GenericNode>(decl->init_expression) : nullptr;
+            if (generic != nullptr && ident->type_arguments.empty() &&
+                this->infer_type_arguments(call, ident, generic) == false)
+            {
+                return;
+            }
+
             if (this->typecheck_and_spread_poison(call->procedure, call))
             {
                 return;
@@ -983,6 +3546,12 @@ void TypeChecker::typecheck_internal(Node *node)
                 return;
             }
 
+            if (async_procedure(call) != nullptr && call != this->current_task_call)
+            {
+                this->error(call, true, "Async procedures can only be called by run, start and await");
+                return;
+            }
+
             auto signature = node_cast<ProcedureSignatureNode, true>(call->procedure->inferred_type());
             call->set_inferred_type(signature->return_type);
 
@@ -1014,12 +3583,45 @@ void TypeChecker::typecheck_internal(Node *node)
 
             for (auto i = 0; i < call->arguments.size(); ++i)
             {
-                this->typecheck(call->arguments[i]);
+                // The arguments of generic procedures have been typechecked to infer the type arguments
+                if (call->arguments[i]->inferred_type() == nullptr)
+                {
+                    this->typecheck(call->arguments[i]);
+                }
+
                 if (call->arguments[i]->is_poisoned())
                 {
                     continue;
                 }
 
+                this->fold_constant(call->arguments[i]);
+
+                auto is_variadic_argument = i >= signature->arguments.size();
+                if (is_variadic_argument && call->arguments[i]->inferred_type()->kind == NodeKind::vector_type)
+                {
+                    this->error(call, false, "Vectors cannot be passed as variadic arguments");
+                    continue;
+                }
+
+                if (is_variadic_argument && is_aggregate(call->arguments[i]->inferred_type()))
+                {
+                    this->error(call, false, "Structs, arrays and slices cannot be passed as variadic arguments");
+                    continue;
+                }
+
+                // Arrays are passed as slices of all their elements
+                auto is_array_for_slice =
+                    i < signature->arguments.size() &&
+                    call->arguments[i]->inferred_type()->kind == NodeKind::array_type &&
+                    signature->arguments[i]->init_expression->inferred_type()->kind == NodeKind::slice_type;
+                if (is_array_for_slice &&
+                    this->do_implicit_cast_if_necessary(
+                        call->arguments[i],
+                        signature->arguments[i]->init_expression->inferred_type()) == false)
+                {
+                    continue;
+                }
+
                 if (i < signature->arguments.size() &&
                     Node::types_equal(
                         call->arguments[i]->inferred_type(),
@@ -1048,6 +3650,25 @@ void TypeChecker::typecheck_internal(Node *node)
                 this->typecheck_and_spread_poison(arg, signature);
             }
 
+            if (this->resolve_type(signature->return_type) == false)
+            {
+                signature->set_inferred_type(&BuiltinTypes::poison);
+                return;
+            }
+
+            auto is_array = [](Node *type) { return type != nullptr && type->kind == NodeKind::array_type; };
+            if (is_array(signature->return_type) ||
+                std::ranges::any_of(
+                    signature->arguments,
+                    [&](DeclarationNode *argument) { return is_array(argument->init_expression->inferred_type()); }))
+            {
+                this->error(
+                    signature,
+                    true,
+                    "Arrays cannot be passed to or returned from procedures by value (pass a slice instead)");
+                return;
+            }
+
             if (signature->inferred_type() == nullptr)
             {
                 signature->set_inferred_type(&BuiltinTypes::type);
@@ -1061,12 +3682,26 @@ void TypeChecker::typecheck_internal(Node *node)
             auto retyrn = static_cast<ReturnStatementNode *>(node);
             retyrn->set_inferred_type(&BuiltinTypes::voyd);
 
+            if (this->current_parallel_loop != nullptr)
+            {
+                this->error(retyrn, false, "Cannot return from inside of a parallel for loop");
+                return;
+            }
+
             this->typecheck(retyrn->expression);
             if (retyrn->expression->is_poisoned())
             {
                 return;
             }
 
+            if (retyrn->is_tail_call)
+            {
+                this->check_tail_call(retyrn);
+                return;
+            }
+
+            this->fold_constant(retyrn->expression);
+
             if (Node::types_equal(this->current_procedure->signature->return_type, &BuiltinTypes::voyd) == false &&
                 this->do_implicit_cast_if_necessary(
                     retyrn->expression,
@@ -1090,6 +3725,9 @@ void TypeChecker::typecheck_internal(Node *node)
             auto module = static_cast<ModuleNode *>(node);
             module->set_inferred_type(&BuiltinTypes::voyd);
 
+            AssignmentCollector assignment_collector{this->assigned_identifiers};
+            visit(module, assignment_collector);
+
             this->typecheck(module->block);
 
             return;
@@ -1098,6 +3736,8 @@ void TypeChecker::typecheck_internal(Node *node)
         case NodeKind::basic_type:
         {
             node->set_inferred_type(&BuiltinTypes::type);
+
+            return;
         }
 
         case NodeKind::pointer_type:
@@ -1106,6 +3746,8 @@ void TypeChecker::typecheck_internal(Node *node)
             pointer->set_inferred_type(&BuiltinTypes::type);
 
             this->typecheck(pointer->target_type);
+
+            return;
         }
 
         case NodeKind::array_type:
@@ -1115,12 +3757,34 @@ void TypeChecker::typecheck_internal(Node *node)
 
             this->typecheck(array->length);
             this->typecheck(array->element_type);
+
+            return;
+        }
+
+        case NodeKind::slice_type:
+        case NodeKind::vector_type:
+        {
+            node->set_inferred_type(&BuiltinTypes::type);
+
+            return;
         }
 
         case NodeKind::struct_type:
         {
-            TODO;
+            auto struct_type = static_cast<StructTypeNode *>(node);
+
+            this->structs_in_progress.insert(struct_type);
+            auto has_layout = this->compute_layout(struct_type);
+            this->structs_in_progress.erase(struct_type);
 
+            struct_type->set_inferred_type(has_layout ? &BuiltinTypes::type : &BuiltinTypes::poison);
+
+            return;
+        }
+
+        // Only the instances are typechecked (see instantiate)
+        case NodeKind::generic:
+        {
             node->set_inferred_type(&BuiltinTypes::type);
 
             return;
@@ -1150,6 +3814,8 @@ void TypeChecker::typecheck_internal(Node *node)
                 this->error(cast, false, "TODO: Currently only casts between numerical types are implemented");
                 return;
             }
+
+            return;
         }
 
         case NodeKind::goto_statement:
@@ -1158,6 +3824,11 @@ void TypeChecker::typecheck_internal(Node *node)
 
             node->set_inferred_type(&BuiltinTypes::voyd);
 
+            if (this->current_parallel_loop != nullptr)
+            {
+                this->error(node, false, "Cannot use goto inside of a parallel for loop");
+            }
+
             return;
         }
 
@@ -1167,6 +3838,11 @@ void TypeChecker::typecheck_internal(Node *node)
 
             node->set_inferred_type(&BuiltinTypes::voyd);
 
+            if (this->current_loop != nullptr && this->current_loop->is_parallel)
+            {
+                this->error(node, false, "Cannot break out of a parallel for loop");
+            }
+
             return;
         }
 
@@ -1185,6 +3861,11 @@ void TypeChecker::typecheck_internal(Node *node)
 
             label->set_inferred_type(&BuiltinTypes::voyd);
 
+            if (this->current_parallel_loop != nullptr)
+            {
+                this->error(label, false, "Cannot declare labels inside of a parallel for loop");
+            }
+
             return;
         }
     }
@@ -1,14 +1,19 @@
 #pragma once
 
 #include "context.h"
+#include "evaluate.h"
 #include "node.h"
 
+#include <unordered_map>
+#include <unordered_set>
+
 struct AstNode;
 
 struct NodeConverter
 {
     Context &ctx;
     BlockNode *current_block{};
+    std::unordered_map<std::string_view, Node *> type_arguments{};  // Replace the type parameters in instances
 
     explicit NodeConverter(Context &ctx)
         : ctx{ctx}
@@ -36,12 +41,29 @@ struct DeclarationRegistrar : NodeVisitorBase
     // void error(const Node *node, std::string_view message);
 };
 
+// A loop that counts up from a non-negative constant by a positive constant while the counter is below an end, like
+// the loops that for loops are desugared to. The counter is in bounds of everything that the end is in bounds of.
+struct CountedLoop
+{
+    DeclarationNode *counter{};
+    BinaryOperatorNode *condition{};  // <counter> < <end> or <counter> <= <end>
+    std::unordered_set<std::string_view> assigned_identifiers{};  // The variables the body assigns to directly
+};
+
 struct TypeChecker
 {
     Context &ctx;
     ProcedureNode *current_procedure{};  // TODO: Implement a node stack and do a upward search
     BlockNode *current_block{};
     std::vector<std::string> errors{};
+    std::unordered_set<std::string_view> assigned_identifiers{};  // The names of all variables that are assigned to
+    std::unordered_set<ProcedureNode *> procedures_in_progress{};  // Their bodies are being typechecked
+    std::unordered_set<StructTypeNode *> structs_in_progress{};  // Their layouts are being computed
+    std::vector<CountedLoop> counted_loops{};  // The counted loops around the current node, innermost last
+    WhileLoopNode *current_loop{};  // The innermost loop around the current node, break and continue refer to it
+    WhileLoopNode *current_parallel_loop{};  // The innermost parallel for loop around the current node
+    ProcedureCallNode *current_task_call{};  // The call of an async procedure that run, start or await makes
+    int64_t instantiation_depth{};  // The number of instances that are being typechecked inside each other
 
     explicit TypeChecker(Context &context)
         : ctx{context}
@@ -50,6 +72,28 @@ struct TypeChecker
 
     bool do_implicit_cast_if_necessary(Node *&node, Node *type);
     Node *coerce_types(BinaryOperatorNode *bin_op);
+    void typecheck_vector_operator(BinaryOperatorNode *bin_op);
+    void typecheck_intrinsic(ProcedureCallNode *call);
+    void typecheck_layout_query(ProcedureCallNode *call);
+    void typecheck_atomic(ProcedureCallNode *call);
+    void typecheck_index(IndexNode *index, bool is_member_object);
+    void typecheck_slice(SliceNode *slice);
+    bool is_in_bounds(IndexNode *index);
+    void check_parallel_loop(WhileLoopNode *whyle);
+    void check_tail_call(ReturnStatementNode *retyrn);
+    void fold_constant(Node *&expression);
+    std::optional<int64_t> run_at_compile_time(ProcedureCallNode *call);
+    LiteralNode *make_constant_literal(const ConstantValue &value, BasicTypeNode *type);
+    bool resolve_type(Node *&type, bool needs_layout = true);
+    DeclarationNode *instantiate(DeclarationNode *declaration, std::vector<Node *> type_arguments, Node *site);
+    bool infer_type_arguments(ProcedureCallNode *call, IdentifierNode *ident, GenericNode *generic);
+    void match_type_parameters(
+        AstNode *parameter_type,
+        Node *argument_type,
+        const GenericNode *generic,
+        std::unordered_map<std::string_view, Node *> &inferred);
+    bool compute_layout(StructTypeNode *struct_type);
+    SliceTypeNode *make_slice_type(Node *element_type);
     void typecheck(Node *node);
     void typecheck_internal(Node *node);
     bool typecheck_and_spread_poison(Node *node, Node *parent);
@@ -0,0 +1,1296 @@
+#include "vm.h"
+
+#include "op_code.h"
+#include "runtime.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <iostream>
+
+// Computed goto is a GNU extension, the switch is the portable fallback.
+// Define FASEL_VM_COMPUTED_GOTO=0 to compare the two.
+#ifndef FASEL_VM_COMPUTED_GOTO
+#if defined(__GNUC__)
+#define FASEL_VM_COMPUTED_GOTO 1
+#else
+#define FASEL_VM_COMPUTED_GOTO 0
+#endif
+#endif
+
+template<typename T>
+static T load(const uint8_t *data)
+{
+    T result;
+    memcpy(&result, data, sizeof(result));
+
+    return result;
+}
+
+// Calls the external procedure with the values of the arguments according to the System V x86-64 calling convention.
+// Integer and floating point arguments are passed in separate register files, so the callee is called through
+// a prototype that fills all six integer and all eight vector argument registers - the callee only looks at the ones
+// it expects. The prototype is variadic so that AL holds the number of vector registers that variadic callees
+// (like printf) need to save.
+static int64_t call_external(const VmExternalCall &call, const int64_t *arguments)
+{
+#if defined(__x86_64__) && !defined(_WIN32)
+    int64_t integers[6]{};
+    double floats[8]{};
+    size_t num_integers = 0;
+    size_t num_floats   = 0;
+
+    for (size_t i = 0; i < call.argument_kinds.size(); ++i)
+    {
+        switch (call.argument_kinds[i])
+        {
+            case VmValueKind::integer:
+            {
+                if (num_integers == std::size(integers))
+                {
+                    FATAL(std::format("Too many integer arguments for external procedure {}", call.name));
+                }
+
+                integers[num_integers++] = arguments[i];
+                break;
+            }
+
+            case VmValueKind::f32:
+            case VmValueKind::f64:
+            {
+                if (num_floats == std::size(floats))
+                {
+                    FATAL(std::format("Too many floating point arguments for external procedure {}", call.name));
+                }
+
+                auto value = std::bit_cast<double>(arguments[i]);
+                if (call.argument_kinds[i] == VmValueKind::f32)
+                {
+                    // A float argument lives in the lower 32 bits of the register
+                    auto bits = std::bit_cast<uint32_t>(static_cast<float>(value));
+                    value     = std::bit_cast<double>(static_cast<uint64_t>(bits));
+                }
+
+                floats[num_floats++] = value;
+                break;
+            }
+
+            case VmValueKind::none: UNREACHED;
+        }
+    }
+
+    using IntegerTrampoline = int64_t (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, ...);
+    using FloatTrampoline   = double (*)(int64_t, int64_t, int64_t, int64_t, int64_t, int64_t, ...);
+
+    if (call.return_kind == VmValueKind::f32 || call.return_kind == VmValueKind::f64)
+    {
+        auto result = reinterpret_cast<FloatTrampoline>(call.address)(
+            integers[0], integers[1], integers[2], integers[3], integers[4], integers[5],
+            floats[0], floats[1], floats[2], floats[3], floats[4], floats[5], floats[6], floats[7]);
+
+        if (call.return_kind == VmValueKind::f32)
+        {
+            auto bits = static_cast<uint32_t>(std::bit_cast<uint64_t>(result));
+            result    = static_cast<double>(std::bit_cast<float>(bits));
+        }
+
+        return std::bit_cast<int64_t>(result);
+    }
+
+    return reinterpret_cast<IntegerTrampoline>(call.address)(
+        integers[0], integers[1], integers[2], integers[3], integers[4], integers[5],
+        floats[0], floats[1], floats[2], floats[3], floats[4], floats[5], floats[6], floats[7]);
+#else
+    FATAL("Calling external procedures from the interpreter is only supported on x86-64 System V");
+#endif
+}
+
+void verify_program(const VmProgram *program)
+{
+    auto bytecode = program->code();
+    auto strings  = program->string_table();
+
+    if (strings.empty() == false && strings.back() != '\0')
+    {
+        FATAL("Invalid bytecode: the string table is not terminated");
+    }
+
+    // The procedures are laid out back to back, each one ends where the next one starts
+    std::vector<const VmProcedure *> procedures{};
+    for (const auto &procedure : program->procedures)
+    {
+        procedures.push_back(&procedure);
+    }
+
+    std::sort(procedures.begin(), procedures.end(), [](auto a, auto b) { return a->address < b->address; });
+
+    struct Jump
+    {
+        int64_t target{};
+        int64_t procedure_begin{};
+        int64_t procedure_end{};
+    };
+
+    std::vector<bool> is_instruction{};
+    is_instruction.resize(bytecode.size());
+    std::vector<Jump> jumps{};
+
+    for (size_t i = 0; i < procedures.size(); ++i)
+    {
+        const auto &procedure = *procedures[i];
+        auto begin = procedure.address;
+        auto end   = i + 1 < procedures.size() ? procedures[i + 1]->address : static_cast<int64_t>(bytecode.size());
+
+        if (begin < 0 || begin >= end || end > bytecode.size())
+        {
+            FATAL(std::format("Invalid bytecode: procedure {} has no instructions", procedure.name));
+        }
+
+        if (procedure.num_arguments < 0 || procedure.num_arguments > procedure.num_registers ||
+            procedure.num_results < 0 || procedure.num_results > procedure.num_arguments ||
+            procedure.num_registers > Vm::num_registers)
+        {
+            FATAL(std::format("Invalid bytecode: procedure {} has an invalid frame", procedure.name));
+        }
+
+        auto frame_alignment = static_cast<uint64_t>(procedure.frame_alignment);
+        if (procedure.frame_size < 0 || procedure.frame_size > Vm::memory_size ||
+            std::has_single_bit(frame_alignment) == false || frame_alignment > Vm::max_frame_alignment)
+        {
+            FATAL(std::format("Invalid bytecode: procedure {} has an invalid frame memory", procedure.name));
+        }
+
+        auto check_register = [&](const uint8_t *operand, int64_t count = 1)
+        {
+            if (load<VmRegister>(operand) + count > procedure.num_registers)
+            {
+                FATAL(std::format("Invalid bytecode: register out of range in procedure {}", procedure.name));
+            }
+        };
+
+        auto add_jump = [&](const uint8_t *operand)
+        {
+            jumps.push_back(Jump{.target = load<int32_t>(operand), .procedure_begin = begin, .procedure_end = end});
+        };
+
+        auto last_op = RETV;
+        for (auto pos = begin; pos < end;)
+        {
+            if (bytecode[pos] >= num_op_codes)
+            {
+                FATAL(std::format("Invalid bytecode: invalid op code at {}", pos));
+            }
+
+            auto op   = static_cast<OpCode>(bytecode[pos]);
+            auto size = static_cast<int64_t>(instruction_size(op));
+            if (pos + size > end)
+            {
+                FATAL(std::format("Invalid bytecode: truncated instruction at {}", pos));
+            }
+
+            auto ip             = &bytecode[pos];
+            is_instruction[pos] = true;
+            last_op             = op;
+
+            // The handler of a superinstruction continues with the handler of its second instruction, so that
+            // instruction has to follow - possibly as the first instruction of another superinstruction
+            for (const auto &superinstruction : superinstructions)
+            {
+                if (superinstruction.op != op)
+                {
+                    continue;
+                }
+
+                auto next = pos + size;
+                if (next >= end || first_op_of(static_cast<OpCode>(bytecode[next])) != superinstruction.second)
+                {
+                    FATAL(std::format("Invalid bytecode: superinstruction {} at {} is not followed by {}",
+                                      to_string(op), pos, to_string(superinstruction.second)));
+                }
+            }
+
+            switch (op_format(op))
+            {
+                case OpFormat::none: break;
+
+                case OpFormat::a:
+                {
+                    check_register(ip + 1);
+                    break;
+                }
+
+                case OpFormat::d_a:
+                {
+                    check_register(ip + 1);
+                    check_register(ip + 3);
+                    break;
+                }
+
+                case OpFormat::d_imm:
+                {
+                    check_register(ip + 1);
+
+                    if (first_op_of(op) == LOADS && static_cast<uint64_t>(load<int64_t>(ip + 3)) >= strings.size())
+                    {
+                        FATAL(std::format("Invalid bytecode: string out of range at {}", pos));
+                    }
+
+                    break;
+                }
+
+                case OpFormat::d_a_b:
+                {
+                    check_register(ip + 1);
+                    check_register(ip + 3);
+                    check_register(ip + 5);
+                    break;
+                }
+
+                case OpFormat::d_a_imm:
+                {
+                    check_register(ip + 1);
+                    check_register(ip + 3);
+                    break;
+                }
+
+                case OpFormat::d_a_bytes:
+                {
+                    check_register(ip + 1);
+                    check_register(ip + 3);
+
+                    auto bytes = ip[5];
+                    if (bytes == 0 || bytes > 8)
+                    {
+                        FATAL(std::format("Invalid bytecode: invalid integer width at {}", pos));
+                    }
+
+                    break;
+                }
+
+                case OpFormat::target:
+                {
+                    add_jump(ip + 1);
+                    break;
+                }
+
+                case OpFormat::a_target:
+                {
+                    check_register(ip + 1);
+                    add_jump(ip + 3);
+                    break;
+                }
+
+                case OpFormat::a_b_target:
+                {
+                    check_register(ip + 1);
+                    check_register(ip + 3);
+                    add_jump(ip + 5);
+                    break;
+                }
+
+                case OpFormat::a_imm_target:
+                {
+                    check_register(ip + 1);
+                    add_jump(ip + 11);
+                    break;
+                }
+
+                case OpFormat::index_a_d:
+                {
+                    auto index = load<uint32_t>(ip + 1);
+
+                    int64_t num_arguments{};
+                    if (op == CALL || op == TCALL || op == SPAWN || op == TASK)
+                    {
+                        if (index >= program->procedures.size())
+                        {
+                            FATAL(std::format("Invalid bytecode: invalid procedure index at {}", pos));
+                        }
+
+                        num_arguments = program->procedures[index].num_arguments;
+                    }
+                    else
+                    {
+                        if (index >= program->external_calls.size())
+                        {
+                            FATAL(std::format("Invalid bytecode: invalid external call index at {}", pos));
+                        }
+
+                        num_arguments = static_cast<int64_t>(program->external_calls[index].argument_kinds.size());
+                    }
+
+                    // The callee of a tail call takes over the registers of the arguments and results
+                    if (op == TCALL && (num_arguments != procedure.num_arguments ||
+                                        program->procedures[index].num_results != procedure.num_results))
+                    {
+                        FATAL(std::format("Invalid bytecode: tail call with a different signature at {}", pos));
+                    }
+
+                    // The procedure of a thread takes the address of the environment, followed by its size and
+                    // alignment in the registers of the thread that spawns it
+                    if (op == SPAWN)
+                    {
+                        if (num_arguments != 1)
+                        {
+                            FATAL(std::format("Invalid bytecode: invalid procedure of the thread at {}", pos));
+                        }
+
+                        num_arguments = 3;
+                    }
+
+                    // The callee's frame starts at the arguments, so they may end exactly at the end of the frame
+                    if (load<VmRegister>(ip + 5) + num_arguments > procedure.num_registers)
+                    {
+                        FATAL(std::format("Invalid bytecode: arguments out of range in procedure {}", procedure.name));
+                    }
+
+                    check_register(ip + 7);
+                    break;
+                }
+            }
+
+            pos += size;
+        }
+
+        if (last_op != RET && last_op != RETV && last_op != JMP)
+        {
+            FATAL(std::format("Invalid bytecode: procedure {} does not end with a return or jump", procedure.name));
+        }
+    }
+
+    for (const auto &jump : jumps)
+    {
+        if (jump.target < jump.procedure_begin || jump.target >= jump.procedure_end || is_instruction[jump.target] == false)
+        {
+            FATAL(std::format("Invalid bytecode: invalid jump target {}", jump.target));
+        }
+    }
+}
+
+void load_program(Vm *vm, const VmProgram *program)
+{
+    verify_program(program);
+
+    vm->program = program;
+    vm->registers.resize(Vm::num_registers);
+    vm->frames.clear();
+    vm->frames.reserve(Vm::max_call_depth);
+    vm->entry_registers = vm->registers.data();
+    vm->memory          = std::make_unique_for_overwrite<uint8_t[]>(Vm::memory_size);
+    vm->entry_memory    = vm->memory.get();
+    vm->num_dispatches  = 0;
+    vm->tiers           = std::make_unique<Vm::ProcedureTier[]>(program->procedures.size());
+}
+
+std::unique_ptr<Vm> create_thread_vm(const Vm *vm)
+{
+    // The program was verified when the given interpreter loaded it
+    auto thread_vm     = std::make_unique<Vm>();
+    thread_vm->program = vm->program;
+    thread_vm->registers.resize(Vm::num_registers);
+    thread_vm->frames.reserve(Vm::max_call_depth);
+    thread_vm->entry_registers  = thread_vm->registers.data();
+    thread_vm->memory           = std::make_unique_for_overwrite<uint8_t[]>(Vm::memory_size);
+    thread_vm->entry_memory     = thread_vm->memory.get();
+    thread_vm->hot_threshold    = vm->hot_threshold;
+    thread_vm->on_hot_procedure = vm->on_hot_procedure;
+    thread_vm->tiers            = vm->tiers;
+
+    return thread_vm;
+}
+
+static thread_local Vm *running_vm{};
+
+Vm *current_vm()
+{
+    return running_vm;
+}
+
+static void count_hotness(Vm *vm, int64_t procedure_index)
+{
+    // Plain loads and stores, the interpreters of other threads may lose some counts but one of them reaches the
+    // threshold
+    auto &hotness = vm->tiers[procedure_index].hotness;
+    auto count    = hotness.load(std::memory_order_relaxed) + 1;
+    hotness.store(count, std::memory_order_relaxed);
+
+    if (count == vm->hot_threshold) [[unlikely]]
+    {
+        vm->on_hot_procedure(procedure_index);
+    }
+}
+
+// The frame memory of the procedure, starting at the next address from begin that has the alignment of the frame
+static uint8_t *frame_memory(Vm *vm, uint8_t *begin, const VmProcedure &procedure)
+{
+    auto alignment = static_cast<uintptr_t>(procedure.frame_alignment);
+    auto memory    = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(begin) + alignment - 1) & ~(alignment - 1));
+    if (memory + procedure.frame_size > vm->memory.get() + Vm::memory_size)
+    {
+        FATAL("Stack overflow");
+    }
+
+    return memory;
+}
+
+// The task of an async procedure (see Intrinsic::run). It is allocated from the arena of the executor, followed by its
+// registers and its frame memory, so the addresses of its structs and arrays stay valid while it is suspended. Its
+// registers are copied to the registers of the interpreter while it runs and back when it suspends.
+struct VmTask
+{
+    Vm *vm{};
+    int64_t procedure{};
+    const uint8_t *ip{};  // Where the task continues when it is resumed
+    int64_t *registers{};
+    uint8_t *memory{};
+    VmTask *waiter{};  // The task that awaits this one
+    int64_t result{};
+    bool is_done{};
+};
+
+// The task that the interpreter is running on the calling thread, AWAIT and YIELD suspend it
+static thread_local VmTask *running_task{};
+
+static void resume_task(void *task);
+
+// Creates the task of the procedure and runs it until it suspends for the first time, which an async procedure does
+// right after it copied its struct arguments to its frame memory (see compile_vm.cpp)
+static VmTask *create_task(Vm *vm, int64_t procedure_index, const int64_t *arguments)
+{
+    const auto &procedure = vm->program->procedures[procedure_index];
+
+    auto registers_size = static_cast<int64_t>(sizeof(VmTask) + procedure.num_registers * sizeof(int64_t));
+    auto memory_offset  = (registers_size + procedure.frame_alignment - 1) / procedure.frame_alignment *
+                         procedure.frame_alignment;
+    auto pointer        = static_cast<uint8_t *>(fasel_task_allocate(
+        memory_offset + procedure.frame_size,
+        std::max<int64_t>(alignof(VmTask), procedure.frame_alignment)));
+
+    auto task = new (pointer) VmTask{
+        .vm        = vm,
+        .procedure = procedure_index,
+        .ip        = vm->program->code().data() + procedure.address,
+        .registers = reinterpret_cast<int64_t *>(pointer + sizeof(VmTask)),
+        .memory    = pointer + memory_offset,
+    };
+
+    std::copy_n(arguments, procedure.num_arguments, task->registers);
+    resume_task(task);
+
+    return task;
+}
+
+// Runs the procedure whose code starts at ip with the frame starting at r and the frame memory at m until it returns,
+// or until its task suspends. The frame memory of the procedures that it calls starts at memory_end.
+// The bytecode was verified when it was loaded, so the operands are not checked here.
+//
+// With computed goto, every instruction handler jumps directly to the handler of the next instruction, which gives
+// the branch predictor one indirect jump per handler to learn from instead of the single one of the switch.
+template<bool profile_op_pairs, bool mixed_mode>
+static int64_t execute(Vm *vm, int64_t procedure, const uint8_t *ip, int64_t *r, uint8_t *m, uint8_t *memory_end)
+{
+    const auto code          = vm->program->code().data();
+    const auto strings       = vm->program->string_table().data();
+    const auto registers_end = vm->registers.data() + vm->registers.size();
+    const auto entry_depth   = vm->frames.size();
+
+    uint64_t num_dispatches = 0;
+    defer
+    {
+        vm->num_dispatches += num_dispatches;
+    };
+
+    // Only pairs where the second instruction directly follows the first one are counted, because only those can be
+    // fused into a superinstruction
+    const uint8_t *previous_ip = nullptr;
+
+    // Loops are jumps back, so procedures that run long loops become hot without being called often
+#define COUNT_BACK_EDGE(next_ip)              \
+    do                                        \
+    {                                         \
+        if constexpr (mixed_mode)             \
+        {                                     \
+            if ((next_ip) <= ip)              \
+            {                                 \
+                count_hotness(vm, procedure); \
+            }                                 \
+        }                                     \
+    } while (false)
+
+#define COUNT_DISPATCH()                                                                                  \
+    do                                                                                                    \
+    {                                                                                                     \
+        ++num_dispatches;                                                                                 \
+        if constexpr (profile_op_pairs)                                                                   \
+        {                                                                                                 \
+            auto falls_through = previous_ip != nullptr &&                                                \
+                                 previous_ip + instruction_size(static_cast<OpCode>(*previous_ip)) == ip; \
+            if (falls_through)                                                                            \
+            {                                                                                             \
+                ++vm->op_pair_counts[*previous_ip * num_op_codes + *ip];                                  \
+            }                                                                                             \
+                                                                                                          \
+            previous_ip = ip;                                                                             \
+        }                                                                                                 \
+    } while (false)
+
+#if FASEL_VM_COMPUTED_GOTO
+    static const void *const handlers[] = {
+        &&handle_MOV,
+        &&handle_LOADI,
+        &&handle_LOADS,
+        &&handle_ADD,
+        &&handle_ADDI,
+        &&handle_SUB,
+        &&handle_MUL,
+        &&handle_DIVS,
+        &&handle_DIVU,
+        &&handle_MODS,
+        &&handle_MODU,
+        &&handle_BITAND,
+        &&handle_BITOR,
+        &&handle_BITXOR,
+        &&handle_LSH,
+        &&handle_RSH,
+        &&handle_SEXT,
+        &&handle_ZEXT,
+        &&handle_CMPEQ,
+        &&handle_CMPNE,
+        &&handle_CMPLT,
+        &&handle_CMPLE,
+        &&handle_CMPGT,
+        &&handle_CMPGE,
+        &&handle_CMPLTU,
+        &&handle_CMPLEU,
+        &&handle_CMPGTU,
+        &&handle_CMPGEU,
+        &&handle_FADD,
+        &&handle_FSUB,
+        &&handle_FMUL,
+        &&handle_FDIV,
+        &&handle_FMOD,
+        &&handle_FCMPEQ,
+        &&handle_FCMPNE,
+        &&handle_FCMPLT,
+        &&handle_FCMPLE,
+        &&handle_FCMPGT,
+        &&handle_FCMPGE,
+        &&handle_ROUNDF,
+        &&handle_ITOF,
+        &&handle_UTOF,
+        &&handle_ADDR,
+        &&handle_LOAD,
+        &&handle_LOADF,
+        &&handle_STORE,
+        &&handle_STOREF,
+        &&handle_COPY,
+        &&handle_ZERO,
+        &&handle_CHKLTU,
+        &&handle_CHKLEU,
+        &&handle_JMP,
+        &&handle_JMPZ,
+        &&handle_JMPNZ,
+        &&handle_JEQ,
+        &&handle_JNE,
+        &&handle_JLT,
+        &&handle_JLE,
+        &&handle_JGT,
+        &&handle_JGE,
+        &&handle_JLTU,
+        &&handle_JLEU,
+        &&handle_JGTU,
+        &&handle_JGEU,
+        &&handle_JEQI,
+        &&handle_JNEI,
+        &&handle_JLTI,
+        &&handle_JLEI,
+        &&handle_JGTI,
+        &&handle_JGEI,
+        &&handle_JLTUI,
+        &&handle_JLEUI,
+        &&handle_JGTUI,
+        &&handle_JGEUI,
+        &&handle_CALL,
+        &&handle_CALLX,
+        &&handle_TCALL,
+        &&handle_SPAWN,
+        &&handle_TASK,
+        &&handle_AWAIT,
+        &&handle_YIELD,
+        &&handle_RUN,
+        &&handle_RET,
+        &&handle_RETV,
+        &&handle_ADDI_JLTI,
+        &&handle_ADDI_CALL,
+        &&handle_ADD_RET,
+        &&handle_LOADI_MUL,
+        &&handle_MUL_ADD,
+    };
+    static_assert(std::size(handlers) == num_op_codes);
+
+#define CASE(op_code) \
+    case op_code:     \
+        handle_##op_code:
+#define DISPATCH()           \
+    do                       \
+    {                        \
+        COUNT_DISPATCH();    \
+        goto *handlers[*ip]; \
+    } while (false)
+#else
+// The labels are also needed here because the superinstructions jump to the handler of their second instruction
+#define CASE(op_code) \
+    case op_code:     \
+        handle_##op_code:
+#define DISPATCH() goto dispatch
+#endif
+
+#if FASEL_VM_COMPUTED_GOTO == 0
+dispatch:
+#endif
+    COUNT_DISPATCH();
+
+    switch (static_cast<OpCode>(*ip))
+    {
+        CASE(MOV)
+        {
+            r[load<VmRegister>(ip + 1)] = r[load<VmRegister>(ip + 3)];
+            ip += instruction_size(MOV);
+            DISPATCH();
+        }
+
+        CASE(LOADI)
+        {
+            r[load<VmRegister>(ip + 1)] = load<int64_t>(ip + 3);
+            ip += instruction_size(LOADI);
+            DISPATCH();
+        }
+
+        CASE(LOADS)
+        {
+            r[load<VmRegister>(ip + 1)] = reinterpret_cast<int64_t>(strings + load<int64_t>(ip + 3));
+            ip += instruction_size(LOADS);
+            DISPATCH();
+        }
+
+        CASE(ADDI)
+        {
+            auto a                      = static_cast<uint64_t>(r[load<VmRegister>(ip + 3)]);
+            auto imm                    = static_cast<uint64_t>(load<int64_t>(ip + 5));
+            r[load<VmRegister>(ip + 1)] = static_cast<int64_t>(a + imm);
+            ip += instruction_size(ADDI);
+            DISPATCH();
+        }
+
+#define BINOP_CASE(op_code, type, expression)                                         \
+    CASE(op_code)                                                                     \
+    {                                                                                 \
+        auto a                      = static_cast<type>(r[load<VmRegister>(ip + 3)]); \
+        auto b                      = static_cast<type>(r[load<VmRegister>(ip + 5)]); \
+        r[load<VmRegister>(ip + 1)] = static_cast<int64_t>(expression);               \
+        ip += instruction_size(op_code);                                              \
+        DISPATCH();                                                                   \
+    }
+        BINOP_CASE(ADD, uint64_t, a + b)
+        BINOP_CASE(SUB, uint64_t, a - b)
+        BINOP_CASE(MUL, uint64_t, a * b)
+        BINOP_CASE(DIVS, int64_t, a / b)
+        BINOP_CASE(DIVU, uint64_t, a / b)
+        BINOP_CASE(MODS, int64_t, a % b)
+        BINOP_CASE(MODU, uint64_t, a % b)
+        BINOP_CASE(BITAND, uint64_t, a & b)
+        BINOP_CASE(BITOR, uint64_t, a | b)
+        BINOP_CASE(BITXOR, uint64_t, a ^ b)
+        BINOP_CASE(LSH, uint64_t, a << (b & 63))
+        BINOP_CASE(RSH, uint64_t, a >> (b & 63))
+        BINOP_CASE(CMPEQ, int64_t, a == b)
+        BINOP_CASE(CMPNE, int64_t, a != b)
+        BINOP_CASE(CMPLT, int64_t, a < b)
+        BINOP_CASE(CMPLE, int64_t, a <= b)
+        BINOP_CASE(CMPGT, int64_t, a > b)
+        BINOP_CASE(CMPGE, int64_t, a >= b)
+        BINOP_CASE(CMPLTU, uint64_t, a < b)
+        BINOP_CASE(CMPLEU, uint64_t, a <= b)
+        BINOP_CASE(CMPGTU, uint64_t, a > b)
+        BINOP_CASE(CMPGEU, uint64_t, a >= b)
+#undef BINOP_CASE
+
+#define FLOAT_BINOP_CASE(op_code, expression, to_register)                                \
+    CASE(op_code)                                                                         \
+    {                                                                                     \
+        auto a                      = std::bit_cast<double>(r[load<VmRegister>(ip + 3)]); \
+        auto b                      = std::bit_cast<double>(r[load<VmRegister>(ip + 5)]); \
+        r[load<VmRegister>(ip + 1)] = to_register(expression);                            \
+        ip += instruction_size(op_code);                                                  \
+        DISPATCH();                                                                       \
+    }
+        FLOAT_BINOP_CASE(FADD, a + b, std::bit_cast<int64_t>)
+        FLOAT_BINOP_CASE(FSUB, a - b, std::bit_cast<int64_t>)
+        FLOAT_BINOP_CASE(FMUL, a * b, std::bit_cast<int64_t>)
+        FLOAT_BINOP_CASE(FDIV, a / b, std::bit_cast<int64_t>)
+        FLOAT_BINOP_CASE(FMOD, std::fmod(a, b), std::bit_cast<int64_t>)
+        FLOAT_BINOP_CASE(FCMPEQ, a == b, static_cast<int64_t>)
+        FLOAT_BINOP_CASE(FCMPNE, a < b || a > b, static_cast<int64_t>)
+        FLOAT_BINOP_CASE(FCMPLT, a < b, static_cast<int64_t>)
+        FLOAT_BINOP_CASE(FCMPLE, a <= b, static_cast<int64_t>)
+        FLOAT_BINOP_CASE(FCMPGT, a > b, static_cast<int64_t>)
+        FLOAT_BINOP_CASE(FCMPGE, a >= b, static_cast<int64_t>)
+#undef FLOAT_BINOP_CASE
+
+        CASE(SEXT)
+        CASE(ZEXT)
+        {
+            auto value = static_cast<uint64_t>(r[load<VmRegister>(ip + 3)]);
+            auto bits  = ip[5] * 8;
+            if (bits < 64)
+            {
+                auto mask = (uint64_t{1} << bits) - 1;
+                value &= mask;
+                if (*ip == SEXT && (value >> (bits - 1)) != 0)
+                {
+                    value |= ~mask;
+                }
+            }
+
+            r[load<VmRegister>(ip + 1)] = static_cast<int64_t>(value);
+            ip += instruction_size(SEXT);
+            DISPATCH();
+        }
+
+        CASE(ROUNDF)
+        {
+            auto value                  = static_cast<float>(std::bit_cast<double>(r[load<VmRegister>(ip + 3)]));
+            r[load<VmRegister>(ip + 1)] = std::bit_cast<int64_t>(static_cast<double>(value));
+            ip += instruction_size(ROUNDF);
+            DISPATCH();
+        }
+
+        CASE(ITOF)
+        {
+            auto value                  = static_cast<double>(r[load<VmRegister>(ip + 3)]);
+            r[load<VmRegister>(ip + 1)] = std::bit_cast<int64_t>(value);
+            ip += instruction_size(ITOF);
+            DISPATCH();
+        }
+
+        CASE(UTOF)
+        {
+            auto value                  = static_cast<double>(static_cast<uint64_t>(r[load<VmRegister>(ip + 3)]));
+            r[load<VmRegister>(ip + 1)] = std::bit_cast<int64_t>(value);
+            ip += instruction_size(UTOF);
+            DISPATCH();
+        }
+
+        CASE(ADDR)
+        {
+            r[load<VmRegister>(ip + 1)] = reinterpret_cast<int64_t>(m + load<int64_t>(ip + 3));
+            ip += instruction_size(ADDR);
+            DISPATCH();
+        }
+
+        CASE(LOAD)
+        {
+            auto address = reinterpret_cast<const uint8_t *>(r[load<VmRegister>(ip + 3)]);
+
+            uint64_t value{};
+            switch (ip[5])
+            {
+                case 1:  value = load<uint8_t>(address); break;
+                case 2:  value = load<uint16_t>(address); break;
+                case 4:  value = load<uint32_t>(address); break;
+                default: memcpy(&value, address, ip[5]); break;
+            }
+
+            r[load<VmRegister>(ip + 1)] = static_cast<int64_t>(value);
+            ip += instruction_size(LOAD);
+            DISPATCH();
+        }
+
+        CASE(LOADF)
+        {
+            auto address                = reinterpret_cast<const uint8_t *>(r[load<VmRegister>(ip + 3)]);
+            r[load<VmRegister>(ip + 1)] = std::bit_cast<int64_t>(static_cast<double>(load<float>(address)));
+            ip += instruction_size(LOADF);
+            DISPATCH();
+        }
+
+        CASE(STORE)
+        {
+            // The lower bytes come first (little endian)
+            auto address = reinterpret_cast<uint8_t *>(r[load<VmRegister>(ip + 1)]);
+            auto value   = r[load<VmRegister>(ip + 3)];
+            memcpy(address, &value, ip[5]);
+            ip += instruction_size(STORE);
+            DISPATCH();
+        }
+
+        CASE(STOREF)
+        {
+            auto address = reinterpret_cast<uint8_t *>(r[load<VmRegister>(ip + 1)]);
+            auto value   = static_cast<float>(std::bit_cast<double>(r[load<VmRegister>(ip + 3)]));
+            memcpy(address, &value, sizeof(value));
+            ip += instruction_size(STOREF);
+            DISPATCH();
+        }
+
+        CASE(COPY)
+        {
+            // The source and the destination are the same for assignments like 'a = a'
+            auto destination = reinterpret_cast<uint8_t *>(r[load<VmRegister>(ip + 1)]);
+            auto source      = reinterpret_cast<const uint8_t *>(r[load<VmRegister>(ip + 3)]);
+            memmove(destination, source, static_cast<size_t>(load<int64_t>(ip + 5)));
+            ip += instruction_size(COPY);
+            DISPATCH();
+        }
+
+        CASE(ZERO)
+        {
+            auto address = reinterpret_cast<uint8_t *>(r[load<VmRegister>(ip + 1)]);
+            memset(address, 0, static_cast<size_t>(load<int64_t>(ip + 3)));
+            ip += instruction_size(ZERO);
+            DISPATCH();
+        }
+
+        CASE(CHKLTU)
+        {
+            auto value = static_cast<uint64_t>(r[load<VmRegister>(ip + 1)]);
+            auto bound = static_cast<uint64_t>(r[load<VmRegister>(ip + 3)]);
+            if (value >= bound)
+            {
+                FATAL("Index out of bounds");
+            }
+
+            ip += instruction_size(CHKLTU);
+            DISPATCH();
+        }
+
+        CASE(CHKLEU)
+        {
+            auto value = static_cast<uint64_t>(r[load<VmRegister>(ip + 1)]);
+            auto bound = static_cast<uint64_t>(r[load<VmRegister>(ip + 3)]);
+            if (value > bound)
+            {
+                FATAL("Slice bounds out of range");
+            }
+
+            ip += instruction_size(CHKLEU);
+            DISPATCH();
+        }
+
+        CASE(JMP)
+        {
+            auto next = code + load<int32_t>(ip + 1);
+            COUNT_BACK_EDGE(next);
+            ip = next;
+            DISPATCH();
+        }
+
+        CASE(JMPZ)
+        {
+            auto a    = r[load<VmRegister>(ip + 1)];
+            auto next = a == 0 ? code + load<int32_t>(ip + 3) : ip + instruction_size(JMPZ);
+            COUNT_BACK_EDGE(next);
+            ip = next;
+            DISPATCH();
+        }
+
+        CASE(JMPNZ)
+        {
+            auto a    = r[load<VmRegister>(ip + 1)];
+            auto next = a != 0 ? code + load<int32_t>(ip + 3) : ip + instruction_size(JMPNZ);
+            COUNT_BACK_EDGE(next);
+            ip = next;
+            DISPATCH();
+        }
+
+#define BRANCH_CASE(op_code, type, comparison)                                                    \
+    CASE(op_code)                                                                                 \
+    {                                                                                             \
+        auto a    = static_cast<type>(r[load<VmRegister>(ip + 1)]);                               \
+        auto b    = static_cast<type>(r[load<VmRegister>(ip + 3)]);                               \
+        auto next = (comparison) ? code + load<int32_t>(ip + 5) : ip + instruction_size(op_code); \
+        COUNT_BACK_EDGE(next);                                                                    \
+        ip = next;                                                                                \
+        DISPATCH();                                                                               \
+    }
+        BRANCH_CASE(JEQ, int64_t, a == b)
+        BRANCH_CASE(JNE, int64_t, a != b)
+        BRANCH_CASE(JLT, int64_t, a < b)
+        BRANCH_CASE(JLE, int64_t, a <= b)
+        BRANCH_CASE(JGT, int64_t, a > b)
+        BRANCH_CASE(JGE, int64_t, a >= b)
+        BRANCH_CASE(JLTU, uint64_t, a < b)
+        BRANCH_CASE(JLEU, uint64_t, a <= b)
+        BRANCH_CASE(JGTU, uint64_t, a > b)
+        BRANCH_CASE(JGEU, uint64_t, a >= b)
+#undef BRANCH_CASE
+
+#define BRANCH_IMMEDIATE_CASE(op_code, type, comparison)                                           \
+    CASE(op_code)                                                                                  \
+    {                                                                                              \
+        auto a    = static_cast<type>(r[load<VmRegister>(ip + 1)]);                                \
+        auto b    = static_cast<type>(load<int64_t>(ip + 3));                                      \
+        auto next = (comparison) ? code + load<int32_t>(ip + 11) : ip + instruction_size(op_code); \
+        COUNT_BACK_EDGE(next);                                                                     \
+        ip = next;                                                                                 \
+        DISPATCH();                                                                                \
+    }
+        BRANCH_IMMEDIATE_CASE(JEQI, int64_t, a == b)
+        BRANCH_IMMEDIATE_CASE(JNEI, int64_t, a != b)
+        BRANCH_IMMEDIATE_CASE(JLTI, int64_t, a < b)
+        BRANCH_IMMEDIATE_CASE(JLEI, int64_t, a <= b)
+        BRANCH_IMMEDIATE_CASE(JGTI, int64_t, a > b)
+        BRANCH_IMMEDIATE_CASE(JGEI, int64_t, a >= b)
+        BRANCH_IMMEDIATE_CASE(JLTUI, uint64_t, a < b)
+        BRANCH_IMMEDIATE_CASE(JLEUI, uint64_t, a <= b)
+        BRANCH_IMMEDIATE_CASE(JGTUI, uint64_t, a > b)
+        BRANCH_IMMEDIATE_CASE(JGEUI, uint64_t, a >= b)
+#undef BRANCH_IMMEDIATE_CASE
+
+        CASE(CALL)
+        CASE(TCALL)
+        {
+            auto callee_index     = static_cast<int64_t>(load<uint32_t>(ip + 1));
+            const auto &callee    = vm->program->procedures[callee_index];
+            auto callee_registers = r + load<VmRegister>(ip + 5);
+
+            if constexpr (mixed_mode)
+            {
+                count_hotness(vm, callee_index);
+
+                // Native code cannot take over the frame, so a tail call to it is made like CALL, followed by the
+                // return of the procedure
+                auto native_entry = vm->tiers[callee_index].native_entry.load(std::memory_order_acquire);
+                if (native_entry != nullptr)
+                {
+                    // The native code may call back into the interpreter, which continues after the arguments and
+                    // after the frame memory
+                    auto entry_registers = vm->entry_registers;
+                    auto entry_memory    = vm->entry_memory;
+                    vm->entry_registers  = callee_registers;
+                    vm->entry_memory     = memory_end;
+
+                    auto result         = native_entry(callee_registers);
+                    vm->entry_registers = entry_registers;
+                    vm->entry_memory    = entry_memory;
+
+                    r[load<VmRegister>(ip + 7)] = result;
+                    ip += instruction_size(CALL);
+                    DISPATCH();
+                }
+            }
+
+            // The arguments move to the registers of the arguments of the procedure, whose frame memory the callee
+            // starts over with
+            if (*ip == TCALL)
+            {
+                if (r + callee.num_registers > registers_end)
+                {
+                    FATAL("Stack overflow");
+                }
+
+                std::memmove(r, callee_registers, static_cast<size_t>(callee.num_arguments) * sizeof(*r));
+
+                procedure  = callee_index;
+                m          = frame_memory(vm, m, callee);
+                memory_end = m + callee.frame_size;
+                ip         = code + callee.address;
+                DISPATCH();
+            }
+
+            if (callee_registers + callee.num_registers > registers_end || vm->frames.size() == Vm::max_call_depth)
+            {
+                FATAL("Stack overflow");
+            }
+
+            vm->frames.push_back(Vm::Frame{
+                .return_address = ip + instruction_size(CALL),
+                .registers      = r,
+                .procedure      = procedure,
+                .result         = load<VmRegister>(ip + 7),
+                .memory         = m,
+                .memory_end     = memory_end,
+            });
+
+            procedure  = callee_index;
+            r          = callee_registers;
+            m          = frame_memory(vm, memory_end, callee);
+            memory_end = m + callee.frame_size;
+            ip         = code + callee.address;
+            DISPATCH();
+        }
+
+        CASE(CALLX)
+        {
+            const auto &call = vm->program->external_calls[load<uint32_t>(ip + 1)];
+
+            auto result = call_external(call, r + load<VmRegister>(ip + 5));
+            if (call.return_kind != VmValueKind::none)
+            {
+                r[load<VmRegister>(ip + 7)] = result;
+            }
+
+            ip += instruction_size(CALLX);
+            DISPATCH();
+        }
+
+        CASE(SPAWN)
+        {
+            auto entry       = static_cast<int64_t>(load<uint32_t>(ip + 1));
+            auto environment = r + load<VmRegister>(ip + 5);
+            auto thread_vm   = std::shared_ptr<Vm>{create_thread_vm(vm)};
+
+            auto thread = spawn_thread(
+                reinterpret_cast<const void *>(environment[0]),
+                environment[1],
+                environment[2],
+                [thread_vm, entry](void *copy)
+                {
+                    auto argument = reinterpret_cast<int64_t>(copy);
+                    call_procedure(thread_vm.get(), entry, std::span{&argument, 1});
+                });
+
+            r[load<VmRegister>(ip + 7)] = static_cast<int64_t>(thread);
+
+            ip += instruction_size(SPAWN);
+            DISPATCH();
+        }
+
+        CASE(TASK)
+        {
+            auto arguments = r + load<VmRegister>(ip + 5);
+
+            // The task runs after the arguments and after the frame memory, like a procedure that is called
+            auto entry_registers = vm->entry_registers;
+            auto entry_memory    = vm->entry_memory;
+            vm->entry_registers  = arguments;
+            vm->entry_memory     = memory_end;
+
+            auto task           = create_task(vm, load<uint32_t>(ip + 1), arguments);
+            vm->entry_registers = entry_registers;
+            vm->entry_memory    = entry_memory;
+
+            r[load<VmRegister>(ip + 7)] = reinterpret_cast<int64_t>(task);
+            ip += instruction_size(TASK);
+            DISPATCH();
+        }
+
+        // Only async procedures suspend, which the executor runs as the first frame of execute, so returning suspends
+        // the task (see resume_task)
+        CASE(AWAIT)
+        {
+            auto task = reinterpret_cast<VmTask *>(r[load<VmRegister>(ip + 3)]);
+            if (task->is_done)
+            {
+                r[load<VmRegister>(ip + 1)] = task->result;
+                ip += instruction_size(AWAIT);
+                DISPATCH();
+            }
+
+            // The task continues with this instruction when the awaited task is done
+            if (task->waiter != nullptr && task->waiter != running_task)
+            {
+                fasel_task_fail(TaskError::awaited_twice);
+            }
+
+            task->waiter     = running_task;
+            running_task->ip = ip;
+            return 0;
+        }
+
+        CASE(YIELD)
+        {
+            fasel_task_schedule(resume_task, running_task);
+            running_task->ip = ip + instruction_size(YIELD);
+            return 0;
+        }
+
+        CASE(RUN)
+        {
+            // The tasks run after the frame
+            auto entry_registers = vm->entry_registers;
+            auto entry_memory    = vm->entry_memory;
+            vm->entry_registers  = r + vm->program->procedures[procedure].num_registers;
+            vm->entry_memory     = memory_end;
+
+            fasel_executor_run();
+            vm->entry_registers = entry_registers;
+            vm->entry_memory    = entry_memory;
+
+            auto task = reinterpret_cast<VmTask *>(r[load<VmRegister>(ip + 3)]);
+            if (task->is_done == false)
+            {
+                fasel_task_fail(TaskError::not_done);
+            }
+
+            r[load<VmRegister>(ip + 1)] = task->result;
+            ip += instruction_size(RUN);
+            DISPATCH();
+        }
+
+        CASE(RET)
+        CASE(RETV)
+        {
+            auto has_value    = *ip == RET;
+            auto return_value = has_value ? r[load<VmRegister>(ip + 1)] : 0;
+
+            if (vm->frames.size() == entry_depth)
+            {
+                return return_value;
+            }
+
+            auto frame = vm->frames.back();
+            vm->frames.pop_back();
+
+            r          = frame.registers;
+            m          = frame.memory;
+            memory_end = frame.memory_end;
+            ip         = frame.return_address;
+            procedure  = frame.procedure;
+
+            if (has_value)
+            {
+                r[frame.result] = return_value;
+            }
+
+            DISPATCH();
+        }
+
+        // The first instruction is executed here, the second one by jumping directly to its handler, which skips
+        // the dispatch in between. Every first instruction writes its result to the register operand d.
+#define OPERAND(offset) static_cast<uint64_t>(r[load<VmRegister>(ip + (offset))])
+#define SUPERINSTRUCTION_CASE(op_code, first, second, expression)       \
+    CASE(op_code)                                                       \
+    {                                                                   \
+        r[load<VmRegister>(ip + 1)] = static_cast<int64_t>(expression); \
+        ip += instruction_size(first);                                  \
+        goto handle_##second;                                           \
+    }
+        SUPERINSTRUCTION_CASE(ADDI_JLTI, ADDI, JLTI, OPERAND(3) + static_cast<uint64_t>(load<int64_t>(ip + 5)))
+        SUPERINSTRUCTION_CASE(ADDI_CALL, ADDI, CALL, OPERAND(3) + static_cast<uint64_t>(load<int64_t>(ip + 5)))
+        SUPERINSTRUCTION_CASE(ADD_RET, ADD, RET, OPERAND(3) + OPERAND(5))
+        SUPERINSTRUCTION_CASE(LOADI_MUL, LOADI, MUL, load<int64_t>(ip + 3))
+        SUPERINSTRUCTION_CASE(MUL_ADD, MUL, ADD, OPERAND(3) * OPERAND(5))
+#undef SUPERINSTRUCTION_CASE
+#undef OPERAND
+
+        default: UNREACHED;
+    }
+
+    UNREACHED;
+
+#undef DISPATCH
+#undef CASE
+#undef COUNT_BACK_EDGE
+#undef COUNT_DISPATCH
+}
+
+// Runs the procedure with the instantiation of execute for the mode of the interpreter
+static int64_t interpret(Vm *vm, int64_t procedure, const uint8_t *ip, int64_t *r, uint8_t *m, uint8_t *memory_end)
+{
+    if (vm->profile_op_pairs)
+    {
+        vm->op_pair_counts.resize(num_op_codes * num_op_codes);
+        return execute<true, false>(vm, procedure, ip, r, m, memory_end);
+    }
+
+    if (vm->hot_threshold != 0)
+    {
+        return execute<false, true>(vm, procedure, ip, r, m, memory_end);
+    }
+
+    return execute<false, false>(vm, procedure, ip, r, m, memory_end);
+}
+
+// The executor resumes the tasks of the interpreter through this (see TaskResume). The registers of the task are
+// placed where the frame of the next call_procedure would start, which RUN and TASK move after their frame.
+static void resume_task(void *pointer)
+{
+    auto task             = static_cast<VmTask *>(pointer);
+    auto vm               = task->vm;
+    const auto &procedure = vm->program->procedures[task->procedure];
+
+    auto registers = vm->entry_registers;
+    if (registers + procedure.num_registers > vm->registers.data() + vm->registers.size())
+    {
+        FATAL("Stack overflow");
+    }
+
+    std::copy_n(task->registers, procedure.num_registers, registers);
+
+    SET_TEMPORARILY(running_task, task);
+
+    auto ip     = std::exchange(task->ip, nullptr);
+    auto result = interpret(vm, task->procedure, ip, registers, task->memory, vm->entry_memory);
+    if (task->ip != nullptr)
+    {
+        // Suspended
+        std::copy_n(registers, procedure.num_registers, task->registers);
+        return;
+    }
+
+    task->result  = result;
+    task->is_done = true;
+    if (task->waiter != nullptr)
+    {
+        fasel_task_schedule(resume_task, task->waiter);
+    }
+}
+
+int64_t call_procedure(Vm *vm, int64_t procedure_index, std::span<const int64_t> arguments, std::span<int64_t> results)
+{
+    const auto &procedure = vm->program->procedures.at(procedure_index);
+    if (arguments.size() != procedure.num_arguments)
+    {
+        FATAL(std::format("Procedure {} expects {} arguments", procedure.name, procedure.num_arguments));
+    }
+
+    auto registers = vm->entry_registers;
+    if (registers + procedure.num_registers > vm->registers.data() + vm->registers.size())
+    {
+        FATAL("Stack overflow");
+    }
+
+    if (results.size() > procedure.num_results)
+    {
+        FATAL(std::format("Procedure {} returns {} values", procedure.name, procedure.num_results));
+    }
+
+    auto memory = frame_memory(vm, vm->entry_memory, procedure);
+
+    SET_TEMPORARILY(running_vm, vm);
+
+    std::copy(arguments.begin(), arguments.end(), registers);
+    defer
+    {
+        std::copy_n(registers, results.size(), results.begin());
+    };
+
+    if (vm->hot_threshold != 0 && vm->profile_op_pairs == false)
+    {
+        count_hotness(vm, procedure_index);
+
+        // Native code that was compiled before this procedure calls it through here, but it may be compiled by now
+        auto native_entry = vm->tiers[procedure_index].native_entry.load(std::memory_order_acquire);
+        if (native_entry != nullptr)
+        {
+            return native_entry(registers);
+        }
+    }
+
+    auto ip = vm->program->code().data() + procedure.address;
+    return interpret(vm, procedure_index, ip, registers, memory, memory + procedure.frame_size);
+}
+
+void run_main(Vm *vm, const VmProgram *program)
+{
+    if (program->main_procedure == -1)
+    {
+        FATAL("The program does not have a main procedure");
+    }
+
+    load_program(vm, program);
+    call_procedure(vm, program->main_procedure);
+}
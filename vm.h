@@ -0,0 +1,84 @@
+#pragma once
+
+#include "compile_vm.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+// A register based bytecode interpreter - the tier that runs programs without compiling them to machine code first
+struct Vm
+{
+    constexpr static size_t num_registers       = 256 * 1024;
+    constexpr static size_t max_call_depth      = 16 * 1024;
+    constexpr static size_t memory_size         = 64 * 1024 * 1024;
+    constexpr static size_t max_frame_alignment = 4096;
+
+    struct Frame
+    {
+        const uint8_t *return_address{};
+        int64_t *registers{};   // The registers of the caller
+        int64_t procedure{};    // The index of the caller
+        VmRegister result{};    // The register of the caller that receives the return value
+        uint8_t *memory{};      // The frame memory of the caller
+        uint8_t *memory_end{};  // Where the frame memory of the procedures that the caller calls starts
+    };
+
+    // Takes the arguments in the representation of the registers and returns the return value (0 if there is none).
+    // A vector result is written to the registers in front of the arguments instead (see VmProcedure::num_results).
+    using NativeEntry = int64_t (*)(int64_t *arguments);
+
+    struct ProcedureTier
+    {
+        std::atomic<NativeEntry> native_entry{};  // Set once the procedure was compiled to machine code
+        std::atomic<uint64_t> hotness{};          // Calls and backward jumps of the interpreters of all threads
+    };
+
+    const VmProgram *program{};
+    std::vector<int64_t> registers{};  // The frames of all procedures on the call stack, each starting at its arguments
+    std::vector<Frame> frames{};
+    int64_t *entry_registers{};  // Where the frame of the next call_procedure starts
+    std::unique_ptr<uint8_t[]> memory{};  // The frame memory of all procedures on the call stack (see ADDR)
+    uint8_t *entry_memory{};              // Where the frame memory of the next call_procedure starts
+    uint64_t num_dispatches{};         // The number of executed instructions, a superinstruction counts once
+
+    // Counts how often each op code directly follows another one, indexed with first * num_op_codes + second.
+    // This is what the superinstructions are picked from (see fuse_superinstructions).
+    bool profile_op_pairs{};
+    std::vector<uint64_t> op_pair_counts{};
+
+    // Mixed mode (see MixedProgram), enabled by a hot_threshold other than 0: procedures that have a native entry are
+    // called through it instead of being interpreted, and on_hot_procedure is called once the hotness of a procedure
+    // reaches the threshold. It may be called while the interpreter is running and must not block. The interpreters
+    // of spawned threads share the tiers (see create_thread_vm), so it may be called from any of them, and more than
+    // once for a procedure.
+    uint64_t hot_threshold{};
+    std::function<void(int64_t procedure_index)> on_hot_procedure{};
+    std::shared_ptr<ProcedureTier[]> tiers{};  // One per procedure
+};
+
+// Checks that the bytecode only references valid registers, procedures, external calls and jump targets,
+// so the interpreter can run it without checking every operand
+void verify_program(const VmProgram *program);
+
+void load_program(Vm *vm, const VmProgram *program);
+// Calls the procedure with the arguments and runs it until it returns, returning the return value or 0 if there is none.
+// The lanes of a vector result are copied to results, the arguments start with room for them.
+// Native code that the interpreter called can call back into it with this.
+int64_t call_procedure(
+    Vm *vm,
+    int64_t procedure_index,
+    std::span<const int64_t> arguments = {},
+    std::span<int64_t> results         = {});
+
+void run_main(Vm *vm, const VmProgram *program);
+
+// Creates an interpreter for another thread that runs the program of the given one, with the same tiers in mixed mode.
+// The program has to outlive it.
+std::unique_ptr<Vm> create_thread_vm(const Vm *vm);
+
+// The interpreter that is running on the calling thread (in call_procedure), nullptr if there is none
+Vm *current_vm();
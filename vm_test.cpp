@@ -0,0 +1,667 @@
+#include "bytecode_image.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <bit>
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <tuple>
+
+static VmProgram make_program(BytecodeWriter &w, int64_t num_arguments, int64_t num_registers)
+{
+    VmProgram program{};
+    program.bytecode = w.bytecode;
+    program.procedures.push_back(VmProcedure{
+        .name          = "test",
+        .address       = 0,
+        .num_arguments = num_arguments,
+        .num_registers = num_registers,
+    });
+
+    return program;
+}
+
+static int64_t run(const VmProgram &program, std::vector<int64_t> arguments = {})
+{
+    Vm vm;
+    load_program(&vm, &program);
+    auto result = call_procedure(&vm, 0, arguments);
+
+    REQUIRE(vm.frames.empty());
+
+    return result;
+}
+
+TEST_CASE("LOADI, MOV", "[vm]")
+{
+    for (auto value : {
+             int64_t{0},
+             int64_t{123},
+             int64_t{-1337},
+             std::numeric_limits<int64_t>::min(),
+             std::numeric_limits<int64_t>::max(),
+         })
+    {
+        BytecodeWriter w;
+        w.write_d_imm(LOADI, 0, value);
+        w.write_d_a(MOV, 1, 0);
+        w.write_a(RET, 1);
+
+        REQUIRE(run(make_program(w, 0, 2)) == value);
+    }
+}
+
+struct Operator
+{
+    OpCode op;
+    int64_t (*calculate)(int64_t, int64_t);
+};
+
+constexpr static auto all_operators = {
+    Operator{.op = ADD, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(uint64_t(a) + uint64_t(b)); }},
+    Operator{.op = SUB, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(uint64_t(a) - uint64_t(b)); }},
+    Operator{.op = MUL, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(uint64_t(a) * uint64_t(b)); }},
+    Operator{.op = DIVS, .calculate = [](int64_t a, int64_t b) { return a / b; }},
+    Operator{.op = MODS, .calculate = [](int64_t a, int64_t b) { return a % b; }},
+    Operator{.op = DIVU, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(uint64_t(a) / uint64_t(b)); }},
+    Operator{.op = MODU, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(uint64_t(a) % uint64_t(b)); }},
+    Operator{.op = BITAND, .calculate = [](int64_t a, int64_t b) { return a & b; }},
+    Operator{.op = BITOR, .calculate = [](int64_t a, int64_t b) { return a | b; }},
+    Operator{.op = BITXOR, .calculate = [](int64_t a, int64_t b) { return a ^ b; }},
+    Operator{.op = CMPEQ, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(a == b); }},
+    Operator{.op = CMPNE, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(a != b); }},
+    Operator{.op = CMPGE, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(a >= b); }},
+    Operator{.op = CMPGT, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(a > b); }},
+    Operator{.op = CMPLE, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(a <= b); }},
+    Operator{.op = CMPLT, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(a < b); }},
+    Operator{.op = CMPLTU, .calculate = [](int64_t a, int64_t b) { return static_cast<int64_t>(uint64_t(a) < uint64_t(b)); }},
+};
+
+static const auto test_values = std::vector<int64_t>{
+    std::numeric_limits<int64_t>::min(),
+    std::numeric_limits<int64_t>::min() + 1,
+    -87923401,
+    -8192,
+    -10,
+    -1,
+    0,
+    1,
+    7,
+    13,
+    16,
+    32,
+    33,
+    63,
+    64,
+    65,
+    256,
+    1000,
+    708927389047,
+    std::numeric_limits<int64_t>::max() - 1,
+    std::numeric_limits<int64_t>::max(),
+};
+
+TEST_CASE("Integer math", "[vm]")
+{
+    for (auto op : all_operators)
+    {
+        SECTION(std::format("Operator {}", to_string(op.op)))
+        {
+            BytecodeWriter w;
+            w.write_d_a_b(op.op, 2, 0, 1);
+            w.write_a(RET, 2);
+
+            auto program = make_program(w, 2, 3);
+
+            for (auto a : test_values)
+            {
+                for (auto b : test_values)
+                {
+                    auto is_division = op.op == DIVS || op.op == MODS || op.op == DIVU || op.op == MODU;
+                    if (is_division && (a == std::numeric_limits<int64_t>::min() && b == -1 || b == 0))
+                    {
+                        continue;
+                    }
+
+                    REQUIRE(run(program, {a, b}) == op.calculate(a, b));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ADDI", "[vm]")
+{
+    for (auto a : test_values)
+    {
+        for (auto b : test_values)
+        {
+            BytecodeWriter w;
+            w.write_d_a_imm(ADDI, 0, 0, b);
+            w.write_a(RET, 0);
+
+            REQUIRE(run(make_program(w, 1, 1), {a}) == static_cast<int64_t>(uint64_t(a) + uint64_t(b)));
+        }
+    }
+}
+
+struct FloatOperator
+{
+    OpCode op;
+    int64_t (*calculate)(double, double);
+};
+
+static int64_t to_register(double value)
+{
+    return std::bit_cast<int64_t>(value);
+}
+
+constexpr static auto all_float_operators = {
+    FloatOperator{.op = FADD, .calculate = [](double a, double b) { return to_register(a + b); }},
+    FloatOperator{.op = FSUB, .calculate = [](double a, double b) { return to_register(a - b); }},
+    FloatOperator{.op = FMUL, .calculate = [](double a, double b) { return to_register(a * b); }},
+    FloatOperator{.op = FDIV, .calculate = [](double a, double b) { return to_register(a / b); }},
+    FloatOperator{.op = FMOD, .calculate = [](double a, double b) { return to_register(std::fmod(a, b)); }},
+    FloatOperator{.op = FCMPEQ, .calculate = [](double a, double b) { return static_cast<int64_t>(a == b); }},
+    FloatOperator{.op = FCMPNE, .calculate = [](double a, double b) { return static_cast<int64_t>(a < b || a > b); }},
+    FloatOperator{.op = FCMPLT, .calculate = [](double a, double b) { return static_cast<int64_t>(a < b); }},
+    FloatOperator{.op = FCMPLE, .calculate = [](double a, double b) { return static_cast<int64_t>(a <= b); }},
+    FloatOperator{.op = FCMPGT, .calculate = [](double a, double b) { return static_cast<int64_t>(a > b); }},
+    FloatOperator{.op = FCMPGE, .calculate = [](double a, double b) { return static_cast<int64_t>(a >= b); }},
+};
+
+static const auto float_test_values = std::vector<double>{
+    -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::lowest(),
+    -1e300,
+    -2.5,
+    -1.0,
+    -0.0,
+    0.0,
+    std::numeric_limits<double>::denorm_min(),
+    0.1,
+    1.0,
+    3.0,
+    1e300,
+    std::numeric_limits<double>::max(),
+    std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN(),
+};
+
+TEST_CASE("Floating point math", "[vm]")
+{
+    for (auto op : all_float_operators)
+    {
+        SECTION(std::format("Operator {}", to_string(op.op)))
+        {
+            BytecodeWriter w;
+            w.write_d_a_b(op.op, 2, 0, 1);
+            w.write_a(RET, 2);
+
+            auto program = make_program(w, 2, 3);
+
+            for (auto a : float_test_values)
+            {
+                for (auto b : float_test_values)
+                {
+                    auto result   = run(program, {to_register(a), to_register(b)});
+                    auto expected = op.calculate(a, b);
+
+                    // NaN results can differ in their payload (the comparisons give 0 or 1, which are no NaNs)
+                    if (std::isnan(std::bit_cast<double>(expected)))
+                    {
+                        REQUIRE(std::isnan(std::bit_cast<double>(result)));
+                    }
+                    else
+                    {
+                        REQUIRE(result == expected);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ROUNDF, ITOF, UTOF", "[vm]")
+{
+    auto convert = [](OpCode op, int64_t value)
+    {
+        BytecodeWriter w;
+        w.write_d_a(op, 1, 0);
+        w.write_a(RET, 1);
+
+        return std::bit_cast<double>(run(make_program(w, 1, 2), {value}));
+    };
+
+    REQUIRE(convert(ROUNDF, to_register(0.1)) == static_cast<double>(0.1f));
+    REQUIRE(convert(ROUNDF, to_register(-2.5)) == -2.5);
+    REQUIRE(convert(ROUNDF, to_register(1e300)) == std::numeric_limits<double>::infinity());
+    REQUIRE(convert(ROUNDF, to_register(16777217.0)) == 16777216.0);
+
+    REQUIRE(convert(ITOF, 0) == 0.0);
+    REQUIRE(convert(ITOF, -7) == -7.0);
+    REQUIRE(convert(ITOF, std::numeric_limits<int64_t>::min()) == -9223372036854775808.0);
+
+    REQUIRE(convert(UTOF, 7) == 7.0);
+    REQUIRE(convert(UTOF, -1) == 18446744073709551616.0);
+}
+
+TEST_CASE("LOADF, STOREF", "[vm]")
+{
+    // a: [2]f32; a[0] = x; a[1] = a[0]; return a[1] + x, the f32 stores round x
+    BytecodeWriter w;
+    w.write_d_imm(ADDR, 1, 0);
+    w.write_d_a(STOREF, 1, 0);
+    w.write_d_a(LOADF, 2, 1);
+    w.write_d_a_imm(ADDI, 3, 1, 4);
+    w.write_d_a(STOREF, 3, 2);
+    w.write_d_a(LOADF, 4, 3);
+    w.write_d_a_b(FADD, 4, 4, 0);
+    w.write_a(RET, 4);
+
+    auto program                          = make_program(w, 1, 5);
+    program.procedures[0].frame_size      = 8;
+    program.procedures[0].frame_alignment = 4;
+
+    for (auto x : {0.0, -1.5, 0.1, 1e300})
+    {
+        auto expected = static_cast<double>(static_cast<float>(x)) + x;
+        REQUIRE(std::bit_cast<double>(run(program, {to_register(x)})) == expected);
+    }
+}
+
+TEST_CASE("SEXT, ZEXT", "[vm]")
+{
+    for (auto [op, bytes, value, expected] : {
+             std::tuple{SEXT, 1, int64_t{0xff}, int64_t{-1}},
+             std::tuple{SEXT, 1, int64_t{0x17f}, int64_t{0x7f}},
+             std::tuple{SEXT, 4, int64_t{0x80000000}, int64_t{-2147483648}},
+             std::tuple{ZEXT, 1, int64_t{-1}, int64_t{0xff}},
+             std::tuple{ZEXT, 2, int64_t{0x12345}, int64_t{0x2345}},
+             std::tuple{ZEXT, 8, int64_t{-1}, int64_t{-1}},
+         })
+    {
+        BytecodeWriter w;
+        w.write_d_a_bytes(op, 1, 0, bytes);
+        w.write_a(RET, 1);
+
+        REQUIRE(run(make_program(w, 1, 2), {value}) == expected);
+    }
+}
+
+TEST_CASE("Compare and branch", "[vm]")
+{
+    struct Branch
+    {
+        OpCode op;
+        OpCode immediate_op;
+        bool (*holds)(int64_t, int64_t);
+    };
+
+    auto all_branches = {
+        Branch{JEQ, JEQI, [](int64_t a, int64_t b) { return a == b; }},
+        Branch{JNE, JNEI, [](int64_t a, int64_t b) { return a != b; }},
+        Branch{JLT, JLTI, [](int64_t a, int64_t b) { return a < b; }},
+        Branch{JLE, JLEI, [](int64_t a, int64_t b) { return a <= b; }},
+        Branch{JGT, JGTI, [](int64_t a, int64_t b) { return a > b; }},
+        Branch{JGE, JGEI, [](int64_t a, int64_t b) { return a >= b; }},
+        Branch{JLTU, JLTUI, [](int64_t a, int64_t b) { return uint64_t(a) < uint64_t(b); }},
+        Branch{JLEU, JLEUI, [](int64_t a, int64_t b) { return uint64_t(a) <= uint64_t(b); }},
+        Branch{JGTU, JGTUI, [](int64_t a, int64_t b) { return uint64_t(a) > uint64_t(b); }},
+        Branch{JGEU, JGEUI, [](int64_t a, int64_t b) { return uint64_t(a) >= uint64_t(b); }},
+    };
+
+    auto values = {int64_t{-2}, int64_t{0}, int64_t{1}, std::numeric_limits<int64_t>::max()};
+
+    for (auto branch : all_branches)
+    {
+        for (auto a : values)
+        {
+            for (auto b : values)
+            {
+                auto expected = branch.holds(a, b) ? 222 : 111;
+
+                // Register operands
+                {
+                    BytecodeWriter w;
+                    auto jump = w.write_a_b_target(branch.op, 0, 1, -1);
+                    w.write_d_imm(LOADI, 2, 111);
+                    w.write_a(RET, 2);
+                    w.patch_target(jump, static_cast<int32_t>(w.pos));
+                    w.write_d_imm(LOADI, 2, 222);
+                    w.write_a(RET, 2);
+
+                    REQUIRE(run(make_program(w, 2, 3), {a, b}) == expected);
+                }
+
+                // Immediate operand
+                {
+                    BytecodeWriter w;
+                    auto jump = w.write_a_imm_target(branch.immediate_op, 0, b, -1);
+                    w.write_d_imm(LOADI, 1, 111);
+                    w.write_a(RET, 1);
+                    w.patch_target(jump, static_cast<int32_t>(w.pos));
+                    w.write_d_imm(LOADI, 1, 222);
+                    w.write_a(RET, 1);
+
+                    REQUIRE(run(make_program(w, 1, 2), {a}) == expected);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("JMP, JMPZ, JMPNZ", "[vm]")
+{
+    for (auto op : {JMPZ, JMPNZ})
+    {
+        for (auto condition : {-1, 0, 1, 2})
+        {
+            BytecodeWriter w;
+
+            auto jmpx = w.write_a_target(op, 0, -1);
+            w.write_d_imm(LOADI, 1, 111);
+            auto jmp_end = w.write_target(JMP, -1);
+            w.patch_target(jmpx, static_cast<int32_t>(w.pos));
+            w.write_d_imm(LOADI, 1, 222);
+            w.patch_target(jmp_end, static_cast<int32_t>(w.pos));
+            w.write_a(RET, 1);
+
+            int64_t expected;
+            if (op == JMPZ)
+            {
+                expected = condition == 0 ? 222 : 111;
+            }
+            else
+            {
+                expected = condition != 0 ? 222 : 111;
+            }
+
+            REQUIRE(run(make_program(w, 1, 2), {condition}) == expected);
+        }
+    }
+}
+
+TEST_CASE("ADDR, LOAD, STORE, COPY, ZERO", "[vm]")
+{
+    // a: [2]i32; a[0] = -5; a[1] = a[0]; return zero extended a[1] + a[0] as i16
+    BytecodeWriter w;
+    w.write_d_imm(ADDR, 1, 0);
+    w.write_d_imm(ZERO, 1, 8);
+    w.write_d_imm(LOADI, 2, -5);
+    w.write_d_a_bytes(STORE, 1, 2, 4);
+    w.write_d_a_imm(ADDI, 3, 1, 4);
+    w.write_d_a_imm(COPY, 3, 1, 4);
+    w.write_d_a_bytes(LOAD, 0, 3, 4);
+    w.write_d_a_bytes(LOAD, 4, 1, 2);
+    w.write_d_a_b(ADD, 0, 0, 4);
+    w.write_a(RET, 0);
+
+    auto program                          = make_program(w, 0, 5);
+    program.procedures[0].frame_size      = 8;
+    program.procedures[0].frame_alignment = 4;
+
+    REQUIRE(run(program) == 0xfffffffb + 0xfffb);
+}
+
+TEST_CASE("CHKLTU, CHKLEU", "[vm]")
+{
+    // return index + length if index < length && index <= length (both unsigned), aborts otherwise
+    BytecodeWriter w;
+    w.write_d_a(CHKLTU, 0, 1);
+    w.write_d_a(CHKLEU, 0, 1);
+    w.write_d_a_b(ADD, 2, 0, 1);
+    w.write_a(RET, 2);
+
+    auto program = make_program(w, 2, 3);
+
+    REQUIRE(run(program, {0, 1}) == 1);
+    REQUIRE(run(program, {9, 10}) == 19);
+    REQUIRE(run(program, {0, std::numeric_limits<int64_t>::min()}) == std::numeric_limits<int64_t>::min());
+
+    // A negative index is a large unsigned one, only an equal bound passes CHKLEU
+    BytecodeWriter w_le;
+    w_le.write_d_a(CHKLEU, 0, 1);
+    w_le.write_d_a(CHKLEU, 1, 0);
+    w_le.write_a(RET, 0);
+
+    REQUIRE(run(make_program(w_le, 2, 2), {-1, -1}) == -1);
+    REQUIRE(run(make_program(w_le, 2, 2), {3, 3}) == 3);
+}
+
+TEST_CASE("CALL", "[vm]")
+{
+    BytecodeWriter w;
+
+    // main := proc() i64 return square(3) + 1
+    w.write_d_imm(LOADI, 1, 3);
+    w.write_index_a_d(CALL, 1, 1, 0);
+    w.write_d_a_imm(ADDI, 0, 0, 1);
+    w.write_a(RET, 0);
+
+    // square := proc(x: i64) i64 return x * x
+    auto square = w.pos;
+    w.write_d_a_b(MUL, 1, 0, 0);
+    w.write_a(RET, 1);
+
+    auto program = make_program(w, 0, 2);
+    program.procedures.push_back(VmProcedure{
+        .name          = "square",
+        .address       = static_cast<int64_t>(square),
+        .num_arguments = 1,
+        .num_registers = 2,
+    });
+
+    REQUIRE(run(program) == 10);
+}
+
+TEST_CASE("TCALL", "[vm]")
+{
+    BytecodeWriter w;
+
+    // main := proc() i64 return sum_to(100000, 0)
+    w.write_d_imm(LOADI, 1, 100000);
+    w.write_d_imm(LOADI, 2, 0);
+    w.write_index_a_d(CALL, 1, 1, 0);
+    w.write_a(RET, 0);
+
+    // sum_to := proc(n: i64, total: i64) i64 { if n == 0 return total; return tail sum_to(n - 1, total + n) }
+    // The calls go deeper than the frames of the interpreter do
+    auto sum_to   = w.pos;
+    auto jne_zero = w.write_a_imm_target(JNEI, 0, 0, -1);
+    w.write_a(RET, 1);
+    w.patch_target(jne_zero, static_cast<int32_t>(w.pos));
+    w.write_d_a_imm(ADDI, 2, 0, -1);
+    w.write_d_a_b(ADD, 3, 1, 0);
+    w.write_index_a_d(TCALL, 1, 2, 4);
+    w.write_a(RET, 4);
+
+    auto program = make_program(w, 0, 3);
+    program.procedures.push_back(VmProcedure{
+        .name          = "sum_to",
+        .address       = static_cast<int64_t>(sum_to),
+        .num_arguments = 2,
+        .num_registers = 5,
+    });
+
+    REQUIRE(run(program) == 5000050000);
+}
+
+static int64_t last_external_argument = 0;
+
+static int64_t external_integers(int64_t a, int64_t b, int64_t c, int64_t d, int64_t e, int64_t f)
+{
+    return a - b + c * d - e * f;
+}
+
+static double external_mixed(int64_t a, double b, float c, int64_t d)
+{
+    return static_cast<double>(a) * b + static_cast<double>(c) - static_cast<double>(d);
+}
+
+static float external_f32(float a, double b)
+{
+    return a * static_cast<float>(b);
+}
+
+static void external_void(int64_t a)
+{
+    last_external_argument = a;
+}
+
+TEST_CASE("CALLX", "[vm]")
+{
+    auto external_call = [](void *address, std::vector<VmValueKind> argument_kinds, VmValueKind return_kind)
+    {
+        return VmExternalCall{
+            .name           = "external",
+            .address        = address,
+            .argument_kinds = std::move(argument_kinds),
+            .return_kind    = return_kind,
+        };
+    };
+
+    SECTION("Integer arguments")
+    {
+        BytecodeWriter w;
+        w.write_index_a_d(CALLX, 0, 0, 6);
+        w.write_a(RET, 6);
+
+        auto program = make_program(w, 6, 7);
+        program.external_calls.push_back(external_call(reinterpret_cast<void *>(&external_integers),
+                                                       std::vector<VmValueKind>(6, VmValueKind::integer),
+                                                       VmValueKind::integer));
+
+        REQUIRE(run(program, {100, 1, 2, 3, 4, 5}) == 100 - 1 + 2 * 3 - 4 * 5);
+    }
+
+    SECTION("Mixed integer and floating point arguments")
+    {
+        // The integers and the floating point values are passed in registers of their own, in order
+        BytecodeWriter w;
+        w.write_index_a_d(CALLX, 0, 0, 4);
+        w.write_a(RET, 4);
+
+        auto program = make_program(w, 4, 5);
+        program.external_calls.push_back(external_call(
+            reinterpret_cast<void *>(&external_mixed),
+            {VmValueKind::integer, VmValueKind::f64, VmValueKind::f32, VmValueKind::integer},
+            VmValueKind::f64));
+
+        auto result = run(program, {3, to_register(0.5), to_register(0.25), 10});
+        REQUIRE(std::bit_cast<double>(result) == 3 * 0.5 + 0.25 - 10);
+    }
+
+    SECTION("f32 arguments and result")
+    {
+        // The f32 result is kept as a double in the register
+        BytecodeWriter w;
+        w.write_index_a_d(CALLX, 0, 0, 2);
+        w.write_a(RET, 2);
+
+        auto program = make_program(w, 2, 3);
+        program.external_calls.push_back(external_call(reinterpret_cast<void *>(&external_f32),
+                                                       {VmValueKind::f32, VmValueKind::f64},
+                                                       VmValueKind::f32));
+
+        auto result = run(program, {to_register(0.1), to_register(3.0)});
+        REQUIRE(std::bit_cast<double>(result) == static_cast<double>(0.1f * 3.0f));
+    }
+
+    SECTION("No result")
+    {
+        // The destination register keeps its value
+        BytecodeWriter w;
+        w.write_d_imm(LOADI, 1, 123);
+        w.write_index_a_d(CALLX, 0, 0, 1);
+        w.write_a(RET, 1);
+
+        auto program = make_program(w, 1, 2);
+        program.external_calls.push_back(
+            external_call(reinterpret_cast<void *>(&external_void), {VmValueKind::integer}, VmValueKind::none));
+
+        last_external_argument = 0;
+        REQUIRE(run(program, {42}) == 123);
+        REQUIRE(last_external_argument == 42);
+    }
+}
+
+TEST_CASE("Superinstructions", "[vm]")
+{
+    // sum := 0; for i in 0:<10 sum = sum + i * 3
+    BytecodeWriter w;
+    w.write_d_imm(LOADI, 0, 0);
+    w.write_d_imm(LOADI, 1, 0);
+    auto jmp_condition = w.write_target(JMP, -1);
+    auto body          = w.pos;
+    w.write_d_imm(LOADI, 2, 3);
+    w.write_d_a_b(MUL, 3, 1, 2);
+    w.write_d_a_b(ADD, 0, 0, 3);
+    w.write_d_a_imm(ADDI, 1, 1, 1);
+    w.patch_target(jmp_condition, static_cast<int32_t>(w.pos));
+    w.write_a_imm_target(JLTI, 1, 10, static_cast<int32_t>(body));
+    w.write_a(RET, 0);
+
+    auto program = make_program(w, 0, 4);
+    fuse_superinstructions(program);
+
+    REQUIRE(program.bytecode[body] == LOADI_MUL);
+    REQUIRE(program.bytecode[body + instruction_size(LOADI)] == MUL_ADD);
+    REQUIRE(program.bytecode[body + instruction_size(LOADI) + instruction_size(MUL)] == ADD);
+    REQUIRE(program.bytecode[body + instruction_size(LOADI) + 2 * instruction_size(MUL)] == ADDI_JLTI);
+
+    Vm vm;
+    load_program(&vm, &program);
+    REQUIRE(call_procedure(&vm, 0) == 135);
+
+    // LOADI, LOADI, JMP, JLTI, then LOADI_MUL (which continues with the MUL), ADD and ADDI_JLTI per iteration, RET
+    REQUIRE(vm.num_dispatches == 3 + 1 + 10 * 3 + 1);
+}
+
+TEST_CASE("Bytecode image", "[vm]")
+{
+    // main := proc() i64 return strlen("hello") + 1
+    BytecodeWriter w;
+    w.write_d_imm(LOADS, 1, 0);
+    w.write_index_a_d(CALLX, 0, 1, 0);
+    w.write_d_a_imm(ADDI, 0, 0, 1);
+    w.write_a(RET, 0);
+
+    auto program                     = make_program(w, 0, 2);
+    program.strings                  = std::string{"hello"} + '\0';
+    program.procedures[0].frame_size = 24;
+    program.external_calls.push_back(VmExternalCall{
+        .name           = "strlen",
+        .address        = reinterpret_cast<void *>(&strlen),
+        .argument_kinds = {VmValueKind::integer},
+        .return_kind    = VmValueKind::integer,
+    });
+    program.main_procedure = 0;
+
+    auto path = (std::filesystem::temp_directory_path() / "fasel_vm_test.fbc").string();
+    REQUIRE(write_bytecode_image(program, path));
+    REQUIRE(is_bytecode_image(path));
+
+    auto image = map_bytecode_image(path);
+    std::filesystem::remove(path);
+    REQUIRE(image.has_value());
+
+    REQUIRE(image->image != nullptr);
+    REQUIRE(image->bytecode.empty());
+    REQUIRE(std::ranges::equal(image->code(), program.code()));
+    REQUIRE(image->string_table().starts_with(program.string_table()));  // Followed by the procedure names
+    REQUIRE(image->main_procedure == 0);
+    REQUIRE(image->procedures.size() == 1);
+    REQUIRE(image->procedures[0].name == "test");
+    REQUIRE(image->procedures[0].num_registers == 2);
+    REQUIRE(image->procedures[0].frame_size == 24);
+    REQUIRE(image->external_calls.size() == 1);
+    REQUIRE(image->external_calls[0].name == "strlen");
+    REQUIRE(image->external_calls[0].address != nullptr);
+
+    REQUIRE(run(image.value()) == 6);
+}